@@ -30,6 +30,7 @@ SOURCES += src/attrmap.cpp \
     src/useralerts.cpp \
     src/utils.cpp \
     src/logging.cpp \
+    src/metrics.cpp \
     src/waiterbase.cpp  \
     src/proxy.cpp \
     src/pendingcontactrequest.cpp \
@@ -363,6 +364,7 @@ HEADERS  += include/mega.h \
             include/mega/useralerts.h \
             include/mega/utils.h \
             include/mega/logging.h \
+            include/mega/metrics.h \
             include/mega/waiter.h \
             include/mega/proxy.h \
             include/mega/pendingcontactrequest.h \
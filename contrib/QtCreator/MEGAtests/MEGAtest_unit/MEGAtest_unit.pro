@@ -24,18 +24,25 @@ include(../../../../bindings/qt/sdk.pri)
 
 SOURCES += \
 ../../../../tests/unit/AttrMap_test.cpp \
+../../../../tests/unit/BandwidthScheduler_test.cpp \
 ../../../../tests/unit/ChunkMacMap_test.cpp \
 ../../../../tests/unit/Commands_test.cpp \
 ../../../../tests/unit/Crypto_test.cpp \
+../../../../tests/unit/FileAttributeCache_test.cpp \
+../../../../tests/unit/FileAttributeFetch_test.cpp \
 ../../../../tests/unit/FileFingerprint_test.cpp \
 ../../../../tests/unit/File_test.cpp \
+../../../../tests/unit/FileSystemAccess_test.cpp \
 ../../../../tests/unit/FsNode.cpp \
 ../../../../tests/unit/Logging_test.cpp \
 ../../../../tests/unit/main.cpp \
 ../../../../tests/unit/MediaProperties_test.cpp \
 ../../../../tests/unit/MegaApi_test.cpp \
+../../../../tests/unit/Metrics_test.cpp \
+../../../../tests/unit/Node_test.cpp \
 ../../../../tests/unit/PayCrypter_test.cpp \
 ../../../../tests/unit/PendingContactRequest_test.cpp \
+../../../../tests/unit/Raid_test.cpp \
 ../../../../tests/unit/Serialization_test.cpp \
 ../../../../tests/unit/Share_test.cpp \
 ../../../../tests/unit/Sync_test.cpp \
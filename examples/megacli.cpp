@@ -3561,7 +3561,6 @@ void exec_cp(autocomplete::ACState& s)
 void exec_du(autocomplete::ACState& s)
 {
     Node *n;
-    TreeProcDU du;
 
     if (s.words.size() > 1)
     {
@@ -3579,11 +3578,11 @@ void exec_du(autocomplete::ACState& s)
 
     if (n)
     {
-        client->proctree(n, &du);
+        const NodeCounter& nc = n->subnodeCounts();
 
-        cout << "Total storage used: " << (du.numbytes / 1048576) << " MB" << endl;
-        cout << "Total # of files: " << du.numfiles << endl;
-        cout << "Total # of folders: " << du.numfolders << endl;
+        cout << "Total storage used: " << (nc.storage / 1048576) << " MB" << endl;
+        cout << "Total # of files: " << nc.files << endl;
+        cout << "Total # of folders: " << nc.folders << endl;
     }
 }
 
@@ -57,6 +57,7 @@
 #include "mega/pendingcontactrequest.h"
 #include "mega/utils.h"
 #include "mega/logging.h"
+#include "mega/metrics.h"
 #include "mega/waiter.h"
 
 #include "mega/node.h"
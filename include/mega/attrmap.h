@@ -26,8 +26,48 @@
 
 namespace mega {
 
-// maps attribute names to attribute values
-typedef map<nameid, string> attr_map;
+// Maps attribute names to attribute values, as a vector sorted by name.  Nodes carry only a
+// handful of attributes, so this takes one allocation instead of a tree node per attribute.
+// Unlike std::map, inserting or erasing an entry moves the ones after it, invalidating
+// iterators and references to them.
+class MEGA_API AttrFlatMap
+{
+public:
+    typedef std::pair<nameid, string> value_type;
+    typedef vector<value_type>::iterator iterator;
+    typedef vector<value_type>::const_iterator const_iterator;
+
+    AttrFlatMap() = default;
+    AttrFlatMap(std::initializer_list<value_type>);
+
+    iterator begin() { return entries.begin(); }
+    iterator end() { return entries.end(); }
+    const_iterator begin() const { return entries.begin(); }
+    const_iterator end() const { return entries.end(); }
+
+    size_t size() const { return entries.size(); }
+    bool empty() const { return entries.empty(); }
+    void clear() { entries.clear(); }
+    void swap(AttrFlatMap& other) { entries.swap(other.entries); }
+
+    iterator find(nameid);
+    const_iterator find(nameid) const;
+    size_t count(nameid name) const { return find(name) != end(); }
+
+    // inserts an empty value if `name` is not present
+    string& operator[](nameid name);
+
+    iterator erase(iterator it) { return entries.erase(it); }
+    size_t erase(nameid);
+
+    bool operator==(const AttrFlatMap& other) const { return entries == other.entries; }
+    bool operator!=(const AttrFlatMap& other) const { return entries != other.entries; }
+
+private:
+    vector<value_type> entries;
+};
+
+typedef AttrFlatMap attr_map;
 
 struct MEGA_API AttrMap
 {
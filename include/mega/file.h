@@ -59,6 +59,9 @@ struct MEGA_API File: public FileFingerprint
     // local filename (must be set upon injection for uploads, can be set in start() for downloads)
     string localname;
 
+    // for uploads whose content is still being received: read instead of localname
+    std::shared_ptr<UploadStream> uploadstream;
+
     // source/target node handle
     handle h;
 
@@ -75,6 +78,9 @@ struct MEGA_API File: public FileFingerprint
 
         // is the source file temporary?
         bool temporaryfile : 1;
+
+        // is this part of a scheduled backup? (backup transfers aren't cached, so not serialized)
+        bool backupxfer : 1;
     };
 
     // private auth to access the node
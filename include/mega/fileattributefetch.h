@@ -46,14 +46,39 @@ struct MEGA_API FileAttributeFetchChannel
     faf_map fafs[2];
     error e;
 
+    // further POSTs to the same URL, so that attributes queued while req is in flight don't wait for it
+    static const unsigned MAXPIPELINED = 3;
+
+    struct Pipelined
+    {
+        HttpReq req;
+        size_t inbytes = 0;
+        BackoffTimer timeout;
+        error e = API_EFAILED;
+
+        Pipelined(PrnGen& rng) : timeout(rng) { }
+    };
+
+    list<unique_ptr<Pipelined>> pipelined;
+
     // dispatch new and retrying attributes by POSTing to existing URL
     void dispatch();
 
-    // parse fetch result and remove completed attributes from pending
-    void parse(int, bool);
+    // POST the new attributes in one more request while req is in flight
+    void pipeline();
+
+    // advance the pipelined requests, dropping the finished ones
+    void pipelineio();
+
+    // parse fetch result of a request and remove completed attributes from pending
+    void parse(HttpReq&, bool);
 
-    // notify app of nodes that failed to receive their requested attribute
-    void failed();
+    // notify app of nodes that failed to receive their attribute from a request, with that request's error
+    void failed(HttpReq&, error);
+
+    // an HTML response to a plain HTTP request means something on the way rewrites the traffic:
+    // switch the client to HTTPS and get a fresh URL (returns true if so)
+    bool switchtohttps(HttpReq&);
 
     FileAttributeFetchChannel(MegaClient*);
 };
@@ -67,8 +92,59 @@ struct MEGA_API FileAttributeFetch
     int retries;
     int tag;
 
+    // request it was POSTed in, while pending
+    HttpReq* req = nullptr;
+
     FileAttributeFetch(handle, string, fatype, int);
 };
+
+// size-bounded on-disk cache of fetched file attributes, kept as received (encrypted with the
+// file's key) in one file per attribute handle; the least recently used ones are evicted first
+class MEGA_API FileAttributeCache
+{
+public:
+    // handles and sizes of the entries in a folder, least recently used first
+    typedef vector<pair<handle, m_off_t>> entry_vector;
+
+    // lists the entries left in localfolder by previous sessions and removes interrupted writes;
+    // it only touches the filesystem, so it may run without the client's lock
+    static entry_vector scan(struct FileSystemAccess&, const string& localfolder);
+
+    // localfolder in local encoding; takes over the `existing` entries (from scan()) that fit
+    FileAttributeCache(struct FileSystemAccess&, const string& localfolder, m_off_t maxsize, const entry_vector& existing);
+
+    // scans localfolder itself
+    FileAttributeCache(struct FileSystemAccess&, const string& localfolder, m_off_t maxsize);
+
+    bool get(handle fah, string* data);
+    bool contains(handle fah) const;
+    void put(handle fah, const char* data, size_t len);
+    void remove(handle fah);
+
+    m_off_t size() const { return mSize; }
+    size_t count() const { return mEntries.size(); }
+
+private:
+    struct Entry
+    {
+        m_off_t size;
+        list<handle>::iterator lru_it;
+    };
+
+    struct FileSystemAccess& fsaccess;
+    string mFolder;
+    m_off_t mMaxSize;
+    m_off_t mSize = 0;
+
+    map<handle, Entry> mEntries;
+
+    // most recently used first
+    list<handle> mLru;
+
+    static string localpath(struct FileSystemAccess&, const string& folder, handle);
+    string localpath(handle fah) const { return localpath(fsaccess, mFolder, fah); }
+    void erase(map<handle, Entry>::iterator);
+};
 } // namespace
 
 #endif
@@ -22,6 +22,7 @@
 #pragma once
 
 #include <array>
+#include <vector>
 
 #include "types.h"
 #include "filesystem.h"
@@ -45,6 +46,9 @@ struct MEGA_API FileFingerprint : public Cachable
     // Generates a fingerprint by iterating through `is`
     bool genfingerprint(InputStreamAccess* is, m_time_t cmtime, bool ignoremtime = false);
 
+    // Offsets and lengths of the reads genfingerprint(FileAccess*) makes in a file of `size` bytes
+    static std::vector<std::pair<m_off_t, unsigned>> sampledranges(m_off_t size);
+
     void serializefingerprint(string* d) const;
     int unserializefingerprint(string* d);
 
@@ -22,6 +22,9 @@
 #ifndef MEGA_FILESYSTEM_H
 #define MEGA_FILESYSTEM_H 1
 
+#include <functional>
+#include <mutex>
+
 #include "types.h"
 #include "waiter.h"
 
@@ -169,6 +172,82 @@ struct MEGA_API InputStreamAccess
     virtual ~InputStreamAccess() { }
 };
 
+// content of an upload that is still being received (e.g. the body of a WebDAV PUT):
+// a producer appends it from its own thread while the upload reads it through a StreamFileAccess.
+// Bytes are kept until the upload releases them, so the memory used is bounded by how far
+// the producer is allowed to get ahead.  The ranges the fingerprint reads are kept too,
+// as it can only be generated once all the content has arrived.
+class MEGA_API UploadStream
+{
+public:
+    enum readresult { READ_OK, READ_PENDING, READ_FAILED };
+
+    UploadStream(m_off_t size, m_time_t mtime);
+
+    // total size and mtime of the content
+    const m_off_t size;
+    const m_time_t mtime;
+
+    // producer: add the next bytes of the content
+    void append(const byte*, size_t);
+
+    // producer: nothing else will be appended.  Reads of missing bytes fail from now on
+    void abort();
+
+    // producer: bytes appended and not released yet
+    m_off_t buffered() const;
+
+    // producer: called (with the stream locked) whenever the upload releases bytes
+    void setreleasecallback(std::function<void()>);
+
+    // upload: copy len bytes at pos.  READ_PENDING if they haven't arrived yet,
+    // in which case waiter is notified upon the next append() or abort()
+    readresult read(byte*, unsigned, m_off_t, Waiter*);
+
+    // upload: the bytes before pos won't be read again
+    void release(m_off_t);
+
+    // upload: the content can still be read from its first byte
+    bool canrestart() const;
+
+private:
+    mutable std::mutex mMutex;
+
+    // appended bytes from mDataPos on; those before mReleased are dropped in batches
+    string mData;
+    m_off_t mDataPos = 0;
+    m_off_t mReleased = 0;
+    m_off_t mReceived = 0;
+    bool mAborted = false;
+
+    // copies of the ranges read by the fingerprint, see FileFingerprint::sampledranges()
+    std::vector<std::pair<m_off_t, string>> mSamples;
+    size_t mNextSample = 0;
+
+    Waiter* mWaiter = nullptr;
+    std::function<void()> mReleaseCallback;
+};
+
+// reads an UploadStream as if it was the local file being uploaded
+struct MEGA_API StreamFileAccess : public FileAccess
+{
+    bool fopen(string*, bool, bool);
+    void updatelocalname(string*);
+    bool fwrite(const byte *, unsigned, m_off_t);
+
+    StreamFileAccess(std::shared_ptr<UploadStream>, Waiter*);
+
+protected:
+    // reads of bytes not received yet fail with retry set
+    bool sysread(byte *, unsigned, m_off_t);
+    bool sysstat(m_time_t*, m_off_t*);
+    bool sysopen(bool async = false);
+    void sysclose();
+
+private:
+    std::shared_ptr<UploadStream> mStream;
+};
+
 // generic host directory enumeration
 struct MEGA_API DirAccess
 {
@@ -25,6 +25,9 @@
 #include "types.h"
 #include "waiter.h"
 #include "backofftimer.h"
+#include "metrics.h"
+
+#include <mutex>
 
 #ifndef _WIN32
 #include <sys/types.h>
@@ -117,6 +120,49 @@ protected:
     int speedCounter;
 };
 
+// Shares a bandwidth limit between request classes with one token bucket per class.  Classes
+// that asked for bandwidth recently are refilled with their minimum rate plus a weighted share
+// of what is left; whatever overflows a full bucket goes to the other busy classes, so a class
+// only loses bandwidth to more urgent ones while they can actually use it.
+class MEGA_API BandwidthScheduler
+{
+public:
+    // a class that hasn't asked for this long doesn't take a share
+    static const dstime IDLEDS;
+
+    // bucket depth, in deciseconds of the class's share
+    static const dstime BURSTDS;
+
+    BandwidthScheduler();
+
+    // bytes per second shared by all classes, 0 for no limit
+    void setlimit(m_off_t bps);
+    m_off_t getlimit() const { return limit; }
+
+    void setclass(bwclass_t, unsigned weight, m_off_t minbps);
+
+    // bytes `cls` may send or receive now; <= 0 means the request should wait
+    m_off_t available(bwclass_t cls, dstime now);
+
+    // record bytes moved (may exceed available(), the debt is repaid by later refills)
+    void consume(bwclass_t cls, m_off_t bytes);
+
+private:
+    struct BwClass
+    {
+        unsigned weight;
+        m_off_t minbps;
+        m_off_t tokens;
+        dstime lastdemand;
+    };
+
+    void refill(dstime now);
+
+    BwClass classes[BW_CLASSES];
+    m_off_t limit;
+    dstime lastrefill;
+};
+
 // generic host HTTP I/O interface
 struct MEGA_API HttpIO : public EventTrigger
 {
@@ -160,6 +206,10 @@ struct MEGA_API HttpIO : public EventTrigger
     m_off_t uploadSpeed;
     void updateuploadspeed(m_off_t size = 0);
 
+    // this instance's speeds in the process-wide metrics
+    MetricGaugeShare downloadSpeedMetric{Metrics::get().downloadSpeed};
+    MetricGaugeShare uploadSpeedMetric{Metrics::get().uploadSpeed};
+
     // data receive timeout (ds)
     static const int NETWORKTIMEOUT;
 
@@ -193,10 +243,66 @@ struct MEGA_API HttpIO : public EventTrigger
     // get max upload speed
     virtual m_off_t getmaxuploadspeed();
 
+    // how the download (GET) and upload (PUT) limits are shared between request classes
+    BandwidthScheduler bandwidth[2];
+
     HttpIO();
     virtual ~HttpIO() { }
 };
 
+// Recycles the buffers that file downloads are received into.  Capacities are rounded up
+// to a size class (see capacity()), and a buffer whose last reference goes away is kept
+// for the next request of the same class (up to MAXPOOLED bytes in total).  A steady
+// download therefore cycles through the same few allocations instead of faulting in fresh
+// pages for every request.  The pooled buffers are freed once no client has transfers.
+class MEGA_API DownloadBufferPool
+{
+public:
+    static const size_t MINPOOLED = 4096;
+    static const size_t GRANULE = 128 << 10;
+    static const size_t MAXPOOLED = 64 << 20;
+
+    static DownloadBufferPool& get();
+
+    // at least len bytes, handed back to the pool when the last reference is dropped
+    std::shared_ptr<byte> acquire(size_t len);
+
+    // size of the buffer acquire(len) hands out: a power of two up to GRANULE, so that small
+    // requests share a few classes, and a multiple of GRANULE above, so that chunk-sized
+    // requests waste little
+    static size_t capacity(size_t len);
+
+    // bytes currently held for reuse
+    size_t pooled();
+
+    // frees the buffers held for reuse
+    void trim();
+
+    // marks its owner as having transfers in progress; buffers are only kept while some owner
+    // is active, and the pool is trimmed when the last one goes idle
+    class MEGA_API Activity
+    {
+    public:
+        Activity() = default;
+        ~Activity() { set(false); }
+
+        void set(bool active);
+
+        MEGA_DISABLE_COPY_MOVE(Activity)
+
+    private:
+        bool mActive = false;
+    };
+
+private:
+    void release(byte* b, size_t capacity);
+
+    std::mutex mMutex;
+    std::map<size_t, std::vector<byte*>> mFree;
+    size_t mPooled = 0;
+    unsigned mActive = 0;
+};
+
 // outgoing HTTP request
 struct MEGA_API HttpReq
 {
@@ -214,6 +320,9 @@ struct MEGA_API HttpReq
     bool protect;
     bool minspeed;
 
+    // share of the bandwidth limit this request competes in
+    bwclass_t bwclass;
+
     bool sslcheckfailed;
     string sslfakeissuer;
 
@@ -224,7 +333,9 @@ struct MEGA_API HttpReq
 
     string outbuf;
 
+    // fixed size receive buffer for binary data, owned by pooledbuf
     byte* buf;
+    std::shared_ptr<byte> pooledbuf;
     m_off_t buflen, bufpos, notifiedbufpos;
 
     // we assume that API responses are smaller than 4 GB
@@ -266,6 +377,7 @@ struct MEGA_API HttpReq
     size_t size();
 
     // a buffer that the HttpReq filled in.   This struct owns the buffer (so HttpReq no longer has it).
+    // The memory is refcounted, so share() can hand out part of it without copying.
     struct http_buf_t 
     { 
         byte* datastart();
@@ -275,12 +387,15 @@ struct MEGA_API HttpReq
         size_t end;
 
         http_buf_t(byte* b, size_t s, size_t e);  // takes ownership of the byte*, which must have been allocated with new[]
-        ~http_buf_t();
+        http_buf_t(std::shared_ptr<byte> b, size_t s, size_t e);
         void swap(http_buf_t& other);
         bool isNull();
 
+        // another view of bytes [s, e) of the same memory, which stays allocated while either view exists
+        http_buf_t* share(size_t s, size_t e) const;
+
     private: 
-        byte* buf;
+        std::shared_ptr<byte> buf;
     };
     
     // give up ownership of the buffer for client to use.  The caller is the new owner of the http_buf_t, and the HttpReq no longer has the buffer or any info about it.
@@ -86,19 +86,39 @@
 
     In performance mode, only outputting to a logger assigned through `setOutputClass` is supported.
     Output streams are not supported.
+
+    5) Asynchronous mode can be enabled via defining ENABLE_LOG_ASYNC at compile time.
+
+    In asynchronous mode, `SimpleLogger` only records the values streamed into it in binary form
+    (a `LogRecord`) and queues them.  A background thread formats the records and delivers them,
+    in order, to the logger and the output streams, so logging costs the calling thread little more
+    than a few copies.  When the queue is full, debug and verbose records are dropped (their count
+    is reported in a warning once there is room again) and more severe ones wait for room.
+    Fatal records are delivered before the logging call returns, as is everything queued before
+    `flush()`.
 */
 #pragma once
 
 #include <array>
 #include <atomic>
 #include <cassert>
+#include <condition_variable>
+#include <cstdint>
 #include <cstring>
+#include <ctime>
+#include <functional>
 #include <iostream>
+#include <memory>
 #include <mutex>
 #include <sstream>
 #include <string>
+#include <thread>
 #include <vector>
 
+#if defined(ENABLE_LOG_PERFORMANCE) && defined(ENABLE_LOG_ASYNC)
+    #error "ENABLE_LOG_PERFORMANCE and ENABLE_LOG_ASYNC are mutually exclusive"
+#endif
+
 // define MEGA_QT_LOGGING to support QString
 #ifdef MEGA_QT_LOGGING
     #include <QString>
@@ -132,17 +152,240 @@ typedef std::vector<std::ostream *> OutputStreams;
 
 class OutputMap : public std::array<OutputStreams, unsigned(logMax)+1> {};
 
+// A log line in binary form: its origin and the values streamed into it, not formatted yet.
+// Values are stored inline while they fit; the rest of a long line is formatted on the spot
+// into `spill`, so it still comes out whole.
+struct LogRecord
+{
+    static const size_t DATASIZE = 464;
+
+    enum Tag : char { SIGNED, UNSIGNED, FLOATING, POINTER, CHARACTER, STRING };
+
+    time_t time = 0;
+    int line = -1;
+    LogLevel level = logInfo;
+    std::unique_ptr<std::string> spill;
+
+    LogRecord() = default;
+
+    // copies only the bytes in use
+    LogRecord& operator=(LogRecord&& other)
+    {
+        time = other.time;
+        line = other.line;
+        level = other.level;
+        spill = std::move(other.spill);
+        mUsed = other.mUsed;
+        memcpy(mData, other.mData, mUsed);
+        return *this;
+    }
+
+    // stamps the current time; `file` is copied, so it needn't outlive the record
+    LogRecord(LogLevel, const char* file, int line);
+
+    void putSigned(long long value) { put(SIGNED, value); }
+    void putUnsigned(unsigned long long value) { put(UNSIGNED, value); }
+    void putFloating(double value) { put(FLOATING, value); }
+    void putPointer(const void* value) { put(POINTER, value); }
+    void putChar(char value) { put(CHARACTER, value); }
+    void putString(const char* value, size_t len);
+
+    // "file:line" and the message text, as passed to Logger::log
+    void format(std::string& source, std::string& message) const;
+
+private:
+    // bytes used in data: a tag followed by the value, a string being its uint16_t length and bytes
+    uint16_t mUsed = 0;
+    char mData[DATASIZE];
+
+    template<typename T>
+    void put(Tag tag, const T value)
+    {
+        if (!spill && mUsed + 1 + sizeof(value) <= DATASIZE)
+        {
+            mData[mUsed] = tag;
+            memcpy(mData + mUsed + 1, &value, sizeof(value));
+            mUsed = static_cast<uint16_t>(mUsed + 1 + sizeof(value));
+        }
+        else
+        {
+            char bytes[sizeof(value)];
+            memcpy(bytes, &value, sizeof(value));
+            appendValue(spillString(), tag, bytes);
+        }
+    }
+
+    std::string& spillString();
+
+    static void appendValue(std::string&, Tag, const char* bytes);
+};
+
+// Bounded lock-free queue of LogRecords from any number of threads, formatted and delivered in
+// order by a thread of its own.  When it is full, records less severe than `dropFrom` are
+// dropped and counted, and the others wait for room.
+class AsyncLogQueue
+{
+public:
+    // called on the queue's thread, with the same arguments as Logger::log
+    using Deliver = std::function<void(const char* time, int loglevel, const char* source, const char* message)>;
+
+    // called after each batch of records is delivered, so a crash loses little of the output
+    using FlushOutputs = std::function<void()>;
+
+    // `capacity` must be a power of two
+    AsyncLogQueue(size_t capacity, LogLevel dropFrom, Deliver, FlushOutputs = nullptr);
+
+    // delivers everything queued, then stops
+    ~AsyncLogQueue();
+
+    // queues the record (moved from); false if it was dropped
+    bool push(LogRecord&);
+
+    // returns once everything pushed so far has been delivered
+    void flush();
+
+    // delivers everything queued and stops the thread; later records are delivered synchronously
+    void stop();
+
+    // number of records dropped so far
+    uint64_t dropped() const { return mDropped.load(); }
+
+private:
+    struct Slot
+    {
+        // equals the position of the next push to this slot while it is free,
+        // and that position + 1 once the record is in
+        std::atomic<size_t> seq;
+        LogRecord record;
+    };
+
+    std::unique_ptr<Slot[]> mSlots;
+    const size_t mMask;
+    const LogLevel mDropFrom;
+    const Deliver mDeliver;
+    const FlushOutputs mFlushOutputs;
+
+    std::atomic<size_t> mTail{0};
+    std::atomic<uint64_t> mDropped{0};
+
+    // consumer state; once stopped, whoever holds mDeliverMutex is the consumer
+    // (recursive, in case a Logger logs from within log())
+    size_t mHead = 0;
+    uint64_t mReported = 0;
+    time_t mLastTime = 0;
+    std::string mTimeStr;
+    std::recursive_mutex mDeliverMutex;
+    std::atomic<size_t> mDelivered{0};
+
+    std::atomic<bool> mIdle{false};
+    std::atomic<bool> mStopping{false};
+    std::atomic<bool> mStopped{false};
+    std::atomic<int> mFlushing{0};
+    std::mutex mWakeMutex;
+    std::condition_variable mWakeCondition;
+    std::condition_variable mFlushedCondition;
+    std::thread mThread;
+
+    void run();
+    void wake();
+    bool ready(size_t pos) const;
+    void consume();
+    void drain();
+    void deliver(LogRecord&);
+    void deliverNow(LogRecord&);
+    void reportDropped();
+};
+
 class SimpleLogger
 {
     enum LogLevel level;
 
-#ifndef ENABLE_LOG_PERFORMANCE
+#ifdef ENABLE_LOG_ASYNC
+    LogRecord mRecord;
+
+    // records of this level and above are dropped when the queue is full
+    static const LogLevel ASYNCDROPFROM = logDebug;
+    static const size_t ASYNCQUEUESIZE = 2048;
+
+    static AsyncLogQueue& asyncQueue();
+
+    // output on the queue's thread
+    static void deliver(const char* time, int loglevel, const char* source, const char* message);
+    static void flushOutputs();
+
+    template<typename T>
+    typename std::enable_if<std::is_enum<T>::value>::type
+    logValue(const T value)
+    {
+        mRecord.putSigned(static_cast<int>(value));
+    }
+
+    template<typename T>
+    typename std::enable_if<std::is_pointer<T>::value && !std::is_same<T, char*>::value>::type
+    logValue(const T value)
+    {
+        mRecord.putPointer(reinterpret_cast<const void*>(value));
+    }
+
+    template<typename T>
+    typename std::enable_if<std::is_same<T, char>::value || std::is_same<T, signed char>::value
+                            || std::is_same<T, unsigned char>::value>::type
+    logValue(const T value)
+    {
+        mRecord.putChar(static_cast<char>(value));
+    }
+
+    template<typename T>
+    typename std::enable_if<std::is_integral<T>::value && std::is_signed<T>::value
+                            && !std::is_same<T, char>::value && !std::is_same<T, signed char>::value>::type
+    logValue(const T value)
+    {
+        mRecord.putSigned(value);
+    }
+
+    template<typename T>
+    typename std::enable_if<std::is_integral<T>::value && std::is_unsigned<T>::value
+                            && !std::is_same<T, char>::value && !std::is_same<T, unsigned char>::value>::type
+    logValue(const T value)
+    {
+        mRecord.putUnsigned(value);
+    }
+
+    template<typename T>
+    typename std::enable_if<std::is_floating_point<T>::value>::type
+    logValue(const T value)
+    {
+        mRecord.putFloating(static_cast<double>(value));
+    }
+
+    void logValue(const char* value)
+    {
+        mRecord.putString(value, std::strlen(value));
+    }
+
+    void logValue(const std::string& value)
+    {
+        mRecord.putString(value.data(), value.size());
+    }
+
+    // anything else that can be streamed is formatted right away
+    template<typename T>
+    typename std::enable_if<!std::is_scalar<T>::value>::type
+    logValue(const T& value)
+    {
+        std::ostringstream oss;
+        oss << value;
+        logValue(oss.str());
+    }
+#elif !defined(ENABLE_LOG_PERFORMANCE)
     std::ostringstream ostr;
     std::string t;
     std::string fname;
 
     std::string getTime();
+#endif
 
+#ifndef ENABLE_LOG_PERFORMANCE
     // logging can occur from multiple threads, so we need to protect the lists of loggers to send to
     // though the loggers themselves are presumed to be owned elsewhere, and the pointers must remain valid
     // actual output to the loggers is not synchronised (at least, not by this class)
@@ -289,6 +532,8 @@ public:
     : level{ll}
 #ifdef ENABLE_LOG_PERFORMANCE
     , mBufferIt{mBuffer.begin()}
+#elif defined(ENABLE_LOG_ASYNC)
+    , mRecord{ll, filename, line}
 #endif
     {
 #ifdef ENABLE_LOG_PERFORMANCE
@@ -304,7 +549,7 @@ public:
         copyToBuffer(":", 1);
         logValue(line);
         copyToBuffer(" ", 1);
-#else
+#elif !defined(ENABLE_LOG_ASYNC)
         if (!logger)
         {
             return;
@@ -325,6 +570,13 @@ public:
     {
 #ifdef ENABLE_LOG_PERFORMANCE
         outputBuffer();
+#elif defined(ENABLE_LOG_ASYNC)
+        AsyncLogQueue& queue = asyncQueue();
+        queue.push(mRecord);
+        if (level == logFatal)
+        {
+            queue.flush();
+        }
 #else
         OutputStreams::iterator iter;
         OutputStreams vec;
@@ -370,6 +622,15 @@ public:
         {
             copyToBuffer("(NULL)", 6);
         }
+#elif defined(ENABLE_LOG_ASYNC)
+        if (obj)
+        {
+            logValue(obj);
+        }
+        else
+        {
+            mRecord.putString("(NULL)", 6);
+        }
 #else
         if (obj)
         {
@@ -387,7 +648,7 @@ public:
     SimpleLogger& operator<<(const T obj)
     {
         static_assert(!std::is_same<T, std::nullptr_t>::value, "T cannot be nullptr_t");
-#ifdef ENABLE_LOG_PERFORMANCE
+#if defined(ENABLE_LOG_PERFORMANCE) || defined(ENABLE_LOG_ASYNC)
         logValue(obj);
 #else
         ostr << obj;
@@ -398,7 +659,7 @@ public:
     template <typename T, typename = typename std::enable_if<!std::is_scalar<T>::value>::type>
     SimpleLogger& operator<<(const T& obj)
     {
-#ifdef ENABLE_LOG_PERFORMANCE
+#if defined(ENABLE_LOG_PERFORMANCE) || defined(ENABLE_LOG_ASYNC)
         logValue(obj);
 #else
         ostr << obj;
@@ -409,7 +670,7 @@ public:
 #ifdef MEGA_QT_LOGGING
     SimpleLogger& operator<<(const QString& s)
     {
-#ifdef ENABLE_LOG_PERFORMANCE
+#if defined(ENABLE_LOG_PERFORMANCE) || defined(ENABLE_LOG_ASYNC)
         logValue(s.toUtf8().constData());
 #else
         ostr << s.toUtf8().constData();
@@ -438,6 +699,7 @@ public:
     static void setAllOutputs(std::ostream *os);
 
     // Synchronizes all registered stream buffers with their controlled output sequence
+    // (in asynchronous mode, after delivering everything queued)
     static void flush();
 #endif
 };
@@ -92,6 +92,9 @@ struct MEGA_API MegaApp
     // nodes have been updated
     virtual void nodes_updated(Node**, int) { }
 
+    // a node's key or attributes have been applied (not reported by nodes_updated())
+    virtual void node_decrypted(handle) { }
+
     // nodes have been updated
     virtual void pcrs_updated(PendingContactRequest**, int) { }
 
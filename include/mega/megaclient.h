@@ -448,7 +448,8 @@ public:
     // (give the user ample warning about possible sync repercussions)
     bool followsymlinks;
 
-    // number of parallel connections per transfer (PUT/GET)
+    // number of parallel connections per transfer (PUT/GET) - non-raid transfers start with these
+    // and then use as many as improve their throughput, up to MAX_NUM_CONNECTIONS
     unsigned char connections[2];
 
     // generate & return next upload handle
@@ -469,6 +470,9 @@ public:
 
     // queue file attribute retrieval
     error getfa(handle h, string *fileattrstring, const string &nodekey, fatype, int = 0);
+
+    // fetch a node's file attribute into facache without notifying the app
+    void prefetchfa(Node*, fatype);
     
     // notify delayed upload completion subsystem about new file attribute
     void checkfacompletion(handle, Transfer* = NULL);
@@ -987,11 +991,20 @@ public:
     // reqs[r^1] is being processed on the API server
     HttpReq* pendingcs;
 
+    // when pendingcs was posted, for the cs latency metric
+    std::chrono::steady_clock::time_point csRequestSent;
+
+    // this client's queues in the process-wide metrics, refreshed by exec()
+    MetricGaugeShare csQueuedMetric{Metrics::get().csQueued};
+    MetricGaugeShare downloadsQueuedMetric{Metrics::get().downloadsQueued};
+    MetricGaugeShare uploadsQueuedMetric{Metrics::get().uploadsQueued};
+    MetricGaugeShare transferSlotsMetric{Metrics::get().transferSlots};
+
     // pending HTTP requests
     pendinghttp_map pendinghttp;
 
     // record type indicator for sctable
-    enum { CACHEDSCSN, CACHEDNODE, CACHEDUSER, CACHEDLOCALNODE, CACHEDPCR, CACHEDTRANSFER, CACHEDFILE, CACHEDCHAT } sctablerectype;
+    enum { CACHEDSCSN, CACHEDNODE, CACHEDUSER, CACHEDLOCALNODE, CACHEDPCR, CACHEDTRANSFER, CACHEDFILE, CACHEDCHAT, CACHEDTRANSFERJOURNAL } sctablerectype;
 
     // open/create state cache database table
     void opensctable();
@@ -1046,6 +1059,9 @@ public:
     // file attribute fetch channels
     fafc_map fafcs;
 
+    // fetched file attributes kept on disk, if enabled by the app
+    unique_ptr<FileAttributeCache> facache;
+
     // generate attribute string based on the pending attributes for this upload
     void pendingattrstring(handle, string*);
 
@@ -1084,6 +1100,9 @@ public:
     // transfer tslots
     transferslot_list tslots;
 
+    // holds on to the pooled download buffers while tslots is not empty
+    DownloadBufferPool::Activity downloadBufferActivity;
+
     // keep track of next transfer slot timeout
     BackoffTimerGroupTracker transferSlotsBackoff;
 
@@ -1093,6 +1112,13 @@ public:
     // FileFingerprint to node mapping
     Fingerprints mFingerprints;
 
+    // file nodes by ctime, for recents
+    NodesByCtime mNodesByCtime;
+
+    // set while every node is being deleted: ~Node() then leaves the indexes and counters
+    // that are cleared wholesale afterwards alone
+    bool mPurgingNodes = false;
+
     // send updates to app when the storage size changes
     int64_t mNotifiedSumSize = 0;
 
@@ -1138,6 +1164,11 @@ public:
     // update transfer in the persistent cache
     void transfercacheadd(Transfer*, DBTableTransactionCommitter*);
 
+    // record transfer progress in the persistent cache: appends a journal entry with the chunk MACs,
+    // and only rewrites the whole transfer once TRANSFERJOURNALCOMPACT entries have accumulated
+    void transferprogresscacheadd(Transfer*, DBTableTransactionCommitter*);
+    static const size_t TRANSFERJOURNALCOMPACT = 32;
+
     // remove a transfer from the persistent cache
     void transfercachedel(Transfer*, DBTableTransactionCommitter* committer);
 
@@ -1423,6 +1454,21 @@ public:
     // apply keys
     void applykeys();
 
+    // apply the keys of all nodes still lacking them, unwrapping keys that share a wrapping key together
+    void applykeysbatch();
+
+    // decrypt and parse the attributes of nodes whose keys have just been applied, in parallel for large batches
+    void decryptattrs(const node_vector&);
+
+    // threads to use for batch work that can be spread across cores
+    static unsigned workerthreads();
+
+    // minimum number of RSA-wrapped node keys for each extra thread decrypting them
+    static const size_t RSAKEYSPERTHREAD = 16;
+
+    // minimum number of attribute strings for each extra thread decrypting them
+    static const size_t ATTRSPERTHREAD = 2048;
+
     // send andy key rewrites prepared when keys were applied
     void sendkeyrewrites();
 
@@ -1476,6 +1522,17 @@ public:
     // process node subtree
     void proctree(Node*, TreeProc*, bool skipinshares = false, bool skipversions = false);
 
+    // process node subtree with read-only processors, one thread per processor, visiting every
+    // node once in no particular order; the caller merges the processors' results afterwards.
+    // the tree must not change meanwhile (hold the client's lock), and the walk stops early
+    // once `cancelled` returns true
+    void proctreeparallel(Node*, const vector<TreeProc*>&, bool skipinshares = false, bool skipversions = false,
+                          std::function<bool()> cancelled = nullptr);
+
+    // sort nodes of a subtree into the order proctree() visits them: siblings in the order of
+    // their parent's children, descendants before their ancestors
+    static void sortinproctreeorder(node_vector&, Node*);
+
     // hash password
     error pw_key(const char*, byte*) const;
 
@@ -0,0 +1,212 @@
+/**
+ * @file mega/metrics.h
+ * @brief Always-on runtime counters, gauges and histograms
+ *
+ * (c) 2013-2019 by Mega Limited, Auckland, New Zealand
+ *
+ * This file is part of the MEGA SDK - Client Access Engine.
+ *
+ * Applications using the MEGA API must present a valid application key
+ * and comply with the the rules set forth in the Terms of Service.
+ *
+ * The MEGA SDK is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.
+ *
+ * @copyright Simplified (2-clause) BSD License.
+ *
+ * You should have received a copy of the license along with this
+ * program.
+ */
+
+#ifndef MEGA_METRICS_H
+#define MEGA_METRICS_H 1
+
+#include <atomic>
+#include <chrono>
+
+#include "types.h"
+
+namespace mega {
+
+// Unlike CodeCounter, these are compiled in unconditionally.  Updates are single relaxed
+// atomic operations so they can be made from any thread, and a snapshot can be taken
+// from the app thread without taking the SDK mutex.
+class MEGA_API Metric
+{
+public:
+    enum Type { COUNTER, GAUGE, HISTOGRAM };
+
+    // registers itself in `registry`, which must outlive it
+    Metric(vector<Metric*>& registry, Type type, const char* name, const char* help, const char* labelName = nullptr, const char* labelValue = nullptr);
+    virtual ~Metric() { }
+
+    const Type type;
+    const char* const name;
+    const char* const help;
+    const char* const labelName;
+    const char* const labelValue;
+
+    virtual void appendJson(string& out) const = 0;
+    virtual void appendPrometheus(string& out) const = 0;
+
+    MEGA_DISABLE_COPY_MOVE(Metric)
+
+protected:
+    // `name{label="value",extra}` in Prometheus notation
+    string series(const char* suffix = "", const string& extraLabel = string()) const;
+};
+
+// monotonically increasing count of events or bytes
+class MEGA_API MetricCounter : public Metric
+{
+public:
+    MetricCounter(vector<Metric*>& registry, const char* name, const char* help, const char* labelName = nullptr, const char* labelValue = nullptr);
+
+    void add(uint64_t n = 1) { mValue.fetch_add(n, std::memory_order_relaxed); }
+    uint64_t value() const { return mValue.load(std::memory_order_relaxed); }
+
+    void appendJson(string& out) const override;
+    void appendPrometheus(string& out) const override;
+
+private:
+    std::atomic<uint64_t> mValue{0};
+};
+
+// last sampled value of a level, such as a queue depth
+class MEGA_API MetricGauge : public Metric
+{
+public:
+    MetricGauge(vector<Metric*>& registry, const char* name, const char* help, const char* labelName = nullptr, const char* labelValue = nullptr);
+
+    void set(int64_t v) { mValue.store(v, std::memory_order_relaxed); }
+    void add(int64_t d) { mValue.fetch_add(d, std::memory_order_relaxed); }
+    int64_t value() const { return mValue.load(std::memory_order_relaxed); }
+
+    void appendJson(string& out) const override;
+    void appendPrometheus(string& out) const override;
+
+private:
+    std::atomic<int64_t> mValue{0};
+};
+
+// distribution of durations, in power-of-two microsecond buckets from 1us to ~2 minutes
+class MEGA_API MetricHistogram : public Metric
+{
+public:
+    enum { BUCKETS = 28 };
+
+    MetricHistogram(vector<Metric*>& registry, const char* name, const char* help, const char* labelName = nullptr, const char* labelValue = nullptr);
+
+    void observe(std::chrono::steady_clock::duration d);
+    void observeMicroseconds(uint64_t us);
+
+    uint64_t count() const { return mCount.load(std::memory_order_relaxed); }
+    uint64_t sumMicroseconds() const { return mSum.load(std::memory_order_relaxed); }
+
+    // observations in bucket `i` (not cumulative); bucket BUCKETS holds everything larger
+    uint64_t bucket(unsigned i) const { return mBuckets[i].load(std::memory_order_relaxed); }
+
+    // upper bound of bucket `i`, in microseconds
+    static uint64_t bucketBound(unsigned i) { return uint64_t(1) << i; }
+
+    void appendJson(string& out) const override;
+    void appendPrometheus(string& out) const override;
+
+private:
+    std::atomic<uint64_t> mBuckets[BUCKETS + 1];
+    std::atomic<uint64_t> mCount{0};
+    std::atomic<uint64_t> mSum{0};
+};
+
+// one instance's part of a gauge summed over all instances (e.g. the queue of each MegaClient);
+// set() replaces only this part, and the destructor withdraws it
+class MEGA_API MetricGaugeShare
+{
+public:
+    explicit MetricGaugeShare(MetricGauge& g) : mGauge(g) { }
+    ~MetricGaugeShare() { mGauge.add(-mValue.load(std::memory_order_relaxed)); }
+
+    void set(int64_t v) { mGauge.add(v - mValue.exchange(v, std::memory_order_relaxed)); }
+
+    MEGA_DISABLE_COPY_MOVE(MetricGaugeShare)
+
+private:
+    MetricGauge& mGauge;
+    std::atomic<int64_t> mValue{0};
+};
+
+// records the lifetime of the scope into a histogram
+class MEGA_API MetricTimer
+{
+public:
+    explicit MetricTimer(MetricHistogram& h) : mHistogram(h), mStart(std::chrono::steady_clock::now()) { }
+    ~MetricTimer() { mHistogram.observe(std::chrono::steady_clock::now() - mStart); }
+
+    MEGA_DISABLE_COPY_MOVE(MetricTimer)
+
+private:
+    MetricHistogram& mHistogram;
+    std::chrono::steady_clock::time_point mStart;
+};
+
+// Process-wide metrics, shared by all MegaClient instances
+class MEGA_API Metrics
+{
+    // must be declared first: every metric below registers itself here on construction
+    vector<Metric*> mAll;
+
+public:
+    static Metrics& get();
+
+    // event loop
+    MetricHistogram execTime{mAll, "mega_exec_seconds", "Duration of MegaClient::exec() iterations"};
+    MetricCounter prepwaitImmediate{mAll, "mega_prepwait_total", "MegaClient::preparewait() outcomes", "reason", "immediate"};
+    MetricCounter prepwaitZero{mAll, "mega_prepwait_total", "MegaClient::preparewait() outcomes", "reason", "zero_timeout"};
+    MetricCounter prepwaitHttpio{mAll, "mega_prepwait_total", "MegaClient::preparewait() outcomes", "reason", "httpio"};
+    MetricCounter prepwaitFsaccess{mAll, "mega_prepwait_total", "MegaClient::preparewait() outcomes", "reason", "fsaccess"};
+    MetricCounter prepwaitSleep{mAll, "mega_prepwait_total", "MegaClient::preparewait() outcomes", "reason", "sleep"};
+
+    // API requests
+    MetricHistogram csLatency{mAll, "mega_cs_request_seconds", "Time from sending a cs batch to its response"};
+    MetricCounter csRequests{mAll, "mega_cs_requests_total", "cs batches completed"};
+    MetricGauge csQueued{mAll, "mega_cs_queued_commands", "Commands waiting to be sent"};
+
+    // transfers
+    MetricCounter downloadBytes{mAll, "mega_transfer_bytes_total", "Bytes transferred", "direction", "download"};
+    MetricCounter uploadBytes{mAll, "mega_transfer_bytes_total", "Bytes transferred", "direction", "upload"};
+    MetricGauge downloadSpeed{mAll, "mega_transfer_bytes_per_second", "Current transfer speed", "direction", "download"};
+    MetricGauge uploadSpeed{mAll, "mega_transfer_bytes_per_second", "Current transfer speed", "direction", "upload"};
+    MetricGauge downloadsQueued{mAll, "mega_transfers_queued", "Transfers waiting or in progress", "direction", "download"};
+    MetricGauge uploadsQueued{mAll, "mega_transfers_queued", "Transfers waiting or in progress", "direction", "upload"};
+    MetricGauge transferSlots{mAll, "mega_transfer_slots", "Transfers with an active slot"};
+    MetricCounter downloadBuffersPooled{mAll, "mega_download_buffers_total", "Download buffers handed out by DownloadBufferPool", "source", "pool"};
+    MetricCounter downloadBuffersAllocated{mAll, "mega_download_buffers_total", "Download buffers handed out by DownloadBufferPool", "source", "alloc"};
+
+    // app queries
+    MetricCounter nodeSnapshotHits{mAll, "mega_node_snapshot_lookups_total", "getNodeByHandle() lookups answered without sdkMutex", "result", "hit"};
+    MetricCounter nodeSnapshotMisses{mAll, "mega_node_snapshot_lookups_total", "getNodeByHandle() lookups answered without sdkMutex", "result", "miss"};
+
+    // local cache
+    MetricHistogram dbCommit{mAll, "mega_db_commit_seconds", "Duration of state cache transaction commits"};
+
+    // file data encryption (SymmCipher::ctr_crypt)
+    MetricCounter cryptoEncryptBytes{mAll, "mega_crypto_bytes_total", "Bytes processed by file data encryption", "operation", "encrypt"};
+    MetricCounter cryptoDecryptBytes{mAll, "mega_crypto_bytes_total", "Bytes processed by file data encryption", "operation", "decrypt"};
+    MetricHistogram cryptoTime{mAll, "mega_crypto_seconds", "Duration of file data encryption calls"};
+
+    const vector<Metric*>& all() const { return mAll; }
+
+    // [{"name":..,"type":..,...},...]
+    string json() const;
+
+    // text exposition format 0.0.4
+    string prometheus() const;
+
+    Metrics() = default;
+    MEGA_DISABLE_COPY_MOVE(Metrics)
+};
+
+} // namespace
+
+#endif
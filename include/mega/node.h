@@ -23,6 +23,9 @@
 #ifndef MEGA_NODE_H
 #define MEGA_NODE_H 1
 
+#include <functional>
+#include <unordered_map>
+
 #include "filefingerprint.h"
 #include "file.h"
 #include "attrmap.h"
@@ -105,6 +108,27 @@ private:
     m_off_t mSumSizes = 0;
 };
 
+// Container storing file nodes (versions included) ordered by ctime.
+// A node's ctime must not change while it is stored.
+struct NodesByCtime
+{
+    void add(Node* n);
+    void remove(Node* n);
+    void clear();
+
+    // visits nodes with ctime >= since, most recent first, until `visit` returns false
+    void recent(m_time_t since, std::function<bool(Node*)> visit) const;
+
+private:
+    // ties are broken by handle, so every node has a unique position
+    struct Cmp
+    {
+        bool operator()(const Node* a, const Node* b) const;
+    };
+
+    std::set<Node*, Cmp> mNodes;
+};
+
 
 // filesystem node
 struct MEGA_API Node : public NodeCore, FileFingerprint
@@ -132,12 +156,21 @@ struct MEGA_API Node : public NodeCore, FileFingerprint
     // try to resolve node key string
     bool applykey();
 
+    // locate the wrapped key in nodekeydata that this account can unwrap, and the key to unwrap it
+    // with (the master key or a share key); NULL if no suitable key is available yet
+    const char* findkey(SymmCipher**);
+
     // set up nodekey in a static SymmCipher
     SymmCipher* nodecipher();
 
     // decrypt attribute string and set fileattrs
     void setattr();
 
+    // the two halves of setattr(): decrypting and parsing attrstring (which only reads the node,
+    // so it may run off the client thread with a cipher of its own), and storing the result
+    bool decryptattrs(SymmCipher&, attr_map&) const;
+    void applyattrs(attr_map&);
+
     // display name (UTF-8)
     const char* displayname() const;
 
@@ -200,13 +233,18 @@ struct MEGA_API Node : public NodeCore, FileFingerprint
     
     void setkey(const byte* = NULL);
 
+    // update node key without decrypting attributes
+    void installkey(const byte*);
+
     void setkeyfromjson(const char*);
 
     void setfingerprint();
 
     void faspec(string*);
 
-    NodeCounter subnodeCounts() const;
+    // files, folders, versions and bytes in the subtree rooted here, this node included;
+    // maintained incrementally as nodes are attached, moved and deleted
+    const NodeCounter& subnodeCounts() const { return mCounter; }
 
     // parent
     Node* parent = nullptr;
@@ -217,6 +255,16 @@ struct MEGA_API Node : public NodeCore, FileFingerprint
     // own position in parent's children
     node_list::iterator child_it;
 
+    // visits the children whose display name is `name` (already normalized), in children order,
+    // until `visit` returns false
+    void childrenbyname(const string& name, std::function<bool(Node*)> visit);
+
+    // keeps the parent's name index and sortkey() current - call after changing attrs.map['n']
+    void namechanged();
+
+    // naturalsortkey() of the display name, computed on first use
+    const string& sortkey();
+
     // own position in fingerprint set (only valid for file nodes)
     Fingerprints::iterator fingerprint_it;
 
@@ -255,11 +303,40 @@ struct MEGA_API Node : public NodeCore, FileFingerprint
     Node(MegaClient*, vector<Node*>*, handle, handle, nodetype_t, m_off_t, handle, const char*, m_time_t);
     ~Node();
 
+    // nodes are carved from large shared slabs rather than allocated one by one
+    static void* operator new(size_t);
+    static void operator delete(void*, size_t);
+
+    // slabs currently held by that allocator
+    static size_t allocatorslabs();
+
 private:
     // full folder/file key, symmetrically or asymmetrically encrypted
     // node crypto keys (raw or cooked -
     // cooked if size() == FOLDERNODEKEYLENGTH or FILEFOLDERNODEKEYLENGTH)
     string nodekeydata;
+
+    // totals for subnodeCounts(), already included in every ancestor's
+    NodeCounter mCounter;
+
+    // folders with fewer children are searched linearly
+    static const size_t CHILDINDEXMIN = 32;
+
+    // children by hash of their display name, built by the first childrenbyname() on a large folder
+    unique_ptr<std::unordered_multimap<size_t, Node*>> mChildIndex;
+
+    // hash of displayname() this node is filed under in its parent's index
+    size_t mNameHash = 0;
+
+    // orders index hits like children: increases along the parent's list
+    uint64_t mChildSeq = 0;
+    uint64_t mNextChildSeq = 0;
+
+    // empty until sortkey() is called
+    string mSortKey;
+
+    void indexchild(Node*);
+    void unindexchild(Node*);
 };
 
 inline const string& Node::nodekey() const
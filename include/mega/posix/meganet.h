@@ -172,8 +172,6 @@ protected:
     bool arerequestspaused[3];
     int numconnections[3];
     set<CURL *>pausedrequests[3];
-    m_off_t partialdata[2];
-    m_off_t maxspeed[2];
     bool curlsocketsprocessed;
     m_time_t arestimeout;
 
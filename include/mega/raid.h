@@ -30,6 +30,11 @@ namespace mega {
     enum { RAIDSECTOR = 16 };
     enum { RAIDLINE = ((RAIDPARTS - 1)*RAIDSECTOR) };
 
+    // Reassemble `partslen` bytes (a multiple of RAIDSECTOR) from each raid part into `dest`, which
+    // receives partslen * (RAIDPARTS - 1) bytes of file data.  inputbufs[0] is the parity part.
+    // At most one entry may be NULL: a missing data part is recovered from parity and the others.
+    void raidInterleave(byte* dest, const byte* const inputbufs[RAIDPARTS], size_t partslen);
+
 
     // Holds the latest download data received.   Raid-aware.   Suitable for file transfers, or direct streaming.
     // For non-raid files, supplies the received buffer back to the same connection for writing to file (having decrypted and mac'd it),
@@ -165,7 +170,6 @@ namespace mega {
         // take raid input part buffers and combine to form the asyncoutputbuffers
         void combineRaidParts(unsigned connectionNum);
         FilePiece* combineRaidParts(size_t partslen, size_t bufflen, m_off_t filepos, FilePiece& prevleftoverchunk);
-        void recoverSectorFromParity(byte* dest, byte* inputbufs[], unsigned offset);
         void combineLastRaidLine(byte* dest, size_t nbytes);
         void rollInputBuffers(size_t dataToDiscard);
         virtual void bufferWriteCompletedAction(FilePiece& r);
@@ -79,6 +79,9 @@ public:
 
     bool cmdspending() const;
 
+    // number of commands waiting to be sent
+    size_t queuedCommands() const;
+
     // get the set of commands to be sent to the server (could be a retry)
     void serverrequest(string*, bool& suppressSID);
 
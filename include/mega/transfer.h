@@ -52,6 +52,10 @@ struct MEGA_API Transfer : public FileFingerprint
     // representative local filename for this transfer
     string localfilename;
 
+    // content of an upload that is still being received, read instead of localfilename.
+    // Its fingerprint is generated upon completion
+    std::shared_ptr<UploadStream> uploadstream;
+
     // progress completed
     m_off_t progresscompleted;
 
@@ -71,6 +75,9 @@ struct MEGA_API Transfer : public FileFingerprint
 
     chunkmac_map chunkmacs;
 
+    // progress journal entries written since the transfer's own cache record was last rewritten
+    vector<uint32_t> journaldbids;
+
     // upload handle for file attribute attachment (only set if file attribute queued)
     handle uploadhandle;
 
@@ -93,6 +100,9 @@ struct MEGA_API Transfer : public FileFingerprint
     // signal failure
     void failed(error, DBTableTransactionCommitter&, dstime = 0);
 
+    // bandwidth class of the most urgent file in this transfer
+    bwclass_t bwclass() const;
+
     // signal completion
     void complete(DBTableTransactionCommitter&);
     
@@ -133,6 +143,9 @@ struct MEGA_API Transfer : public FileFingerprint
     // priority of the transfer
     uint64_t priority;
 
+    // end of the backoff this transfer is parked for in TransferList's dispatch index, or 0
+    dstime parkeduntil = 0;
+
     // state of the transfer
     transferstate_t state;
 
@@ -151,6 +164,18 @@ struct MEGA_API Transfer : public FileFingerprint
     void addAnyMissingMediaFileAttributes(Node* node, std::string& localpath);
 };
 
+// Progress journal entry in the transfer cache: the chunk MACs of a transfer when it was written.
+// The newest entry supersedes the chunkmacs in the transfer's own record, so progress updates
+// append a small record instead of rewriting the whole transfer each time.
+struct MEGA_API TransferJournalEntry : public Cachable
+{
+    uint32_t transferdbid = 0;
+    chunkmac_map chunkmacs;
+
+    bool serialize(string*) override;
+    bool unserialize(string*);
+};
+
 class MEGA_API TransferList
 {
 public:
@@ -179,6 +204,12 @@ public:
     Transfer *nexttransfer(direction_t direction);
     Transfer *transferat(direction_t direction, unsigned int position);
 
+    // the transfer may have become dispatchable: it lost its slot, was requeued or its backoff was cut short
+    void ready(Transfer *transfer);
+
+    // backoffs of this direction were aborted: parked transfers compete again
+    void abortbackoff(direction_t direction);
+
     transfer_list transfers[2];
     MegaClient *client;
     uint64_t currentpriority;
@@ -187,6 +218,21 @@ private:
     void prepareIncreasePriority(Transfer *transfer, transfer_list::iterator srcit, transfer_list::iterator dstit, DBTableTransactionCommitter& committer);
     void prepareDecreasePriority(Transfer *transfer, transfer_list::iterator it, transfer_list::iterator dstit);
     bool isReady(Transfer *transfer);
+    bool dropready(Transfer *transfer);
+    void unpark(Transfer *transfer);
+
+    struct PriorityLess
+    {
+        bool operator()(const Transfer* a, const Transfer* b) const { return a->priority < b->priority; }
+    };
+
+    // Dispatch index, so that finding the next transfer doesn't scan past every active, paused or
+    // backing off one.  mReady holds, by priority, a superset of the transfers that are dispatchable;
+    // nexttransfer() confirms entries lazily and drops the ones that no longer qualify, so anything that
+    // makes a transfer dispatchable again must call ready().  Priorities only change while a transfer is
+    // out of mReady.  Entries found backing off are parked in mBackingOff until their backoff ends.
+    std::set<Transfer*, PriorityLess> mReady[2];
+    std::set<std::pair<dstime, Transfer*>> mBackingOff[2];
 };
 
 struct MEGA_API DirectReadSlot
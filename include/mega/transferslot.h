@@ -46,6 +46,74 @@ public:
 
 class DBTableTransactionCommitter;
 
+// Tunes the number of connections and the download request size of a non-raid transfer slot
+// from what the transfer achieves.  Connections are hill-climbed within [1, maxconnections]: every
+// WINDOWDS the throughput is sampled, and a probe one connection up (or down) is kept only if it
+// raised throughput by 5% (or didn't cost more than 5%), otherwise it is undone and the slot holds
+// for a while before probing in the other direction.  Failed or timed out requests halve both the
+// connections and the request size, at most once per window, as one network hiccup usually fails
+// several connections at once.  Requests that complete very quickly are dominated by their round
+// trip, so the request size doubles, up to maxrequestsize; ones that take very long halve it.
+class MEGA_API TransferRateController
+{
+public:
+    // throughput sampling period
+    static const dstime WINDOWDS;
+
+    // windows to wait after an unsuccessful probe or a failure
+    static const int HOLDWINDOWS;
+
+    // full-size requests completing faster than this grow, slower than SLOWREQUESTDS shrink
+    static const dstime FASTREQUESTDS;
+    static const dstime SLOWREQUESTDS;
+
+    // smallest request size that still batches several chunks
+    static const m_off_t MINREQUESTSIZE;
+
+    TransferRateController(unsigned connections, unsigned maxconnections, m_off_t requestsize, m_off_t maxrequestsize);
+
+    // connections that may start new requests, numbered from 0
+    unsigned connections() const { return mConnections; }
+
+    // upper bound for the size of the next download request
+    m_off_t requestsize() const { return mRequestSize; }
+
+    // the slot made `bytes` of progress by `now`
+    void transferred(m_off_t bytes, dstime now);
+
+    // a request was sent on connection `i`
+    void requeststarted(unsigned i, dstime now);
+
+    // the request on connection `i` completed successfully with `bytes`
+    void requestcompleted(unsigned i, m_off_t bytes, dstime now);
+
+    // a request failed or timed out at `now`
+    void requestfailed(dstime now);
+
+private:
+    enum { STEADY, PROBINGUP, PROBINGDOWN } mState = STEADY;
+
+    unsigned mConnections;
+    unsigned mMaxConnections;
+    m_off_t mRequestSize;
+    m_off_t mMaxRequestSize;
+
+    // direction of the next probe
+    bool mProbeUp = true;
+    int mHold = 0;
+
+    // bytes per window before the current probe
+    m_off_t mBaseRate = 0;
+
+    dstime mWindowStart = 0;
+    m_off_t mWindowBytes = 0;
+
+    // when failures last shrank the slot
+    dstime mLastFailure = 0;
+
+    std::vector<dstime> mStarted;
+};
+
 // active transfer
 struct MEGA_API TransferSlot
 {
@@ -68,12 +136,16 @@ struct MEGA_API TransferSlot
     // max request size for downloads and uploads
     static const m_off_t MAX_REQ_SIZE;
 
+    // request size that downloads tuned by a TransferRateController may grow to
+    static const m_off_t MAX_ADAPTIVE_REQ_SIZE;
+
     // max allowed difference between the next chunk and the first unfinished chunk
     static const m_off_t MAX_UPLOAD_GAP;
 
     bool delayedchunk;
 
     m_off_t maxRequestSize;
+    m_off_t maxAdaptiveRequestSize;
 
     m_off_t progressreported;
 
@@ -102,6 +174,10 @@ struct MEGA_API TransferSlot
     int connections;
     HttpReqXfer** reqs;
 
+    // adjusts how many of those connections are used, and the request size, for non-raid transfers
+    // (NULL for raid and small transfers, which always use all their connections)
+    std::unique_ptr<TransferRateController> ratecontroller;
+
     // Manage download input buffers and file output buffers for file download.  Raid-aware, and automatically performs decryption and mac.
     TransferBufferManager transferbuf;
 
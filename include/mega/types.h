@@ -105,6 +105,7 @@ struct DirectReadSlot;
 struct FileAccess;
 struct FileAttributeFetch;
 struct FileAttributeFetchChannel;
+class FileAttributeCache;
 struct FileFingerprint;
 struct FileFingerprintCmp;
 struct HttpReq;
@@ -156,6 +157,9 @@ typedef enum { METHOD_POST, METHOD_GET, METHOD_NONE} httpmethod_t;
 
 typedef enum { REQ_BINARY, REQ_JSON } contenttype_t;
 
+// bandwidth scheduling classes of transfer requests, most urgent first
+typedef enum { BW_INTERACTIVE, BW_SYNC, BW_BULK, BW_BACKUP, BW_CLASSES } bwclass_t;
+
 // new node source types
 typedef enum { NEW_NODE, NEW_PUBLIC, NEW_UPLOAD } newnodesource_t;
 
@@ -170,6 +174,9 @@ struct ChunkMAC
 };
 
 // file chunk macs
+// Chunks finished contiguously from the start of the file are folded into a running MAC-of-MACs
+// and dropped from the map, so only in-progress and out-of-order chunks are kept (and serialized)
+// regardless of the file size.
 class chunkmac_map : public map<m_off_t, ChunkMAC>
 {
 public:
@@ -177,6 +184,30 @@ public:
     void serialize(string& d) const;
     bool unserialize(const char*& ptr, const char* end);
     void calcprogress(m_off_t size, m_off_t& chunkpos, m_off_t& completedprogress, m_off_t* lastblockprogress = nullptr);
+
+    // fold the finished chunks at the front of the map into the MAC-of-MACs
+    void foldFinishedPrefix(SymmCipher *cipher);
+
+    // the chunk starting at pos is complete (folded or not)
+    bool finishedAt(m_off_t pos) const;
+
+    // some of the chunk starting at pos has been processed
+    bool startedAt(m_off_t pos) const;
+
+    // end of the folded prefix
+    m_off_t foldedEnd() const { return macsmacPrefixEnd; }
+
+    // entry for the chunk starting at pos.  Chunks already folded yield a finished placeholder
+    ChunkMAC& operator[](m_off_t pos);
+
+    void clear();
+    void swap(chunkmac_map& other);
+
+private:
+    // all chunks before macsmacPrefixEnd have been folded into macsmacPrefix
+    m_off_t macsmacPrefixEnd = 0;
+    byte macsmacPrefix[SymmCipher::BLOCKSIZE] = {};
+    ChunkMAC foldedChunk;
 };
 
 /**
@@ -414,6 +414,10 @@ std::string webdavnameescape(const std::string &value);
 
 void tolower_string(std::string& str);
 
+// binary key whose byte order matches the natural (case-insensitive, numbers by value)
+// order the apps sort node names in: digit runs sort before other characters and by value
+std::string naturalsortkey(const char* name);
+
 #ifdef __APPLE__
 int macOSmajorVersion();
 #endif
@@ -6747,6 +6747,11 @@ class MegaApi
             ATTR_TYPE_PREVIEW = 1
         };
 
+        enum {
+            METRICS_FORMAT_JSON = 0,
+            METRICS_FORMAT_PROMETHEUS = 1
+        };
+
         enum {
             USER_ATTR_UNKNOWN = -1,
             USER_ATTR_AVATAR = 0,               // public - char array
@@ -8617,6 +8622,36 @@ class MegaApi
          */
         void setLoggingName(const char* loggingName);
 
+        /**
+         * @brief Get a snapshot of the SDK runtime metrics
+         *
+         * The metrics are always collected, with negligible overhead, and are shared by all
+         * MegaApi instances in the process. They include the duration of the SDK loop
+         * iterations and why the loop woke up, API request latency and queue depth,
+         * transferred bytes and current speed per direction, local cache commit times and
+         * file encryption throughput.
+         *
+         * Counters are cumulative since the process started. Durations are histograms in
+         * seconds with power-of-two buckets from 1 microsecond.
+         *
+         * This function doesn't lock the SDK, so it's cheap to call periodically from any thread.
+         *
+         * You take the ownership of the returned value.
+         *
+         * @param format Format of the snapshot
+         *
+         * These are the valid values for this parameter:
+         * - MegaApi::METRICS_FORMAT_JSON = 0
+         * An array of objects with "name", "type", optional "labels", and either "value" or
+         * "count", "sum" and the non-empty "buckets"
+         *
+         * - MegaApi::METRICS_FORMAT_PROMETHEUS = 1
+         * Prometheus text exposition format, ready to be served on a /metrics endpoint
+         *
+         * @return Snapshot of the metrics in the requested format
+         */
+        static char* getMetrics(int format = METRICS_FORMAT_JSON);
+
         /**
          * @brief Create a folder in the MEGA account
          *
@@ -9034,6 +9069,24 @@ class MegaApi
          */
         void getThumbnail(MegaNode* node, const char *dstFilePath, MegaRequestListener *listener = NULL);
 
+        /**
+         * @brief Get the thumbnails of several nodes
+         *
+         * This is equivalent to calling MegaApi::getThumbnail for each node with \c dstFolderPath
+         * as the destination folder, but the whole batch is sent to the servers at once, so
+         * listings with many images are faster to populate.
+         *
+         * One request of type MegaRequest::TYPE_GET_ATTR_FILE is started per node, with the same
+         * data as the ones of MegaApi::getThumbnail, and \c listener receives the callbacks of all
+         * of them.
+         *
+         * @param nodes Nodes to get the thumbnails
+         * @param dstFolderPath Local folder where the thumbnails are saved, using
+         * (Base64-encoded handle + "0.jpg") as the file name
+         * @param listener MegaRequestListener to track these requests
+         */
+        void getThumbnails(MegaNodeList *nodes, const char *dstFolderPath, MegaRequestListener *listener = NULL);
+
         /**
          * @brief Get the preview of a node
          *
@@ -9425,6 +9478,38 @@ class MegaApi
          */
         void cancelGetPreview(MegaNode* node, MegaRequestListener *listener = NULL);
 
+        /**
+         * @brief Keep downloaded thumbnails and previews in a local folder
+         *
+         * Once enabled, MegaApi::getThumbnail and MegaApi::getPreview are served from the
+         * folder when possible, without a network request. Attributes are stored as they
+         * are received from the servers, encrypted with the key of their file, and the least
+         * recently used ones are removed when the folder would exceed the maximum size.
+         *
+         * Entries left in the folder by previous executions are reused. The folder should
+         * not be used for anything else.
+         *
+         * @param localFolder Path of the folder, or NULL to stop using the cache. The files
+         * already in it are kept.
+         * @param maxSize Maximum size of the cache, in bytes
+         */
+        void setThumbnailCacheFolder(const char *localFolder, long long maxSize = 104857600);
+
+        /**
+         * @brief Download the thumbnails of some nodes into the thumbnail cache
+         *
+         * Apps showing a folder listing can pass the nodes around the visible ones, so that
+         * their thumbnails are already cached when they are scrolled into view. The
+         * thumbnails are fetched in batches, and no callbacks are received for them.
+         *
+         * Nodes without thumbnail or whose thumbnail is already cached are ignored. This
+         * function does nothing if the cache is not enabled by
+         * MegaApi::setThumbnailCacheFolder.
+         *
+         * @param nodes Nodes whose thumbnails should be cached
+         */
+        void prefetchThumbnails(MegaNodeList *nodes);
+
         /**
          * @brief Set the thumbnail of a MegaNode
          *
@@ -11464,6 +11549,9 @@ class MegaApi
          * The maximum number of allowed connections is 6. If a higher number of connections is passed
          * to this function, it will fail with the error code API_ETOOMANY.
          *
+         * Transfers of files larger than 128 KB that aren't stored in CloudRAID start with this number
+         * of connections, and then use more (up to 6) or fewer depending on the throughput they measure.
+         *
          * The associated request type with this request is MegaRequest::TYPE_SET_MAX_CONNECTIONS
          * Valid data in the MegaRequest object received on callbacks:
          * - MegaRequest::getParamType - Returns the value for \c direction parameter
@@ -11483,6 +11571,9 @@ class MegaApi
          * The maximum number of allowed connections is 6. If a higher number of connections is passed
          * to this function, it will fail with the error code API_ETOOMANY.
          *
+         * Transfers of files larger than 128 KB that aren't stored in CloudRAID start with this number
+         * of connections, and then use more (up to 6) or fewer depending on the throughput they measure.
+         *
          * The associated request type with this request is MegaRequest::TYPE_SET_MAX_CONNECTIONS
          * Valid data in the MegaRequest object received on callbacks:
          * - MegaRequest::getNumber - Returns the number of connections
@@ -14810,6 +14901,32 @@ class MegaApi
          */
         int httpServerGetMaxOutputSize();
 
+        /**
+         * @brief Set the number of additional threads serving HTTP connections
+         *
+         * By default, the HTTP proxy server handles all its connections on a single thread.
+         * With worker threads, each new connection is handed to the least busy of the
+         * server's own thread and the workers, and stays there until it's closed, so
+         * many concurrent streams can use several CPU cores.
+         *
+         * Worker threads are not used by servers started with TLS, nor on Windows.
+         *
+         * The new value will be taken into account the next time the server is started.
+         *
+         * @param workerThreads Number of additional threads, or 0 to serve all connections
+         * on a single thread
+         */
+        void httpServerSetWorkerThreads(int workerThreads);
+
+        /**
+         * @brief Get the number of additional threads serving HTTP connections
+         *
+         * See MegaApi::httpServerSetWorkerThreads
+         *
+         * @return Number of additional threads
+         */
+        int httpServerGetWorkerThreads();
+
         /**
          * @brief Start an FTP server in specified port
          *
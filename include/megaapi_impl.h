@@ -24,6 +24,8 @@
 
 #include <atomic>
 #include <memory>
+#include <mutex>
+#include <unordered_map>
 
 #include "mega.h"
 #include "mega/gfx/external.h"
@@ -503,6 +505,48 @@ class MegaNodePrivate : public MegaNode, public Cachable
 #endif
 };
 
+// Copies of nodes as they were when last published, so getNodeByHandle() can be answered
+// from app threads without waiting for sdkMutex.  A miss is filled in by the reader that
+// looked it up, while it holds sdkMutex; nodes_updated() drops the entries of every node it
+// reports, before the app is told about the change, and node_decrypted() those of nodes
+// whose key or attributes arrive later.  Only the most recently used nodes are kept.
+class MegaNodeSnapshots
+{
+public:
+    static const size_t MAXNODES = 16384;
+
+    // a copy of the published node, or NULL
+    MegaNode* get(MegaHandle h);
+
+    // takes ownership of `node`
+    void publish(MegaNode* node);
+
+    void invalidate(MegaHandle h);
+    void clear();
+
+    size_t size() const { return mCount.load(std::memory_order_relaxed); }
+
+private:
+    // readers of different shards never contend
+    static const unsigned SHARDS = 16;
+
+    struct Shard
+    {
+        std::mutex mutex;
+
+        // most recently used first
+        std::list<MegaHandle> lru;
+        std::unordered_map<MegaHandle, std::pair<std::shared_ptr<MegaNode>, std::list<MegaHandle>::iterator>> nodes;
+    };
+
+    Shard mShards[SHARDS];
+
+    // lets invalidate() skip the lock while nothing is published, as during fetchnodes
+    std::atomic<size_t> mCount{0};
+
+    Shard& shard(MegaHandle h) { return mShards[(h ^ (h >> 32)) % SHARDS]; }
+};
+
 
 class MegaUserPrivate : public MegaUser
 {
@@ -653,6 +697,8 @@ class MegaTransferPrivate : public MegaTransfer, public Cachable
         void setFolderTransferTag(int tag);
         void setNotificationNumber(long long notificationNumber);
         void setListener(MegaTransferListener *listener);
+        void setUploadStream(std::shared_ptr<UploadStream> stream);
+        std::shared_ptr<UploadStream> getUploadStream() const;
 
         virtual int getType() const;
         virtual const char * getTransferString() const;
@@ -747,6 +793,7 @@ class MegaTransferPrivate : public MegaTransfer, public Cachable
         int folderTransferTag;
         const char* appData;
         unique_ptr<MegaRecursiveOperation> recursiveOperation;
+        std::shared_ptr<UploadStream> uploadStream; // content of an upload still being received, not copied
 };
 
 class MegaTransferDataPrivate : public MegaTransferData
@@ -1839,6 +1886,18 @@ class SearchTreeProcessor : public TreeProcessor
         vector<Node *> results;
 };
 
+// feeds the nodes of a MegaClient::proctreeparallel() walk to a SearchTreeProcessor
+class SearchTreeProc : public TreeProc
+{
+    public:
+        SearchTreeProc(Node* root, SearchTreeProcessor* processor);
+        void proc(MegaClient*, Node* node) override;
+
+    private:
+        Node* mRoot;
+        SearchTreeProcessor* mProcessor;
+};
+
 class OutShareProcessor : public TreeProcessor
 {
     public:
@@ -1880,33 +1939,6 @@ class PublicLinkProcessor : public TreeProcessor
         vector<Node *> nodes;
 };
 
-class SizeProcessor : public TreeProcessor
-{
-    protected:
-        long long totalBytes;
-
-    public:
-        SizeProcessor();
-        virtual bool processNode(Node* node);
-        long long getTotalBytes();
-};
-
-class TreeProcFolderInfo : public TreeProc
-{
-    public:
-        TreeProcFolderInfo();
-        virtual void proc(MegaClient*, Node*);
-        virtual ~TreeProcFolderInfo() {}
-        MegaFolderInfo *getResult();
-
-    protected:
-        int numFiles;
-        int numFolders;
-        int numVersions;
-        long long currentSize;
-        long long versionsSize;
-};
-
 //Thread safe request queue
 class RequestQueue
 {
@@ -2074,6 +2106,7 @@ class MegaApiImpl : public MegaApp
         static void log(int logLevel, const char* message, const char *filename = NULL, int line = -1);
 
         void setLoggingName(const char* loggingName);
+        static char* getMetrics(int format);
 
         void createFolder(const char* name, MegaNode *parent, MegaRequestListener *listener = NULL);
         bool createLocalFolder(const char *path);
@@ -2096,12 +2129,15 @@ class MegaApiImpl : public MegaApp
         void getPublicNode(const char* megaFileLink, MegaRequestListener *listener = NULL);
         const char *buildPublicLink(const char *publicHandle, const char *key, bool isFolder);
         void getThumbnail(MegaNode* node, const char *dstFilePath, MegaRequestListener *listener = NULL);
+        void getThumbnails(MegaNodeList *nodes, const char *dstFolderPath, MegaRequestListener *listener = NULL);
 		void cancelGetThumbnail(MegaNode* node, MegaRequestListener *listener = NULL);
         void setThumbnail(MegaNode* node, const char *srcFilePath, MegaRequestListener *listener = NULL);
         void putThumbnail(MegaBackgroundMediaUpload* node, const char *srcFilePath, MegaRequestListener *listener = NULL);
         void setThumbnailByHandle(MegaNode* node, MegaHandle attributehandle, MegaRequestListener *listener = NULL);
         void getPreview(MegaNode* node, const char *dstFilePath, MegaRequestListener *listener = NULL);
 		void cancelGetPreview(MegaNode* node, MegaRequestListener *listener = NULL);
+        void setThumbnailCacheFolder(const char *localFolder, long long maxSize);
+        void prefetchThumbnails(MegaNodeList *nodes);
         void setPreview(MegaNode* node, const char *srcFilePath, MegaRequestListener *listener = NULL);
         void putPreview(MegaBackgroundMediaUpload* node, const char *srcFilePath, MegaRequestListener *listener = NULL);
         void setPreviewByHandle(MegaNode* node, MegaHandle attributehandle, MegaRequestListener *listener = NULL);
@@ -2178,6 +2214,7 @@ class MegaApiImpl : public MegaApp
         void startUpload(bool startFirst, const char* localPath, MegaNode* parent, const char* fileName, int64_t mtime, int folderTransferTag, bool isBackup, const char *appData, bool isSourceFileTemporary, bool forceNewUpload, MegaTransferListener *listener);
         void startUpload(bool startFirst, const char* localPath, MegaNode* parent, const char* fileName, const char* targetUser, int64_t mtime, int folderTransferTag, bool isBackup, const char *appData, bool isSourceFileTemporary, bool forceNewUpload, MegaTransferListener *listener);
         void startUploadForSupport(const char *localPath, bool isSourceTemporary = false, MegaTransferListener *listener=NULL);
+        void startUpload(std::shared_ptr<UploadStream> stream, const char* localPath, MegaNode* parent, const char* fileName, MegaTransferListener *listener); // localPath only names the transfer
         void startDownload(MegaNode* node, const char* localPath, MegaTransferListener *listener = NULL);
         void startDownload(bool startFirst, MegaNode *node, const char* target, int folderTransferTag, const char *appData, MegaTransferListener *listener);
         void startStreaming(MegaNode* node, m_off_t startPos, m_off_t size, MegaTransferListener *listener);
@@ -2457,6 +2494,8 @@ class MegaApiImpl : public MegaApp
         int httpServerGetMaxBufferSize();
         void httpServerSetMaxOutputSize(int outputSize);
         int httpServerGetMaxOutputSize();
+        void httpServerSetWorkerThreads(int workerThreads);
+        int httpServerGetWorkerThreads();
 
         // permissions
         void httpServerEnableFileServer(bool enable);
@@ -2648,6 +2687,7 @@ protected:
         MegaHTTPServer *httpServer;
         int httpServerMaxBufferSize;
         int httpServerMaxOutputSize;
+        int httpServerWorkerThreads;
         bool httpServerEnableFiles;
         bool httpServerEnableFolders;
         bool httpServerOfflineAttributeEnabled;
@@ -2701,6 +2741,7 @@ protected:
         long long syncUpperSizeLimit;
         std::recursive_timed_mutex sdkMutex;
         using SdkMutexGuard = std::unique_lock<std::recursive_timed_mutex>;   // (equivalent to typedef)
+        MegaNodeSnapshots nodeSnapshots;
         std::atomic<bool> syncPathStateLockTimeout{ false };
         MegaTransferPrivate *currentTransfer;
         MegaRequestPrivate *activeRequest;
@@ -2789,6 +2830,7 @@ protected:
         void unlink_result(handle, error) override;
         void unlinkversions_result(error) override;
         void nodes_updated(Node**, int) override;
+        void node_decrypted(handle) override;
         void users_updated(User**, int) override;
         void useralerts_updated(UserAlert::Base**, int) override;
         void account_updated() override;
@@ -2998,6 +3040,8 @@ protected:
         Node* getNodeByFingerprintInternal(const char *fingerprint);
         Node *getNodeByFingerprintInternal(const char *fingerprint, Node *parent);
 
+        // recursive searches of subtrees with at least this many nodes run on several threads
+        static const size_t PARALLEL_SEARCH_MIN = 50000;
         bool processTree(Node* node, TreeProcessor* processor, bool recursive = 1, MegaCancelToken* cancelToken = nullptr);
         void getNodeAttribute(MegaNode* node, int type, const char *dstFilePath, MegaRequestListener *listener = NULL);
 		    void cancelGetNodeAttribute(MegaNode *node, int type, MegaRequestListener *listener = NULL);
@@ -3066,6 +3110,8 @@ public:
     unsigned int availableSpace();
     unsigned int availableCapacity();
     uv_buf_t nextBuffer();
+    // up to maxOutputSize bytes in (at most) two pieces, when the data wraps around the end of the buffer
+    unsigned int nextBuffers(uv_buf_t bufs[2]);
     void freeData(unsigned int len);
     void setMaxBufferSize(unsigned int bufferSize);
     void setMaxOutputSize(unsigned int outputSize);
@@ -3085,6 +3131,22 @@ protected:
 };
 
 class MegaTCPServer;
+class MegaTCPContext;
+
+// An additional event loop of a server, serving the connections the server's own loop hands to it
+struct MegaTCPWorker
+{
+    MegaTCPServer *server;
+    uv_loop_t uv_loop;
+    uv_async_t accept_handle; // signals sockets in acceptedSockets
+    uv_async_t exit_handle;
+    uv_mutex_t mutex; // protects acceptedSockets
+    std::deque<uv_os_sock_t> acceptedSockets;
+    std::list<MegaTCPContext*> connections;
+    std::atomic<int> numConnections; // including the ones not adopted yet
+    MegaThread thread;
+};
+
 class MegaTCPContext : public MegaTransferListener, public MegaRequestListener
 {
 public:
@@ -3093,6 +3155,7 @@ public:
 
     // Connection management
     MegaTCPServer *server;
+    MegaTCPWorker *worker; // NULL if served by the server's own loop
     uv_tcp_t tcphandle;
     uv_async_t asynchandle;
     uv_mutex_t mutex;
@@ -3155,6 +3218,10 @@ protected:
     bool closing;
     int remainingcloseevents;
 
+    // additional event loops, only for servers without TLS; connections stay on the loop that adopted them
+    int workerThreads;
+    std::vector<MegaTCPWorker*> workers;
+
 #ifdef ENABLE_EVT_TLS
     // TLS
     bool evtrequirescleaning;
@@ -3187,6 +3254,14 @@ protected:
 
     static void onCloseRequested(uv_async_t* handle);
 
+    // worker loops
+    static void *workerEntryPoint(void *param);
+    static void onSocketsAccepted(uv_async_t* handle);
+    static void onWorkerCloseRequested(uv_async_t* handle);
+    static bool handToWorker(MegaTCPServer *tcpServer, uv_stream_t* server_handle);
+    void startWorkers();
+    void joinWorkers();
+
     static void onWriteFinished(uv_write_t* req, int status); //This might need to go to HTTPServer
 #ifdef ENABLE_EVT_TLS
     static void onWriteFinished_tls(evt_tls_t *evt_tls, int status);
@@ -3208,6 +3283,7 @@ protected:
     virtual void processOnAsyncEventClose(MegaTCPContext* tcpctx);
     virtual bool respondNewConnection(MegaTCPContext* tcpctx) = 0; //returns true if server needs to start by reading
     virtual void processOnExitHandleClose(MegaTCPServer* tcpServer);
+    virtual bool deferAsyncEventClose(MegaTCPContext* tcpctx); //returns true if the server closes the async handle later itself
 
 public:
     const bool useIPv6;
@@ -3235,6 +3311,9 @@ public:
     set<handle> getAllowedHandles();
     void removeAllowedHandle(MegaHandle handle);
 
+    // number of additional event loop threads, effective from the next start
+    void setWorkerThreads(int count);
+
     void readData(MegaTCPContext* tcpctx);
 };
 
@@ -3286,6 +3365,21 @@ public:
     bool overwrite;
     std::unique_ptr<FileAccess> tmpFileAccess;
     std::string tmpFileName;
+    std::shared_ptr<UploadStream> uploadStream; // PUT body uploaded as it arrives, instead of tmpFileAccess
+
+    // PUT body: received bytes are written to tmpFileAccess in batches, off the event loop
+    std::string bodyPending;
+    std::string bodyWriting;
+    m_off_t bodyWriteOffset;
+    uv_work_t bodyWriteReq;
+    bool bodyWriteInFlight;
+    bool bodyWriteResult; //set by the worker
+    bool bodyWriteFailed;
+    bool bodyReadStopped;
+    bool asyncCloseDeferred;
+    std::unique_ptr<MegaNode> uploadParent; //set when the upload waits for the last write
+    std::string uploadName;
+
     std::string newname; //newname for moved node
     MegaHandle nodeToMove; //node to be moved after delete
     MegaHandle newParentNode; //parent node for moved after delete
@@ -3317,6 +3411,23 @@ protected:
     virtual void processOnAsyncEventClose(MegaTCPContext* tcpctx);
     virtual bool respondNewConnection(MegaTCPContext* tcpctx);
     virtual void processOnExitHandleClose(MegaTCPServer* tcpServer);
+    virtual bool deferAsyncEventClose(MegaTCPContext* tcpctx);
+
+    // reading stops while this many bytes of a PUT body wait to be written
+    static const size_t MAX_PUT_BUFFER_SIZE = 4194304;
+
+    // reading stops while this many bytes of a streamed PUT body wait to be uploaded.
+    // They include the chunks in flight, which are kept until the storage server confirms them
+    static const m_off_t MAX_PUT_STREAM_BUFFER_SIZE = 16777216;
+
+    // writing PUT bodies
+    static void startBodyWrite(MegaHTTPContext *httpctx);
+    static void writeBody(uv_work_t *req);
+    static void onBodyWritten(uv_work_t *req, int status);
+
+    // PUT bodies of known size are uploaded while they are received, if the target can be resolved from the headers
+    static void startStreamedPut(MegaHTTPContext *httpctx, m_off_t size);
+    static MegaNode *getPutParent(MegaHTTPContext *httpctx, MegaNode *node, MegaNode *baseNode, string *newname);
 
 
     // HTTP parser callback
@@ -22,6 +22,58 @@
 #include "mega/attrmap.h"
 
 namespace mega {
+
+static bool namebefore(const AttrFlatMap::value_type& entry, nameid name)
+{
+    return entry.first < name;
+}
+
+AttrFlatMap::AttrFlatMap(std::initializer_list<value_type> init)
+{
+    entries.reserve(init.size());
+    for (const value_type& entry : init)
+    {
+        iterator it = std::lower_bound(entries.begin(), entries.end(), entry.first, namebefore);
+        if (it == entries.end() || it->first != entry.first)
+        {
+            entries.insert(it, entry);
+        }
+    }
+}
+
+AttrFlatMap::iterator AttrFlatMap::find(nameid name)
+{
+    iterator it = std::lower_bound(entries.begin(), entries.end(), name, namebefore);
+    return it != entries.end() && it->first == name ? it : entries.end();
+}
+
+AttrFlatMap::const_iterator AttrFlatMap::find(nameid name) const
+{
+    const_iterator it = std::lower_bound(entries.begin(), entries.end(), name, namebefore);
+    return it != entries.end() && it->first == name ? it : entries.end();
+}
+
+string& AttrFlatMap::operator[](nameid name)
+{
+    iterator it = std::lower_bound(entries.begin(), entries.end(), name, namebefore);
+    if (it == entries.end() || it->first != name)
+    {
+        it = entries.insert(it, value_type(name, string()));
+    }
+    return it->second;
+}
+
+size_t AttrFlatMap::erase(nameid name)
+{
+    iterator it = find(name);
+    if (it == entries.end())
+    {
+        return 0;
+    }
+    entries.erase(it);
+    return 1;
+}
+
 // approximate raw storage size of serialized AttrMap, not taking JSON escaping
 // or name length into account
 unsigned AttrMap::storagesize(int perrecord) const
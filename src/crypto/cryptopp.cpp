@@ -270,6 +270,10 @@ void SymmCipher::ctr_crypt(byte* data, unsigned len, m_off_t pos, ctr_iv ctriv,
 {
     assert(!(pos & (KEYLENGTH - 1)));
 
+    Metrics& metrics = Metrics::get();
+    (encrypt ? metrics.cryptoEncryptBytes : metrics.cryptoDecryptBytes).add(len);
+    MetricTimer metricTimer(metrics.cryptoTime);
+
     byte ctr[BLOCKSIZE], tmp[BLOCKSIZE];
 
     MemAccess::set<int64_t>(ctr,ctriv);
@@ -321,6 +321,7 @@ void SqliteDbTable::commit()
     }
 
     LOG_debug << "DB transaction COMMIT " << dbfile;
+    MetricTimer metricTimer(Metrics::get().dbCommit);
     sqlite3_exec(db, "COMMIT", 0, 0, NULL);
 }
 
@@ -35,6 +35,7 @@ File::File()
     hprivate = true;
     hforeign = false;
     syncxfer = false;
+    backupxfer = false;
     temporaryfile = false;
     h = UNDEF;
     tag = 0;
@@ -315,8 +316,15 @@ void File::completed(Transfer* t, LocalNode* l)
         // store filename
         attrs.map['n'] = name;
 
-        // store fingerprint
-        t->serializefingerprint(&attrs.map['c']);
+        // store fingerprint (a streamed upload's is only known by its files, see Transfer::complete())
+        if (t->uploadstream)
+        {
+            serializefingerprint(&attrs.map['c']);
+        }
+        else
+        {
+            t->serializefingerprint(&attrs.map['c']);
+        }
 
         string tattrstring;
 
@@ -23,6 +23,8 @@
 #include "mega/megaclient.h"
 #include "mega/megaapp.h"
 #include "mega/logging.h"
+#include "mega/base64.h"
+#include "mega/filesystem.h"
 
 namespace mega {
 FileAttributeFetchChannel::FileAttributeFetchChannel(MegaClient* client)
@@ -57,7 +59,15 @@ void FileAttributeFetchChannel::dispatch()
     {
         for (it = fafs[i].begin(); it != fafs[i].end(); )
         {
+            // pending in a pipelined request
+            if (it->second->req && it->second->req != &req)
+            {
+                it++;
+                continue;
+            }
+
             req.outbuf.append((char*)&it->first, sizeof(handle));
+            it->second->req = &req;
 
             if (!i)
             {
@@ -90,8 +100,107 @@ void FileAttributeFetchChannel::dispatch()
     }
 }
 
+void FileAttributeFetchChannel::pipeline()
+{
+    if (pipelined.size() >= MAXPIPELINED || fafs[0].empty())
+    {
+        return;
+    }
+
+    unique_ptr<Pipelined> p(new Pipelined(client->rng));
+    p->req.binary = true;
+    p->req.outbuf.reserve(fafs[0].size() * sizeof(handle));
+
+    for (faf_map::iterator it = fafs[0].begin(); it != fafs[0].end(); )
+    {
+        p->req.outbuf.append((char*)&it->first, sizeof(handle));
+        it->second->req = &p->req;
+
+        // move from fresh to pending
+        fafs[1][it->first] = it->second;
+        fafs[0].erase(it++);
+    }
+
+    LOG_debug << "Getting file attribute (pipelined: " << pipelined.size() + 1 << ")";
+    p->req.posturl = posturl;
+    p->req.post(client);
+    p->timeout.backoff(150);
+    pipelined.push_back(std::move(p));
+}
+
+void FileAttributeFetchChannel::pipelineio()
+{
+    for (auto it = pipelined.begin(); it != pipelined.end(); )
+    {
+        Pipelined* p = it->get();
+
+        switch (p->req.status)
+        {
+            case REQ_SUCCESS:
+                if (!switchtohttps(p->req))
+                {
+                    parse(p->req, true);
+                }
+                failed(p->req, p->e);
+                break;
+
+            case REQ_INFLIGHT:
+                if (p->req.httpio && p->inbytes != p->req.in.size())
+                {
+                    client->httpio->lock();
+                    parse(p->req, false);
+                    client->httpio->unlock();
+
+                    p->timeout.backoff(100);
+                    p->inbytes = p->req.in.size();
+                }
+
+                if (!p->timeout.armed())
+                {
+                    it++;
+                    continue;
+                }
+
+                LOG_warn << "Timeout getting pipelined file attr";
+                // fall through
+            case REQ_FAILURE:
+                LOG_warn << "Error getting pipelined file attr";
+                switchtohttps(p->req);
+                failed(p->req, p->e);
+
+                // the URL may have gone stale
+                urltime = 0;
+                break;
+
+            default:
+                it++;
+                continue;
+        }
+
+        p->req.disconnect();
+        it = pipelined.erase(it);
+    }
+}
+
+bool FileAttributeFetchChannel::switchtohttps(HttpReq& r)
+{
+    if (!r.httpstatus || r.contenttype.find("text/html") == string::npos
+            || memcmp(r.posturl.c_str(), "http:", 5))
+    {
+        return false;
+    }
+
+    LOG_warn << "Invalid Content-Type detected getting file attr: " << r.contenttype;
+    urltime = 0;
+    client->usehttps = true;
+    client->app->notify_change_to_https();
+
+    client->sendevent(99436, "Automatic change to HTTPS", 0);
+    return true;
+}
+
 // communicate received file attributes to the application
-void FileAttributeFetchChannel::parse(int /*fac*/, bool final)
+void FileAttributeFetchChannel::parse(HttpReq& r, bool final)
 {
 #pragma pack(push,1)
     struct FaHeader
@@ -101,8 +210,8 @@ void FileAttributeFetchChannel::parse(int /*fac*/, bool final)
     };
 #pragma pack(pop)
 
-    const char* ptr = req.data();
-    const char* endptr = ptr + req.size();
+    const char* ptr = r.data();
+    const char* endptr = ptr + r.size();
     faf_map::iterator it;
     uint32_t falen = 0;
 
@@ -120,7 +229,7 @@ void FileAttributeFetchChannel::parse(int /*fac*/, bool final)
             }
             else
             {
-                req.purge(ptr - req.data());
+                r.purge(ptr - r.data());
             }
 
             break;
@@ -131,13 +240,19 @@ void FileAttributeFetchChannel::parse(int /*fac*/, bool final)
         ptr += sizeof(FaHeader);
 
         // locate fetch request (could have been deleted by the application in the meantime)
-        if (it != fafs[1].end())
+        if (it != fafs[1].end() && it->second->req == &r)
         {
             client->restag = it->second->tag;
 
             if (!(falen & (SymmCipher::BLOCKSIZE - 1)))
             {
-                if (client->tmpnodecipher.setkey(&it->second->nodekey))
+                if (client->facache)
+                {
+                    client->facache->put(it->first, ptr, falen);
+                }
+
+                // untagged fetches are prefetches, only meant for the cache
+                if (it->second->tag && client->tmpnodecipher.setkey(&it->second->nodekey))
                 {
                     client->tmpnodecipher.cbc_decrypt((byte*)ptr, falen);
                     client->app->fa_complete(it->second->nodehandle, it->second->type, ptr, falen);
@@ -153,13 +268,21 @@ void FileAttributeFetchChannel::parse(int /*fac*/, bool final)
 }
 
 // notify the application of the request failure and remove records no longer needed
-void FileAttributeFetchChannel::failed()
+void FileAttributeFetchChannel::failed(HttpReq& r, error e)
 {
     for (faf_map::iterator it = fafs[1].begin(); it != fafs[1].end(); )
     {
+        // attributes moved to pending without being POSTed belong to the channel's own request
+        if (it->second->req ? it->second->req != &r : &r != &req)
+        {
+            it++;
+            continue;
+        }
+
         client->restag = it->second->tag;
+        it->second->req = nullptr;
 
-        if (client->app->fa_failed(it->second->nodehandle, it->second->type, it->second->retries, e))
+        if (!it->second->tag || client->app->fa_failed(it->second->nodehandle, it->second->type, it->second->retries, e))
         {
             // no retry desired
             delete it->second;
@@ -173,8 +296,204 @@ void FileAttributeFetchChannel::failed()
             // move from pending to fresh
             fafs[0][it->first] = it->second;
             fafs[1].erase(it++);
-            req.status = REQ_PREPARED;
+            if (&r == &req)
+            {
+                req.status = REQ_PREPARED;
+            }
         }
     }
 }
+
+FileAttributeCache::entry_vector FileAttributeCache::scan(FileSystemAccess& fsaccess, const string& localfolder)
+{
+    std::unique_ptr<DirAccess> da(fsaccess.newdiraccess());
+    multimap<m_time_t, pair<handle, m_off_t>> found;
+    string folder = localfolder, localname, name;
+    nodetype_t type;
+
+    if (da->dopen(&folder, NULL, false))
+    {
+        while (da->dnext(&folder, &localname, false, &type))
+        {
+            handle fah = 0;
+            char encoded[16];
+            fsaccess.local2path(&localname, &name);
+
+            // interrupted writes (see put()) would otherwise accumulate outside the size limit
+            bool tmp = name.size() > 4 && !name.compare(name.size() - 4, 4, ".tmp");
+            if (tmp)
+            {
+                name.resize(name.size() - 4);
+            }
+
+            if (type != FILENODE || Base32::atob(name.c_str(), (byte*)&fah, sizeof fah) != sizeof fah)
+            {
+                continue;
+            }
+
+            Base32::btoa((const byte*)&fah, sizeof fah, encoded);
+            if (name != encoded)
+            {
+                // not an entry of ours
+                continue;
+            }
+
+            if (tmp)
+            {
+                string tmppath = localfolder;
+                tmppath.append(fsaccess.localseparator);
+                tmppath.append(localname);
+                fsaccess.unlinklocal(&tmppath);
+                continue;
+            }
+
+            string path = localpath(fsaccess, localfolder, fah);
+
+            auto fa = fsaccess.newfileaccess();
+            if (fa->fopen(&path, true, false))
+            {
+                found.emplace(fa->mtime, std::make_pair(fah, fa->size));
+            }
+        }
+    }
+
+    entry_vector entries;
+    entries.reserve(found.size());
+    for (auto& f : found)
+    {
+        entries.push_back(f.second);
+    }
+    return entries;
+}
+
+FileAttributeCache::FileAttributeCache(FileSystemAccess& fsaccess, const string& localfolder, m_off_t maxsize)
+    : FileAttributeCache(fsaccess, localfolder, maxsize, scan(fsaccess, localfolder))
+{
+}
+
+FileAttributeCache::FileAttributeCache(FileSystemAccess& fsaccess, const string& localfolder, m_off_t maxsize, const entry_vector& existing)
+    : fsaccess(fsaccess), mFolder(localfolder), mMaxSize(maxsize)
+{
+    string folder = mFolder;
+    fsaccess.mkdirlocal(&folder);
+
+    for (auto& e : existing)
+    {
+        mLru.push_front(e.first);
+        mEntries[e.first] = Entry{ e.second, mLru.begin() };
+        mSize += e.second;
+    }
+
+    while (mSize > mMaxSize && mLru.size())
+    {
+        remove(mLru.back());
+    }
+
+    LOG_debug << "File attribute cache: " << mEntries.size() << " entries, " << mSize << " bytes";
+}
+
+string FileAttributeCache::localpath(FileSystemAccess& fsaccess, const string& folder, handle fah)
+{
+    // lowercase, so that case-insensitive filesystems don't merge entries
+    char name[16];
+    Base32::btoa((const byte*)&fah, sizeof fah, name);
+
+    string path = folder, localname, sname = name;
+    fsaccess.path2local(&sname, &localname);
+    path.append(fsaccess.localseparator);
+    path.append(localname);
+    return path;
+}
+
+bool FileAttributeCache::contains(handle fah) const
+{
+    return mEntries.find(fah) != mEntries.end();
+}
+
+bool FileAttributeCache::get(handle fah, string* data)
+{
+    auto it = mEntries.find(fah);
+    if (it == mEntries.end())
+    {
+        return false;
+    }
+
+    string path = localpath(fah);
+    auto fa = fsaccess.newfileaccess();
+    if (!fa->fopen(&path, true, false) || fa->size != it->second.size)
+    {
+        LOG_warn << "Dropping unreadable cached file attribute";
+        erase(it);
+        return false;
+    }
+
+    data->resize(size_t(fa->size));
+    if (fa->size && !fa->frawread((byte*)&(*data)[0], unsigned(fa->size), 0))
+    {
+        fa.reset();
+        erase(it);
+        return false;
+    }
+    fa.reset();
+
+    // the mtime carries the recency over to the next session
+    fsaccess.setmtimelocal(&path, m_time());
+    mLru.splice(mLru.begin(), mLru, it->second.lru_it);
+    return true;
+}
+
+void FileAttributeCache::put(handle fah, const char* data, size_t len)
+{
+    if (m_off_t(len) > mMaxSize || contains(fah))
+    {
+        return;
+    }
+
+    while (mSize + m_off_t(len) > mMaxSize && mLru.size())
+    {
+        remove(mLru.back());
+    }
+
+    // written under a temporary name, so that an interrupted write never looks like an entry
+    string path = localpath(fah);
+    string tmppath = path;
+    string tmpsuffix = ".tmp", localtmpsuffix;
+    fsaccess.path2local(&tmpsuffix, &localtmpsuffix);
+    tmppath.append(localtmpsuffix);
+
+    auto fa = fsaccess.newfileaccess();
+    fsaccess.unlinklocal(&tmppath);
+    bool written = fa->fopen(&tmppath, false, true) && fa->fwrite((const byte*)data, unsigned(len), 0);
+    fa.reset();
+
+    if (!written || !fsaccess.renamelocal(&tmppath, &path, true))
+    {
+        LOG_warn << "Unable to cache file attribute";
+        fsaccess.unlinklocal(&tmppath);
+        return;
+    }
+
+    mLru.push_front(fah);
+    mEntries[fah] = Entry{ m_off_t(len), mLru.begin() };
+    mSize += m_off_t(len);
+}
+
+void FileAttributeCache::remove(handle fah)
+{
+    auto it = mEntries.find(fah);
+    if (it != mEntries.end())
+    {
+        erase(it);
+    }
+}
+
+void FileAttributeCache::erase(map<handle, Entry>::iterator it)
+{
+    string path = localpath(it->first);
+    fsaccess.unlinklocal(&path);
+
+    mSize -= it->second.size;
+    mLru.erase(it->second.lru_it);
+    mEntries.erase(it);
+}
 } // namespace
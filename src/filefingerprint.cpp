@@ -229,6 +229,34 @@ bool FileFingerprint::genfingerprint(FileAccess* fa, bool ignoremtime)
     return changed;
 }
 
+std::vector<std::pair<m_off_t, unsigned>> FileFingerprint::sampledranges(m_off_t size)
+{
+    std::vector<std::pair<m_off_t, unsigned>> ranges;
+
+    if (size <= MAXFULL)
+    {
+        // tiny and small files: read whole
+        if (size > 0)
+        {
+            ranges.emplace_back(0, unsigned(size));
+        }
+    }
+    else
+    {
+        // large file: the blocks of the sparse CRC32s
+        const unsigned blocksize = 4 * sizeof(crc);
+        const unsigned crcs = sizeof(crc) / sizeof(int32_t);
+        const unsigned blocks = MAXFULL / (blocksize * crcs);
+
+        for (unsigned k = 0; k < crcs * blocks; k++)
+        {
+            ranges.emplace_back((size - blocksize) * k / (crcs * blocks - 1), blocksize);
+        }
+    }
+
+    return ranges;
+}
+
 bool FileFingerprint::genfingerprint(InputStreamAccess *is, m_time_t cmtime, bool ignoremtime)
 {
     bool changed = false;
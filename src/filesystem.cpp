@@ -19,6 +19,7 @@
  * program.
  */
 #include "mega/filesystem.h"
+#include "mega/filefingerprint.h"
 #include "mega/node.h"
 #include "mega/megaclient.h"
 #include "mega/logging.h"
@@ -121,13 +122,57 @@ void FileSystemAccess::name2local(string* filename) const
     path2local(&t, filename);
 }
 
+namespace {
+// true if the string is certainly in NFC already: every codepoint is a starter that
+// neither decomposes nor composes with a preceding one (ASCII always qualifies)
+bool isnfc(const string& s)
+{
+    const utf8proc_uint8_t* str = (const utf8proc_uint8_t*)s.data();
+    utf8proc_ssize_t len = utf8proc_ssize_t(s.size());
+
+    for (utf8proc_ssize_t i = 0; i < len; )
+    {
+        if (str[i] < 0x80)
+        {
+            i++;
+            continue;
+        }
+
+        utf8proc_int32_t c;
+        utf8proc_ssize_t n = utf8proc_iterate(str + i, len - i, &c);
+        if (n < 0)
+        {
+            return false;
+        }
+        i += n;
+
+        const utf8proc_property_t* p = utf8proc_get_property(c);
+        if (p->combining_class
+                || p->decomp_seqindex != UINT16_MAX
+                || (p->comb_index >= 0x8000 && p->comb_index != UINT16_MAX)
+                || (c >= 0x1100 && c < 0x1200))   // Hangul jamo are composed algorithmically
+        {
+            return false;
+        }
+    }
+
+    return true;
+}
+}
+
 void FileSystemAccess::normalize(string* filename) const
 {
-    if (!filename) return;
+    if (!filename || isnfc(*filename)) return;
 
+    const utf8proc_option_t options = utf8proc_option_t(UTF8PROC_NULLTERM | UTF8PROC_STABLE | UTF8PROC_COMPOSE);
     const char* cfilename = filename->c_str();
     size_t fnsize = filename->size();
     string result;
+    result.reserve(fnsize);
+
+    // decomposed codepoints, reencoded in place; names rarely need more
+    utf8proc_int32_t stackbuf[256];
+    std::vector<utf8proc_int32_t> heapbuf;
 
     for (size_t i = 0; i < fnsize; )
     {
@@ -139,22 +184,37 @@ void FileSystemAccess::normalize(string* filename) const
             continue;
         }
 
-        const char* substring = cfilename + i;
-        char* normalized = (char*)utf8proc_NFC((uint8_t*)substring);
+        const utf8proc_uint8_t* substring = (const utf8proc_uint8_t*)cfilename + i;
+
+        // reencoding needs one spare codepoint for the terminating NUL
+        utf8proc_int32_t* buffer = stackbuf;
+        utf8proc_ssize_t bufsize = sizeof stackbuf / sizeof *stackbuf - 1;
+        utf8proc_ssize_t len = utf8proc_decompose(substring, 0, buffer, bufsize, options);
+
+        if (len > bufsize)
+        {
+            heapbuf.resize(size_t(len) + 1);
+            buffer = heapbuf.data();
+            len = utf8proc_decompose(substring, 0, buffer, len, options);
+        }
+
+        if (len >= 0)
+        {
+            len = utf8proc_reencode(buffer, len, options);
+        }
 
-        if (!normalized)
+        if (len < 0)
         {
             filename->clear();
             return;
         }
 
-        result.append(normalized);
-        free(normalized);
+        result.append((const char*)buffer, size_t(len));
 
-        i += strlen(substring);
+        i += strlen((const char*)substring);
     }
 
-    *filename = result;
+    filename->swap(result);
 }
 
 // convert from local encoding, then unescape escaped forbidden characters
@@ -604,4 +664,192 @@ void AsyncIOContext::finish()
     }
 }
 
+UploadStream::UploadStream(m_off_t csize, m_time_t cmtime)
+    : size(csize)
+    , mtime(cmtime)
+{
+    for (auto& range : FileFingerprint::sampledranges(size))
+    {
+        mSamples.emplace_back(range.first, string(range.second, '\0'));
+    }
+}
+
+void UploadStream::append(const byte* data, size_t len)
+{
+    std::lock_guard<std::mutex> g(mMutex);
+
+    assert(!mAborted && mReceived + m_off_t(len) <= size);
+    len = size_t(std::min<m_off_t>(len, size - mReceived));
+    m_off_t end = mReceived + m_off_t(len);
+
+    // samples are sorted by offset and equally long, so the ones left behind are complete
+    for (size_t i = mNextSample; i < mSamples.size() && mSamples[i].first < end; i++)
+    {
+        m_off_t samplepos = mSamples[i].first;
+        string& sample = mSamples[i].second;
+        m_off_t from = std::max(samplepos, mReceived);
+        m_off_t to = std::min(samplepos + m_off_t(sample.size()), end);
+
+        if (from < to)
+        {
+            memcpy((char*)sample.data() + (from - samplepos), data + (from - mReceived), size_t(to - from));
+        }
+
+        if (i == mNextSample && samplepos + m_off_t(sample.size()) <= end)
+        {
+            mNextSample++;
+        }
+    }
+
+    mData.append((const char*)data, len);
+    mReceived = end;
+
+    if (mWaiter)
+    {
+        mWaiter->notify();
+        mWaiter = nullptr;
+    }
+}
+
+void UploadStream::abort()
+{
+    std::lock_guard<std::mutex> g(mMutex);
+
+    mAborted = mReceived < size;
+    mReleaseCallback = nullptr;
+
+    if (mWaiter)
+    {
+        mWaiter->notify();
+        mWaiter = nullptr;
+    }
+}
+
+m_off_t UploadStream::buffered() const
+{
+    std::lock_guard<std::mutex> g(mMutex);
+    return mReceived - mReleased;
+}
+
+void UploadStream::setreleasecallback(std::function<void()> callback)
+{
+    std::lock_guard<std::mutex> g(mMutex);
+    mReleaseCallback = std::move(callback);
+}
+
+UploadStream::readresult UploadStream::read(byte* dst, unsigned len, m_off_t pos, Waiter* waiter)
+{
+    std::lock_guard<std::mutex> g(mMutex);
+
+    if (pos >= mReleased && pos + len <= mReceived)
+    {
+        memcpy(dst, mData.data() + (pos - mDataPos), len);
+        return READ_OK;
+    }
+
+    for (auto& sample : mSamples)
+    {
+        if (sample.first == pos && sample.second.size() == len && pos + len <= mReceived)
+        {
+            memcpy(dst, sample.second.data(), len);
+            return READ_OK;
+        }
+    }
+
+    if (pos < mReleased || mAborted || pos + len > size)
+    {
+        return READ_FAILED;
+    }
+
+    mWaiter = waiter;
+    return READ_PENDING;
+}
+
+void UploadStream::release(m_off_t pos)
+{
+    std::lock_guard<std::mutex> g(mMutex);
+
+    pos = std::min(pos, mReceived);
+    if (pos <= mReleased)
+    {
+        return;
+    }
+    mReleased = pos;
+
+    // drop the released bytes once they are half of the buffer, so that each byte is moved once on average
+    if (mReleased - mDataPos >= m_off_t(mData.size() / 2))
+    {
+        mData.erase(0, size_t(mReleased - mDataPos));
+        mDataPos = mReleased;
+    }
+
+    if (mReleaseCallback)
+    {
+        mReleaseCallback();
+    }
+}
+
+bool UploadStream::canrestart() const
+{
+    std::lock_guard<std::mutex> g(mMutex);
+    return !mReleased && !mAborted;
+}
+
+StreamFileAccess::StreamFileAccess(std::shared_ptr<UploadStream> stream, Waiter* w)
+    : FileAccess(w)
+    , mStream(std::move(stream))
+{
+    size = mStream->size;
+    mtime = mStream->mtime;
+    fsid = 0;
+    fsidvalid = false;
+    type = FILENODE;
+    retry = false;
+    errorcode = 0;
+}
+
+bool StreamFileAccess::fopen(string*, bool read, bool write)
+{
+    retry = false;
+    return read && !write;
+}
+
+void StreamFileAccess::updatelocalname(string* name)
+{
+    if (nonblocking_localname.size())
+    {
+        nonblocking_localname = *name;
+    }
+}
+
+bool StreamFileAccess::fwrite(const byte*, unsigned, m_off_t)
+{
+    return false;
+}
+
+bool StreamFileAccess::sysread(byte* dst, unsigned len, m_off_t pos)
+{
+    UploadStream::readresult r = mStream->read(dst, len, pos, waiter);
+    retry = r == UploadStream::READ_PENDING;
+    return r == UploadStream::READ_OK;
+}
+
+bool StreamFileAccess::sysstat(m_time_t* curr_mtime, m_off_t* curr_size)
+{
+    *curr_mtime = mStream->mtime;
+    *curr_size = mStream->size;
+    type = FILENODE;
+    retry = false;
+    return true;
+}
+
+bool StreamFileAccess::sysopen(bool)
+{
+    return true;
+}
+
+void StreamFileAccess::sysclose()
+{
+}
+
 } // namespace
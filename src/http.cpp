@@ -22,10 +22,13 @@
 #include "mega/http.h"
 #include "mega/megaclient.h"
 #include "mega/logging.h"
+#include "mega/metrics.h"
 #include "mega/proxy.h"
 #include "mega/base64.h"
 #include "mega/testhooks.h"
 
+#include <limits>
+
 #if defined(WIN32) && !defined(WINDOWS_PHONE)
 #include <winhttp.h>
 #endif
@@ -134,11 +137,25 @@ bool HttpIO::inetisback()
 void HttpIO::updatedownloadspeed(m_off_t size)
 {
     downloadSpeed = downloadSpeedController.calculateSpeed(size);
+
+    Metrics& metrics = Metrics::get();
+    if (size > 0)
+    {
+        metrics.downloadBytes.add(uint64_t(size));
+    }
+    downloadSpeedMetric.set(downloadSpeed);
 }
 
 void HttpIO::updateuploadspeed(m_off_t size)
 {
     uploadSpeed = uploadSpeedController.calculateSpeed(size);
+
+    Metrics& metrics = Metrics::get();
+    if (size > 0)
+    {
+        metrics.uploadBytes.add(uint64_t(size));
+    }
+    uploadSpeedMetric.set(uploadSpeed);
 }
 
 Proxy *HttpIO::getautoproxy()
@@ -411,6 +428,124 @@ void HttpReq::disconnect()
     }
 }
 
+DownloadBufferPool& DownloadBufferPool::get()
+{
+    // never destroyed, as buffers may still be released during static destruction
+    static DownloadBufferPool* pool = new DownloadBufferPool;
+    return *pool;
+}
+
+size_t DownloadBufferPool::capacity(size_t len)
+{
+    if (len > GRANULE)
+    {
+        return (len + GRANULE - 1) / GRANULE * GRANULE;
+    }
+
+    size_t c = MINPOOLED;
+    while (c < len)
+    {
+        c <<= 1;
+    }
+    return c;
+}
+
+std::shared_ptr<byte> DownloadBufferPool::acquire(size_t len)
+{
+    size_t c = capacity(len);
+
+    byte* b = NULL;
+    {
+        std::lock_guard<std::mutex> g(mMutex);
+        auto it = mFree.find(c);
+        if (it != mFree.end() && !it->second.empty())
+        {
+            b = it->second.back();
+            it->second.pop_back();
+            mPooled -= c;
+        }
+    }
+
+    if (b)
+    {
+        Metrics::get().downloadBuffersPooled.add();
+    }
+    else
+    {
+        Metrics::get().downloadBuffersAllocated.add();
+        b = new byte[c];
+    }
+
+    return std::shared_ptr<byte>(b, [c](byte* p) { DownloadBufferPool::get().release(p, c); });
+}
+
+void DownloadBufferPool::release(byte* b, size_t c)
+{
+    {
+        std::lock_guard<std::mutex> g(mMutex);
+        if (mActive && mPooled + c <= MAXPOOLED)
+        {
+            mFree[c].push_back(b);
+            mPooled += c;
+            return;
+        }
+    }
+    delete[] b;
+}
+
+size_t DownloadBufferPool::pooled()
+{
+    std::lock_guard<std::mutex> g(mMutex);
+    return mPooled;
+}
+
+void DownloadBufferPool::trim()
+{
+    std::map<size_t, std::vector<byte*>> free;
+    {
+        std::lock_guard<std::mutex> g(mMutex);
+        free.swap(mFree);
+        mPooled = 0;
+    }
+
+    for (auto& c : free)
+    {
+        for (byte* b : c.second)
+        {
+            delete[] b;
+        }
+    }
+}
+
+void DownloadBufferPool::Activity::set(bool active)
+{
+    if (active == mActive)
+    {
+        return;
+    }
+    mActive = active;
+
+    DownloadBufferPool& pool = get();
+    bool idle;
+    {
+        std::lock_guard<std::mutex> g(pool.mMutex);
+        if (active)
+        {
+            pool.mActive++;
+        }
+        else
+        {
+            pool.mActive--;
+        }
+        idle = !pool.mActive;
+    }
+
+    if (idle)
+    {
+        pool.trim();
+    }
+}
+
 HttpReq::HttpReq(bool b)
 {
     binary = b;
@@ -425,6 +560,7 @@ HttpReq::HttpReq(bool b)
     buflen = 0;
     protect = false;
     minspeed = false;
+    bwclass = BW_BULK;
 
     init();
 }
@@ -435,8 +571,6 @@ HttpReq::~HttpReq()
     {
         httpio->cancel(this);
     }
-
-    delete[] buf;
 }
 
 void HttpReq::init()
@@ -492,30 +626,30 @@ void HttpReq::put(void* data, unsigned len, bool purge)
 
 
 HttpReq::http_buf_t::http_buf_t(byte* b, size_t s, size_t e)
-    : start(s), end(e), buf(b)
+    : start(s), end(e), buf(b, std::default_delete<byte[]>())
 {
 }
 
-HttpReq::http_buf_t::~http_buf_t()
+HttpReq::http_buf_t::http_buf_t(std::shared_ptr<byte> b, size_t s, size_t e)
+    : start(s), end(e), buf(std::move(b))
 {
-    delete[] buf;
 }
 
 void HttpReq::http_buf_t::swap(http_buf_t& other)
 {
-    byte* tb = buf; buf = other.buf; other.buf = tb;
+    buf.swap(other.buf);
     size_t ts = start; start = other.start; other.start = ts;
     size_t te = end; end = other.end; other.end = te;
 }
 
 bool HttpReq::http_buf_t::isNull()
 {
-    return buf == NULL;
+    return !buf;
 }
 
 byte* HttpReq::http_buf_t::datastart()
 { 
-    return buf + start; 
+    return buf.get() + start; 
 }
 
 size_t HttpReq::http_buf_t::datalen() 
@@ -524,10 +658,17 @@ size_t HttpReq::http_buf_t::datalen()
 }
 
 
+HttpReq::http_buf_t* HttpReq::http_buf_t::share(size_t s, size_t e) const
+{
+    assert(buf && start <= s && s <= e && e <= end);
+    return new http_buf_t(buf, s, e);
+}
+
 // give up ownership of the buffer for client to use.  
 struct HttpReq::http_buf_t* HttpReq::release_buf()
 {
-    HttpReq::http_buf_t* result = new HttpReq::http_buf_t(buf, inpurge, (size_t)bufpos);
+    HttpReq::http_buf_t* result = new HttpReq::http_buf_t(std::move(pooledbuf), inpurge, (size_t)bufpos);
+    pooledbuf.reset();
     buf = NULL;
     inpurge = 0;
     buflen = 0;
@@ -636,15 +777,13 @@ void HttpReqDL::prepare(const char* tempurl, SymmCipher* /*key*/,
     if (!buf || buflen != size)
     {
         // (re)allocate buffer
-        if (buf)
-        {
-            delete[] buf;
-            buf = NULL;
-        }
+        pooledbuf.reset();
+        buf = NULL;
 
         if (size)
         {
-            buf = new byte[(size + SymmCipher::BLOCKSIZE - 1) & - SymmCipher::BLOCKSIZE];
+            pooledbuf = DownloadBufferPool::get().acquire((size + SymmCipher::BLOCKSIZE - 1) & - SymmCipher::BLOCKSIZE);
+            buf = pooledbuf.get();
         }
         buflen = size;
     }
@@ -826,6 +965,125 @@ m_off_t SpeedController::getMeanSpeed()
     return meanSpeed;
 }
 
+const dstime BandwidthScheduler::IDLEDS = 10;
+const dstime BandwidthScheduler::BURSTDS = 5;
+
+BandwidthScheduler::BandwidthScheduler()
+{
+    limit = 0;
+    lastrefill = 0;
+
+    // streaming playback keeps a floor of 256 KB/s, the rest is shared 8:4:2:1
+    static const unsigned weights[BW_CLASSES] = { 8, 4, 2, 1 };
+    for (int i = 0; i < BW_CLASSES; i++)
+    {
+        classes[i].weight = weights[i];
+        classes[i].minbps = i == BW_INTERACTIVE ? 262144 : 0;
+        classes[i].tokens = 0;
+        classes[i].lastdemand = NEVER;
+    }
+}
+
+void BandwidthScheduler::setlimit(m_off_t bps)
+{
+    limit = bps > 0 ? bps : 0;
+}
+
+void BandwidthScheduler::setclass(bwclass_t cls, unsigned weight, m_off_t minbps)
+{
+    classes[cls].weight = weight ? weight : 1;
+    classes[cls].minbps = minbps > 0 ? minbps : 0;
+}
+
+m_off_t BandwidthScheduler::available(bwclass_t cls, dstime now)
+{
+    if (!limit)
+    {
+        return std::numeric_limits<m_off_t>::max();
+    }
+
+    classes[cls].lastdemand = now;
+    refill(now);
+    return classes[cls].tokens;
+}
+
+void BandwidthScheduler::consume(bwclass_t cls, m_off_t bytes)
+{
+    classes[cls].tokens -= bytes;
+}
+
+void BandwidthScheduler::refill(dstime now)
+{
+    dstime elapsed = std::min(now - lastrefill, BURSTDS);
+    if (!elapsed)
+    {
+        return;
+    }
+    lastrefill = now;
+
+    bool busy[BW_CLASSES];
+    bool room[BW_CLASSES];
+    m_off_t minsum = 0;
+    unsigned weightsum = 0;
+    for (int i = 0; i < BW_CLASSES; i++)
+    {
+        busy[i] = classes[i].lastdemand != NEVER && now - classes[i].lastdemand < IDLEDS;
+        if (busy[i])
+        {
+            minsum += classes[i].minbps;
+            weightsum += classes[i].weight;
+        }
+        else if (classes[i].tokens > 0)
+        {
+            classes[i].tokens = 0;  // don't let an idle class come back with a burst
+        }
+    }
+
+    if (!weightsum)
+    {
+        return;
+    }
+
+    // minimums are scaled down if together they exceed the limit
+    m_off_t spare = std::max<m_off_t>(limit - minsum, 0);
+    m_off_t spill = 0;
+    unsigned roomweight = 0;
+    for (int i = 0; i < BW_CLASSES; i++)
+    {
+        if (busy[i])
+        {
+            BwClass& c = classes[i];
+            m_off_t minbps = minsum > limit ? c.minbps * limit / minsum : c.minbps;
+            m_off_t share = minbps + spare * c.weight / weightsum;
+            m_off_t depth = share * BURSTDS / 10;
+
+            c.tokens += share * elapsed / 10;
+            room[i] = c.tokens < depth;
+            if (room[i])
+            {
+                roomweight += c.weight;
+            }
+            else
+            {
+                spill += c.tokens - depth;
+                c.tokens = depth;
+            }
+        }
+    }
+
+    // what a full class can't hold goes to the others, by weight
+    if (spill && roomweight)
+    {
+        for (int i = 0; i < BW_CLASSES; i++)
+        {
+            if (busy[i] && room[i])
+            {
+                classes[i].tokens += spill * classes[i].weight / roomweight;
+            }
+        }
+    }
+}
+
 GenericHttpReq::GenericHttpReq(PrnGen &rng, bool binary)
     : HttpReq(binary), bt(rng), maxbt(rng)
 {
@@ -28,6 +28,8 @@
 
 #include "mega/logging.h"
 
+#include <algorithm>
+#include <cstdlib>
 #include <ctime>
 
 #if defined(WINDOWS_PHONE)
@@ -41,11 +43,441 @@ Logger *SimpleLogger::logger = nullptr;
 // by the default, display logs with level equal or less than logInfo
 enum LogLevel SimpleLogger::logCurrentLevel = logInfo;
 
+LogRecord::LogRecord(LogLevel ll, const char* file, int l)
+    : time(std::time(NULL))
+    , line(l)
+    , level(ll)
+{
+    // the first value is always the file name
+    putString(file, std::min(std::strlen(file), DATASIZE / 2));
+}
+
+void LogRecord::putString(const char* value, size_t len)
+{
+    if (!spill && mUsed + 1 + sizeof(uint16_t) + len <= DATASIZE)
+    {
+        uint16_t len16 = static_cast<uint16_t>(len);
+        mData[mUsed] = STRING;
+        memcpy(mData + mUsed + 1, &len16, sizeof(len16));
+        memcpy(mData + mUsed + 1 + sizeof(len16), value, len);
+        mUsed = static_cast<uint16_t>(mUsed + 1 + sizeof(len16) + len);
+    }
+    else
+    {
+        spillString().append(value, len);
+    }
+}
+
+std::string& LogRecord::spillString()
+{
+    if (!spill)
+    {
+        spill.reset(new std::string);
+    }
+    return *spill;
+}
+
+void LogRecord::appendValue(std::string& out, Tag tag, const char* bytes)
+{
+    char buf[32];
+    int n = 0;
+
+    switch (tag)
+    {
+        case SIGNED:
+        {
+            long long value;
+            memcpy(&value, bytes, sizeof(value));
+            n = snprintf(buf, sizeof(buf), "%lld", value);
+            break;
+        }
+        case UNSIGNED:
+        {
+            unsigned long long value;
+            memcpy(&value, bytes, sizeof(value));
+            n = snprintf(buf, sizeof(buf), "%llu", value);
+            break;
+        }
+        case FLOATING:
+        {
+            double value;
+            memcpy(&value, bytes, sizeof(value));
+            n = snprintf(buf, sizeof(buf), "%g", value);
+            break;
+        }
+        case POINTER:
+        {
+            const void* value;
+            memcpy(&value, bytes, sizeof(value));
+            n = snprintf(buf, sizeof(buf), "%p", value);
+            break;
+        }
+        case CHARACTER:
+            out.push_back(*bytes);
+            return;
+        case STRING:
+            assert(false);
+            return;
+    }
+
+    if (n > 0)
+    {
+        out.append(buf, std::min(static_cast<size_t>(n), sizeof(buf) - 1));
+    }
+}
+
+void LogRecord::format(std::string& source, std::string& message) const
+{
+    static const size_t valuesize[] = { sizeof(long long), sizeof(unsigned long long), sizeof(double),
+                                        sizeof(const void*), sizeof(char) };
+    source.clear();
+    message.clear();
+
+    size_t i = 0;
+    while (i < mUsed)
+    {
+        // the first value is the file name
+        std::string& out = i ? message : source;
+        Tag tag = static_cast<Tag>(mData[i++]);
+
+        if (tag == STRING)
+        {
+            uint16_t len;
+            memcpy(&len, mData + i, sizeof(len));
+            out.append(mData + i + sizeof(len), len);
+            i += sizeof(len) + len;
+        }
+        else
+        {
+            appendValue(out, tag, mData + i);
+            i += valuesize[tag];
+        }
+    }
+
+    if (line >= 0)
+    {
+        source.push_back(':');
+        source.append(std::to_string(line));
+    }
+
+    if (spill)
+    {
+        message.append(*spill);
+    }
+}
+
+AsyncLogQueue::AsyncLogQueue(size_t capacity, LogLevel dropFrom, Deliver deliver, FlushOutputs flushOutputs)
+    : mSlots(new Slot[capacity])
+    , mMask(capacity - 1)
+    , mDropFrom(dropFrom)
+    , mDeliver(std::move(deliver))
+    , mFlushOutputs(std::move(flushOutputs))
+{
+    assert(capacity && !(capacity & mMask));
+
+    for (size_t i = 0; i < capacity; i++)
+    {
+        mSlots[i].seq.store(i, std::memory_order_relaxed);
+    }
+
+    mThread = std::thread([this]() { run(); });
+}
+
+AsyncLogQueue::~AsyncLogQueue()
+{
+    stop();
+}
+
+bool AsyncLogQueue::push(LogRecord& record)
+{
+    // the queue's own thread must not wait for itself
+    const bool mayWait = record.level < mDropFrom && std::this_thread::get_id() != mThread.get_id();
+    size_t pos = mTail.load(std::memory_order_relaxed);
+
+    for (;;)
+    {
+        if (mStopped.load(std::memory_order_acquire))
+        {
+            deliverNow(record);
+            return true;
+        }
+
+        Slot& slot = mSlots[pos & mMask];
+        size_t seq = slot.seq.load(std::memory_order_acquire);
+
+        if (seq == pos)
+        {
+            if (mTail.compare_exchange_weak(pos, pos + 1))
+            {
+                slot.record = std::move(record);
+                slot.seq.store(pos + 1, std::memory_order_release);
+
+                // stop() may have finished draining after the check above: then either it sees
+                // this claim in mTail and waits for the record, or this sees mStopped and drains
+                if (mStopped.load())
+                {
+                    std::lock_guard<std::recursive_mutex> g(mDeliverMutex);
+                    drain();
+                }
+                else
+                {
+                    wake();
+                }
+                return true;
+            }
+        }
+        else if (static_cast<ptrdiff_t>(seq - pos) < 0)
+        {
+            // full: the slot still holds the record pushed one lap earlier
+            wake();
+
+            if (!mayWait)
+            {
+                mDropped.fetch_add(1, std::memory_order_relaxed);
+                return false;
+            }
+
+            std::this_thread::yield();
+            pos = mTail.load(std::memory_order_relaxed);
+        }
+        else
+        {
+            pos = mTail.load(std::memory_order_relaxed);
+        }
+    }
+}
+
+void AsyncLogQueue::flush()
+{
+    if (std::this_thread::get_id() == mThread.get_id())
+    {
+        return;
+    }
+
+    const size_t target = mTail.load();
+
+    ++mFlushing;
+    {
+        std::unique_lock<std::mutex> lock(mWakeMutex);
+        mIdle = false;
+        mWakeCondition.notify_one();
+        mFlushedCondition.wait(lock, [this, target]() {
+            return mDelivered.load() >= target || mStopped.load();
+        });
+    }
+    --mFlushing;
+
+    if (mStopped.load())
+    {
+        std::lock_guard<std::recursive_mutex> g(mDeliverMutex);
+        drain();
+    }
+}
+
+void AsyncLogQueue::stop()
+{
+    if (mStopping.exchange(true))
+    {
+        return;
+    }
+
+    {
+        std::lock_guard<std::mutex> g(mWakeMutex);
+        mWakeCondition.notify_one();
+    }
+    mThread.join();
+
+    // from here on pushes are delivered by their callers; first deliver what is left, waiting
+    // for records whose slots were claimed but not filled yet
+    std::lock_guard<std::recursive_mutex> g(mDeliverMutex);
+    mStopped = true;
+    while (mHead != mTail.load())
+    {
+        if (ready(mHead))
+        {
+            consume();
+        }
+        else
+        {
+            std::this_thread::yield();
+        }
+    }
+    reportDropped();
+    if (mFlushOutputs)
+    {
+        mFlushOutputs();
+    }
+
+    std::lock_guard<std::mutex> w(mWakeMutex);
+    mFlushedCondition.notify_all();
+}
+
+void AsyncLogQueue::run()
+{
+    for (;;)
+    {
+        drain();
+
+        if (mFlushing.load())
+        {
+            std::lock_guard<std::mutex> g(mWakeMutex);
+            mFlushedCondition.notify_all();
+        }
+
+        if (mStopping.load())
+        {
+            return;
+        }
+
+        // sleep unless a record arrived meanwhile; pairs with the fence in wake()
+        mIdle.store(true, std::memory_order_relaxed);
+        std::atomic_thread_fence(std::memory_order_seq_cst);
+        if (ready(mHead))
+        {
+            mIdle = false;
+            continue;
+        }
+
+        std::unique_lock<std::mutex> lock(mWakeMutex);
+        mWakeCondition.wait(lock, [this]() { return !mIdle.load() || mStopping.load(); });
+    }
+}
+
+void AsyncLogQueue::wake()
+{
+    std::atomic_thread_fence(std::memory_order_seq_cst);
+    if (mIdle.load(std::memory_order_relaxed) && mIdle.exchange(false))
+    {
+        std::lock_guard<std::mutex> g(mWakeMutex);
+        mWakeCondition.notify_one();
+    }
+}
+
+bool AsyncLogQueue::ready(size_t pos) const
+{
+    return mSlots[pos & mMask].seq.load(std::memory_order_acquire) == pos + 1;
+}
+
+void AsyncLogQueue::consume()
+{
+    while (ready(mHead))
+    {
+        Slot& slot = mSlots[mHead & mMask];
+        LogRecord record;
+        record = std::move(slot.record);
+
+        // hand the slot back to producers before formatting
+        slot.seq.store(mHead + mMask + 1, std::memory_order_release);
+        mHead++;
+
+        deliver(record);
+        mDelivered.store(mHead);
+    }
+}
+
+// delivers what is ready and reports drops, then flushes the outputs if anything was written
+void AsyncLogQueue::drain()
+{
+    const size_t head = mHead;
+    const uint64_t reported = mReported;
+
+    consume();
+    reportDropped();
+
+    if (mFlushOutputs && (mHead != head || mReported != reported))
+    {
+        mFlushOutputs();
+    }
+}
+
+void AsyncLogQueue::deliver(LogRecord& record)
+{
+    if (record.time != mLastTime || mTimeStr.empty())
+    {
+        char ts[50];
+        if (!std::strftime(ts, sizeof(ts), "%H:%M:%S", std::gmtime(&record.time)))
+        {
+            ts[0] = '\0';
+        }
+        mTimeStr = ts;
+        mLastTime = record.time;
+    }
+
+    std::string source, message;
+    record.format(source, message);
+    mDeliver(mTimeStr.c_str(), record.level, source.c_str(), message.c_str());
+}
+
+void AsyncLogQueue::deliverNow(LogRecord& record)
+{
+    std::lock_guard<std::recursive_mutex> g(mDeliverMutex);
+    drain();
+    deliver(record);
+    if (mFlushOutputs)
+    {
+        mFlushOutputs();
+    }
+}
+
+void AsyncLogQueue::reportDropped()
+{
+    uint64_t dropped = mDropped.load();
+    if (dropped != mReported)
+    {
+        LogRecord record(logWarning, __FILE__, __LINE__);
+        record.putUnsigned(dropped - mReported);
+        const char* text = " log records dropped: the logging queue was full";
+        record.putString(text, strlen(text));
+        mReported = dropped;
+        deliver(record);
+    }
+}
+
+#ifdef ENABLE_LOG_ASYNC
+AsyncLogQueue& SimpleLogger::asyncQueue()
+{
+    // never destroyed, as records may be logged during static destruction;
+    // its thread is stopped at exit, before the outputs it delivers to go away
+    static AsyncLogQueue* queue = []() {
+        AsyncLogQueue* q = new AsyncLogQueue(ASYNCQUEUESIZE, ASYNCDROPFROM, &SimpleLogger::deliver, &SimpleLogger::flushOutputs);
+        std::atexit([]() { asyncQueue().stop(); });
+        return q;
+    }();
+    return *queue;
+}
+
+void SimpleLogger::deliver(const char* time, int loglevel, const char* source, const char* message)
+{
+    if (logger)
+    {
+        logger->log(time, loglevel, source, message);
+    }
+
+    for (std::ostream* os : getOutput(static_cast<LogLevel>(loglevel)))
+    {
+        *os << message << '\n';
+    }
+}
+
+void SimpleLogger::flushOutputs()
+{
+    std::lock_guard<std::mutex> guard(outputs_mutex);
+    for (auto& o : outputs)
+    {
+        for (std::ostream* os : o)
+        {
+            os->flush();
+        }
+    }
+}
+#endif
+
 #ifndef ENABLE_LOG_PERFORMANCE
 // static member initialization
 std::mutex SimpleLogger::outputs_mutex;
 OutputMap SimpleLogger::outputs;
 
+#ifndef ENABLE_LOG_ASYNC
 std::string SimpleLogger::getTime()
 {
     char ts[50];
@@ -56,9 +488,14 @@ std::string SimpleLogger::getTime()
     }
     return ts;
 }
+#endif
 
 void SimpleLogger::flush()
 {
+#ifdef ENABLE_LOG_ASYNC
+    asyncQueue().flush();
+#endif
+
     for (auto& o : outputs)
     {
         OutputStreams::iterator iter;
@@ -1849,6 +1849,11 @@ void MegaApi::setLoggingName(const char* loggingName)
     pImpl->setLoggingName(loggingName);
 }
 
+char* MegaApi::getMetrics(int format)
+{
+    return MegaApiImpl::getMetrics(format);
+}
+
 long long MegaApi::getSDKtime()
 {
     return pImpl->getSDKtime();
@@ -2271,6 +2276,11 @@ void MegaApi::getThumbnail(MegaNode* node, const char *dstFilePath, MegaRequestL
     pImpl->getThumbnail(node, dstFilePath, listener);
 }
 
+void MegaApi::getThumbnails(MegaNodeList *nodes, const char *dstFolderPath, MegaRequestListener *listener)
+{
+    pImpl->getThumbnails(nodes, dstFolderPath, listener);
+}
+
 void MegaApi::cancelGetThumbnail(MegaNode* node, MegaRequestListener *listener)
 {
 	pImpl->cancelGetThumbnail(node, listener);
@@ -2301,6 +2311,16 @@ void MegaApi::cancelGetPreview(MegaNode* node, MegaRequestListener *listener)
 	pImpl->cancelGetPreview(node, listener);
 }
 
+void MegaApi::setThumbnailCacheFolder(const char *localFolder, long long maxSize)
+{
+    pImpl->setThumbnailCacheFolder(localFolder, maxSize);
+}
+
+void MegaApi::prefetchThumbnails(MegaNodeList *nodes)
+{
+    pImpl->prefetchThumbnails(nodes);
+}
+
 void MegaApi::setPreview(MegaNode* node, const char *srcFilePath, MegaRequestListener *listener)
 {
     pImpl->setPreview(node, srcFilePath, listener);
@@ -4127,6 +4147,16 @@ int MegaApi::httpServerGetMaxOutputSize()
     return pImpl->httpServerGetMaxOutputSize();
 }
 
+void MegaApi::httpServerSetWorkerThreads(int workerThreads)
+{
+    pImpl->httpServerSetWorkerThreads(workerThreads);
+}
+
+int MegaApi::httpServerGetWorkerThreads()
+{
+    return pImpl->httpServerGetWorkerThreads();
+}
+
 //FTP Server:
 bool MegaApi::ftpServerStart(bool localOnly, int port, int dataportBegin, int dataPortEnd, bool useTLS, const char * certificatepath, const char * keypath)
 {
@@ -1642,6 +1642,81 @@ MegaNodePrivate::~MegaNodePrivate()
     delete children;
 }
 
+MegaNode* MegaNodeSnapshots::get(MegaHandle h)
+{
+    Shard& s = shard(h);
+    std::shared_ptr<MegaNode> node;
+    {
+        std::lock_guard<std::mutex> g(s.mutex);
+        auto it = s.nodes.find(h);
+        if (it == s.nodes.end())
+        {
+            return NULL;
+        }
+        node = it->second.first;
+        s.lru.splice(s.lru.begin(), s.lru, it->second.second);
+    }
+
+    // published nodes are never modified, so they can be copied outside the lock
+    return node->copy();
+}
+
+void MegaNodeSnapshots::publish(MegaNode* node)
+{
+    std::shared_ptr<MegaNode> p(node);
+    MegaHandle h = node->getHandle();
+    Shard& s = shard(h);
+    std::lock_guard<std::mutex> g(s.mutex);
+
+    auto it = s.nodes.find(h);
+    if (it != s.nodes.end())
+    {
+        it->second.first = std::move(p);
+        s.lru.splice(s.lru.begin(), s.lru, it->second.second);
+        return;
+    }
+
+    if (s.nodes.size() >= MAXNODES / SHARDS)
+    {
+        s.nodes.erase(s.lru.back());
+        s.lru.pop_back();
+        mCount--;
+    }
+
+    s.lru.push_front(h);
+    s.nodes.emplace(h, std::make_pair(std::move(p), s.lru.begin()));
+    mCount++;
+}
+
+void MegaNodeSnapshots::invalidate(MegaHandle h)
+{
+    if (!mCount.load(std::memory_order_relaxed))
+    {
+        return;
+    }
+
+    Shard& s = shard(h);
+    std::lock_guard<std::mutex> g(s.mutex);
+    auto it = s.nodes.find(h);
+    if (it != s.nodes.end())
+    {
+        s.lru.erase(it->second.second);
+        s.nodes.erase(it);
+        mCount--;
+    }
+}
+
+void MegaNodeSnapshots::clear()
+{
+    for (Shard& s : mShards)
+    {
+        std::lock_guard<std::mutex> g(s.mutex);
+        mCount -= s.nodes.size();
+        s.nodes.clear();
+        s.lru.clear();
+    }
+}
+
 MegaUserPrivate::MegaUserPrivate(User *user) : MegaUser()
 {
     email = MegaApi::strdup(user->email.c_str());
@@ -2765,6 +2840,16 @@ void MegaTransferPrivate::setNotificationNumber(long long notificationNumber)
     this->notificationNumber = notificationNumber;
 }
 
+void MegaTransferPrivate::setUploadStream(std::shared_ptr<UploadStream> stream)
+{
+    this->uploadStream = std::move(stream);
+}
+
+std::shared_ptr<UploadStream> MegaTransferPrivate::getUploadStream() const
+{
+    return uploadStream;
+}
+
 void MegaTransferPrivate::setListener(MegaTransferListener *listener)
 {
     this->listener = listener;
@@ -5053,6 +5138,7 @@ void MegaApiImpl::init(MegaApi *api, const char *appKey, MegaGfxProcessor* proce
     httpServer = NULL;
     httpServerMaxBufferSize = 0;
     httpServerMaxOutputSize = 0;
+    httpServerWorkerThreads = 0;
     httpServerEnableFiles = true;
     httpServerEnableFolders = false;
     httpServerOfflineAttributeEnabled = false;
@@ -5438,6 +5524,14 @@ void MegaApiImpl::setLoggingName(const char* loggingName)
     sdkMutex.unlock();
 }
 
+char* MegaApiImpl::getMetrics(int format)
+{
+    // metrics are atomics, no need to lock the SDK
+    Metrics& metrics = Metrics::get();
+    string snapshot = format == MegaApi::METRICS_FORMAT_PROMETHEUS ? metrics.prometheus() : metrics.json();
+    return MegaApi::strdup(snapshot.c_str());
+}
+
 long long MegaApiImpl::getSDKtime()
 {
     return Waiter::ds;
@@ -6442,6 +6536,35 @@ void MegaApiImpl::getThumbnail(MegaNode* node, const char *dstFilePath, MegaRequ
     getNodeAttribute(node, GfxProc::THUMBNAIL, dstFilePath, listener);
 }
 
+void MegaApiImpl::getThumbnails(MegaNodeList *nodes, const char *dstFolderPath, MegaRequestListener *listener)
+{
+    if (!nodes)
+    {
+        return;
+    }
+
+    string path;
+    if (dstFolderPath)
+    {
+        path = dstFolderPath;
+        if (path.empty() || (path.back() != '/' && path.back() != '\\'))
+        {
+#ifdef _WIN32
+            path.push_back('\\');
+#else
+            path.push_back('/');
+#endif
+        }
+    }
+
+    // queue the whole batch before the SDK thread gets to it, so that it goes out in one POST per channel
+    SdkMutexGuard g(sdkMutex);
+    for (int i = 0; i < nodes->size(); i++)
+    {
+        getNodeAttribute(nodes->get(i), GfxProc::THUMBNAIL, dstFolderPath ? path.c_str() : NULL, listener);
+    }
+}
+
 void MegaApiImpl::cancelGetThumbnail(MegaNode* node, MegaRequestListener *listener)
 {
     cancelGetNodeAttribute(node, GfxProc::THUMBNAIL, listener);
@@ -6472,6 +6595,45 @@ void MegaApiImpl::cancelGetPreview(MegaNode* node, MegaRequestListener *listener
     cancelGetNodeAttribute(node, GfxProc::PREVIEW, listener);
 }
 
+void MegaApiImpl::setThumbnailCacheFolder(const char *localFolder, long long maxSize)
+{
+    if (!localFolder)
+    {
+        SdkMutexGuard g(sdkMutex);
+        client->facache.reset();
+        return;
+    }
+
+    string path = localFolder;
+    string localPath;
+    fsAccess->path2local(&path, &localPath);
+
+    // a large cache takes a while to list, which must not hold up the SDK thread
+    FileAttributeCache::entry_vector existing = FileAttributeCache::scan(*fsAccess, localPath);
+
+    SdkMutexGuard g(sdkMutex);
+    client->facache.reset(new FileAttributeCache(*client->fsaccess, localPath, maxSize, existing));
+}
+
+void MegaApiImpl::prefetchThumbnails(MegaNodeList *nodes)
+{
+    if (!nodes)
+    {
+        return;
+    }
+
+    SdkMutexGuard g(sdkMutex);
+    for (int i = 0; i < nodes->size(); i++)
+    {
+        Node *n = client->nodebyhandle(nodes->get(i)->getHandle());
+        if (n)
+        {
+            client->prefetchfa(n, GfxProc::THUMBNAIL);
+        }
+    }
+    waiter->notify();
+}
+
 void MegaApiImpl::setPreview(MegaNode* node, const char *srcFilePath, MegaRequestListener *listener)
 {
     setNodeAttribute(node, GfxProc::PREVIEW, srcFilePath, INVALID_HANDLE, listener);
@@ -8020,6 +8182,20 @@ void MegaApiImpl::startUpload(const char *localPath, MegaNode *parent, int64_t m
 void MegaApiImpl::startUpload(const char* localPath, MegaNode* parent, const char* fileName, MegaTransferListener *listener)
 { return startUpload(false, localPath, parent, fileName, -1, 0, false, NULL, false, false, listener); }
 
+void MegaApiImpl::startUpload(std::shared_ptr<UploadStream> stream, const char *localPath, MegaNode *parent, const char *fileName, MegaTransferListener *listener)
+{
+    MegaTransferPrivate* transfer = new MegaTransferPrivate(MegaTransfer::TYPE_UPLOAD, listener);
+    transfer->setPath(localPath);
+    transfer->setParentHandle(parent->getHandle());
+    transfer->setMaxRetries(maxRetries);
+    transfer->setFileName(fileName);
+    transfer->setTime(-1);
+    transfer->setUploadStream(std::move(stream));
+
+    transferQueue.push(transfer);
+    waiter->notify();
+}
+
 void MegaApiImpl::startUploadForSupport(const char *localPath, bool isSourceTemporary, MegaTransferListener *listener)
 {
     return startUpload(true, localPath, nullptr, nullptr, "pGTOqu7_Fek", -1, 0, false, nullptr, isSourceTemporary, false, listener);
@@ -8957,6 +9133,7 @@ bool MegaApiImpl::httpServerStart(bool localOnly, int port, bool useTLS, const c
     httpServer = new MegaHTTPServer(this, basePath, useTLS, certificatepath ? certificatepath : string(), keypath ? keypath : string(), useIPv6);
     httpServer->setMaxBufferSize(httpServerMaxBufferSize);
     httpServer->setMaxOutputSize(httpServerMaxOutputSize);
+    httpServer->setWorkerThreads(httpServerWorkerThreads);
     httpServer->enableFileServer(httpServerEnableFiles);
     httpServer->enableOfflineAttribute(httpServerOfflineAttributeEnabled);
     httpServer->enableFolderServer(httpServerEnableFolders);
@@ -9182,6 +9359,21 @@ int MegaApiImpl::httpServerGetMaxOutputSize()
     return value;
 }
 
+void MegaApiImpl::httpServerSetWorkerThreads(int workerThreads)
+{
+    sdkMutex.lock();
+    httpServerWorkerThreads = workerThreads <= 0 ? 0 : workerThreads;
+    sdkMutex.unlock();
+}
+
+int MegaApiImpl::httpServerGetWorkerThreads()
+{
+    sdkMutex.lock();
+    int value = httpServerWorkerThreads;
+    sdkMutex.unlock();
+    return value;
+}
+
 void MegaApiImpl::httpServerEnableFileServer(bool enable)
 {
     sdkMutex.lock();
@@ -11228,14 +11420,45 @@ MegaNodeList* MegaApiImpl::search(MegaNode* n, const char* searchString, MegaCan
         return new MegaNodeListPrivate();
     }
 
-    SearchTreeProcessor searchProcessor(searchString);
-    for (node_list::iterator it = node->children.begin(); it != node->children.end()
-         && !(cancelToken && cancelToken->isCancelled()); )
+    vector<Node *> vNodes;
+    const NodeCounter& nc = node->subnodeCounts();
+    if (recursive && nc.files + nc.folders >= PARALLEL_SEARCH_MIN)
+    {
+        // large subtrees are split across threads; each one collects its own matches
+        unsigned numThreads = MegaClient::workerthreads();
+        vector<SearchTreeProcessor> searchProcessors(numThreads, SearchTreeProcessor(searchString));
+        vector<std::unique_ptr<SearchTreeProc>> procs;
+        vector<TreeProc*> tps;
+        for (auto& sp : searchProcessors)
+        {
+            procs.emplace_back(new SearchTreeProc(node, &sp));
+            tps.push_back(procs.back().get());
+        }
+
+        client->proctreeparallel(node, tps, false, true, [cancelToken]()
+        {
+            return cancelToken && cancelToken->isCancelled();
+        });
+
+        for (auto& sp : searchProcessors)
+        {
+            vNodes.insert(vNodes.end(), sp.getResults().begin(), sp.getResults().end());
+        }
+
+        // the split between threads varies from run to run; return what the sequential walk would
+        MegaClient::sortinproctreeorder(vNodes, node);
+    }
+    else
     {
-        processTree(*it++, &searchProcessor, recursive, cancelToken);
+        SearchTreeProcessor searchProcessor(searchString);
+        for (node_list::iterator it = node->children.begin(); it != node->children.end()
+             && !(cancelToken && cancelToken->isCancelled()); )
+        {
+            processTree(*it++, &searchProcessor, recursive, cancelToken);
+        }
+        vNodes.swap(searchProcessor.getResults());
     }
 
-    vector<Node *>& vNodes = searchProcessor.getResults();
     sortByComparatorFunction(vNodes, order, *client);
 
     MegaNodeList *nodeList = new MegaNodeListPrivate(vNodes.data(), int(vNodes.size()));
@@ -11265,9 +11488,8 @@ long long MegaApiImpl::getSize(MegaNode *n)
         sdkMutex.unlock();
         return 0;
     }
-    SizeProcessor sizeProcessor;
-    processTree(node, &sizeProcessor);
-    long long result = sizeProcessor.getTotalBytes();
+    const NodeCounter& nc = node->subnodeCounts();
+    long long result = nc.storage - nc.versionStorage;
     sdkMutex.unlock();
 
     return result;
@@ -11561,6 +11783,21 @@ MegaNode *MegaApiImpl::getNodeByCRC(const char *crc, MegaNode *parent)
 
 SearchTreeProcessor::SearchTreeProcessor(const char *search) { this->search = search; }
 
+SearchTreeProc::SearchTreeProc(Node* root, SearchTreeProcessor* processor)
+    : mRoot(root)
+    , mProcessor(processor)
+{
+}
+
+void SearchTreeProc::proc(MegaClient*, Node* node)
+{
+    // the searched folder itself is not a result
+    if (node != mRoot)
+    {
+        mProcessor->processNode(node);
+    }
+}
+
 #if defined(_WIN32) || defined(__APPLE__)
 
 char *strcasestr(const char *string, const char *substring)
@@ -11612,23 +11849,6 @@ vector<Node *> &SearchTreeProcessor::getResults()
     return results;
 }
 
-SizeProcessor::SizeProcessor()
-{
-    totalBytes=0;
-}
-
-bool SizeProcessor::processNode(Node *node)
-{
-    if(node->type == FILENODE)
-        totalBytes += node->size;
-    return true;
-}
-
-long long SizeProcessor::getTotalBytes()
-{
-    return totalBytes;
-}
-
 void MegaApiImpl::file_added(File *f)
 {
     Transfer *t = f->transfer;
@@ -13669,6 +13889,8 @@ void MegaApiImpl::copysession_result(string *session, error e)
 
 void MegaApiImpl::clearing()
 {
+    nodeSnapshots.clear();
+
 #ifdef ENABLE_SYNC
     map<int, MegaSyncPrivate *>::iterator it;
     for (it = syncMap.begin(); it != syncMap.end(); )
@@ -14334,6 +14556,11 @@ void MegaApiImpl::reload(const char*)
 // nodes have been modified
 // (nodes with their removed flag set will be deleted immediately after returning from this call,
 // at which point their pointers will become invalid at that point.)
+void MegaApiImpl::node_decrypted(handle h)
+{
+    nodeSnapshots.invalidate(h);
+}
+
 void MegaApiImpl::nodes_updated(Node** n, int count)
 {
     LOG_debug << "Nodes updated: " << count;
@@ -14345,11 +14572,17 @@ void MegaApiImpl::nodes_updated(Node** n, int count)
     MegaNodeList *nodeList = NULL;
     if (n != NULL)
     {
+        for (int i = 0; i < count; i++)
+        {
+            nodeSnapshots.invalidate(n[i]->nodehandle);
+        }
+
         nodeList = new MegaNodeListPrivate(n, count);
         fireOnNodesUpdate(nodeList);
     }
     else
     {
+        nodeSnapshots.clear();
         fireOnNodesUpdate(NULL);
     }
     delete nodeList;
@@ -16392,114 +16625,6 @@ bool MegaApiImpl::isFilesystemAvailable()
     return result;
 }
 
-bool isDigit(const char *c)
-{
-    return (*c >= '0' && *c <= '9');
-}
-
-// returns 0 if i==j, +1 if i goes first, -1 if j goes first.
-int naturalsorting_compare (const char *i, const char *j)
-{
-    static uint64_t maxNumber = (ULONG_MAX - 57) / 10; // 57 --> ASCII code for '9'
-
-    bool stringMode = true;
-
-    while (*i && *j)
-    {
-        if (stringMode)
-        {
-            char char_i, char_j;
-            while ( (char_i = *i) && (char_j = *j) )
-            {
-                bool char_i_isDigit = isDigit(i);
-                bool char_j_isDigit = isDigit(j);
-
-                if (char_i_isDigit && char_j_isDigit)
-                {
-                    stringMode = false;
-                    break;
-                }
-
-                if(char_i_isDigit)
-                {
-                    return -1;
-                }
-
-                if(char_j_isDigit)
-                {
-                    return 1;
-                }
-
-                int difference = strncasecmp((char *)&char_i, (char *)&char_j, 1);
-                if (difference)
-                {
-                    return difference;
-                }
-
-                ++i;
-                ++j;
-            }
-        }
-        else    // we are comparing numbers on both strings
-        {
-            uint64_t number_i = 0;
-            unsigned int i_overflow_count = 0;
-            while (*i && isDigit(i))
-            {
-                number_i = number_i * 10 + (*i - 48); // '0' ASCII code is 48
-                ++i;
-
-                // check the number won't overflow upon addition of next char
-                if (number_i >= maxNumber)
-                {
-                    number_i -= maxNumber;
-                    i_overflow_count++;
-                }
-            }
-
-            uint64_t number_j = 0;
-            unsigned int j_overflow_count = 0;
-            while (*j && isDigit(j))
-            {
-                number_j = number_j * 10 + (*j - 48);
-                ++j;
-
-                // check the number won't overflow upon addition of next char
-                if (number_j >= maxNumber)
-                {
-                    number_j -= maxNumber;
-                    j_overflow_count++;
-                }
-            }
-
-            int difference = i_overflow_count - j_overflow_count;
-            if (difference)
-            {
-                return difference;
-            }
-
-            if (number_i != number_j)
-            {
-                return number_i > number_j ? 1 : -1;
-            }
-
-            stringMode = true;
-        }
-    }
-
-    if (*j)
-    {
-        return -1;
-    }
-
-    if (*i)
-    {
-        return 1;
-    }
-
-    return 0;
-}
-
 std::function<bool (Node*, Node*)> MegaApiImpl::getComparatorFunction(int order, MegaClient& mc)
 {
     switch (order)
@@ -16534,22 +16659,12 @@ void MegaApiImpl::sortByComparatorFunction(node_vector& v, int order, MegaClient
 
 bool MegaApiImpl::nodeNaturalComparatorASC(Node *i, Node *j)
 {
-    int r = naturalsorting_compare(i->displayname(), j->displayname());
-    if (r < 0)
-    {
-        return 1;
-    }
-    return 0;
+    return i->sortkey() < j->sortkey();
 }
 
 bool MegaApiImpl::nodeNaturalComparatorDESC(Node *i, Node *j)
 {
-    int r = naturalsorting_compare(i->displayname(), j->displayname());
-    if (r <= 0)
-    {
-        return 0;
-    }
-    return 1;
+    return j->sortkey() < i->sortkey();
 }
 
 bool MegaApiImpl::nodeComparatorDefaultASC(Node *i, Node *j)
@@ -17563,8 +17678,26 @@ MegaNode* MegaApiImpl::getNodeByPath(const char *path, MegaNode* node)
 MegaNode* MegaApiImpl::getNodeByHandle(handle handle)
 {
     if(handle == UNDEF) return NULL;
+
+    if (MegaNode *snapshot = nodeSnapshots.get(handle))
+    {
+        Metrics::get().nodeSnapshotHits.add();
+        return snapshot;
+    }
+    Metrics::get().nodeSnapshotMisses.add();
+
     sdkMutex.lock();
-    MegaNode *result = MegaNodePrivate::fromNode(client->nodebyhandle(handle));
+    Node *n = client->nodebyhandle(handle);
+    MegaNode *result = MegaNodePrivate::fromNode(n);
+
+    // a node with pending changes is read from inside onNodesUpdate(): its flags are reset
+    // right after, so it is left for the next reader to publish.  Nor is a node still waiting
+    // for its key or attributes published, so that it isn't served undecrypted after they arrive.
+    if (result && !result->getChanges()
+            && (n->type > FOLDERNODE || n->keyApplied()) && !n->attrstring)
+    {
+        nodeSnapshots.publish(result->copy());
+    }
     sdkMutex.unlock();
     return result;
 }
@@ -17630,7 +17763,9 @@ unsigned MegaApiImpl::sendPendingTransfers()
                 string wLocalPath;
                 client->fsaccess->path2local(&tmpString, &wLocalPath);
 
-                auto fa = fsAccess->newfileaccess();
+                std::shared_ptr<UploadStream> uploadStream = transfer->getUploadStream();
+                auto fa = uploadStream ? std::unique_ptr<FileAccess>(new StreamFileAccess(uploadStream, client->waiter))
+                                       : fsAccess->newfileaccess();
                 if (!fa->fopen(&wLocalPath, true, false))
                 {
                     e = API_EREAD;
@@ -17648,7 +17783,15 @@ unsigned MegaApiImpl::sendPendingTransfers()
                 }
                 m_off_t size = fa->size;
                 FileFingerprint fp;
-                if (type == FILENODE)
+                if (uploadStream)
+                {
+                    // the content hasn't arrived yet: a unique fingerprint until Transfer::complete() generates it
+                    fp.size = size;
+                    fp.mtime = fa->mtime;
+                    client->rng.genblock((byte*)fp.crc.data(), sizeof fp.crc);
+                    fp.isvalid = true;
+                }
+                else if (type == FILENODE)
                 {
                     fp.genfingerprint(fa.get());
                 }
@@ -17656,7 +17799,8 @@ unsigned MegaApiImpl::sendPendingTransfers()
 
                 if (type == FILENODE)
                 {
-                    Node *previousNode = client->childnodebyname(parent, fileName, true);
+                    // content that is still being received can't match existing nodes
+                    Node *previousNode = uploadStream ? NULL : client->childnodebyname(parent, fileName, true);
 
                     bool forceToUpload = false;
                     if (previousNode && previousNode->type == type)
@@ -17689,7 +17833,7 @@ unsigned MegaApiImpl::sendPendingTransfers()
                     }
 
                     // If has been found by name and it's necessary force upload, it isn't necessary look for it again
-                    if (!forceToUpload)
+                    if (!forceToUpload && !uploadStream)
                     {
                         Node *samenode = client->nodebyfingerprint(&fp);
                         if (samenode && samenode->nodekey().size() && !hasToForceUpload(*samenode, *transfer))
@@ -17751,7 +17895,11 @@ unsigned MegaApiImpl::sendPendingTransfers()
                     MegaFilePut *f = new MegaFilePut(client, &wLocalPath, &wFileName, transfer->getParentHandle(), uploadToInbox ? inboxTarget : "", mtime, isSourceTemporary);
                     *static_cast<FileFingerprint*>(f) = fp;  // deliberate slicing - startxfer would re-fingerprint if we don't supply this info
                     f->setTransfer(transfer);
-                    bool started = client->startxfer(PUT, f, committer, true, startFirst, transfer->isBackupTransfer());
+                    f->backupxfer = transfer->isBackupTransfer();
+                    f->uploadstream = uploadStream;
+
+                    // streamed content can't be resumed after a restart, so it isn't cached
+                    bool started = client->startxfer(PUT, f, committer, true, startFirst, transfer->isBackupTransfer() || uploadStream);
                     if (!started)
                     {
                         transfer->setState(MegaTransfer::STATE_QUEUED);
@@ -21398,11 +21546,11 @@ void MegaApiImpl::sendPendingRequests()
                 break;
             }
 
-            TreeProcFolderInfo folderProcessor;
-            client->proctree(node, &folderProcessor, false, false);
-            MegaFolderInfo *folderInfo = folderProcessor.getResult();
-            request->setMegaFolderInfo(folderInfo);
-            delete folderInfo;
+            // versions are included in the file totals, and the folder itself in the folder count
+            const NodeCounter& nc = node->subnodeCounts();
+            MegaFolderInfoPrivate folderInfo(int(nc.files - nc.versions), int(nc.folders) - (node->type == FOLDERNODE),
+                                             int(nc.versions), nc.storage - nc.versionStorage, nc.versionStorage);
+            request->setMegaFolderInfo(&folderInfo);
 
             fireOnRequestFinish(request, MegaError(API_OK));
             break;
@@ -22298,11 +22446,13 @@ void ExternalLogger::postLog(int logLevel, const char *message, const char *file
         filename = "";
     }
 
-#ifndef ENABLE_LOG_PERFORMANCE
+    // in asynchronous mode log() is called on the logging thread, which
+    // this thread may have to wait for if the queue is full
+#if !defined(ENABLE_LOG_PERFORMANCE) && !defined(ENABLE_LOG_ASYNC)
     mutex.lock();
 #endif
     SimpleLogger{static_cast<LogLevel>(logLevel), filename, line} << message;
-#ifndef ENABLE_LOG_PERFORMANCE
+#if !defined(ENABLE_LOG_PERFORMANCE) && !defined(ENABLE_LOG_ASYNC)
     mutex.unlock();
 #endif
 }
@@ -24987,6 +25137,22 @@ uv_buf_t StreamingBuffer::nextBuffer()
     return uv_buf_init(outbuf, len);
 }
 
+unsigned int StreamingBuffer::nextBuffers(uv_buf_t bufs[2])
+{
+    unsigned int outputSize = maxOutputSize;
+    bufs[0] = nextBuffer();
+    if (!bufs[0].len)
+    {
+        return 0;
+    }
+
+    // the first piece was cut short by the end of the buffer: continue from its start
+    maxOutputSize -= static_cast<unsigned int>(bufs[0].len);
+    bufs[1] = maxOutputSize ? nextBuffer() : uv_buf_init(NULL, 0);
+    maxOutputSize = outputSize;
+    return bufs[1].len ? 2 : 1;
+}
+
 void StreamingBuffer::freeData(unsigned int len)
 {
     // update the internal state
@@ -25038,6 +25204,7 @@ MegaTCPServer::MegaTCPServer(MegaApiImpl *megaApi, string basePath, bool tls, st
     this->lastHandle = INVALID_HANDLE;
     this->remainingcloseevents = 0;
     this->closing = false;
+    this->workerThreads = 0;
     this->thread = new MegaThread();
 #ifdef ENABLE_EVT_TLS
     this->certificatepath = certificatepath;
@@ -25068,6 +25235,7 @@ MegaTCPServer::MegaTCPServer(MegaApiImpl *megaApi, string basePath, bool tls, st
 MegaTCPServer::~MegaTCPServer()
 {
     stop();
+    joinWorkers();
     semaphoresdestroyed = true;
     uv_sem_destroy(&semaphoreStartup);
     uv_sem_destroy(&semaphoreEnd);
@@ -25226,6 +25394,7 @@ void MegaTCPServer::run()
     }
 
     LOG_info << "TCP" << (useTLS ? "(tls)" : "") << " server started on port " << port;
+    startWorkers();
     started = true;
     uv_sem_post(&semaphoreStartup);
 
@@ -25328,6 +25497,7 @@ void MegaTCPServer::initializeAndStartListening()
     }
 
     LOG_info << "TCP" << (useTLS ? "(tls)" : "") << " server started on port " << port;
+    startWorkers();
     started = true;
     uv_sem_post(&semaphoreStartup);
     LOG_debug << "UV loop already alive!";
@@ -25347,6 +25517,7 @@ void MegaTCPServer::stop(bool doNotWait)
     {
         LOG_verbose << "Waiting for sempahoreEnd to conclude server stop port = " << port;
         uv_sem_wait(&semaphoreEnd); //this is signaled when closed my last connection
+        joinWorkers();
     }
     LOG_debug << "Stopped MegaTCPServer port = " << port;
     started = false;
@@ -25480,35 +25651,210 @@ void MegaTCPServer::removeAllowedHandle(MegaHandle handle)
     allowedHandles.erase(handle);
 }
 
-void *MegaTCPServer::threadEntryPoint(void *param)
+void MegaTCPServer::setWorkerThreads(int count)
 {
-#ifndef _WIN32
-    struct sigaction noaction;
-    memset(&noaction, 0, sizeof(noaction));
-    noaction.sa_handler = SIG_IGN;
-    ::sigaction(SIGPIPE, &noaction, 0);
-#endif
-
-    MegaTCPServer *tcpServer = (MegaTCPServer *)param;
-    tcpServer->run();
-    return NULL;
+    workerThreads = count;
 }
 
-#ifdef ENABLE_EVT_TLS
-void MegaTCPServer::evt_on_rd(evt_tls_t *evt_tls, char *bfr, int sz)
+void MegaTCPServer::startWorkers()
 {
-    MegaTCPContext *tcpctx = (MegaTCPContext*)evt_tls->data;
-    assert(tcpctx != NULL);
-
-    uv_buf_t data;
-    data.base = bfr;
-    data.len = sz;
-
-    if (!tcpctx->invalid)
+#ifdef _WIN32
+    // sockets can't be handed to another loop by descriptor
+    if (workerThreads)
     {
-        tcpctx->server->processReceivedData(tcpctx, sz, &data);
+        LOG_warn << "TCP server worker threads are not supported on Windows";
     }
-    else
+#else
+    if (useTLS)
+    {
+        // the TLS context is shared by all connections
+        if (workerThreads)
+        {
+            LOG_warn << "TCP server worker threads are not used with TLS";
+        }
+        return;
+    }
+
+    // the ones of a previous run stopped without waiting
+    joinWorkers();
+    for (int i = 0; i < workerThreads; i++)
+    {
+        MegaTCPWorker *worker = new MegaTCPWorker();
+        worker->server = this;
+        worker->numConnections = 0;
+        uv_loop_init(&worker->uv_loop);
+        uv_mutex_init(&worker->mutex);
+        uv_async_init(&worker->uv_loop, &worker->accept_handle, onSocketsAccepted);
+        worker->accept_handle.data = worker;
+        uv_async_init(&worker->uv_loop, &worker->exit_handle, onWorkerCloseRequested);
+        worker->exit_handle.data = worker;
+        worker->thread.start(workerEntryPoint, worker);
+        workers.push_back(worker);
+    }
+    LOG_debug << "TCP server port = " << port << " started " << workers.size() << " worker threads";
+#endif
+}
+
+void MegaTCPServer::joinWorkers()
+{
+    // they end once onCloseRequested has told them to close their connections
+    for (MegaTCPWorker *worker : workers)
+    {
+        worker->thread.join();
+        uv_mutex_destroy(&worker->mutex);
+        delete worker;
+    }
+    workers.clear();
+}
+
+void *MegaTCPServer::workerEntryPoint(void *param)
+{
+    MegaTCPWorker *worker = (MegaTCPWorker *)param;
+    uv_run(&worker->uv_loop, UV_RUN_DEFAULT);
+    uv_loop_close(&worker->uv_loop);
+    LOG_debug << "TCP server worker loop ended, port = " << worker->server->port;
+    return NULL;
+}
+
+bool MegaTCPServer::handToWorker(MegaTCPServer *tcpServer, uv_stream_t *server_handle)
+{
+#ifdef _WIN32
+    return false;
+#else
+    // the least busy loop takes the connection, the server's own one included
+    MegaTCPWorker *target = NULL;
+    int load = int(tcpServer->connections.size());
+    for (MegaTCPWorker *worker : tcpServer->workers)
+    {
+        if (worker->numConnections < load)
+        {
+            target = worker;
+            load = worker->numConnections;
+        }
+    }
+
+    if (!target)
+    {
+        return false;
+    }
+
+    // accept here and pass the descriptor, as handles belong to the loop they were created on
+    uv_tcp_t *client = new uv_tcp_t();
+    uv_tcp_init(&tcpServer->uv_loop, client);
+    uv_os_fd_t fd;
+    uv_os_sock_t sock = -1;
+    if (uv_accept(server_handle, (uv_stream_t*)client) || uv_fileno((uv_handle_t*)client, &fd) || (sock = dup(fd)) < 0)
+    {
+        LOG_err << "Unable to hand a new connection to a worker";
+    }
+    uv_close((uv_handle_t*)client, [](uv_handle_t* handle) { delete (uv_tcp_t*)handle; });
+
+    if (sock >= 0)
+    {
+        target->numConnections++;
+        uv_mutex_lock(&target->mutex);
+        target->acceptedSockets.push_back(sock);
+        uv_mutex_unlock(&target->mutex);
+        uv_async_send(&target->accept_handle);
+    }
+    return true;
+#endif
+}
+
+void MegaTCPServer::onSocketsAccepted(uv_async_t *handle)
+{
+#ifndef _WIN32
+    MegaTCPWorker *worker = (MegaTCPWorker *)handle->data;
+    MegaTCPServer *tcpServer = worker->server;
+
+    std::deque<uv_os_sock_t> sockets;
+    uv_mutex_lock(&worker->mutex);
+    sockets.swap(worker->acceptedSockets);
+    uv_mutex_unlock(&worker->mutex);
+
+    for (uv_os_sock_t sock : sockets)
+    {
+        MegaTCPContext* tcpctx = tcpServer->initializeContext((uv_stream_t*)&tcpServer->server);
+        tcpctx->worker = worker;
+
+        // Mutex to protect the data buffer
+        uv_mutex_init(&tcpctx->mutex);
+
+        // Async handle to perform writes
+        uv_async_init(&worker->uv_loop, &tcpctx->asynchandle, onAsyncEvent);
+
+        uv_tcp_init(&worker->uv_loop, &tcpctx->tcphandle);
+        worker->connections.push_back(tcpctx);
+        if (uv_tcp_open(&tcpctx->tcphandle, sock))
+        {
+            LOG_err << "uv_tcp_open failed";
+            close(sock);
+            closeTCPConnection(tcpctx);
+            continue;
+        }
+
+        LOG_debug << "Connection adopted by worker at port " << tcpServer->port << "! " << worker->connections.size() << " tcpctx = " << tcpctx;
+        if (tcpServer->respondNewConnection(tcpctx))
+        {
+            tcpServer->readData(tcpctx);
+        }
+    }
+#endif
+}
+
+void MegaTCPServer::onWorkerCloseRequested(uv_async_t *handle)
+{
+#ifndef _WIN32
+    MegaTCPWorker *worker = (MegaTCPWorker *)handle->data;
+
+    for (MegaTCPContext *tcpctx : worker->connections)
+    {
+        closeTCPConnection(tcpctx);
+    }
+
+    uv_mutex_lock(&worker->mutex);
+    for (uv_os_sock_t sock : worker->acceptedSockets)
+    {
+        close(sock);
+    }
+    worker->acceptedSockets.clear();
+    uv_mutex_unlock(&worker->mutex);
+
+    // the loop ends when the connections are closed too
+    uv_close((uv_handle_t *)&worker->accept_handle, NULL);
+    uv_close((uv_handle_t *)&worker->exit_handle, NULL);
+#endif
+}
+
+void *MegaTCPServer::threadEntryPoint(void *param)
+{
+#ifndef _WIN32
+    struct sigaction noaction;
+    memset(&noaction, 0, sizeof(noaction));
+    noaction.sa_handler = SIG_IGN;
+    ::sigaction(SIGPIPE, &noaction, 0);
+#endif
+
+    MegaTCPServer *tcpServer = (MegaTCPServer *)param;
+    tcpServer->run();
+    return NULL;
+}
+
+#ifdef ENABLE_EVT_TLS
+void MegaTCPServer::evt_on_rd(evt_tls_t *evt_tls, char *bfr, int sz)
+{
+    MegaTCPContext *tcpctx = (MegaTCPContext*)evt_tls->data;
+    assert(tcpctx != NULL);
+
+    uv_buf_t data;
+    data.base = bfr;
+    data.len = sz;
+
+    if (!tcpctx->invalid)
+    {
+        tcpctx->server->processReceivedData(tcpctx, sz, &data);
+    }
+    else
     {
         LOG_debug << " Not procesing invalid data after failed evt_close";
     }
@@ -25618,8 +25964,14 @@ void MegaTCPServer::onNewClient(uv_stream_t* server_handle, int status)
         return;
     }
 
+    MegaTCPServer *tcpServer = (MegaTCPServer *)server_handle->data;
+    if (tcpServer->workers.size() && handToWorker(tcpServer, server_handle))
+    {
+        return;
+    }
+
     // Create an object to save context information
-    MegaTCPContext* tcpctx = ((MegaTCPServer *)server_handle->data)->initializeContext(server_handle);
+    MegaTCPContext* tcpctx = tcpServer->initializeContext(server_handle);
 
     LOG_debug << "Connection received at port " << tcpctx->server->port << "! " << tcpctx->server->connections.size() << " tcpctx = " << tcpctx;
 
@@ -25701,8 +26053,19 @@ void MegaTCPServer::onClose(uv_handle_t* handle)
     tcpctx->megaApi->removeTransferListener(tcpctx);
     tcpctx->megaApi->removeRequestListener(tcpctx);
 
-    tcpctx->server->connections.remove(tcpctx);
-    LOG_debug << "Connection closed: " << tcpctx->server->connections.size() << " port = " << tcpctx->server->port << " closing async handle";
+    list<MegaTCPContext*>& connections = tcpctx->worker ? tcpctx->worker->connections : tcpctx->server->connections;
+    if (tcpctx->worker)
+    {
+        tcpctx->worker->numConnections--;
+    }
+    connections.remove(tcpctx);
+    if (tcpctx->server->deferAsyncEventClose(tcpctx))
+    {
+        LOG_debug << "Connection closed: " << connections.size() << " port = " << tcpctx->server->port << " async handle closed when pending work ends";
+        return;
+    }
+
+    LOG_debug << "Connection closed: " << connections.size() << " port = " << tcpctx->server->port << " closing async handle";
     uv_close((uv_handle_t *)&tcpctx->asynchandle, onAsyncEventClose);
 }
 
@@ -25713,9 +26076,19 @@ void MegaTCPServer::onAsyncEventClose(uv_handle_t *handle)
 
     int port = tcpctx->server->port;
 
-    tcpctx->server->remainingcloseevents--;
     tcpctx->server->processOnAsyncEventClose(tcpctx);
 
+    // workers' loops just end when their last handle is closed
+    if (tcpctx->worker)
+    {
+        uv_mutex_destroy(&tcpctx->mutex);
+        delete tcpctx;
+        LOG_debug << "Connection deleted by worker, port = " << port;
+        return;
+    }
+
+    tcpctx->server->remainingcloseevents--;
+
     LOG_verbose << "At onAsyncEventClose port = " << tcpctx->server->port << " remaining=" << tcpctx->server->remainingcloseevents;
 
     if (!tcpctx->server->remainingcloseevents && tcpctx->server->closing && !tcpctx->server->semaphoresdestroyed)
@@ -25813,6 +26186,7 @@ MegaTCPContext::MegaTCPContext()
     invalid = false;
 #endif
     server = NULL;
+    worker = NULL;
     megaApi = NULL;
 }
 
@@ -25871,6 +26245,11 @@ void MegaTCPServer::onCloseRequested(uv_async_t *handle)
         closeTCPConnection(tcpctx);
     }
 
+    for (MegaTCPWorker *worker : tcpServer->workers)
+    {
+        uv_async_send(&worker->exit_handle);
+    }
+
     tcpServer->remainingcloseevents++;
     LOG_verbose << "At onCloseRequested: closing server port = " << tcpServer->port << " remainingcloseevent = " << tcpServer->remainingcloseevents;
     uv_close((uv_handle_t *)&tcpServer->server, onExitHandleClose);
@@ -25902,7 +26281,10 @@ void MegaTCPServer::closeTCPConnection(MegaTCPContext *tcpctx)
     tcpctx->finished = true;
     if (!uv_is_closing((uv_handle_t*)&tcpctx->tcphandle))
     {
-        tcpctx->server->remainingcloseevents++;
+        if (!tcpctx->worker)
+        {
+            tcpctx->server->remainingcloseevents++;
+        }
         LOG_verbose << "At closeTCPConnection port = " << tcpctx->server->port << " remainingcloseevent = " << tcpctx->server->remainingcloseevents;
         uv_close((uv_handle_t*)&tcpctx->tcphandle, onClose);
     }
@@ -25918,6 +26300,11 @@ void MegaTCPServer::processOnExitHandleClose(MegaTCPServer *tcpServer) // withou
     LOG_debug << "At supposed to be virtual processOnExitHandleClose";
 }
 
+bool MegaTCPServer::deferAsyncEventClose(MegaTCPContext *tcpctx)
+{
+    return false;
+}
+
 void MegaTCPServer::processReceivedData(MegaTCPContext *tcpctx, ssize_t nread, const uv_buf_t *buf)
 {
     LOG_debug << "At supposed to be virtual processReceivedData";
@@ -26084,6 +26471,168 @@ void MegaHTTPServer::processOnExitHandleClose(MegaTCPServer *tcpServer)
 {
 }
 
+bool MegaHTTPServer::deferAsyncEventClose(MegaTCPContext *tcpctx)
+{
+    MegaHTTPContext* httpctx = dynamic_cast<MegaHTTPContext *>(tcpctx);
+
+    // the upload of a streamed PUT body stops waking up the async handle before it is closed;
+    // if the body is incomplete, the upload fails
+    if (httpctx->uploadStream)
+    {
+        httpctx->uploadStream->abort();
+    }
+
+    // the context must outlive the write of its PUT body, see onBodyWritten
+    httpctx->asyncCloseDeferred = httpctx->bodyWriteInFlight;
+    return httpctx->asyncCloseDeferred;
+}
+
+void MegaHTTPServer::startBodyWrite(MegaHTTPContext *httpctx)
+{
+    assert(!httpctx->bodyWriteInFlight && httpctx->bodyWriting.empty());
+    httpctx->bodyWriting.swap(httpctx->bodyPending);
+    httpctx->bodyWriteInFlight = true;
+    httpctx->bodyWriteReq.data = httpctx;
+    uv_queue_work(httpctx->tcphandle.loop, &httpctx->bodyWriteReq, writeBody, onBodyWritten);
+}
+
+void MegaHTTPServer::writeBody(uv_work_t *req)
+{
+    // runs on the libuv thread pool; the event loop leaves these members alone meanwhile
+    MegaHTTPContext* httpctx = (MegaHTTPContext*) req->data;
+    httpctx->bodyWriteResult = httpctx->tmpFileAccess->fwrite((const byte*)httpctx->bodyWriting.data(),
+                                                              static_cast<unsigned>(httpctx->bodyWriting.size()),
+                                                              httpctx->bodyWriteOffset);
+}
+
+void MegaHTTPServer::onBodyWritten(uv_work_t *req, int status)
+{
+    MegaHTTPContext* httpctx = (MegaHTTPContext*) req->data;
+    httpctx->bodyWriteInFlight = false;
+    httpctx->bodyWriteOffset += httpctx->bodyWriting.size();
+    httpctx->bodyWriting.clear();
+
+    if (httpctx->asyncCloseDeferred)
+    {
+        LOG_debug << "PUT body write finished after the connection was closed";
+        uv_close((uv_handle_t *)&httpctx->asynchandle, onAsyncEventClose);
+        return;
+    }
+
+    if (httpctx->finished)
+    {
+        return;
+    }
+
+    if (status < 0 || !httpctx->bodyWriteResult)
+    {
+        LOG_err << "Error writing PUT body to " << httpctx->tmpFileName;
+        httpctx->bodyWriteFailed = true;
+        httpctx->bodyPending.clear();
+        httpctx->uploadParent.reset();
+        returnHttpCode(httpctx, 500);
+    }
+    else if (httpctx->bodyPending.size())
+    {
+        startBodyWrite(httpctx);
+    }
+
+    if (httpctx->bodyReadStopped && httpctx->bodyPending.size() + httpctx->bodyWriting.size() < MAX_PUT_BUFFER_SIZE
+            && !uv_is_closing((uv_handle_t*)&httpctx->tcphandle))
+    {
+        LOG_verbose << "Resuming the reception of PUT body";
+        httpctx->bodyReadStopped = false;
+        httpctx->server->readData(httpctx);
+    }
+
+    if (!httpctx->bodyWriteInFlight && httpctx->uploadParent)
+    {
+        httpctx->megaApi->startUpload(httpctx->tmpFileName.c_str(), httpctx->uploadParent.get(), httpctx->uploadName.c_str(), httpctx);
+        httpctx->uploadParent.reset();
+    }
+}
+
+void MegaHTTPServer::startStreamedPut(MegaHTTPContext *httpctx, m_off_t size)
+{
+    // anything unusual is left to onMessageComplete, which answers once the body is stored
+    if (!httpctx->nodehandle.size() || httpctx->path == "/")
+    {
+        return;
+    }
+
+    handle h = MegaApi::base64ToHandle(httpctx->nodehandle.c_str());
+    if (!httpctx->server->isHandleAllowed(h))
+    {
+        return;
+    }
+
+    std::unique_ptr<MegaNode> node(httpctx->megaApi->getNodeByHandle(h));
+    if (!node || httpctx->nodename != node->getName())
+    {
+        return;
+    }
+
+    std::unique_ptr<MegaNode> baseNode;
+    if (httpctx->subpathrelative.size())
+    {
+        string subnodepath = httpctx->subpathrelative;
+        size_t seppos = subnodepath.find_last_of("/");
+        while ( (seppos != string::npos) && ((seppos + 1) == subnodepath.size()) )
+        {
+            subnodepath = subnodepath.substr(0,seppos);
+            seppos = subnodepath.find_last_of("/");
+        }
+
+        baseNode = std::move(node);
+        node.reset(httpctx->megaApi->getNodeByPath(subnodepath.c_str(), baseNode.get()));
+    }
+
+    if (node && !httpctx->overwrite)
+    {
+        return;
+    }
+
+    string newname;
+    std::unique_ptr<MegaNode> newParentNode(getPutParent(httpctx, node.get(), baseNode.get(), &newname));
+    if (!newParentNode || newname.empty())
+    {
+        return;
+    }
+
+    LOG_debug << "Uploading PUT body of " << size << " bytes while it is received";
+    httpctx->uploadStream = std::make_shared<UploadStream>(size, m_time());
+
+    // the upload releasing data may let the body be read again, see processAsyncEvent
+    uv_async_t* asynchandle = &httpctx->asynchandle;
+    httpctx->uploadStream->setreleasecallback([asynchandle]() { uv_async_send(asynchandle); });
+
+    string localPath = httpctx->server->basePath + newname;
+    httpctx->megaApi->startUpload(httpctx->uploadStream, localPath.c_str(), newParentNode.get(), newname.c_str(), httpctx);
+}
+
+MegaNode *MegaHTTPServer::getPutParent(MegaHTTPContext *httpctx, MegaNode *node, MegaNode *baseNode, string *newname)
+{
+    string dest = httpctx->subpathrelative;
+    size_t seppos = dest.find_last_of("/");
+    while ( (seppos != string::npos) && ((seppos + 1) == dest.size()) )
+    {
+        dest = dest.substr(0,seppos);
+        seppos = dest.find_last_of("/");
+    }
+    if (seppos == string::npos)
+    {
+        *newname = dest;
+        return baseNode ? baseNode->copy() : node->copy();
+    }
+
+    if ((seppos + 1) < dest.size())
+    {
+        *newname = dest.substr(seppos + 1);
+    }
+    string newparentpath = dest.substr(0, seppos);
+    return httpctx->megaApi->getNodeByPath(newparentpath.c_str(), baseNode ? baseNode : node);
+}
+
 MegaHTTPServer::~MegaHTTPServer()
 {
     // if not stopped, the uv thread might want to access a pointer to this.
@@ -26163,8 +26712,15 @@ int MegaHTTPServer::onMessageBegin(http_parser *)
     return 0;
 }
 
-int MegaHTTPServer::onHeadersComplete(http_parser *)
+int MegaHTTPServer::onHeadersComplete(http_parser *parser)
 {
+    MegaHTTPContext* httpctx = (MegaHTTPContext*) parser->data;
+
+    if (parser->method == HTTP_PUT && !(parser->flags & F_CHUNKED)
+            && parser->content_length && parser->content_length != ULLONG_MAX)
+    {
+        startStreamedPut(httpctx, m_off_t(parser->content_length));
+    }
     return 0;
 }
 
@@ -26344,6 +26900,21 @@ int MegaHTTPServer::onBody(http_parser *parser, const char *b, size_t n)
 
     if (parser->method == HTTP_PUT)
     {
+        if (httpctx->uploadStream)
+        {
+            // straight to the upload; the client has to wait while too much is buffered
+            httpctx->uploadStream->append((const byte*)b, n);
+            httpctx->messageBodySize += n;
+
+            if (!httpctx->bodyReadStopped && httpctx->uploadStream->buffered() >= MAX_PUT_STREAM_BUFFER_SIZE)
+            {
+                LOG_verbose << "Pausing the reception of PUT body until it is uploaded";
+                uv_read_stop((uv_stream_t*)&httpctx->tcphandle);
+                httpctx->bodyReadStopped = true;
+            }
+            return 0;
+        }
+
         //create tmp file with contents in messageBody
         if (!httpctx->tmpFileAccess)
         {
@@ -26371,12 +26942,26 @@ int MegaHTTPServer::onBody(http_parser *parser, const char *b, size_t n)
             }
         }
 
-        if (!httpctx->tmpFileAccess->fwrite((const byte*)b, static_cast<unsigned>(n), httpctx->messageBodySize))
+        if (httpctx->bodyWriteFailed)
         {
-            returnHttpCode(httpctx, 500);
             return 0;
         }
+
+        // written by the thread pool, so disk latency doesn't stall the other connections;
+        // the client has to wait while too much is buffered
+        httpctx->bodyPending.append(b, n);
         httpctx->messageBodySize += n;
+        if (!httpctx->bodyWriteInFlight)
+        {
+            startBodyWrite(httpctx);
+        }
+
+        if (!httpctx->bodyReadStopped && httpctx->bodyPending.size() + httpctx->bodyWriting.size() >= MAX_PUT_BUFFER_SIZE)
+        {
+            LOG_verbose << "Pausing the reception of PUT body until it is written";
+            uv_read_stop((uv_stream_t*)&httpctx->tcphandle);
+            httpctx->bodyReadStopped = true;
+        }
     }
     else
     {
@@ -26829,6 +27414,13 @@ int MegaHTTPServer::onMessageComplete(http_parser *parser)
     httpctx->streamingBuffer.setMaxBufferSize(httpctx->server->getMaxBufferSize());
     httpctx->streamingBuffer.setMaxOutputSize(httpctx->server->getMaxOutputSize());
 
+    if (httpctx->uploadStream)
+    {
+        // the upload started with the headers and answers when it finishes
+        LOG_debug << "Request method: HTTP_PUT, body received";
+        return 0;
+    }
+
     MegaHTTPServer* httpserver = dynamic_cast<MegaHTTPServer *>(httpctx->server);
 
     switch (parser->method)
@@ -27374,31 +27966,8 @@ int MegaHTTPServer::onMessageComplete(http_parser *parser)
         }
         else
         {
-            MegaNode *newParentNode = NULL;
             string newname;
-
-            string dest = httpctx->subpathrelative;
-            size_t seppos = dest.find_last_of("/");
-            while ( (seppos != string::npos) && ((seppos + 1) == dest.size()) )
-            {
-                dest = dest.substr(0,seppos);
-                seppos = dest.find_last_of("/");
-            }
-            if (seppos == string::npos)
-            {
-                newParentNode = baseNode ? baseNode->copy() : node->copy();
-                newname = dest;
-            }
-            else
-            {
-                if ((seppos + 1) < dest.size())
-                {
-                    newname = dest.substr(seppos + 1);
-                }
-                string newparentpath = dest.substr(0, seppos);
-                newParentNode = httpctx->megaApi->getNodeByPath(newparentpath.c_str(), baseNode ? baseNode : node);
-            }
-
+            MegaNode *newParentNode = getPutParent(httpctx, node, baseNode, &newname);
             if (!newParentNode)
             {
                 returnHttpCode(httpctx, 409);
@@ -27434,6 +28003,24 @@ int MegaHTTPServer::onMessageComplete(http_parser *parser)
                 }
             }
 
+            if (httpctx->bodyWriteFailed) // already answered
+            {
+                delete node;
+                delete baseNode;
+                delete newParentNode;
+                return 0;
+            }
+
+            if (httpctx->bodyWriteInFlight)
+            {
+                // uploaded once the rest of the body is written
+                httpctx->uploadParent.reset(newParentNode);
+                httpctx->uploadName = newname;
+                delete node;
+                delete baseNode;
+                return 0;
+            }
+
             httpctx->megaApi->startUpload(httpctx->tmpFileName.c_str(), newParentNode, newname.c_str(), httpctx);
 
             delete node;
@@ -27795,6 +28382,15 @@ void MegaHTTPServer::processAsyncEvent(MegaTCPContext* tcpctx)
         return;
     }
 
+    if (httpctx->bodyReadStopped && httpctx->uploadStream
+            && httpctx->uploadStream->buffered() < MAX_PUT_STREAM_BUFFER_SIZE
+            && !uv_is_closing((uv_handle_t*)&httpctx->tcphandle))
+    {
+        LOG_verbose << "Resuming the reception of PUT body";
+        httpctx->bodyReadStopped = false;
+        httpctx->server->readData(httpctx);
+    }
+
     uv_mutex_lock(&httpctx->mutex_responses);
     while (httpctx->responses.size())
     {
@@ -27858,25 +28454,38 @@ void MegaHTTPServer::sendNextBytes(MegaHTTPContext *httpctx)
         return;
     }
 
-    uv_buf_t resbuf = httpctx->streamingBuffer.nextBuffer();
+    // without TLS, data wrapping around the end of the buffer goes out in the same write
+    uv_buf_t bufs[2];
+    unsigned int nbufs = 1;
+#ifdef ENABLE_EVT_TLS
+    if (httpctx->server->useTLS)
+    {
+        bufs[0] = httpctx->streamingBuffer.nextBuffer();
+    }
+    else
+#endif
+    {
+        nbufs = httpctx->streamingBuffer.nextBuffers(bufs);
+    }
     uv_mutex_unlock(&httpctx->mutex);
 
-    if (!resbuf.len)
+    size_t len = nbufs > 1 ? bufs[0].len + bufs[1].len : bufs[0].len;
+    if (!len)
     {
         LOG_verbose << "Skipping write. No data available";
         return;
     }
 
-    LOG_verbose << "Writing " << resbuf.len << " bytes";
-    httpctx->rangeWritten += resbuf.len;
-    httpctx->lastBuffer = resbuf.base;
-    httpctx->lastBufferLen = resbuf.len;
+    LOG_verbose << "Writing " << len << " bytes";
+    httpctx->rangeWritten += len;
+    httpctx->lastBuffer = bufs[0].base;
+    httpctx->lastBufferLen = len;
 
 #ifdef ENABLE_EVT_TLS
     if (httpctx->server->useTLS)
     {
         //notice this, contrary to !useTLS is synchronous
-        int err = evt_tls_write(httpctx->evt_tls, resbuf.base, resbuf.len, onWriteFinished_tls);
+        int err = evt_tls_write(httpctx->evt_tls, bufs[0].base, bufs[0].len, onWriteFinished_tls);
         if (err <= 0)
         {
             LOG_warn << "Finishing due to an error sending the response: " << err;
@@ -27886,10 +28495,35 @@ void MegaHTTPServer::sendNextBytes(MegaHTTPContext *httpctx)
     else
     {
 #endif
+        // most writes fit in the socket buffer: skip the write request when they do
+        int written = uv_try_write((uv_stream_t*)&httpctx->tcphandle, bufs, nbufs);
+        if (written == int(len))
+        {
+            ((MegaHTTPServer *)httpctx->server)->processWriteFinished(httpctx, 0);
+            return;
+        }
+
+        uv_buf_t *pending = bufs;
+        if (written > 0)
+        {
+            if (size_t(written) >= bufs[0].len)
+            {
+                bufs[1].base += written - bufs[0].len;
+                bufs[1].len -= written - bufs[0].len;
+                pending = &bufs[1];
+                nbufs = 1;
+            }
+            else
+            {
+                bufs[0].base += written;
+                bufs[0].len -= written;
+            }
+        }
+
         uv_write_t *req = new uv_write_t();
         req->data = httpctx;
 
-        if (int err = uv_write(req, (uv_stream_t*)&httpctx->tcphandle, &resbuf, 1, onWriteFinished))
+        if (int err = uv_write(req, (uv_stream_t*)&httpctx->tcphandle, pending, nbufs, onWriteFinished))
         {
             delete req;
             LOG_warn << "Finishing due to an error in uv_write: " << err;
@@ -27919,6 +28553,12 @@ MegaHTTPContext::MegaHTTPContext()
     messageBody = NULL;
     messageBodySize = 0;
     tmpFileAccess = NULL;
+    bodyWriteOffset = 0;
+    bodyWriteInFlight = false;
+    bodyWriteResult = false;
+    bodyWriteFailed = false;
+    bodyReadStopped = false;
+    asyncCloseDeferred = false;
     newParentNode = UNDEF;
     nodeToMove = UNDEF;
     depth = -1;
@@ -31463,41 +32103,6 @@ long long MegaFolderInfoPrivate::getVersionsSize() const
     return versionsSize;
 }
 
-TreeProcFolderInfo::TreeProcFolderInfo()
-{
-    numFiles = 0;
-    numFolders = 0;
-    numVersions = 0;
-    currentSize = 0;
-    versionsSize = 0;
-}
-
-void TreeProcFolderInfo::proc(MegaClient *, Node *node)
-{
-    if (node->parent && node->parent->type == FILENODE)
-    {
-        numVersions++;
-        versionsSize += node->size;
-    }
-    else
-    {
-        if (node->type == FILENODE)
-        {
-            numFiles++;
-            currentSize += node->size;
-        }
-        else
-        {
-            numFolders++;
-        }
-    }
-}
-
-MegaFolderInfo *TreeProcFolderInfo::getResult()
-{
-    return new MegaFolderInfoPrivate(numFiles, numFolders - 1, numVersions, currentSize, versionsSize);
-}
-
 MegaTimeZoneDetailsPrivate::MegaTimeZoneDetailsPrivate(vector<std::string> *timeZones, vector<int> *timeZoneOffsets, int defaultTimeZone)
 {
     this->timeZones = *timeZones;
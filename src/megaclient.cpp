@@ -23,6 +23,8 @@
 #include "mega/mediafileattribute.h"
 #include <cctype>
 #include <algorithm>
+#include <condition_variable>
+#include <thread>
 
 #undef min // avoid issues with std::min and std::max
 #undef max
@@ -972,22 +974,12 @@ Node* MegaClient::childnodebyname(Node* p, const char* name, bool skipfolders)
 
     fsaccess->normalize(&nname);
 
-    for (node_list::iterator it = p->children.begin(); it != p->children.end(); it++)
+    // the first folder, or else the last file - unless skipfolders, which takes the first match
+    p->childrenbyname(nname, [&](Node* child)
     {
-        if (!strcmp(nname.c_str(), (*it)->displayname()))
-        {
-            if ((*it)->type != FILENODE && !skipfolders)
-            {
-                return *it;
-            }
-
-            found = *it;
-            if (skipfolders)
-            {
-                return found;
-            }
-        }
-    }
+        found = child;
+        return !skipfolders && child->type == FILENODE;
+    });
 
     return found;
 }
@@ -1005,16 +997,14 @@ vector<Node*> MegaClient::childnodesbyname(Node* p, const char* name, bool skipf
 
     fsaccess->normalize(&nname);
 
-    for (node_list::iterator it = p->children.begin(); it != p->children.end(); it++)
+    p->childrenbyname(nname, [&](Node* child)
     {
-        if (nname == (*it)->displayname())
+        if (child->type == FILENODE || !skipfolders)
         {
-            if ((*it)->type == FILENODE || !skipfolders)
-            {
-                found.push_back(*it);
-            }
+            found.push_back(child);
         }
-    }
+        return true;
+    });
 
     return found;
 }
@@ -1271,6 +1261,7 @@ std::string MegaClient::getPublicLink(bool newLinkFormat, nodetype_t type, handl
 void MegaClient::exec()
 {
     CodeCounter::ScopeTimer ccst(performanceStats.execFunction);
+    MetricTimer metricTimer(Metrics::get().execTime);
 
     WAIT_CLASS::bumpds();
 
@@ -1564,23 +1555,13 @@ void MegaClient::exec()
                 switch (fc->req.status)
                 {
                     case REQ_SUCCESS:
-                        if (fc->req.contenttype.find("text/html") != string::npos
-                            && !memcmp(fc->req.posturl.c_str(), "http:", 5))
+                        if (!fc->switchtohttps(fc->req))
                         {
-                            LOG_warn << "Invalid Content-Type detected downloading file attr: " << fc->req.contenttype;
-                            fc->urltime = 0;
-                            usehttps = true;
-                            app->notify_change_to_https();
-
-                            sendevent(99436, "Automatic change to HTTPS", 0);
-                        }
-                        else
-                        {
-                            fc->parse(cit->first, true);
+                            fc->parse(fc->req, true);
                         }
 
                         // notify app in case some attributes were not returned, then redispatch
-                        fc->failed();
+                        fc->failed(fc->req, fc->e);
                         fc->req.disconnect();
                         fc->req.status = REQ_PREPARED;
                         fc->timeout.reset();
@@ -1596,7 +1577,7 @@ void MegaClient::exec()
                         if (fc->inbytes != fc->req.in.size())
                         {
                             httpio->lock();
-                            fc->parse(cit->first, false);
+                            fc->parse(fc->req, false);
                             httpio->unlock();
 
                             fc->timeout.backoff(100);
@@ -1610,18 +1591,8 @@ void MegaClient::exec()
                         // timeout! fall through...
                     case REQ_FAILURE:
                         LOG_warn << "Error getting file attr";
-
-                        if (fc->req.httpstatus && fc->req.contenttype.find("text/html") != string::npos
-                                && !memcmp(fc->req.posturl.c_str(), "http:", 5))
-                        {
-                            LOG_warn << "Invalid Content-Type detected on failed file attr: " << fc->req.contenttype;
-                            usehttps = true;
-                            app->notify_change_to_https();
-
-                            sendevent(99436, "Automatic change to HTTPS", 0);
-                        }
-
-                        fc->failed();
+                        fc->switchtohttps(fc->req);
+                        fc->failed(fc->req, fc->e);
                         fc->timeout.reset();
                         fc->bt.backoff();
                         fc->urltime = 0;
@@ -1650,6 +1621,14 @@ void MegaClient::exec()
                         fc->dispatch();
                     }
                 }
+
+                // attributes queued while the channel is busy POSTing go out in further requests
+                fc->pipelineio();
+                if (fc->req.status == REQ_INFLIGHT && fc->req.httpio && fc->urltime
+                        && (Waiter::ds - fc->urltime) <= 600)
+                {
+                    fc->pipeline();
+                }
             }
         }
 
@@ -1665,6 +1644,8 @@ void MegaClient::exec()
                 if (pendingcs->status == REQ_SUCCESS || pendingcs->status == REQ_FAILURE)
                 {
                     performanceStats.csRequestWaitTime.stop();
+                    Metrics::get().csLatency.observe(std::chrono::steady_clock::now() - csRequestSent);
+                    Metrics::get().csRequests.add();
                 }
 
                 switch (pendingcs->status)
@@ -1883,6 +1864,7 @@ void MegaClient::exec()
                     pendingcs->type = REQ_JSON;
 
                     performanceStats.csRequestWaitTime.start();
+                    csRequestSent = std::chrono::steady_clock::now();
                     pendingcs->post(this);
                     continue;
                 }
@@ -2784,6 +2766,12 @@ void MegaClient::exec()
         app->storagesum_changed(mNotifiedSumSize);
     }
 
+    csQueuedMetric.set(int64_t(reqs.queuedCommands()));
+    downloadsQueuedMetric.set(int64_t(transfers[GET].size()));
+    uploadsQueuedMetric.set(int64_t(transfers[PUT].size()));
+    transferSlotsMetric.set(int64_t(tslots.size()));
+    downloadBufferActivity.set(!tslots.empty());
+
 #ifdef MEGA_MEASURE_CODE
     performanceStats.transfersActiveTime.start(!tslots.empty() && !performanceStats.transfersActiveTime.inprogress());
     performanceStats.transfersActiveTime.stop(tslots.empty() && performanceStats.transfersActiveTime.inprogress());
@@ -2903,6 +2891,11 @@ int MegaClient::preparewait()
             {
                 cit->second->bt.update(&nds);
             }
+
+            for (auto& p : cit->second->pipelined)
+            {
+                p->timeout.update(&nds);
+            }
         }
 
         // next pending pread event
@@ -3043,10 +3036,13 @@ int MegaClient::preparewait()
         }
     }
 
+    Metrics& metrics = Metrics::get();
+
     // immediate action required?
     if (!nds)
     {
         ++performanceStats.prepwaitImmediate;
+        metrics.prepwaitImmediate.add();
         return Waiter::NEEDEXEC;
     }
 
@@ -3056,41 +3052,39 @@ int MegaClient::preparewait()
         nds -= Waiter::ds;
     }
 
-#ifdef MEGA_MEASURE_CODE
     bool reasonGiven = false;
     if (nds == 0)
     {
         ++performanceStats.prepwaitZero;
+        metrics.prepwaitZero.add();
         reasonGiven = true;
     }
-#endif
 
     waiter->init(nds);
 
     // set subsystem wakeup criteria (WinWaiter assumes httpio to be set first!)
     waiter->wakeupby(httpio, Waiter::NEEDEXEC);
 
-#ifdef MEGA_MEASURE_CODE
     if (waiter->maxds == 0 && !reasonGiven)
     {
         ++performanceStats.prepwaitHttpio;
+        metrics.prepwaitHttpio.add();
         reasonGiven = true;
     }
-#endif
 
     waiter->wakeupby(fsaccess, Waiter::NEEDEXEC);
 
-#ifdef MEGA_MEASURE_CODE
     if (waiter->maxds == 0 && !reasonGiven)
     {
         ++performanceStats.prepwaitFsaccess;
+        metrics.prepwaitFsaccess.add();
         reasonGiven = true;
     }
     if (!reasonGiven)
     {
         ++performanceStats.nonzeroWait;
+        metrics.prepwaitSleep.add();
     }
-#endif
 
     return 0;
 }
@@ -3143,6 +3137,8 @@ bool MegaClient::abortbackoff(bool includexfers)
                     }
                 }
             }
+
+            transferlist.abortbackoff(direction_t(d));
         }
 
         for (handledrn_map::iterator it = hdrns.begin(); it != hdrns.end();)
@@ -3409,7 +3405,7 @@ bool MegaClient::dispatch(direction_t d)
                     {
                         nexttransfer->uploadhandle = getuploadhandle();
 
-                        if (!gfxdisabled && gfx && gfx->isgfx(&nexttransfer->localfilename))
+                        if (!gfxdisabled && gfx && !nexttransfer->uploadstream && gfx->isgfx(&nexttransfer->localfilename))
                         {
                             // we want all imagery to be safely tucked away before completing the upload, so we bump minfa
                             nexttransfer->minfa += gfx->gendimensionsputfa(ts->fa, &nexttransfer->localfilename, nexttransfer->uploadhandle, nexttransfer->transfercipher(), -1, false);
@@ -3625,6 +3621,11 @@ void MegaClient::disconnect()
     for (fafc_map::iterator it = fafcs.begin(); it != fafcs.end(); it++)
     {
         it->second->req.disconnect();
+
+        for (auto& p : it->second->pipelined)
+        {
+            p->req.disconnect();
+        }
     }
 
     for (transferslot_list::iterator it = tslots.begin(); it != tslots.end(); it++)
@@ -4622,6 +4623,29 @@ error MegaClient::getfa(handle h, string *fileattrstring, const string &nodekey,
 
     int c = atoi(fileattrstring->c_str() + pp);
 
+    if (!cancel && facache && facache->contains(fah))
+    {
+        // prefetches (untagged) only need the attribute to be in the cache
+        if (!reqtag)
+        {
+            return API_OK;
+        }
+
+        // get() drops entries it can't read; a bad key is the caller's problem, not the entry's
+        string data;
+        if (!facache->get(fah, &data) || (data.size() & (SymmCipher::BLOCKSIZE - 1)))
+        {
+            facache->remove(fah);
+        }
+        else if (tmpnodecipher.setkey(&nodekey))
+        {
+            tmpnodecipher.cbc_decrypt((byte*)data.data(), data.size());
+            restag = reqtag;
+            app->fa_complete(h, t, data.data(), uint32_t(data.size()));
+            return API_OK;
+        }
+    }
+
     if (cancel)
     {
         // cancel pending request
@@ -4672,23 +4696,46 @@ error MegaClient::getfa(handle h, string *fileattrstring, const string &nodekey,
             {
                 *fafp = new FileAttributeFetch(h, nodekey, t, reqtag);
             }
-            else
+            else if ((*fafp)->tag || !reqtag)
             {
                 restag = (*fafp)->tag;
                 return API_EEXIST;
             }
+            else
+            {
+                // a prefetch of the same attribute: the request takes it over
+                (*fafp)->tag = reqtag;
+            }
         }
         else
         {
             FileAttributeFetch** fafp = &(*fafcp)->fafs[1][fah];
-            restag = (*fafp)->tag;
-            return API_EEXIST;
+            if ((*fafp)->tag || !reqtag)
+            {
+                restag = (*fafp)->tag;
+                return API_EEXIST;
+            }
+
+            (*fafp)->tag = reqtag;
         }
 
         return API_OK;
     }
 }
 
+void MegaClient::prefetchfa(Node* n, fatype t)
+{
+    if (!facache || n->type != FILENODE || !n->keyApplied() || !n->hasfileattribute(t))
+    {
+        return;
+    }
+
+    int creqtag = reqtag;
+    reqtag = 0;
+    getfa(n->nodehandle, &n->fileattrstring, n->nodekey(), t);
+    reqtag = creqtag;
+}
+
 // build pending attribute string for this handle and remove
 void MegaClient::pendingattrstring(handle h, string* fa)
 {
@@ -4904,7 +4951,9 @@ void MegaClient::sc_updatenode()
 
                         if (ts != -1 && n->ctime != ts)
                         {
+                            mNodesByCtime.remove(n);
                             n->ctime = ts;
+                            mNodesByCtime.add(n);
                             n->changed.ctime = true;
                             notify = true;
                         }
@@ -6699,6 +6748,9 @@ void MegaClient::makeattr(SymmCipher* key, string* attrstring, const char* json,
 // (with speculative instant completion)
 error MegaClient::setattr(Node* n, const char *prevattr)
 {
+    // callers have already updated n->attrs, possibly renaming it
+    n->namechanged();
+
     if (!checkaccess(n, FULL))
     {
         return API_EACCESS;
@@ -7907,13 +7959,202 @@ void MegaClient::applykeys()
 
     if (nodes.size() > size_t(mAppliedKeyNodeCount + noKeyExpected))
     {
-        for (auto& it : nodes)
+        applykeysbatch();
+    }
+
+    sendkeyrewrites();
+}
+
+void MegaClient::applykeysbatch()
+{
+    // symmetric node keys are collected per wrapping key and unwrapped with a single ECB call
+    // each, which lets the cipher pipeline many blocks at once
+    struct WrappedKeys
+    {
+        vector<Node*> nodes;
+        string keys;
+    };
+    std::map<SymmCipher*, WrappedKeys> symmetric;
+
+    // RSA-wrapped keys (legacy, rewritten on the server once decrypted)
+    struct RsaKey
+    {
+        Node* node;
+        string wrapped;
+        byte key[FILENODEKEYLENGTH];
+        bool ok;
+    };
+    vector<RsaKey> rsa;
+
+    for (auto& it : nodes)
+    {
+        Node* n = it.second;
+
+        if (n->type > FOLDERNODE || n->keyApplied() || n->nodekeyUnchecked().empty())
         {
-            it.second->applykey();
+            n->applykey();
+            continue;
         }
+
+        SymmCipher* sc;
+        const char* k = n->findkey(&sc);
+        if (!k)
+        {
+            continue;
+        }
+
+        int keylength = (n->type == FILENODE) ? FILENODEKEYLENGTH : FOLDERNODEKEYLENGTH;
+        const char* ptr = k;
+        while (*ptr && *ptr != '"' && *ptr != '/')
+        {
+            ptr++;
+        }
+        int sl = int(ptr - k);
+
+        if (sl > 4 * FILENODEKEYLENGTH / 3 + 1)
+        {
+            sl = sl / 4 * 3 + 3;
+            if (sl > 4096)
+            {
+                continue;
+            }
+
+            RsaKey r;
+            r.node = n;
+            r.wrapped.resize(sl);
+            r.wrapped.resize(Base64::atob(k, (byte*)r.wrapped.data(), sl));
+            rsa.push_back(std::move(r));
+            continue;
+        }
+
+        WrappedKeys& wk = symmetric[sc];
+        size_t offset = wk.keys.size();
+        wk.keys.resize(offset + keylength);
+        if (Base64::atob(k, (byte*)wk.keys.data() + offset, keylength) != keylength)
+        {
+            LOG_warn << "Corrupt or invalid symmetric node key";
+            wk.keys.resize(offset);
+            continue;
+        }
+        wk.nodes.push_back(n);
     }
 
-    sendkeyrewrites();
+    // attributes are decrypted together once all keys are in place
+    node_vector keyed;
+
+    for (auto& it : symmetric)
+    {
+        WrappedKeys& wk = it.second;
+        if (wk.nodes.empty())
+        {
+            continue;
+        }
+
+        it.first->ecb_decrypt((byte*)wk.keys.data(), wk.keys.size());
+
+        const byte* key = (const byte*)wk.keys.data();
+        for (Node* n : wk.nodes)
+        {
+            n->installkey(key);
+            keyed.push_back(n);
+            key += (n->type == FILENODE) ? FILENODEKEYLENGTH : FOLDERNODEKEYLENGTH;
+        }
+    }
+
+    if (!rsa.empty())
+    {
+        // RSA decryption only reads the private key, so the work can be split across threads
+        auto decryptRange = [this, &rsa](size_t first, size_t step)
+        {
+            for (size_t i = first; i < rsa.size(); i += step)
+            {
+                RsaKey& r = rsa[i];
+                unsigned keylength = (r.node->type == FILENODE) ? FILENODEKEYLENGTH : FOLDERNODEKEYLENGTH;
+                r.ok = asymkey.decrypt((const byte*)r.wrapped.data(), r.wrapped.size(), r.key, keylength) != 0;
+            }
+        };
+
+        size_t numThreads = rsa.size() < RSAKEYSPERTHREAD ? 1 : std::min<size_t>(rsa.size() / RSAKEYSPERTHREAD, workerthreads());
+        vector<std::thread> workers;
+        for (size_t i = 1; i < numThreads; i++)
+        {
+            workers.emplace_back(decryptRange, i, numThreads);
+        }
+        decryptRange(0, numThreads);
+        for (auto& w : workers)
+        {
+            w.join();
+        }
+
+        for (RsaKey& r : rsa)
+        {
+            if (!r.ok)
+            {
+                LOG_warn << "Corrupt or invalid RSA node key";
+                continue;
+            }
+
+            r.node->installkey(r.key);
+            keyed.push_back(r.node);
+            nodekeyrewrite.push_back(r.node->nodehandle);
+        }
+    }
+
+    decryptattrs(keyed);
+}
+
+void MegaClient::decryptattrs(const node_vector& v)
+{
+    size_t numThreads = v.size() < ATTRSPERTHREAD ? 1 : std::min<size_t>(v.size() / ATTRSPERTHREAD, workerthreads());
+    if (numThreads < 2)
+    {
+        for (Node* n : v)
+        {
+            n->setattr();
+        }
+        return;
+    }
+
+    // decryption and parsing only read the node, so each thread takes a contiguous range with
+    // a cipher of its own; storing the results updates shared indexes and stays on this thread
+    vector<attr_map> decrypted(v.size());
+    vector<char> ok(v.size());
+
+    auto decryptRange = [&v, &decrypted, &ok](size_t first, size_t last)
+    {
+        SymmCipher cipher;
+        for (size_t i = first; i < last; i++)
+        {
+            Node* n = v[i];
+            ok[i] = n->attrstring && cipher.setkey(&n->nodekeyUnchecked()) && n->decryptattrs(cipher, decrypted[i]);
+        }
+    };
+
+    vector<std::thread> workers;
+    size_t rangeSize = (v.size() + numThreads - 1) / numThreads;
+    for (size_t first = rangeSize; first < v.size(); first += rangeSize)
+    {
+        workers.emplace_back(decryptRange, first, std::min(first + rangeSize, v.size()));
+    }
+    decryptRange(0, rangeSize);
+    for (auto& w : workers)
+    {
+        w.join();
+    }
+
+    for (size_t i = 0; i < v.size(); i++)
+    {
+        if (ok[i])
+        {
+            v[i]->applyattrs(decrypted[i]);
+        }
+        v[i]->namechanged();
+    }
+}
+
+unsigned MegaClient::workerthreads()
+{
+    return std::max(1u, std::min(std::thread::hardware_concurrency(), 8u));
 }
 
 void MegaClient::sendkeyrewrites()
@@ -8730,6 +8971,141 @@ void MegaClient::proctree(Node* n, TreeProc* tp, bool skipinshares, bool skipver
     tp->proc(this, n);
 }
 
+void MegaClient::proctreeparallel(Node* n, const vector<TreeProc*>& tps, bool skipinshares, bool skipversions, std::function<bool()> cancelled)
+{
+    // Subtrees waiting for a worker.  Each worker walks its subtree depth first on a private
+    // stack, and whenever another worker is waiting it hands back the half of that stack
+    // nearest the root - the largest pending subtrees - so work spreads without per-node locking.
+    std::mutex mutex;
+    std::condition_variable cv;
+    vector<Node*> subtrees(1, n);
+    size_t waiting = 0;
+    std::atomic<size_t> hungry{0};
+
+    auto work = [&](TreeProc* tp)
+    {
+        vector<Node*> stack;
+
+        for (;;)
+        {
+            {
+                std::unique_lock<std::mutex> lock(mutex);
+                hungry = ++waiting;
+
+                // everyone waiting and nothing left: the walk is complete
+                cv.notify_all();
+                cv.wait(lock, [&]() { return !subtrees.empty() || waiting == tps.size(); });
+                if (subtrees.empty())
+                {
+                    return;
+                }
+
+                hungry = --waiting;
+                stack.push_back(subtrees.back());
+                subtrees.pop_back();
+            }
+
+            while (!stack.empty())
+            {
+                if (cancelled && cancelled())
+                {
+                    stack.clear();
+                    break;
+                }
+
+                Node* node = stack.back();
+                stack.pop_back();
+
+                if (!skipversions || node->type != FILENODE)
+                {
+                    for (Node* child : node->children)
+                    {
+                        if (!(skipinshares && child->inshare))
+                        {
+                            stack.push_back(child);
+                        }
+                    }
+                }
+
+                tp->proc(this, node);
+
+                if (hungry.load(std::memory_order_relaxed) && stack.size() > 1)
+                {
+                    std::lock_guard<std::mutex> lock(mutex);
+                    auto half = stack.begin() + stack.size() / 2;
+                    subtrees.insert(subtrees.end(), stack.begin(), half);
+                    stack.erase(stack.begin(), half);
+                    cv.notify_all();
+                }
+            }
+        }
+    };
+
+    vector<std::thread> threads;
+    for (size_t i = 1; i < tps.size(); i++)
+    {
+        threads.emplace_back(work, tps[i]);
+    }
+
+    if (!tps.empty())
+    {
+        work(tps[0]);
+    }
+
+    for (auto& t : threads)
+    {
+        t.join();
+    }
+}
+
+void MegaClient::sortinproctreeorder(node_vector& nodes, Node* root)
+{
+    // position of each node among its siblings, indexed one parent at a time as needed
+    std::unordered_map<const Node*, size_t> positions;
+    vector<pair<vector<size_t>, Node*>> paths;
+    paths.reserve(nodes.size());
+
+    for (Node* n : nodes)
+    {
+        vector<size_t> path;
+        for (Node* p = n; p != root && p->parent; p = p->parent)
+        {
+            auto it = positions.find(p);
+            if (it == positions.end())
+            {
+                size_t i = 0;
+                for (const Node* child : p->parent->children)
+                {
+                    positions[child] = i++;
+                }
+                it = positions.find(p);
+            }
+            path.push_back(it->second);
+        }
+        std::reverse(path.begin(), path.end());
+        paths.emplace_back(std::move(path), n);
+    }
+
+    std::sort(paths.begin(), paths.end(), [](const pair<vector<size_t>, Node*>& a, const pair<vector<size_t>, Node*>& b)
+    {
+        for (size_t i = 0; i < a.first.size() && i < b.first.size(); i++)
+        {
+            if (a.first[i] != b.first[i])
+            {
+                return a.first[i] < b.first[i];
+            }
+        }
+
+        // one is an ancestor of the other (or they are the same node)
+        return a.first.size() > b.first.size();
+    });
+
+    for (size_t i = 0; i < paths.size(); i++)
+    {
+        nodes[i] = paths[i].second;
+    }
+}
+
 // queue PubKeyAction request to be triggered upon availability of the user's
 // public key
 void MegaClient::queuepubkeyreq(User* u, PubKeyAction* pka)
@@ -9275,6 +9651,33 @@ void MegaClient::transfercacheadd(Transfer *transfer, DBTableTransactionCommitte
         LOG_debug << "Caching transfer";
         tctable->checkCommitter(committer);
         tctable->put(MegaClient::CACHEDTRANSFER, transfer, &tckey);
+
+        // the record is current again, so the journal is obsolete
+        for (uint32_t id : transfer->journaldbids)
+        {
+            tctable->del(id);
+        }
+        transfer->journaldbids.clear();
+    }
+}
+
+void MegaClient::transferprogresscacheadd(Transfer *transfer, DBTableTransactionCommitter* committer)
+{
+    if (tctable && !transfer->skipserialization)
+    {
+        if (!transfer->dbid || transfer->journaldbids.size() >= TRANSFERJOURNALCOMPACT)
+        {
+            return transfercacheadd(transfer, committer);
+        }
+
+        LOG_debug << "Journaling transfer progress";
+        tctable->checkCommitter(committer);
+
+        TransferJournalEntry entry;
+        entry.transferdbid = transfer->dbid;
+        entry.chunkmacs = transfer->chunkmacs;
+        tctable->put(MegaClient::CACHEDTRANSFERJOURNAL, &entry, &tckey);
+        transfer->journaldbids.push_back(entry.dbid);
     }
 }
 
@@ -9285,6 +9688,12 @@ void MegaClient::transfercachedel(Transfer *transfer, DBTableTransactionCommitte
         LOG_debug << "Removing cached transfer";
         tctable->checkCommitter(committer);
         tctable->del(transfer->dbid);
+
+        for (uint32_t id : transfer->journaldbids)
+        {
+            tctable->del(id);
+        }
+        transfer->journaldbids.clear();
     }
 }
 
@@ -10688,6 +11097,7 @@ void MegaClient::enabletransferresumption(const char *loggedoutid)
     uint32_t id;
     string data;
     Transfer* t;
+    map<uint32_t, string> journal;
 
     LOG_info << "Loading transfers from local cache";
     tctable->rewind();
@@ -10716,7 +11126,46 @@ void MegaClient::enabletransferresumption(const char *loggedoutid)
                 cachedfilesdbids.push_back(id);
                 LOG_debug << "Cached file loaded";
                 break;
+            case CACHEDTRANSFERJOURNAL:
+                journal[id] = data;
+                break;
+        }
+    }
+
+    if (!journal.empty())
+    {
+        // replay the progress journal in the order it was written, on top of the transfer records
+        map<uint32_t, Transfer*> transfersbydbid;
+        for (int d = GET; d == GET || d == PUT; d += PUT - GET)
+        {
+            for (transfer_map::iterator it = cachedtransfers[d].begin(); it != cachedtransfers[d].end(); it++)
+            {
+                transfersbydbid[it->second->dbid] = it->second;
+            }
+        }
+
+        DBTableTransactionCommitter committer(tctable);
+        for (map<uint32_t, string>::iterator it = journal.begin(); it != journal.end(); it++)
+        {
+            TransferJournalEntry entry;
+            map<uint32_t, Transfer*>::iterator tit;
+            if (entry.unserialize(&it->second)
+                    && (tit = transfersbydbid.find(entry.transferdbid)) != transfersbydbid.end())
+            {
+                Transfer* t = tit->second;
+                t->chunkmacs.swap(entry.chunkmacs);
+                t->journaldbids.push_back(it->first);
+
+                // progress was computed from the cached record's chunk MACs by Transfer::unserialize
+                t->chunkmacs.calcprogress(t->size, t->pos, t->progresscompleted);
+            }
+            else
+            {
+                LOG_warn << "Discarding orphan transfer journal entry";
+                tctable->del(it->first);
+            }
         }
+        LOG_debug << "Transfer journal replayed: " << journal.size();
     }
 
     // if we are logged in but the filesystem is not current yet
@@ -11634,17 +12083,20 @@ void MegaClient::purgenodesusersabortsc()
     syncs.clear();
 #endif
 
+    mPurgingNodes = true;
     for (node_map::iterator it = nodes.begin(); it != nodes.end(); it++)
     {
         delete it->second;
     }
+    mPurgingNodes = false;
 
     nodes.clear();
+    mFingerprints.clear();
+    mNodesByCtime.clear();
 
 #ifdef ENABLE_SYNC
     todebris.clear();
     tounlink.clear();
-    mFingerprints.clear();
 #endif
 
     for (fafc_map::iterator cit = fafcs.begin(); cit != fafcs.end(); cit++)
@@ -13642,6 +14094,7 @@ bool MegaClient::startxfer(direction_t d, File* f, DBTableTransactionCommitter&
             {
                 t = new Transfer(this, d);
                 *(FileFingerprint*)t = *(FileFingerprint*)f;
+                t->uploadstream = f->uploadstream;
             }
 
             t->skipserialization = donotpersist;
@@ -13776,6 +14229,7 @@ void MegaClient::setmaxconnections(direction_t d, int num)
                     {
                         slot->transfer->bt.arm();
                     }
+                    transferlist.ready(slot->transfer);
                     delete slot;
                 }
             }
@@ -13793,12 +14247,6 @@ node_vector *MegaClient::nodesbyfingerprint(FileFingerprint* fingerprint)
     return mFingerprints.nodesbyfingerprint(fingerprint);
 }
 
-static bool nodes_ctime_less(const Node* a, const Node* b)
-{
-    // heaps return the largest element
-    return a->ctime < b->ctime;
-}
-
 static bool nodes_ctime_greater(const Node* a, const Node* b)
 {
     return a->ctime > b->ctime;
@@ -13806,36 +14254,23 @@ static bool nodes_ctime_greater(const Node* a, const Node* b)
 
 node_vector MegaClient::getRecentNodes(unsigned maxcount, m_time_t since, bool includerubbishbin)
 {
-    // 1. Get nodes added/modified not older than `since`
+    // files added/modified not older than `since`, most recent first, up to `maxcount`
     node_vector v;
-    v.reserve(nodes.size());
-    for (node_map::iterator i = nodes.begin(); i != nodes.end(); ++i)
+    mNodesByCtime.recent(since, [&](Node* n)
     {
-        if (i->second->type == FILENODE && i->second->ctime >= since &&  // recent files only 
-            (!i->second->parent || i->second->parent->type != FILENODE)) // excluding versions
+        if (v.size() >= maxcount)
         {
-            v.push_back(i->second);
+            return false;
         }
-    }
 
-    // heaps use a 'less' function, and pop_heap returns the largest item stored.
-    std::make_heap(v.begin(), v.end(), nodes_ctime_less);
-
-    // 2. Order them chronologically and restrict them to a maximum of `maxcount`
-    node_vector v2;
-    unsigned maxItems = std::min(maxcount, unsigned(v.size()));
-    v2.reserve(maxItems);
-    while (v2.size() < maxItems && !v.empty())
-    {
-        std::pop_heap(v.begin(), v.end(), nodes_ctime_less);
-        Node* n = v.back();
-        v.pop_back();
-        if (includerubbishbin || n->firstancestor()->type != RUBBISHNODE)
+        if ((!n->parent || n->parent->type != FILENODE) &&   // excluding versions
+            (includerubbishbin || n->firstancestor()->type != RUBBISHNODE))
         {
-            v2.push_back(n);
+            v.push_back(n);
         }
-    }
-    return v2;
+        return true;
+    });
+    return v;
 }
 
 
@@ -0,0 +1,228 @@
+/**
+ * @file metrics.cpp
+ * @brief Always-on runtime counters, gauges and histograms
+ *
+ * (c) 2013-2019 by Mega Limited, Auckland, New Zealand
+ *
+ * This file is part of the MEGA SDK - Client Access Engine.
+ *
+ * Applications using the MEGA API must present a valid application key
+ * and comply with the the rules set forth in the Terms of Service.
+ *
+ * The MEGA SDK is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.
+ *
+ * @copyright Simplified (2-clause) BSD License.
+ *
+ * You should have received a copy of the license along with this
+ * program.
+ */
+
+#include "mega/metrics.h"
+
+#include <cstdio>
+#include <cstring>
+
+namespace mega {
+
+namespace {
+
+const char* typeName(Metric::Type t)
+{
+    switch (t)
+    {
+        case Metric::COUNTER: return "counter";
+        case Metric::GAUGE: return "gauge";
+        default: return "histogram";
+    }
+}
+
+// microseconds to seconds, in the shortest exact-enough notation
+string seconds(uint64_t us)
+{
+    char buf[32];
+    snprintf(buf, sizeof buf, "%.6g", double(us) / 1e6);
+    return buf;
+}
+
+} // anonymous
+
+Metric::Metric(vector<Metric*>& registry, Type t, const char* n, const char* h, const char* ln, const char* lv)
+    : type(t)
+    , name(n)
+    , help(h)
+    , labelName(ln)
+    , labelValue(lv)
+{
+    registry.push_back(this);
+}
+
+string Metric::series(const char* suffix, const string& extraLabel) const
+{
+    string s = string(name) + suffix;
+    if (labelName || !extraLabel.empty())
+    {
+        s += '{';
+        if (labelName)
+        {
+            s += string(labelName) + "=\"" + labelValue + "\"";
+        }
+        if (!extraLabel.empty())
+        {
+            s += (labelName ? "," : "") + extraLabel;
+        }
+        s += '}';
+    }
+    return s;
+}
+
+static void appendJsonHeader(string& out, const Metric& m)
+{
+    out += "{\"name\":\"";
+    out += m.name;
+    out += "\",\"type\":\"";
+    out += typeName(m.type);
+    out += '"';
+    if (m.labelName)
+    {
+        out += ",\"labels\":{\"";
+        out += m.labelName;
+        out += "\":\"";
+        out += m.labelValue;
+        out += "\"}";
+    }
+}
+
+MetricCounter::MetricCounter(vector<Metric*>& registry, const char* n, const char* h, const char* ln, const char* lv)
+    : Metric(registry, COUNTER, n, h, ln, lv)
+{
+}
+
+void MetricCounter::appendJson(string& out) const
+{
+    appendJsonHeader(out, *this);
+    out += ",\"value\":" + std::to_string(value()) + "}";
+}
+
+void MetricCounter::appendPrometheus(string& out) const
+{
+    out += series() + " " + std::to_string(value()) + "\n";
+}
+
+MetricGauge::MetricGauge(vector<Metric*>& registry, const char* n, const char* h, const char* ln, const char* lv)
+    : Metric(registry, GAUGE, n, h, ln, lv)
+{
+}
+
+void MetricGauge::appendJson(string& out) const
+{
+    appendJsonHeader(out, *this);
+    out += ",\"value\":" + std::to_string(value()) + "}";
+}
+
+void MetricGauge::appendPrometheus(string& out) const
+{
+    out += series() + " " + std::to_string(value()) + "\n";
+}
+
+MetricHistogram::MetricHistogram(vector<Metric*>& registry, const char* n, const char* h, const char* ln, const char* lv)
+    : Metric(registry, HISTOGRAM, n, h, ln, lv)
+{
+    for (auto& b : mBuckets)
+    {
+        b.store(0, std::memory_order_relaxed);
+    }
+}
+
+void MetricHistogram::observe(std::chrono::steady_clock::duration d)
+{
+    auto us = std::chrono::duration_cast<std::chrono::microseconds>(d).count();
+    observeMicroseconds(us > 0 ? uint64_t(us) : 0);
+}
+
+void MetricHistogram::observeMicroseconds(uint64_t us)
+{
+    unsigned i = 0;
+    while (i < BUCKETS && bucketBound(i) < us)
+    {
+        i++;
+    }
+    mBuckets[i].fetch_add(1, std::memory_order_relaxed);
+    mCount.fetch_add(1, std::memory_order_relaxed);
+    mSum.fetch_add(us, std::memory_order_relaxed);
+}
+
+void MetricHistogram::appendJson(string& out) const
+{
+    // only non-empty buckets, keyed by their upper bound in seconds
+    appendJsonHeader(out, *this);
+    out += ",\"count\":" + std::to_string(count()) + ",\"sum\":" + seconds(sumMicroseconds()) + ",\"buckets\":{";
+    bool first = true;
+    for (unsigned i = 0; i <= BUCKETS; i++)
+    {
+        if (uint64_t n = bucket(i))
+        {
+            out += first ? "\"" : ",\"";
+            out += i < BUCKETS ? seconds(bucketBound(i)) : "+Inf";
+            out += "\":" + std::to_string(n);
+            first = false;
+        }
+    }
+    out += "}}";
+}
+
+void MetricHistogram::appendPrometheus(string& out) const
+{
+    // buckets are cumulative in the exposition format
+    uint64_t cumulative = 0;
+    for (unsigned i = 0; i < BUCKETS; i++)
+    {
+        cumulative += bucket(i);
+        out += series("_bucket", "le=\"" + seconds(bucketBound(i)) + "\"") + " " + std::to_string(cumulative) + "\n";
+    }
+    cumulative += bucket(BUCKETS);
+    out += series("_bucket", "le=\"+Inf\"") + " " + std::to_string(cumulative) + "\n";
+    out += series("_sum") + " " + seconds(sumMicroseconds()) + "\n";
+    out += series("_count") + " " + std::to_string(count()) + "\n";
+}
+
+Metrics& Metrics::get()
+{
+    static Metrics metrics;
+    return metrics;
+}
+
+string Metrics::json() const
+{
+    string out = "[";
+    for (size_t i = 0; i < mAll.size(); i++)
+    {
+        if (i)
+        {
+            out += ',';
+        }
+        mAll[i]->appendJson(out);
+    }
+    return out + "]";
+}
+
+string Metrics::prometheus() const
+{
+    string out;
+    const char* lastName = nullptr;
+    for (const Metric* m : mAll)
+    {
+        // series sharing a name are registered next to each other and get a single HELP/TYPE header
+        if (!lastName || strcmp(lastName, m->name))
+        {
+            out += string("# HELP ") + m->name + " " + m->help + "\n";
+            out += string("# TYPE ") + m->name + " " + typeName(m->type) + "\n";
+            lastName = m->name;
+        }
+        m->appendPrometheus(out);
+    }
+    return out;
+}
+
+} // namespace
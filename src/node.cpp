@@ -49,6 +49,155 @@ NewNode::~NewNode()
 }
 
 
+namespace {
+
+// Fixed-size slots for Node objects, carved from slabs of SLABNODES.  This saves the general
+// allocator's per-object overhead on trees of millions of nodes.  Each slab counts its live nodes
+// and is freed as soon as it empties (but for one spare, so that a tree hovering around a slab
+// boundary doesn't allocate and free one over and over); nodes kept by other clients only pin
+// the slabs they are in.
+class NodePool
+{
+public:
+    void* allocate()
+    {
+        std::lock_guard<std::mutex> g(mMutex);
+        if (mAvailable.empty())
+        {
+            Slot* slots = new Slot[SLABNODES];
+            Slab& slab = mSlabs[slots];
+            slab.slots.reset(slots);
+            for (size_t i = SLABNODES; i--; )
+            {
+                slots[i].next = slab.free;
+                slab.free = &slots[i];
+            }
+            mAvailable.insert(&slab);
+            mEmpty++;
+        }
+
+        // the lowest slab first, to keep the live nodes packed
+        Slab* slab = *mAvailable.begin();
+        if (!slab->live++)
+        {
+            mEmpty--;
+        }
+
+        Slot* slot = slab->free;
+        slab->free = slot->next;
+        if (!slab->free)
+        {
+            mAvailable.erase(mAvailable.begin());
+        }
+        return slot;
+    }
+
+    void release(void* p)
+    {
+        std::lock_guard<std::mutex> g(mMutex);
+        Slot* slot = static_cast<Slot*>(p);
+
+        // the slab starting at or below the slot
+        auto it = mSlabs.upper_bound(slot);
+        assert(it != mSlabs.begin());
+        Slab& slab = (--it)->second;
+        assert(slot < slab.slots.get() + SLABNODES);
+
+        if (!slab.free)
+        {
+            mAvailable.insert(&slab);
+        }
+        slot->next = slab.free;
+        slab.free = slot;
+
+        if (!--slab.live)
+        {
+            if (mEmpty)
+            {
+                mAvailable.erase(&slab);
+                mSlabs.erase(it);
+            }
+            else
+            {
+                mEmpty++;
+            }
+        }
+    }
+
+    size_t slabs()
+    {
+        std::lock_guard<std::mutex> g(mMutex);
+        return mSlabs.size();
+    }
+
+private:
+    static const size_t SLABNODES = 1024;
+
+    union Slot
+    {
+        Slot* next;
+        std::aligned_storage<sizeof(Node), alignof(Node)>::type storage;
+    };
+
+    struct Slab
+    {
+        std::unique_ptr<Slot[]> slots;
+        Slot* free = nullptr;
+        size_t live = 0;
+    };
+
+    struct SlabOrder
+    {
+        bool operator()(const Slab* a, const Slab* b) const
+        {
+            return std::less<const Slot*>()(a->slots.get(), b->slots.get());
+        }
+    };
+
+    std::mutex mMutex;
+
+    // by address of their first slot, so that a slot's slab is found by lookup
+    std::map<const Slot*, Slab> mSlabs;
+
+    // slabs with free slots
+    std::set<Slab*, SlabOrder> mAvailable;
+
+    // slabs without live nodes (at most one outside of allocate())
+    size_t mEmpty = 0;
+};
+
+// never destroyed, so nodes deleted during static destruction still have somewhere to go
+NodePool& nodepool()
+{
+    static NodePool* pool = new NodePool;
+    return *pool;
+}
+
+} // namespace
+
+void* Node::operator new(size_t size)
+{
+    assert(size == sizeof(Node));
+    return size == sizeof(Node) ? nodepool().allocate() : ::operator new(size);
+}
+
+size_t Node::allocatorslabs()
+{
+    return nodepool().slabs();
+}
+
+void Node::operator delete(void* p, size_t size)
+{
+    if (size == sizeof(Node))
+    {
+        nodepool().release(p);
+    }
+    else
+    {
+        ::operator delete(p);
+    }
+}
+
 Node::Node(MegaClient* cclient, node_vector* dp, handle h, handle ph,
            nodetype_t t, m_off_t s, handle u, const char* fa, m_time_t ts)
 {
@@ -77,6 +226,16 @@ Node::Node(MegaClient* cclient, node_vector* dp, handle h, handle ph,
     size = s;
     owner = u;
 
+    if (type == FILENODE)
+    {
+        mCounter.files = 1;
+        mCounter.storage = size;
+    }
+    else if (type == FOLDERNODE)
+    {
+        mCounter.folders = 1;
+    }
+
     copystring(&fileattrstring, fa);
 
     ctime = ts;
@@ -118,6 +277,7 @@ Node::Node(MegaClient* cclient, node_vector* dp, handle h, handle ph,
     }
 
     client->mFingerprints.newnode(this);
+    client->mNodesByCtime.add(this);
 }
 
 Node::~Node()
@@ -131,22 +291,26 @@ Node::~Node()
     // abort pending direct reads
     client->preadabort(this);
 
-    // remove node's fingerprint from hash
-    client->mFingerprints.remove(this);
+    if (!client->mPurgingNodes)
+    {
+        // remove node's fingerprint from hash
+        client->mFingerprints.remove(this);
+        client->mNodesByCtime.remove(this);
 
 #ifdef ENABLE_SYNC
-    // remove from todebris node_set
-    if (todebris_it != client->todebris.end())
-    {
-        client->todebris.erase(todebris_it);
-    }
+        // remove from todebris node_set
+        if (todebris_it != client->todebris.end())
+        {
+            client->todebris.erase(todebris_it);
+        }
 
-    // remove from tounlink node_set
-    if (tounlink_it != client->tounlink.end())
-    {
-        client->tounlink.erase(tounlink_it);
-    }
+        // remove from tounlink node_set
+        if (tounlink_it != client->tounlink.end())
+        {
+            client->tounlink.erase(tounlink_it);
+        }
 #endif
+    }
 
     if (outshares)
     {
@@ -169,29 +333,43 @@ Node::~Node()
     }
 
 
-    // remove from parent's children
-    if (parent)
+    // the rest of the tree is going too, in no particular order: parent may already be gone
+    if (!client->mPurgingNodes)
     {
-        parent->children.erase(child_it);
-    }
+        // remove from parent's children
+        if (parent)
+        {
+            parent->children.erase(child_it);
 
-    Node* fa = firstancestor();
-    handle ancestor = fa->nodehandle;
-    if (ancestor == client->rootnodes[0] || ancestor == client->rootnodes[1] || ancestor == client->rootnodes[2] || fa->inshare)
-    {
-        client->mNodeCounters[firstancestor()->nodehandle] -= subnodeCounts();
-    }
+            if (parent->mChildIndex)
+            {
+                parent->unindexchild(this);
+            }
 
-    if (inshare)
-    {
-        client->mNodeCounters.erase(nodehandle);
-    }
+            for (Node* a = parent; a; a = a->parent)
+            {
+                a->mCounter -= mCounter;
+            }
+        }
 
-    // delete child-parent associations (normally not used, as nodes are
-    // deleted bottom-up)
-    for (node_list::iterator it = children.begin(); it != children.end(); it++)
-    {
-        (*it)->parent = NULL;
+        Node* fa = firstancestor();
+        handle ancestor = fa->nodehandle;
+        if (ancestor == client->rootnodes[0] || ancestor == client->rootnodes[1] || ancestor == client->rootnodes[2] || fa->inshare)
+        {
+            client->mNodeCounters[firstancestor()->nodehandle] -= subnodeCounts();
+        }
+
+        if (inshare)
+        {
+            client->mNodeCounters.erase(nodehandle);
+        }
+
+        // delete child-parent associations (normally not used, as nodes are
+        // deleted bottom-up)
+        for (node_list::iterator it = children.begin(); it != children.end(); it++)
+        {
+            (*it)->parent = NULL;
+        }
     }
 
     delete plink;
@@ -224,15 +402,22 @@ void Node::setkey(const byte* newkey)
 {
     if (newkey)
     {
-        if (keyApplied()) --client->mAppliedKeyNodeCount;
-        nodekeydata.assign(reinterpret_cast<const char*>(newkey), (type == FILENODE) ? FILENODEKEYLENGTH : FOLDERNODEKEYLENGTH);
-        if (keyApplied()) ++client->mAppliedKeyNodeCount;
-        assert(client->mAppliedKeyNodeCount >= 0);
+        installkey(newkey);
     }
 
     setattr();
 }
 
+// update node key only
+void Node::installkey(const byte* newkey)
+{
+    if (keyApplied()) --client->mAppliedKeyNodeCount;
+    nodekeydata.assign(reinterpret_cast<const char*>(newkey), (type == FILENODE) ? FILENODEKEYLENGTH : FOLDERNODEKEYLENGTH);
+    if (keyApplied()) ++client->mAppliedKeyNodeCount;
+    assert(client->mAppliedKeyNodeCount >= 0);
+    client->app->node_decrypted(nodehandle);
+}
+
 // parse serialized node and return Node object - updates nodes hash and parent
 // mismatch vector
 Node* Node::unserialize(MegaClient* client, const string* d, node_vector* dp)
@@ -404,6 +589,7 @@ Node* Node::unserialize(MegaClient* client, const string* d, node_vector* dp)
     {
         client->fsaccess->normalize(&(it->second));
     }
+    n->namechanged();
 
     PublicLink *plink = NULL;
     if (isExported)
@@ -702,34 +888,163 @@ SymmCipher* Node::nodecipher()
 // decrypt attributes and build attribute hash
 void Node::setattr()
 {
-    byte* buf;
     SymmCipher* cipher;
+    attr_map decrypted;
 
-    if (attrstring && (cipher = nodecipher()) && (buf = decryptattr(cipher, attrstring->c_str(), attrstring->size())))
+    if (attrstring && (cipher = nodecipher()) && decryptattrs(*cipher, decrypted))
     {
-        JSON json;
-        nameid name;
-        string* t;
+        applyattrs(decrypted);
+    }
 
-        attrs.map.clear();
-        json.begin((char*)buf + 5);
+    namechanged();
+}
+
+bool Node::decryptattrs(SymmCipher& cipher, attr_map& decrypted) const
+{
+    byte* buf;
+
+    if (!(buf = decryptattr(&cipher, attrstring->c_str(), attrstring->size())))
+    {
+        return false;
+    }
 
-        while ((name = json.getnameid()) != EOO && json.storeobject((t = &attrs.map[name])))
+    JSON json;
+    nameid name;
+    string* t;
+
+    json.begin((char*)buf + 5);
+
+    while ((name = json.getnameid()) != EOO && json.storeobject((t = &decrypted[name])))
+    {
+        JSON::unescape(t);
+
+        if (name == 'n')
         {
-            JSON::unescape(t);
+            client->fsaccess->normalize(t);
+        }
+    }
 
-            if (name == 'n')
+    delete[] buf;
+    return true;
+}
+
+void Node::applyattrs(attr_map& decrypted)
+{
+    attrs.map.swap(decrypted);
+
+    setfingerprint();
+
+    delete attrstring;
+    attrstring = NULL;
+
+    client->app->node_decrypted(nodehandle);
+}
+
+void Node::childrenbyname(const string& name, std::function<bool(Node*)> visit)
+{
+    if (!mChildIndex && children.size() < CHILDINDEXMIN)
+    {
+        for (Node* child : children)
+        {
+            if (name == child->displayname() && !visit(child))
             {
-                client->fsaccess->normalize(t);
+                return;
             }
         }
+        return;
+    }
 
-        setfingerprint();
+    if (!mChildIndex)
+    {
+        mChildIndex.reset(new std::unordered_multimap<size_t, Node*>(children.size()));
+        for (Node* child : children)
+        {
+            indexchild(child);
+        }
+    }
 
-        delete[] buf;
+    // entries are filed by hash: confirm the name
+    auto range = mChildIndex->equal_range(std::hash<string>()(name));
+    Node* first = nullptr;
+    bool duplicates = false;
+    for (auto it = range.first; it != range.second; ++it)
+    {
+        if (name == it->second->displayname())
+        {
+            duplicates = first != nullptr;
+            first = it->second;
+            if (duplicates)
+            {
+                break;
+            }
+        }
+    }
 
-        delete attrstring;
-        attrstring = NULL;
+    if (!duplicates)
+    {
+        if (first)
+        {
+            visit(first);
+        }
+        return;
+    }
+
+    // restore list order among duplicates
+    vector<Node*> found;
+    for (auto it = range.first; it != range.second; ++it)
+    {
+        if (name == it->second->displayname())
+        {
+            found.push_back(it->second);
+        }
+    }
+    std::sort(found.begin(), found.end(), [](const Node* a, const Node* b) { return a->mChildSeq < b->mChildSeq; });
+
+    for (Node* child : found)
+    {
+        if (!visit(child))
+        {
+            return;
+        }
+    }
+}
+
+void Node::namechanged()
+{
+    mSortKey.clear();
+
+    if (parent && parent->mChildIndex)
+    {
+        parent->unindexchild(this);
+        parent->indexchild(this);
+    }
+}
+
+const string& Node::sortkey()
+{
+    if (mSortKey.empty())
+    {
+        mSortKey = naturalsortkey(displayname());
+    }
+    return mSortKey;
+}
+
+void Node::indexchild(Node* child)
+{
+    child->mNameHash = std::hash<string>()(child->displayname());
+    mChildIndex->emplace(child->mNameHash, child);
+}
+
+void Node::unindexchild(Node* child)
+{
+    auto range = mChildIndex->equal_range(child->mNameHash);
+    for (auto it = range.first; it != range.second; ++it)
+    {
+        if (it->second == child)
+        {
+            mChildIndex->erase(it);
+            return;
+        }
     }
 }
 
@@ -889,11 +1204,35 @@ bool Node::applykey()
         return false;
     }
 
+    SymmCipher* sc;
+    const char* k = findkey(&sc);
+    if (!k)
+    {
+        return false;
+    }
+
+    byte key[FILENODEKEYLENGTH];
+    unsigned keylength = (type == FILENODE) ? FILENODEKEYLENGTH : FOLDERNODEKEYLENGTH;
+
+    if (client->decryptkey(k, key, keylength, sc, 0, nodehandle))
+    {
+        client->mAppliedKeyNodeCount++;
+        nodekeydata.assign((const char*)key, keylength);
+        client->app->node_decrypted(nodehandle);
+        setattr();
+    }
+
+    assert(keyApplied());
+    return true;
+}
+
+const char* Node::findkey(SymmCipher** sc)
+{
     int l = -1;
     size_t t = 0;
     handle h;
     const char* k = NULL;
-    SymmCipher* sc = &client->key;
+    *sc = &client->key;
     handle me = client->loggedin() ? client->me : *client->rootnodes;
 
     while ((t = nodekeydata.find_first_of(':', t)) != string::npos)
@@ -926,7 +1265,7 @@ bool Node::applykey()
                     continue;
                 }
 
-                sc = n->sharekey;
+                *sc = n->sharekey;
 
                 // this key will be rewritten when the node leaves the outbound share
                 foreignkey = true;
@@ -939,54 +1278,12 @@ bool Node::applykey()
 
     // no: found => personal key, use directly
     // otherwise, no suitable key available yet - bail (it might arrive soon)
-    if (!k)
-    {
-        if (l < 0)
-        {
-            k = nodekeydata.c_str();
-        }
-        else
-        {
-            return false;
-        }
-    }
-
-    byte key[FILENODEKEYLENGTH];
-    unsigned keylength = (type == FILENODE) ? FILENODEKEYLENGTH : FOLDERNODEKEYLENGTH;
-
-    if (client->decryptkey(k, key, keylength, sc, 0, nodehandle))
+    if (!k && l < 0)
     {
-        client->mAppliedKeyNodeCount++;
-        nodekeydata.assign((const char*)key, keylength);
-        setattr();
+        k = nodekeydata.c_str();
     }
 
-    assert(keyApplied());
-    return true;
-}
-
-NodeCounter Node::subnodeCounts() const
-{
-    NodeCounter nc;
-    for (Node *child : children)
-    {
-        nc += child->subnodeCounts();
-    }
-    if (type == FILENODE)
-    {
-        nc.files += 1;
-        nc.storage += size;
-        if (parent && parent->type == FILENODE)
-        {
-            nc.versions += 1;
-            nc.versionStorage += size;
-        }
-    }
-    else if (type == FOLDERNODE)
-    {
-        nc.folders += 1;
-    }
-    return nc;
+    return k;
 }
 
 // returns whether node was moved
@@ -997,23 +1294,43 @@ bool Node::setparent(Node* p)
         return false;
     }
 
-    NodeCounter nc;
-    bool gotnc = false;
-
     Node *originalancestor = firstancestor();
     handle oah = originalancestor->nodehandle;
     if (oah == client->rootnodes[0] || oah == client->rootnodes[1] || oah == client->rootnodes[2] || originalancestor->inshare)
     {
-        nc = subnodeCounts();
-        gotnc = true;
-
         // nodes moving from cloud drive to rubbish for example, or between inshares from the same user.
-        client->mNodeCounters[oah] -= nc;
+        client->mNodeCounters[oah] -= mCounter;
     }
 
     if (parent)
     {
         parent->children.erase(child_it);
+
+        if (parent->mChildIndex)
+        {
+            parent->unindexchild(this);
+        }
+
+        for (Node* a = parent; a; a = a->parent)
+        {
+            a->mCounter -= mCounter;
+        }
+    }
+
+    // a file is a version while its parent is another file
+    if (type == FILENODE && (parent && parent->type == FILENODE) != (p && p->type == FILENODE))
+    {
+        NodeCounter version;
+        version.versions = 1;
+        version.versionStorage = size;
+        if (p && p->type == FILENODE)
+        {
+            mCounter += version;
+        }
+        else
+        {
+            mCounter -= version;
+        }
     }
 
 #ifdef ENABLE_SYNC
@@ -1025,18 +1342,24 @@ bool Node::setparent(Node* p)
     if (parent)
     {
         child_it = parent->children.insert(parent->children.end(), this);
+        mChildSeq = parent->mNextChildSeq++;
+
+        if (parent->mChildIndex)
+        {
+            parent->indexchild(this);
+        }
+
+        for (Node* a = parent; a; a = a->parent)
+        {
+            a->mCounter += mCounter;
+        }
     }
 
     Node* newancestor = firstancestor();
     handle nah = newancestor->nodehandle;
     if (nah == client->rootnodes[0] || nah == client->rootnodes[1] || nah == client->rootnodes[2] || newancestor->inshare)
     {
-        if (!gotnc)
-        {
-            nc = subnodeCounts();
-        }
-
-        client->mNodeCounters[nah] += nc;
+        client->mNodeCounters[nah] += mCounter;
     }
 
 #ifdef ENABLE_SYNC
@@ -2004,4 +2327,41 @@ node_vector *Fingerprints::nodesbyfingerprint(FileFingerprint* fingerprint)
     return nodes;
 }
 
+bool NodesByCtime::Cmp::operator()(const Node* a, const Node* b) const
+{
+    return a->ctime != b->ctime ? a->ctime < b->ctime : a->nodehandle < b->nodehandle;
+}
+
+void NodesByCtime::add(Node* n)
+{
+    if (n->type == FILENODE)
+    {
+        mNodes.insert(n);
+    }
+}
+
+void NodesByCtime::remove(Node* n)
+{
+    if (n->type == FILENODE)
+    {
+        mNodes.erase(n);
+    }
+}
+
+void NodesByCtime::clear()
+{
+    mNodes.clear();
+}
+
+void NodesByCtime::recent(m_time_t since, std::function<bool(Node*)> visit) const
+{
+    for (auto it = mNodes.rbegin(); it != mNodes.rend() && (*it)->ctime >= since; ++it)
+    {
+        if (!visit(*it))
+        {
+            break;
+        }
+    }
+}
+
 } // namespace
@@ -243,8 +243,6 @@ CurlHttpIO::CurlHttpIO()
     reset = false;
     statechange = false;
     disconnecting = false;
-    maxspeed[GET] = 0;
-    maxspeed[PUT] = 0;
     pkpErrors = 0;
 
     WAIT_CLASS::bumpds();
@@ -652,9 +650,8 @@ void CurlHttpIO::processcurlevents(direction_t d)
     int dummy = 0;
     SockInfoMap *socketmap = &curlsockets[d];
     m_time_t *timeout = &curltimeoutreset[d];
-    bool *paused = &arerequestspaused[d];
 
-    for (SockInfoMap::iterator it = socketmap->begin(); !(*paused) && it != socketmap->end();)
+    for (SockInfoMap::iterator it = socketmap->begin(); it != socketmap->end();)
     {
         SockInfo &info = (it++)->second;
         if (!info.mode)
@@ -841,24 +838,24 @@ void CurlHttpIO::disconnect()
 
 bool CurlHttpIO::setmaxdownloadspeed(m_off_t bpslimit)
 {
-    maxspeed[GET] = bpslimit;
+    bandwidth[GET].setlimit(bpslimit);
     return true;
 }
 
 bool CurlHttpIO::setmaxuploadspeed(m_off_t bpslimit)
 {
-    maxspeed[PUT] = bpslimit;
+    bandwidth[PUT].setlimit(bpslimit);
     return true;
 }
 
 m_off_t CurlHttpIO::getmaxdownloadspeed()
 {
-    return maxspeed[GET];
+    return bandwidth[GET].getlimit();
 }
 
 m_off_t CurlHttpIO::getmaxuploadspeed()
 {
-    return maxspeed[PUT];
+    return bandwidth[PUT].getlimit();
 }
 
 // wake up from cURL I/O
@@ -889,6 +886,7 @@ void CurlHttpIO::addevents(Waiter* w, int)
 
     for (int d = GET; d == GET || d == PUT; d += PUT - GET)
     {
+        // paused requests are retried when their class has been refilled; the others keep going
         if (arerequestspaused[d])
         {
             if (curltimeoutms < 0 || curltimeoutms > 100)
@@ -896,22 +894,20 @@ void CurlHttpIO::addevents(Waiter* w, int)
                 curltimeoutms = 100;
             }
         }
-        else
+
+        addcurlevents(waiter, (direction_t)d);
+        if (curltimeoutreset[d] >= 0)
         {
-            addcurlevents(waiter, (direction_t)d);
-            if (curltimeoutreset[d] >= 0)
+            m_time_t ds = curltimeoutreset[d] - Waiter::ds;
+            if (ds <= 0)
             {
-                m_time_t ds = curltimeoutreset[d] - Waiter::ds;
-                if (ds <= 0)
-                {
-                    curltimeoutms = 0;
-                }
-                else
+                curltimeoutms = 0;
+            }
+            else
+            {
+                if (curltimeoutms < 0 || curltimeoutms > ds * 100)
                 {
-                    if (curltimeoutms < 0 || curltimeoutms > ds * 100)
-                    {
-                        curltimeoutms = long(ds * 100);
-                    }
+                    curltimeoutms = long(ds * 100);
                 }
             }
         }
@@ -1416,7 +1412,7 @@ void CurlHttpIO::send_request(CurlHttpContext* httpctx)
         curl_easy_setopt(curl, CURLOPT_SOCKOPTFUNCTION, sockopt_callback);
         curl_easy_setopt(curl, CURLOPT_SOCKOPTDATA, (void*)req);
 
-        if (httpio->maxspeed[GET] && httpio->maxspeed[GET] <= 102400)
+        if (httpio->bandwidth[GET].getlimit() && httpio->bandwidth[GET].getlimit() <= 102400)
         {
             curl_easy_setopt(curl, CURLOPT_BUFFERSIZE, 4096L);
         }
@@ -1989,30 +1985,23 @@ bool CurlHttpIO::doio()
 
     for (int d = GET; d == GET || d == PUT; d += PUT - GET)
     {
-        partialdata[d] = 0;
         if (arerequestspaused[d])
         {
+            // every class has its own bucket, so one request pausing again says nothing about the others
             arerequestspaused[d] = false;
-            set<CURL *>::iterator it = pausedrequests[d].begin();
-            while (!arerequestspaused[d] && it != pausedrequests[d].end())
+            set<CURL *> paused;
+            paused.swap(pausedrequests[d]);
+            for (CURL *easy_handle : paused)
             {
-                CURL *easy_handle = *it;
-                pausedrequests[d].erase(it++);
                 curl_easy_pause(easy_handle, CURLPAUSE_CONT);
             }
 
-            if (!arerequestspaused[d])
-            {
-                int dummy;
-                curl_multi_socket_action(curlm[d], CURL_SOCKET_TIMEOUT, 0, &dummy);
-            }
+            int dummy;
+            curl_multi_socket_action(curlm[d], CURL_SOCKET_TIMEOUT, 0, &dummy);
         }
 
-        if (!arerequestspaused[d])
-        {
-            processcurlevents((direction_t)d);
-            result |= multidoio(curlm[d]);
-        }
+        processcurlevents((direction_t)d);
+        result |= multidoio(curlm[d]);
     }
 
     curlsocketsprocessed = true;
@@ -2342,12 +2331,12 @@ size_t CurlHttpIO::read_data(void* ptr, size_t size, size_t nmemb, void* source)
         return 0;
     }
 
-    if (httpio->maxspeed[PUT])
+    if (httpio->bandwidth[PUT].getlimit())
     {
         bool isApi = (req->type == REQ_JSON);
         if (!isApi)
         {
-            long maxbytes = long( (httpio->maxspeed[PUT] - httpio->uploadSpeed) * (SpeedController::SPEED_MEAN_INTERVAL_DS / 10) - httpio->partialdata[PUT] );
+            m_off_t maxbytes = httpio->bandwidth[PUT].available(req->bwclass, Waiter::ds);
             if (maxbytes <= 0)
             {
                 httpio->pausedrequests[PUT].insert(httpctx->curl);
@@ -2357,9 +2346,9 @@ size_t CurlHttpIO::read_data(void* ptr, size_t size, size_t nmemb, void* source)
 
             if (nread > (size_t)maxbytes)
             {
-                nread = maxbytes;
+                nread = size_t(maxbytes);
             }
-            httpio->partialdata[PUT] += nread;
+            httpio->bandwidth[PUT].consume(req->bwclass, nread);
         }
     }
     
@@ -2375,21 +2364,22 @@ size_t CurlHttpIO::write_data(void* ptr, size_t size, size_t nmemb, void* target
     CurlHttpIO* httpio = (CurlHttpIO*)req->httpio;
     if (httpio)
     {
-        if (httpio->maxspeed[GET])
+        if (httpio->bandwidth[GET].getlimit())
         {
             CurlHttpContext* httpctx = (CurlHttpContext*)req->httpiohandle;
             bool isUpload = httpctx->data ? httpctx->len : req->out->size();
             bool isApi = (req->type == REQ_JSON);
             if (!isApi && !isUpload)
             {
-                if ((httpio->downloadSpeed + 10 * (httpio->partialdata[GET] + len) / SpeedController::SPEED_MEAN_INTERVAL_DS) > httpio->maxspeed[GET])
+                // curl can't take part of the data back, so a class with any tokens left may go into debt
+                if (httpio->bandwidth[GET].available(req->bwclass, Waiter::ds) <= 0)
                 {
                     CurlHttpContext* httpctx = (CurlHttpContext*)req->httpiohandle;
                     httpio->pausedrequests[GET].insert(httpctx->curl);
                     httpio->arerequestspaused[GET] = true;
                     return CURL_WRITEFUNC_PAUSE;
                 }
-                httpio->partialdata[GET] += len;
+                httpio->bandwidth[GET].consume(req->bwclass, len);
             }
         }
 
@@ -27,9 +27,98 @@
 
 #undef min //avoids issues with std::min
 
+// RAIDSECTOR is 16 bytes, exactly one SSE2/NEON register, so each sector is a single load/xor/store
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#include <emmintrin.h>
+#define MEGA_RAID_SSE2 1
+#elif defined(__ARM_NEON) || defined(__ARM_NEON__)
+#include <arm_neon.h>
+#define MEGA_RAID_NEON 1
+#endif
+
 namespace mega
 {
 
+namespace {
+
+#if defined(MEGA_RAID_SSE2)
+typedef __m128i Sector;
+inline Sector loadSector(const byte* p) { return _mm_loadu_si128(reinterpret_cast<const __m128i*>(p)); }
+inline void storeSector(byte* p, Sector s) { _mm_storeu_si128(reinterpret_cast<__m128i*>(p), s); }
+inline Sector xorSector(Sector a, Sector b) { return _mm_xor_si128(a, b); }
+#elif defined(MEGA_RAID_NEON)
+typedef uint8x16_t Sector;
+inline Sector loadSector(const byte* p) { return vld1q_u8(p); }
+inline void storeSector(byte* p, Sector s) { vst1q_u8(p, s); }
+inline Sector xorSector(Sector a, Sector b) { return veorq_u8(a, b); }
+#else
+struct Sector { uint64_t a, b; };
+inline Sector loadSector(const byte* p) { Sector s; memcpy(&s, p, sizeof s); return s; }
+inline void storeSector(byte* p, Sector s) { memcpy(p, &s, sizeof s); }
+inline Sector xorSector(Sector x, Sector y) { Sector s = { x.a ^ y.a, x.b ^ y.b }; return s; }
+#endif
+
+static_assert(sizeof(Sector) == RAIDSECTOR, "one raid sector per vector");
+
+} // anonymous
+
+void raidInterleave(byte* dest, const byte* const inputbufs[RAIDPARTS], size_t partslen)
+{
+    assert(partslen % RAIDSECTOR == 0);
+
+    unsigned missing = 0;   // parity is not needed when it's the part missing
+    for (unsigned j = 1; j < RAIDPARTS; ++j)
+    {
+        if (!inputbufs[j])
+        {
+            assert(!missing);
+            missing = j;
+        }
+    }
+
+    if (!missing)
+    {
+        // whole raid lines at a time: one sector from each data part
+        for (size_t i = 0; i < partslen; i += RAIDSECTOR, dest += RAIDLINE)
+        {
+            Sector s1 = loadSector(inputbufs[1] + i);
+            Sector s2 = loadSector(inputbufs[2] + i);
+            Sector s3 = loadSector(inputbufs[3] + i);
+            Sector s4 = loadSector(inputbufs[4] + i);
+            Sector s5 = loadSector(inputbufs[5] + i);
+            storeSector(dest, s1);
+            storeSector(dest + RAIDSECTOR, s2);
+            storeSector(dest + 2 * RAIDSECTOR, s3);
+            storeSector(dest + 3 * RAIDSECTOR, s4);
+            storeSector(dest + 4 * RAIDSECTOR, s5);
+        }
+    }
+    else
+    {
+        // the missing sector is the xor of the parity sector and the other four
+        assert(inputbufs[0]);
+        for (size_t i = 0; i < partslen; i += RAIDSECTOR, dest += RAIDLINE)
+        {
+            Sector s[RAIDPARTS];
+            Sector recovered = loadSector(inputbufs[0] + i);
+            for (unsigned j = 1; j < RAIDPARTS; ++j)
+            {
+                if (j != missing)
+                {
+                    s[j] = loadSector(inputbufs[j] + i);
+                    recovered = xorSector(recovered, s[j]);
+                }
+            }
+            s[missing] = recovered;
+
+            for (unsigned j = 1; j < RAIDPARTS; ++j)
+            {
+                storeSector(dest + (j - 1) * RAIDSECTOR, s[j]);
+            }
+        }
+    }
+}
+
 const unsigned RAID_ACTIVE_CHANNEL_FAIL_THRESHOLD = 5;
 
 struct FaultyServers
@@ -114,7 +203,7 @@ RaidBufferManager::FilePiece::FilePiece()
 
 RaidBufferManager::FilePiece::FilePiece(m_off_t p, size_t len)
     : pos(p)
-    , buf(new byte[len + std::min<size_t>(SymmCipher::BLOCKSIZE, RAIDSECTOR)], 0, len)   // SymmCipher::ctr_crypt requirement: decryption: data must be padded to BLOCKSIZE.  Also make sure we can xor up to RAIDSECTOR more for convenience
+    , buf(DownloadBufferPool::get().acquire(len + std::min<size_t>(SymmCipher::BLOCKSIZE, RAIDSECTOR)), 0, len)   // SymmCipher::ctr_crypt requirement: decryption: data must be padded to BLOCKSIZE.  Also make sure we can xor up to RAIDSECTOR more for convenience
 {
 }
 
@@ -476,10 +565,10 @@ void RaidBufferManager::combineRaidParts(unsigned connectionNum)
         else if (!processToEnd && outputfilepos > macchunkpos)
         {
             // for transfers we do mac processing which must be done in chunks, delimited by chunkfloor and chunkceil.  If we don't have the right amount then hold the remainder over for next time.
+            // The remainder shares outputrec's memory: finalize() stops at the (block aligned) chunk boundary, so it never touches those bytes.
             size_t excessdata = static_cast<size_t>(outputfilepos - macchunkpos);
-            FilePiece newleftover(outputfilepos - excessdata, excessdata);
+            FilePiece newleftover(outputfilepos - excessdata, outputrec->buf.share(outputrec->buf.end - excessdata, outputrec->buf.end));
             leftoverchunk.swap(newleftover);
-            memcpy(leftoverchunk.buf.datastart(), outputrec->buf.datastart() + outputrec->buf.datalen() - excessdata, excessdata);
             outputrec->buf.end -= excessdata;
             outputfilepos -= excessdata;
             assert(raidpartspos * (RAIDPARTS - 1) == outputfilepos + m_off_t(leftoverchunk.buf.datalen()));
@@ -529,7 +618,7 @@ RaidBufferManager::FilePiece* RaidBufferManager::combineRaidParts(size_t partsle
     // usual case, for simple and fast processing: all input buffers are the same size, and aligned, and a multiple of raidsector
     if (partslen > 0)
     {
-        byte* inputbufs[RAIDPARTS];
+        const byte* inputbufs[RAIDPARTS];
         for (unsigned i = RAIDPARTS; i--; )
         {
             FilePiece* inputPiece = raidinputparts[i].front();
@@ -537,51 +626,12 @@ RaidBufferManager::FilePiece* RaidBufferManager::combineRaidParts(size_t partsle
         }
 
         byte* b = result->buf.datastart() + prevleftoverchunk.buf.datalen();
-        byte* endpos = b + partslen * (RAIDPARTS-1);
-
-        for (unsigned i = 0; b < endpos; i += RAIDSECTOR)
-        {
-            for (unsigned j = 1; j < RAIDPARTS; ++j)
-            {
-                assert(b + RAIDSECTOR <= result->buf.datastart() + result->buf.datalen());
-                if (inputbufs[j])
-                {
-                    memcpy(b, inputbufs[j] + i, RAIDSECTOR);
-                }
-                else
-                {
-                    recoverSectorFromParity(b, inputbufs, i);
-                }
-                b += RAIDSECTOR;
-            }
-        }
-        assert(b == endpos);
+        assert(b + partslen * (RAIDPARTS - 1) <= result->buf.datastart() + result->buf.datalen());
+        raidInterleave(b, inputbufs, partslen);
     }
     return result;
 }
 
-void RaidBufferManager::recoverSectorFromParity(byte* dest, byte* inputbufs[], unsigned offset)
-{
-    assert(sizeof(m_off_t)*2 == RAIDSECTOR);
-    bool set = false;
-    for (unsigned i = RAIDPARTS; i--; )
-    {
-        if (inputbufs[i])
-        {
-            if (!set)
-            {
-                memcpy(dest, inputbufs[i] + offset, RAIDSECTOR);
-                set = true;
-            }
-            else
-            {
-                *(m_off_t*)dest ^= *(m_off_t*)(inputbufs[i] + offset);
-                *(m_off_t*)(dest + sizeof(m_off_t)) ^= *(m_off_t*)(inputbufs[i] + offset + sizeof(m_off_t));
-            }
-        }
-    }
-}
-
 void RaidBufferManager::combineLastRaidLine(byte* dest, size_t remainingbytes)
 {
     // we have to be careful to use the right number of bytes from each sector
@@ -815,19 +865,15 @@ m_off_t TransferBufferManager::nextTransferPos()
 {
     assert(!isRaid());
     chunkmac_map& chunkmacs = transfer->chunkmacs;
+    while (chunkmacs.finishedAt(ChunkedHash::chunkfloor(transfer->pos)))
+    {
+        transfer->pos = ChunkedHash::chunkceil(transfer->pos);
+    }
+
     chunkmac_map::const_iterator it = chunkmacs.find(ChunkedHash::chunkfloor(transfer->pos));
-    while (it != chunkmacs.end())
+    if (it != chunkmacs.end())
     {
-        if (it->second.finished)
-        {
-            transfer->pos = ChunkedHash::chunkceil(transfer->pos);
-        }
-        else
-        {
-            transfer->pos += it->second.offset;
-            break;
-        }
-        it = chunkmacs.find(ChunkedHash::chunkfloor(transfer->pos));
+        transfer->pos += it->second.offset;
     }
     return transfer->pos;
 }
@@ -873,16 +919,13 @@ std::pair<m_off_t, m_off_t> TransferBufferManager::nextNPosForConnection(unsigne
                 maxReqSize = 0;
             }
 
-            chunkmac_map::iterator it = transfer->chunkmacs.find(npos);
             m_off_t reqSize = npos - transfer->pos;
             while (npos < transfer->size
                 && reqSize <= maxReqSize
-                && (it == transfer->chunkmacs.end()
-                    || (!it->second.finished && !it->second.offset)))
+                && !transfer->chunkmacs.startedAt(npos))
             {
                 npos = ChunkedHash::chunkceil(npos, transfer->size);
                 reqSize = npos - transfer->pos;
-                it = transfer->chunkmacs.find(npos);
             }
             LOG_debug << "Downloading chunk of size " << reqSize;
             assert(reqSize > 0);
@@ -899,6 +942,7 @@ void TransferBufferManager::bufferWriteCompletedAction(FilePiece& r)
     }
 
     r.chunkmacs.clear();
+    transfer->chunkmacs.foldFinishedPrefix(transfer->transfercipher());
     transfer->progresscompleted += r.buf.datalen();
     LOG_debug << "Cached data at: " << r.pos << "   Size: " << r.buf.datalen();
 }
@@ -201,6 +201,16 @@ bool RequestDispatcher::cmdspending() const
     return !nextreqs.front().empty();
 }
 
+size_t RequestDispatcher::queuedCommands() const
+{
+    size_t n = 0;
+    for (const Request& r : nextreqs)
+    {
+        n += r.size();
+    }
+    return n;
+}
+
 void RequestDispatcher::serverrequest(string *out, bool& suppressSID)
 {
     assert(inflightreq.empty());
@@ -332,6 +332,20 @@ Transfer *Transfer::unserialize(MegaClient *client, string *d, transfer_map* tra
     return t;
 }
 
+bool TransferJournalEntry::serialize(string* d)
+{
+    CacheableWriter w(*d);
+    w.serializeu32(transferdbid);
+    w.serializechunkmacs(chunkmacs);
+    return true;
+}
+
+bool TransferJournalEntry::unserialize(string* d)
+{
+    CacheableReader r(*d);
+    return r.unserializeu32(transferdbid) && r.unserializechunkmacs(chunkmacs);
+}
+
 SymmCipher *Transfer::transfercipher()
 {
     client->tmptransfercipher.setkey(transferkey);
@@ -470,6 +484,12 @@ void Transfer::failed(error e, DBTableTransactionCommitter& committer, dstime ti
                      << "    FaSize: " << slot->fa->size << "  FaMtime: " << slot->fa->mtime;
             defer = false;
         }
+
+        if (uploadstream && !uploadstream->canrestart())
+        {
+            LOG_warn << "Streamed upload can't be restarted, its first bytes are gone";
+            defer = false;
+        }
     }
 
     if (defer)
@@ -477,6 +497,7 @@ void Transfer::failed(error e, DBTableTransactionCommitter& committer, dstime ti
         failcount++;
         delete slot;
         slot = NULL;
+        client->transferlist.ready(this);
         client->transfercacheadd(this, &committer);
 
         LOG_debug << "Deferring transfer " << failcount << " during " << (bt.retryin() * 100) << " ms";
@@ -505,6 +526,26 @@ void Transfer::failed(error e, DBTableTransactionCommitter& committer, dstime ti
     }
 }
 
+// the most urgent class among the transfer's files
+bwclass_t Transfer::bwclass() const
+{
+    if (files.empty())
+    {
+        return BW_BULK;
+    }
+
+    bwclass_t cls = BW_BACKUP;
+    for (file_list::const_iterator it = files.begin(); it != files.end(); it++)
+    {
+        bwclass_t fcls = (*it)->syncxfer ? BW_SYNC : ((*it)->backupxfer ? BW_BACKUP : BW_BULK);
+        if (fcls < cls)
+        {
+            cls = fcls;
+        }
+    }
+    return cls;
+}
+
 #ifdef USE_MEDIAINFO
 static uint32_t* fileAttributeKeyPtr(byte filekey[FILENODEKEYLENGTH])
 {
@@ -969,6 +1010,25 @@ void Transfer::complete(DBTableTransactionCommitter& committer)
             slot->fa.reset();
         }
 
+        if (uploadstream)
+        {
+            // the content was unknown when the upload started, so it got a provisional fingerprint.
+            // The transfer stays under that key in client->transfers, the files get the real one
+            FileFingerprint fp;
+            StreamFileAccess sfa(uploadstream, client->waiter);
+            fp.genfingerprint(&sfa);
+            if (!fp.isvalid)
+            {
+                LOG_err << "Unable to fingerprint streamed upload";
+                return failed(API_EREAD, committer);
+            }
+
+            for (File* f : files)
+            {
+                *(FileFingerprint*)f = fp;
+            }
+        }
+
         // files must not change during a PUT transfer
         for (file_list::iterator it = files.begin(); it != files.end(); )
         {
@@ -990,7 +1050,8 @@ void Transfer::complete(DBTableTransactionCommitter& committer)
             }
 #endif
 
-            auto fa = client->fsaccess->newfileaccess();
+            auto fa = uploadstream ? std::unique_ptr<FileAccess>(new StreamFileAccess(uploadstream, client->waiter))
+                                   : client->fsaccess->newfileaccess();
             bool isOpen = fa->fopen(localpath);
             if (!isOpen)
             {
@@ -1034,7 +1095,7 @@ void Transfer::complete(DBTableTransactionCommitter& committer)
         }
 
 
-        if (!client->gfxdisabled)
+        if (!client->gfxdisabled && !uploadstream)
         {
             // prepare file attributes for video/audio files if the file is suitable
             addAnyMissingMediaFileAttributes(NULL, localfilename);
@@ -1071,6 +1132,8 @@ void Transfer::completefiles()
         files.erase(it++);
     }
     ids.push_back(dbid);
+    ids.insert(ids.end(), journaldbids.begin(), journaldbids.end());
+    journaldbids.clear();
 }
 
 DirectReadNode::DirectReadNode(MegaClient* cclient, handle ch, bool cp, SymmCipher* csymmcipher, int64_t cctriv, const char *privauth, const char *pubauth, const char *cauth)
@@ -1561,6 +1624,7 @@ DirectReadSlot::DirectReadSlot(DirectRead* cdr)
         reqs.push_back(new HttpReq(true));
         reqs.back()->status = REQ_READY;
         reqs.back()->type = REQ_BINARY;
+        reqs.back()->bwclass = BW_INTERACTIVE;  // streaming reads are waited on by the app
     }
 
     drs_it = dr->drn->client->drss.insert(dr->drn->client->drss.end(), this);
@@ -1622,6 +1686,8 @@ void TransferList::addtransfer(Transfer *transfer, DBTableTransactionCommitter&
         assert(it == transfers[transfer->type].end() || (*it)->priority != transfer->priority);
         transfers[transfer->type].insert(it, transfer);
     }
+
+    ready(transfer);
 }
 
 void TransferList::removetransfer(Transfer *transfer)
@@ -1631,6 +1697,9 @@ void TransferList::removetransfer(Transfer *transfer)
     {
         transfers[transfer->type].erase(it);
     }
+
+    dropready(transfer);
+    unpark(transfer);
 }
 
 void TransferList::movetransfer(Transfer *transfer, Transfer *prevTransfer, DBTableTransactionCommitter& committer)
@@ -1689,6 +1758,10 @@ void TransferList::movetransfer(transfer_list::iterator it, transfer_list::itera
     }
 
     Transfer *transfer = (*it);
+
+    // the dispatch index is ordered by priority, which is about to change
+    dropready(transfer);
+
     if (dstit == transfers[transfer->type].end())
     {
         LOG_debug << "Moving transfer to the last position";
@@ -1699,6 +1772,7 @@ void TransferList::movetransfer(transfer_list::iterator it, transfer_list::itera
         transfer->priority = currentpriority;
         assert(!transfers[transfer->type].size() || transfers[transfer->type][transfers[transfer->type].size() - 1]->priority < transfer->priority);
         transfers[transfer->type].push_back(transfer);
+        ready(transfer);
         client->transfercacheadd(transfer, &committer);
         client->app->transfer_update(transfer);
         return;
@@ -1733,7 +1807,12 @@ void TransferList::movetransfer(transfer_list::iterator it, transfer_list::itera
         {
             Transfer *t = transfers[transfer->type][i];
             LOG_debug << "Adjusting priority of transfer " << i << " to " << fixedPriority;
+            bool indexed = dropready(t);
             t->priority = fixedPriority;
+            if (indexed)
+            {
+                mReady[t->type].insert(t);
+            }
             client->transfercacheadd(t, &committer);
             client->app->transfer_update(t);
             fixedPriority += PRIORITY_STEP;
@@ -1757,6 +1836,7 @@ void TransferList::movetransfer(transfer_list::iterator it, transfer_list::itera
     transfer_list::iterator fit = transfers[transfer->type].begin() + dstindex;
     assert(fit == transfers[transfer->type].end() || (*fit)->priority != transfer->priority);
     transfers[transfer->type].insert(fit, transfer);
+    ready(transfer);
     client->transfercacheadd(transfer, &committer);
     client->app->transfer_update(transfer);
 }
@@ -1851,6 +1931,7 @@ error TransferList::pause(Transfer *transfer, bool enable, DBTableTransactionCom
     {
         transfer_list::iterator it = iterator(transfer);
         transfer->state = TRANSFERSTATE_QUEUED;
+        ready(transfer);
         prepareIncreasePriority(transfer, it, it, committer);
         client->transfercacheadd(transfer, &committer);
         client->app->transfer_update(transfer);
@@ -1908,12 +1989,41 @@ transfer_list::iterator TransferList::iterator(Transfer *transfer)
 
 Transfer *TransferList::nexttransfer(direction_t direction)
 {
-    for (transfer_list::iterator it = transfers[direction].begin(); it != transfers[direction].end(); it++)
+    // transfers whose backoff has ended compete again
+    auto& backingoff = mBackingOff[direction];
+    while (!backingoff.empty() && backingoff.begin()->first <= Waiter::ds)
+    {
+        Transfer *transfer = backingoff.begin()->second;
+        backingoff.erase(backingoff.begin());
+        transfer->parkeduntil = 0;
+        mReady[direction].insert(transfer);
+    }
+
+    auto& ready = mReady[direction];
+    for (auto it = ready.begin(); it != ready.end(); )
     {
-        Transfer *transfer = (*it);
-        if ((!transfer->slot && isReady(transfer))
-                || (transfer->asyncopencontext
-                    && transfer->asyncopencontext->finished))
+        Transfer *transfer = *it;
+        if (transfer->asyncopencontext)
+        {
+            // waiting for its file to open: keep it until the open completes
+            if (transfer->asyncopencontext->finished)
+            {
+                return transfer;
+            }
+            it++;
+        }
+        else if (transfer->slot || (transfer->state != TRANSFERSTATE_QUEUED && transfer->state != TRANSFERSTATE_RETRYING))
+        {
+            // active, paused or finished: whatever makes it dispatchable again calls ready()
+            it = ready.erase(it);
+        }
+        else if (!transfer->bt.armed())
+        {
+            transfer->parkeduntil = transfer->bt.nextset();
+            backingoff.insert(std::make_pair(transfer->parkeduntil, transfer));
+            it = ready.erase(it);
+        }
+        else
         {
             return transfer;
         }
@@ -1930,6 +2040,42 @@ Transfer *TransferList::transferat(direction_t direction, unsigned int position)
     return NULL;
 }
 
+void TransferList::ready(Transfer *transfer)
+{
+    unpark(transfer);
+    mReady[transfer->type].insert(transfer);
+}
+
+void TransferList::abortbackoff(direction_t direction)
+{
+    for (auto& parked : mBackingOff[direction])
+    {
+        parked.second->parkeduntil = 0;
+        mReady[direction].insert(parked.second);
+    }
+    mBackingOff[direction].clear();
+}
+
+bool TransferList::dropready(Transfer *transfer)
+{
+    auto it = mReady[transfer->type].find(transfer);
+    if (it != mReady[transfer->type].end() && *it == transfer)
+    {
+        mReady[transfer->type].erase(it);
+        return true;
+    }
+    return false;
+}
+
+void TransferList::unpark(Transfer *transfer)
+{
+    if (transfer->parkeduntil)
+    {
+        mBackingOff[transfer->type].erase(std::make_pair(transfer->parkeduntil, transfer));
+        transfer->parkeduntil = 0;
+    }
+}
+
 void TransferList::prepareIncreasePriority(Transfer *transfer, transfer_list::iterator /*srcit*/, transfer_list::iterator dstit, DBTableTransactionCommitter& committer)
 {
     if (dstit == transfers[transfer->type].end())
@@ -1961,6 +2107,7 @@ void TransferList::prepareIncreasePriority(Transfer *transfer, transfer_list::it
             delete lastActiveTransfer->slot; 
             lastActiveTransfer->slot = NULL;
             lastActiveTransfer->state = TRANSFERSTATE_QUEUED;
+            ready(lastActiveTransfer);
             client->transfercacheadd(lastActiveTransfer, &committer);
             client->app->transfer_update(lastActiveTransfer);
         }
@@ -1969,11 +2116,17 @@ void TransferList::prepareIncreasePriority(Transfer *transfer, transfer_list::it
 
 void TransferList::prepareDecreasePriority(Transfer *transfer, transfer_list::iterator it, transfer_list::iterator dstit)
 {
-    if (transfer->slot && transfer->state == TRANSFERSTATE_ACTIVE)
+    if (transfer->slot && transfer->state == TRANSFERSTATE_ACTIVE && it + 1 != transfers[transfer->type].end())
     {
-        transfer_list::iterator cit = it + 1;
-        while (cit != transfers[transfer->type].end())
+        // is any transfer between the current and the new position (inclusive) waiting for a slot?
+        auto& ready = mReady[transfer->type];
+        for (auto cit = ready.lower_bound(*(it + 1)); cit != ready.end(); cit++)
         {
+            if (dstit != transfers[transfer->type].end() && (*cit)->priority > (*dstit)->priority)
+            {
+                break;
+            }
+
             if (!(*cit)->slot && isReady(*cit))
             {
                 if (transfer->client->ststatus != STORAGE_RED || transfer->type == GET)
@@ -1985,13 +2138,6 @@ void TransferList::prepareDecreasePriority(Transfer *transfer, transfer_list::it
                 transfer->state = TRANSFERSTATE_QUEUED;
                 break;
             }
-
-            if (cit == dstit)
-            {
-                break;
-            }
-
-            cit++;
         }
     }
 }
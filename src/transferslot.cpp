@@ -62,16 +62,155 @@ const dstime TransferSlot::PROGRESSTIMEOUT = 10;
 // max request size for downloads
 #if defined(__ANDROID__) || defined(USE_IOS) || defined(WINDOWS_PHONE)
     const m_off_t TransferSlot::MAX_REQ_SIZE = 2097152; // 2 MB
+    const m_off_t TransferSlot::MAX_ADAPTIVE_REQ_SIZE = 4194304; // 4 MB
 #elif defined (_WIN32) || defined(HAVE_AIO_RT)
     const m_off_t TransferSlot::MAX_REQ_SIZE = 16777216; // 16 MB
+    const m_off_t TransferSlot::MAX_ADAPTIVE_REQ_SIZE = 16777216; // 16 MB, larger requests are rejected in doio()
 #else
     const m_off_t TransferSlot::MAX_REQ_SIZE = 4194304; // 4 MB
+    const m_off_t TransferSlot::MAX_ADAPTIVE_REQ_SIZE = 16777216; // 16 MB
 #endif
 
 const m_off_t TransferSlot::MAX_UPLOAD_GAP = 62914560; // 60 MB (up to 63 chunks)
 
+const dstime TransferRateController::WINDOWDS = 50;
+const int TransferRateController::HOLDWINDOWS = 6;
+const dstime TransferRateController::FASTREQUESTDS = 20;
+const dstime TransferRateController::SLOWREQUESTDS = 200;
+const m_off_t TransferRateController::MINREQUESTSIZE = 2097152; // 2 MB
+
+TransferRateController::TransferRateController(unsigned connections, unsigned maxconnections, m_off_t requestsize, m_off_t maxrequestsize)
+    : mConnections(std::max(1u, std::min(connections, maxconnections)))
+    , mMaxConnections(std::max(1u, maxconnections))
+    , mRequestSize(std::min(requestsize, maxrequestsize))
+    , mMaxRequestSize(maxrequestsize)
+    , mStarted(mMaxConnections, 0)
+{
+}
+
+void TransferRateController::transferred(m_off_t bytes, dstime now)
+{
+    if (!mWindowStart)
+    {
+        mWindowStart = now;
+    }
+
+    mWindowBytes += bytes;
+    if (now - mWindowStart < WINDOWDS)
+    {
+        return;
+    }
+
+    m_off_t rate = mWindowBytes * WINDOWDS / (now - mWindowStart);
+    mWindowStart = now;
+    mWindowBytes = 0;
+
+    if (mState == PROBINGUP && rate * 20 < mBaseRate * 21)
+    {
+        // the extra connection didn't pay for itself
+        mConnections--;
+        mProbeUp = false;
+        mHold = HOLDWINDOWS;
+        mState = STEADY;
+        LOG_debug << "Transfer connections back to " << mConnections;
+        return;
+    }
+
+    if (mState == PROBINGDOWN && rate * 20 < mBaseRate * 19)
+    {
+        // the connection we dropped was pulling its weight
+        mConnections++;
+        mProbeUp = true;
+        mHold = HOLDWINDOWS;
+        mState = STEADY;
+        LOG_debug << "Transfer connections back to " << mConnections;
+        return;
+    }
+
+    // a successful probe keeps going in the same direction
+    mState = STEADY;
+    mBaseRate = rate;
+    if (mHold)
+    {
+        mHold--;
+        return;
+    }
+
+    if (mMaxConnections > 1)
+    {
+        mProbeUp = mConnections == 1 || (mProbeUp && mConnections < mMaxConnections);
+        if (mProbeUp)
+        {
+            mConnections++;
+            mState = PROBINGUP;
+        }
+        else
+        {
+            mConnections--;
+            mState = PROBINGDOWN;
+        }
+        LOG_verbose << "Probing transfer with " << mConnections << " connections";
+    }
+}
+
+void TransferRateController::requeststarted(unsigned i, dstime now)
+{
+    if (i < mStarted.size())
+    {
+        mStarted[i] = now;
+    }
+}
+
+void TransferRateController::requestcompleted(unsigned i, m_off_t bytes, dstime now)
+{
+    if (i >= mStarted.size() || !mStarted[i])
+    {
+        return;
+    }
+
+    dstime elapsed = now - mStarted[i];
+    mStarted[i] = 0;
+
+    // requests near the end of the file are cut short and tell us nothing
+    if (bytes * 2 < mRequestSize)
+    {
+        return;
+    }
+
+    if (elapsed < FASTREQUESTDS && mRequestSize < mMaxRequestSize)
+    {
+        mRequestSize = std::min(mRequestSize * 2, mMaxRequestSize);
+        LOG_debug << "Transfer request size raised to " << mRequestSize;
+    }
+    else if (elapsed > SLOWREQUESTDS && mRequestSize > MINREQUESTSIZE)
+    {
+        mRequestSize = std::max(mRequestSize / 2, MINREQUESTSIZE);
+        LOG_debug << "Transfer request size lowered to " << mRequestSize;
+    }
+}
+
+void TransferRateController::requestfailed(dstime now)
+{
+    if (mLastFailure && now - mLastFailure < WINDOWDS)
+    {
+        return;
+    }
+    mLastFailure = now;
+
+    mConnections = std::max(1u, mConnections / 2);
+    if (mRequestSize > MINREQUESTSIZE)
+    {
+        mRequestSize = std::max(mRequestSize / 2, MINREQUESTSIZE);
+    }
+    mProbeUp = true;
+    mHold = HOLDWINDOWS;
+    mState = STEADY;
+    LOG_debug << "Transfer backing off to " << mConnections << " connections, request size " << mRequestSize;
+}
+
 TransferSlot::TransferSlot(Transfer* ctransfer)
-    : fa(ctransfer->client->fsaccess->newfileaccess(), ctransfer)
+    : fa(ctransfer->uploadstream ? std::unique_ptr<FileAccess>(new StreamFileAccess(ctransfer->uploadstream, ctransfer->client->waiter))
+                                 : ctransfer->client->fsaccess->newfileaccess(), ctransfer)
     , retrybt(ctransfer->client->rng, ctransfer->client->transferSlotsBackoff)
 {
     starttime = 0;
@@ -102,6 +241,7 @@ TransferSlot::TransferSlot(Transfer* ctransfer)
     slots_it = transfer->client->tslots.end();
 
     maxRequestSize = MAX_REQ_SIZE;
+    maxAdaptiveRequestSize = MAX_ADAPTIVE_REQ_SIZE;
 #if defined(_WIN32) && !defined(WINDOWS_PHONE)
     MEMORYSTATUSEX statex;
     memset(&statex, 0, sizeof (statex));
@@ -129,6 +269,9 @@ TransferSlot::TransferSlot(Transfer* ctransfer)
             {
                 maxRequestSize = 8388608; // 8 MB
             }
+
+            // short of memory: don't let adaptive downloads grow past it either
+            maxAdaptiveRequestSize = maxRequestSize;
         }
         else
         {
@@ -152,7 +295,22 @@ bool TransferSlot::createconnectionsonce()
             return false;   // too soon, we don't know raid / non-raid yet
         }
 
-        connections = transferbuf.isRaid() ? RAIDPARTS : (transfer->size > 131072 ? transfer->client->connections[transfer->type] : 1);
+        if (transferbuf.isRaid())
+        {
+            connections = RAIDPARTS;
+        }
+        else if (transfer->size > 131072)
+        {
+            // the configured number of connections is where the controller starts; how many are
+            // worth using, up to the global maximum, is measured
+            connections = MegaClient::MAX_NUM_CONNECTIONS;
+            ratecontroller.reset(new TransferRateController(transfer->client->connections[transfer->type], connections,
+                                                            maxRequestSize, std::max(maxRequestSize, maxAdaptiveRequestSize)));
+        }
+        else
+        {
+            connections = 1;
+        }
         LOG_debug << "Populating transfer slot with " << connections << " connections, max request size of " << maxRequestSize << " bytes";
         reqs = new HttpReqXfer*[connections]();
         asyncIO = new AsyncIOContext*[connections]();
@@ -244,7 +402,7 @@ TransferSlot::~TransferSlot()
 
         if (cachetransfer)
         {
-            transfer->client->transfercacheadd(transfer, nullptr);
+            transfer->client->transferprogresscacheadd(transfer, nullptr);
             LOG_debug << "Completed: " << transfer->progresscompleted;
         }
     }
@@ -320,10 +478,25 @@ void TransferSlot::disconnect()
     }
 }
 
+void chunkmac_map::foldFinishedPrefix(SymmCipher *cipher)
+{
+    iterator it;
+    while ((it = begin()) != end() && it->first == macsmacPrefixEnd && it->second.finished)
+    {
+        SymmCipher::xorblock(it->second.mac, macsmacPrefix);
+        cipher->ecb_encrypt(macsmacPrefix);
+        macsmacPrefixEnd = ChunkedHash::chunkceil(it->first);
+        erase(it);
+    }
+}
+
 // coalesce block macs into file mac
 int64_t chunkmac_map::macsmac(SymmCipher *cipher)
 {
-    byte mac[SymmCipher::BLOCKSIZE] = { 0 };
+    foldFinishedPrefix(cipher);
+
+    byte mac[SymmCipher::BLOCKSIZE];
+    memcpy(mac, macsmacPrefix, sizeof mac);
 
     for (chunkmac_map::iterator it = begin(); it != end(); it++)
     {
@@ -492,6 +665,11 @@ void TransferSlot::doio(MegaClient* client, DBTableTransactionCommitter& committ
                     break;
 
                 case REQ_SUCCESS:
+                    if (ratecontroller && transfer->type == GET)
+                    {
+                        ratecontroller->requestcompleted(i, reqs[i]->size, Waiter::ds);
+                    }
+
                     if (client->orderdownloadedchunks && transfer->type == GET && !transferbuf.isRaid() && transfer->progresscompleted != static_cast<HttpReqDL*>(reqs[i])->dlpos)
                     {
                         // postponing unsorted chunk
@@ -625,8 +803,15 @@ void TransferSlot::doio(MegaClient* client, DBTableTransactionCommitter& committ
                             LOG_verbose << "Upload chunk completed: " << startpos;
                             startpos = ChunkedHash::chunkceil(startpos, finalpos);
                         }
+                        transfer->chunkmacs.foldFinishedPrefix(transfer->transfercipher());
                         transfer->progresscompleted += reqs[i]->size;
 
+                        if (transfer->uploadstream)
+                        {
+                            // a new slot resumes after the folded chunks, so the stream can drop them
+                            transfer->uploadstream->release(transfer->chunkmacs.foldedEnd());
+                        }
+
                         updatecontiguousprogress();
 
                         if (transfer->progresscompleted == transfer->size)
@@ -638,7 +823,7 @@ void TransferSlot::doio(MegaClient* client, DBTableTransactionCommitter& committ
 
                         errorcount = 0;
                         transfer->failcount = 0;
-                        client->transfercacheadd(transfer, &committer);
+                        client->transferprogresscacheadd(transfer, &committer);
                         reqs[i]->status = REQ_READY;
                     }
                     else   // GET
@@ -700,7 +885,7 @@ void TransferSlot::doio(MegaClient* client, DBTableTransactionCommitter& committ
                                         return;
                                     }
 
-                                    client->transfercacheadd(transfer, &committer);
+                                    client->transferprogresscacheadd(transfer, &committer);
                                     reqs[i]->status = REQ_READY;
                                 }
                             }
@@ -779,7 +964,7 @@ void TransferSlot::doio(MegaClient* client, DBTableTransactionCommitter& committ
                                     return;
                                 }
 
-                                client->transfercacheadd(transfer, &committer);
+                                client->transferprogresscacheadd(transfer, &committer);
                                 reqs[i]->status = REQ_READY;
 
                                 if (client->orderdownloadedchunks && !transferbuf.isRaid())
@@ -895,6 +1080,11 @@ void TransferSlot::doio(MegaClient* client, DBTableTransactionCommitter& committ
                             client->setchunkfailed(&reqs[i]->posturl);
                             ++client->performanceStats.transferTempErrors;
 
+                            if (ratecontroller)
+                            {
+                                ratecontroller->requestfailed(Waiter::ds);
+                            }
+
                             if (changeport)
                             {
                                 toggleport(reqs[i]);
@@ -910,11 +1100,15 @@ void TransferSlot::doio(MegaClient* client, DBTableTransactionCommitter& committ
 
         if (!failure)
         {
-            if (!reqs[i] || (reqs[i]->status == REQ_READY))
+            // connections above the controller's limit finish what they have in flight, but take nothing new
+            if ((!reqs[i] || (reqs[i]->status == REQ_READY))
+                    && (!ratecontroller || unsigned(i) < ratecontroller->connections()))
             {
                 bool newInputBufferSupplied = false;
                 bool pauseConnectionInputForRaid = false;
-                std::pair<m_off_t, m_off_t> posrange = transferbuf.nextNPosForConnection(i, maxRequestSize, connections, newInputBufferSupplied, pauseConnectionInputForRaid);
+                std::pair<m_off_t, m_off_t> posrange = ratecontroller
+                        ? transferbuf.nextNPosForConnection(i, ratecontroller->requestsize(), ratecontroller->connections(), newInputBufferSupplied, pauseConnectionInputForRaid)
+                        : transferbuf.nextNPosForConnection(i, maxRequestSize, connections, newInputBufferSupplied, pauseConnectionInputForRaid);
 
                 // we might have a raid-reassembled block to write, or a previously loaded block, or a skip block to process.
                 bool newOutputBufferSupplied = false;
@@ -966,14 +1160,24 @@ void TransferSlot::doio(MegaClient* client, DBTableTransactionCommitter& committ
                         {
                             if (!fa->fread(reqs[i]->out, size, (-(int)size) & (SymmCipher::BLOCKSIZE - 1), transfer->pos))
                             {
-                                LOG_warn << "Error preparing transfer: " << fa->retry;
-                                if (!fa->retry)
+                                if (transfer->uploadstream && fa->retry)
                                 {
-                                    return transfer->failed(API_EREAD, committer);
+                                    // not received yet: the stream wakes us up when it is.
+                                    // The storage server isn't stalling meanwhile
+                                    lastdata = Waiter::ds;
+                                }
+                                else
+                                {
+                                    LOG_warn << "Error preparing transfer: " << fa->retry;
+                                    if (!fa->retry)
+                                    {
+                                        return transfer->failed(API_EREAD, committer);
+                                    }
+
+                                    // retry the read shortly
+                                    backoff = 2;
                                 }
 
-                                // retry the read shortly
-                                backoff = 2;
                                 posrange.second = transfer->pos;
                                 prepare = false;
                             }
@@ -1042,7 +1246,13 @@ void TransferSlot::doio(MegaClient* client, DBTableTransactionCommitter& committ
             if (reqs[i] && (reqs[i]->status == REQ_PREPARED))
             {
                 reqs[i]->minspeed = true;
+                reqs[i]->bwclass = transfer->bwclass();
                 reqs[i]->post(client);
+
+                if (ratecontroller)
+                {
+                    ratecontroller->requeststarted(i, Waiter::ds);
+                }
             }
         }
     }
@@ -1060,6 +1270,10 @@ void TransferSlot::doio(MegaClient* client, DBTableTransactionCommitter& committ
         {
             m_off_t diff = p - progressreported;
             speed = speedController.calculateSpeed(diff);
+            if (ratecontroller)
+            {
+                ratecontroller->transferred(diff, Waiter::ds);
+            }
             meanSpeed = speedController.getMeanSpeed();
             if (transfer->type == PUT)
             {
@@ -1125,6 +1339,11 @@ void TransferSlot::doio(MegaClient* client, DBTableTransactionCommitter& committ
             LOG_warn << "Chunk failed due to a timeout";
             client->app->transfer_failed(transfer, API_EFAILED);
             ++client->performanceStats.transferTempErrors;
+
+            if (ratecontroller)
+            {
+                ratecontroller->requestfailed(Waiter::ds);
+            }
         }
     }
 
@@ -1175,10 +1394,8 @@ void TransferSlot::progress()
 
 void TransferSlot::updatecontiguousprogress()
 {
-    chunkmac_map::iterator pcit;
-    chunkmac_map &pcchunkmacs = transfer->chunkmacs;
-    while ((pcit = pcchunkmacs.find(progresscontiguous)) != pcchunkmacs.end()
-           && pcit->second.finished)
+    while (progresscontiguous < transfer->size
+           && transfer->chunkmacs.finishedAt(progresscontiguous))
     {
         progresscontiguous = ChunkedHash::chunkceil(progresscontiguous, transfer->size);
     }
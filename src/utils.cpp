@@ -206,10 +206,28 @@ bool CacheableReader::unserializebinary(byte* data, size_t len)
 }
 
 
+// Without a folded prefix the original layout is kept: a 16-bit count followed by the entries.
+// Otherwise the count is FOLDED_MARKER, then a format byte, the prefix end and MAC, and a 32-bit count.
+static const unsigned short FOLDED_MARKER = 0xFFFF;
+static const byte FOLDED_FORMAT = 1;
+
 void chunkmac_map::serialize(string& d) const
 {
-    unsigned short ll = (unsigned short)size();
-    d.append((char*)&ll, sizeof(ll));
+    if (!macsmacPrefixEnd && size() < FOLDED_MARKER)
+    {
+        unsigned short ll = (unsigned short)size();
+        d.append((char*)&ll, sizeof(ll));
+    }
+    else
+    {
+        uint32_t ll = (uint32_t)size();
+        d.append((char*)&FOLDED_MARKER, sizeof(FOLDED_MARKER));
+        d.append((char*)&FOLDED_FORMAT, sizeof(FOLDED_FORMAT));
+        d.append((char*)&macsmacPrefixEnd, sizeof(macsmacPrefixEnd));
+        d.append((char*)macsmacPrefix, sizeof(macsmacPrefix));
+        d.append((char*)&ll, sizeof(ll));
+    }
+
     for (const_iterator it = begin(); it != end(); it++)
     {
         d.append((char*)&it->first, sizeof(it->first));
@@ -219,29 +237,105 @@ void chunkmac_map::serialize(string& d) const
 
 bool chunkmac_map::unserialize(const char*& ptr, const char* end)
 {
-    unsigned short ll;
-    if ((ptr + sizeof(ll) > end) || ptr + (ll = MemAccess::get<unsigned short>(ptr)) * (sizeof(m_off_t) + sizeof(ChunkMAC)) + sizeof(ll) > end)
+    const char* p = ptr;
+    uint32_t ll;
+    m_off_t prefixEnd = 0;
+    byte prefix[SymmCipher::BLOCKSIZE] = {};
+
+    if (p + sizeof(unsigned short) > end)
+    {
+        return false;
+    }
+    ll = MemAccess::get<unsigned short>(p);
+    p += sizeof(unsigned short);
+
+    // a legacy map with exactly FOLDED_MARKER entries starts with a chunk position, whose low byte is never FOLDED_FORMAT
+    if (ll == FOLDED_MARKER && p < end && byte(*p) == FOLDED_FORMAT)
+    {
+        p += sizeof(FOLDED_FORMAT);
+        if (p + sizeof(prefixEnd) + sizeof(prefix) + sizeof(ll) > end)
+        {
+            return false;
+        }
+        prefixEnd = MemAccess::get<m_off_t>(p);
+        p += sizeof(prefixEnd);
+        memcpy(prefix, p, sizeof(prefix));
+        p += sizeof(prefix);
+        ll = MemAccess::get<uint32_t>(p);
+        p += sizeof(ll);
+    }
+
+    if (size_t(end - p) / (sizeof(m_off_t) + sizeof(ChunkMAC)) < ll)
     {
         return false;
     }
 
-    ptr += sizeof(ll);
+    macsmacPrefixEnd = prefixEnd;
+    memcpy(macsmacPrefix, prefix, sizeof(macsmacPrefix));
 
-    for (int i = 0; i < ll; i++)
+    for (uint32_t i = 0; i < ll; i++)
     {
-        m_off_t pos = MemAccess::get<m_off_t>(ptr);
-        ptr += sizeof(m_off_t);
+        m_off_t pos = MemAccess::get<m_off_t>(p);
+        p += sizeof(m_off_t);
 
-        memcpy(&((*this)[pos]), ptr, sizeof(ChunkMAC));
-        ptr += sizeof(ChunkMAC);
+        memcpy(&((*this)[pos]), p, sizeof(ChunkMAC));
+        p += sizeof(ChunkMAC);
     }
+    ptr = p;
     return true;
 }
 
+bool chunkmac_map::finishedAt(m_off_t pos) const
+{
+    if (pos < macsmacPrefixEnd)
+    {
+        return true;
+    }
+    const_iterator it = find(pos);
+    return it != end() && it->second.finished;
+}
+
+bool chunkmac_map::startedAt(m_off_t pos) const
+{
+    if (pos < macsmacPrefixEnd)
+    {
+        return true;
+    }
+    const_iterator it = find(pos);
+    return it != end() && (it->second.finished || it->second.offset);
+}
+
+ChunkMAC& chunkmac_map::operator[](m_off_t pos)
+{
+    if (pos < macsmacPrefixEnd)
+    {
+        // already accounted for in the prefix; anything written here is discarded
+        foldedChunk = ChunkMAC();
+        foldedChunk.finished = true;
+        return foldedChunk;
+    }
+    return map<m_off_t, ChunkMAC>::operator[](pos);
+}
+
+void chunkmac_map::clear()
+{
+    map<m_off_t, ChunkMAC>::clear();
+    macsmacPrefixEnd = 0;
+    memset(macsmacPrefix, 0, sizeof(macsmacPrefix));
+}
+
+void chunkmac_map::swap(chunkmac_map& other)
+{
+    map<m_off_t, ChunkMAC>::swap(other);
+    std::swap(macsmacPrefixEnd, other.macsmacPrefixEnd);
+    std::swap_ranges(macsmacPrefix, macsmacPrefix + sizeof(macsmacPrefix), other.macsmacPrefix);
+}
+
 void chunkmac_map::calcprogress(m_off_t size, m_off_t& chunkpos, m_off_t& progresscompleted, m_off_t* lastblockprogress)
 {
-    chunkpos = 0;
-    progresscompleted = 0;
+    // the folded prefix ends at a chunk boundary, which may lie beyond the end of the file
+    chunkpos = std::min(macsmacPrefixEnd, size);
+    progresscompleted = chunkpos;
 
     for (chunkmac_map::iterator it = begin(); it != end(); ++it)
     {
@@ -1957,6 +2051,63 @@ void tolower_string(std::string& str)
     std::transform(str.begin(), str.end(), str.begin(), [](char c) {return static_cast<char>(::tolower(c)); });
 }
 
+std::string naturalsortkey(const char* name)
+{
+    // long digit runs keep the ordering node lists have always had: the value is reduced
+    // by maxNumber whenever it reaches it, and the number of reductions compares first
+    static const uint64_t maxNumber = (ULONG_MAX - 57) / 10;
+
+    std::string key;
+    key.reserve(strlen(name) + 8);
+
+    while (*name)
+    {
+        if (*name >= '0' && *name <= '9')
+        {
+            uint64_t number = 0;
+            uint32_t overflows = 0;
+            while (*name >= '0' && *name <= '9')
+            {
+                number = number * 10 + uint64_t(*name++ - '0');
+                if (number >= maxNumber)
+                {
+                    number -= maxNumber;
+                    overflows++;
+                }
+            }
+
+            // \1, overflow count, then the value with its length first so shorter values sort lower
+            unsigned bytes = 0;
+            for (uint64_t v = number; v; v >>= 8)
+            {
+                bytes++;
+            }
+            key += '\1';
+            for (int shift = 24; shift >= 0; shift -= 8)
+            {
+                key += static_cast<char>(overflows >> shift);
+            }
+            key += static_cast<char>(bytes);
+            while (bytes--)
+            {
+                key += static_cast<char>(number >> (bytes * 8));
+            }
+        }
+        else
+        {
+            // escape the two lowest bytes so they stay above digit runs and below everything else
+            int c = ::tolower(static_cast<unsigned char>(*name++));
+            if (c <= 2)
+            {
+                key += '\2';
+            }
+            key += static_cast<char>(c);
+        }
+    }
+
+    return key;
+}
+
 #ifdef __APPLE__
 int macOSmajorVersion()
 {
@@ -0,0 +1,130 @@
+/**
+ * (c) 2019 by Mega Limited, Wellsford, New Zealand
+ *
+ * This file is part of the MEGA SDK - Client Access Engine.
+ *
+ * Applications using the MEGA API must present a valid application key
+ * and comply with the the rules set forth in the Terms of Service.
+ *
+ * The MEGA SDK is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.
+ *
+ * @copyright Simplified (2-clause) BSD License.
+ *
+ * You should have received a copy of the license along with this
+ * program.
+ */
+
+#include <mega.h>
+
+#include "bench.h"
+#include "inputs.h"
+
+namespace {
+
+const unsigned CTR_BUFFER = 1 << 20;    // one full-size chunk
+const m_off_t MACSMAC_FILE = m_off_t(1) << 30;
+
+mega::chunkmac_map referenceChunkMacs(m_off_t size)
+{
+    mega::chunkmac_map macs;
+    unsigned seed = 0;
+    for (m_off_t pos = 0; pos < size; pos = mega::ChunkedHash::chunkceil(pos, size))
+    {
+        std::string mac = mt::bench::referenceBytes(mega::SymmCipher::BLOCKSIZE, ++seed);
+        mega::ChunkMAC& m = macs[pos];
+        memcpy(m.mac, mac.data(), sizeof m.mac);
+        m.finished = true;
+    }
+    return macs;
+}
+
+} // anonymous
+
+// upload path: encrypt and mac one chunk
+MEGA_BENCHMARK(SymmCipher_ctr_crypt_encrypt_1MiB)
+{
+    mega::SymmCipher cipher(mt::bench::referenceFileKey());
+    std::string data = mt::bench::referenceBytes(CTR_BUFFER + mega::SymmCipher::BLOCKSIZE);
+    mega::byte mac[mega::SymmCipher::BLOCKSIZE];
+    state.setBytesPerIteration(CTR_BUFFER);
+    while (state.keepRunning())
+    {
+        cipher.ctr_crypt(reinterpret_cast<mega::byte*>(&data[0]), CTR_BUFFER, 0, 0x0102030405060708, mac, true);
+    }
+    mt::bench::doNotOptimize(mac);
+}
+
+// download path: decrypt and mac one chunk
+MEGA_BENCHMARK(SymmCipher_ctr_crypt_decrypt_1MiB)
+{
+    mega::SymmCipher cipher(mt::bench::referenceFileKey());
+    std::string data = mt::bench::referenceBytes(CTR_BUFFER + mega::SymmCipher::BLOCKSIZE);
+    mega::byte mac[mega::SymmCipher::BLOCKSIZE];
+    state.setBytesPerIteration(CTR_BUFFER);
+    while (state.keepRunning())
+    {
+        cipher.ctr_crypt(reinterpret_cast<mega::byte*>(&data[0]), CTR_BUFFER, 0, 0x0102030405060708, mac, false);
+    }
+    mt::bench::doNotOptimize(mac);
+}
+
+// streaming path: decrypt without mac
+MEGA_BENCHMARK(SymmCipher_ctr_crypt_nomac_1MiB)
+{
+    mega::SymmCipher cipher(mt::bench::referenceFileKey());
+    std::string data = mt::bench::referenceBytes(CTR_BUFFER + mega::SymmCipher::BLOCKSIZE);
+    state.setBytesPerIteration(CTR_BUFFER);
+    while (state.keepRunning())
+    {
+        cipher.ctr_crypt(reinterpret_cast<mega::byte*>(&data[0]), CTR_BUFFER, 0, 0x0102030405060708, NULL, false);
+    }
+    mt::bench::doNotOptimize(data.data());
+}
+
+// condensing the chunk macs of a 1 GiB file
+MEGA_BENCHMARK(chunkmac_map_macsmac_1GiB)
+{
+    mega::SymmCipher cipher(mt::bench::referenceFileKey());
+    mega::chunkmac_map macs = referenceChunkMacs(MACSMAC_FILE);
+    int64_t result = 0;
+    state.setItemsPerIteration(macs.size());
+    while (state.keepRunning())
+    {
+        result ^= macs.macsmac(&cipher);
+    }
+    mt::bench::doNotOptimize(&result);
+}
+
+// a typical node cache record
+MEGA_BENCHMARK(PaddedCBC_encrypt_256B)
+{
+    mega::PrnGen rng;
+    mega::SymmCipher key(mt::bench::referenceKey());
+    const std::string record = mt::bench::referenceBytes(256);
+    std::string data;
+    state.setBytesPerIteration(record.size());
+    while (state.keepRunning())
+    {
+        data = record;
+        mega::PaddedCBC::encrypt(rng, &data, &key);
+    }
+    mt::bench::doNotOptimize(data.data());
+}
+
+MEGA_BENCHMARK(PaddedCBC_decrypt_256B)
+{
+    mega::PrnGen rng;
+    mega::SymmCipher key(mt::bench::referenceKey());
+    std::string encrypted = mt::bench::referenceBytes(256);
+    mega::PaddedCBC::encrypt(rng, &encrypted, &key);
+    std::string data;
+    state.setBytesPerIteration(encrypted.size());
+    while (state.keepRunning())
+    {
+        data = encrypted;
+        mega::PaddedCBC::decrypt(&data, &key);
+    }
+    mt::bench::doNotOptimize(data.data());
+}
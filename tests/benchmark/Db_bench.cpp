@@ -0,0 +1,98 @@
+/**
+ * (c) 2019 by Mega Limited, Wellsford, New Zealand
+ *
+ * This file is part of the MEGA SDK - Client Access Engine.
+ *
+ * Applications using the MEGA API must present a valid application key
+ * and comply with the the rules set forth in the Terms of Service.
+ *
+ * The MEGA SDK is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.
+ *
+ * @copyright Simplified (2-clause) BSD License.
+ *
+ * You should have received a copy of the license along with this
+ * program.
+ */
+
+#include <mega.h>
+#include <megaapi_impl.h>
+
+#include "bench.h"
+#include "inputs.h"
+
+#ifdef USE_SQLITE
+
+namespace {
+
+const unsigned RECORD_SIZE = 256;   // an encrypted node record
+const unsigned BATCH = 1000;        // records written per transaction
+const unsigned TABLE_RECORDS = 10000;
+
+// a state cache table in the working directory, deleted on destruction
+struct Table
+{
+    mega::PrnGen rng;
+    mega::MegaFileSystemAccess fs;
+    mega::SqliteDbAccess access;
+    std::unique_ptr<mega::DbTable> table;
+
+    Table()
+    {
+        std::string name = "benchmark";
+        table.reset(access.open(rng, &fs, &name, false, false));
+        assert(table);
+        table->truncate();
+    }
+
+    ~Table()
+    {
+        table->remove();
+    }
+};
+
+} // anonymous
+
+MEGA_BENCHMARK(SqliteDbTable_put_1000)
+{
+    Table t;
+    std::string record = mt::bench::referenceBytes(RECORD_SIZE);
+    uint32_t id = 0;
+    state.setBytesPerIteration(BATCH * RECORD_SIZE);
+    state.setItemsPerIteration(BATCH);
+    while (state.keepRunning())
+    {
+        t.table->begin();
+        for (unsigned i = BATCH; i--; )
+        {
+            t.table->put(id++ % TABLE_RECORDS, &record[0], RECORD_SIZE);
+        }
+        t.table->commit();
+    }
+}
+
+MEGA_BENCHMARK(SqliteDbTable_get)
+{
+    Table t;
+    std::string record = mt::bench::referenceBytes(RECORD_SIZE);
+    t.table->begin();
+    for (uint32_t id = 0; id < TABLE_RECORDS; id++)
+    {
+        t.table->put(id, &record[0], RECORD_SIZE);
+    }
+    t.table->commit();
+
+    std::string data;
+    uint32_t id = 0;
+    state.setBytesPerIteration(RECORD_SIZE);
+    while (state.keepRunning())
+    {
+        // stride through the table so consecutive reads do not share a page
+        t.table->get(id, &data);
+        id = (id + 7919) % TABLE_RECORDS;
+    }
+    mt::bench::doNotOptimize(data.data());
+}
+
+#endif
@@ -0,0 +1,152 @@
+/**
+ * (c) 2019 by Mega Limited, Wellsford, New Zealand
+ *
+ * This file is part of the MEGA SDK - Client Access Engine.
+ *
+ * Applications using the MEGA API must present a valid application key
+ * and comply with the the rules set forth in the Terms of Service.
+ *
+ * The MEGA SDK is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.
+ *
+ * @copyright Simplified (2-clause) BSD License.
+ *
+ * You should have received a copy of the license along with this
+ * program.
+ */
+
+#include <mega.h>
+
+#include "bench.h"
+#include "inputs.h"
+
+using mega::nameid;   // for MAKENAMEID2
+
+namespace {
+
+const size_t BASE64_BUFFER = 1024;
+const unsigned FETCHNODES_NODES = 10000;
+
+} // anonymous
+
+MEGA_BENCHMARK(Base64_btoa_1KiB)
+{
+    const std::string in = mt::bench::referenceBytes(BASE64_BUFFER);
+    std::string out;
+    state.setBytesPerIteration(in.size());
+    while (state.keepRunning())
+    {
+        out.clear();
+        mega::Base64::btoa(in, out);
+    }
+    mt::bench::doNotOptimize(out.data());
+}
+
+MEGA_BENCHMARK(Base64_atob_1KiB)
+{
+    const std::string in = mega::Base64::btoa(mt::bench::referenceBytes(BASE64_BUFFER));
+    std::string out;
+    state.setBytesPerIteration(in.size());
+    while (state.keepRunning())
+    {
+        out.clear();
+        mega::Base64::atob(in, out);
+    }
+    mt::bench::doNotOptimize(out.data());
+}
+
+// node handles are encoded and decoded on every command and action packet
+MEGA_BENCHMARK(Base64Str_handle)
+{
+    mega::handle h = 0x0000123456789abc;
+    state.setItemsPerIteration(1);
+    while (state.keepRunning())
+    {
+        mega::Base64Str<mega::MegaClient::NODEHANDLE> s(h);
+        mt::bench::doNotOptimize(s.chars);
+        h++;
+    }
+}
+
+// tokenizes the `f` array of a fetchnodes response the way MegaClient::readnodes does
+MEGA_BENCHMARK(JSON_parse_fetchnodes_10k)
+{
+    const std::string response = mt::bench::referenceFetchNodesResponse(FETCHNODES_NODES);
+    state.setBytesPerIteration(response.size());
+    state.setItemsPerIteration(FETCHNODES_NODES);
+    while (state.keepRunning())
+    {
+        mega::JSON j;
+        j.begin(response.c_str());
+        j.enterarray();
+
+        m_off_t total = 0;
+        while (j.enterobject())
+        {
+            mega::handle h = mega::UNDEF, ph = mega::UNDEF, u = 0;
+            const char* a = nullptr;
+            const char* k = nullptr;
+            const char* fa = nullptr;
+            m_off_t s = 0, ts = 0;
+            int t = -1;
+
+            for (mega::nameid name; (name = j.getnameid()) != EOO; )
+            {
+                switch (name)
+                {
+                    case 'h': h = j.gethandle(); break;
+                    case 'p': ph = j.gethandle(); break;
+                    case 'u': u = j.gethandle(mega::MegaClient::USERHANDLE); break;
+                    case 't': t = int(j.getint()); break;
+                    case 'a': a = j.getvalue(); break;
+                    case 'k': k = j.getvalue(); break;
+                    case 's': s = j.getint(); break;
+                    case MAKENAMEID2('t', 's'): ts = j.getint(); break;
+                    case MAKENAMEID2('f', 'a'): fa = j.getvalue(); break;
+                    default: j.storeobject(); break;
+                }
+            }
+            j.leaveobject();
+
+            total += m_off_t(h ^ ph ^ u) + t + s + ts + (a != nullptr) + (k != nullptr) + (fa != nullptr);
+        }
+        j.leavearray();
+        mt::bench::doNotOptimize(&total);
+    }
+}
+
+// the attribute map of a file with a name, fingerprint and a couple of app attributes
+MEGA_BENCHMARK(AttrMap_serialize)
+{
+    mega::AttrMap attrs;
+    attrs.map['n'] = mt::bench::referenceText(40);
+    attrs.map['c'] = mega::Base64::btoa(mt::bench::referenceBytes(24));
+    attrs.map[mega::AttrMap::string2nameid("lbl")] = "3";
+    attrs.map[mega::AttrMap::string2nameid("fav")] = "1";
+    std::string out;
+    while (state.keepRunning())
+    {
+        out.clear();
+        attrs.serialize(&out);
+    }
+    state.setBytesPerIteration(out.size());
+    mt::bench::doNotOptimize(out.data());
+}
+
+MEGA_BENCHMARK(AttrMap_getjson)
+{
+    mega::AttrMap attrs;
+    attrs.map['n'] = mt::bench::referenceText(40);
+    attrs.map['c'] = mega::Base64::btoa(mt::bench::referenceBytes(24));
+    attrs.map[mega::AttrMap::string2nameid("lbl")] = "3";
+    attrs.map[mega::AttrMap::string2nameid("fav")] = "1";
+    std::string out;
+    while (state.keepRunning())
+    {
+        out.clear();
+        attrs.getjson(&out);
+    }
+    state.setBytesPerIteration(out.size());
+    mt::bench::doNotOptimize(out.data());
+}
@@ -0,0 +1,152 @@
+/**
+ * (c) 2019 by Mega Limited, Wellsford, New Zealand
+ *
+ * This file is part of the MEGA SDK - Client Access Engine.
+ *
+ * Applications using the MEGA API must present a valid application key
+ * and comply with the the rules set forth in the Terms of Service.
+ *
+ * The MEGA SDK is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.
+ *
+ * @copyright Simplified (2-clause) BSD License.
+ *
+ * You should have received a copy of the license along with this
+ * program.
+ */
+
+#include <mega.h>
+#include <megaapi_impl.h>
+
+#include "../unit/DefaultedFileAccess.h"
+#include "bench.h"
+#include "inputs.h"
+
+namespace {
+
+struct HttpIo : mega::HttpIO
+{
+    void addevents(mega::Waiter*, int) override {}
+    void post(struct mega::HttpReq*, const char* = NULL, unsigned = 0) override {}
+    void cancel(mega::HttpReq*) override {}
+    m_off_t postpos(void*) override { return {}; }
+    bool doio(void) override { return {}; }
+    void setuseragent(std::string*) override {}
+};
+
+// a logged out client that only holds nodes
+struct Client
+{
+    mega::MegaApp app;
+    HttpIo httpio;
+    mega::MegaFileSystemAccess fs;
+    std::unique_ptr<mega::MegaClient> cli{new mega::MegaClient(&app, nullptr, &httpio, &fs, nullptr, nullptr, "XXX", "benchmark")};
+};
+
+// a file node as found in a typical account: named, fingerprinted, with thumbnail and preview
+mega::Node& makeFileNode(mega::MegaClient& client, mega::handle h, mega::handle parent)
+{
+    mega::node_vector dp;
+    auto n = new mega::Node(&client, &dp, h, parent, mega::FILENODE, 123456789, 0x1234, "123:0*AAAAAAAAAAA/456:1*BBBBBBBBBBB", 1500000000); // owned by the client
+    n->setkey(mt::bench::referenceFileKey());
+    n->attrs.map['n'] = mt::bench::referenceText(32) + ".jpg";
+    n->attrs.map['c'] = mega::Base64::btoa(mt::bench::referenceBytes(24));
+    n->setfingerprint();
+    return *n;
+}
+
+// serves a fixed content buffer as if it were a file on disk
+class MemoryFileAccess : public mt::DefaultedFileAccess
+{
+public:
+    MemoryFileAccess(std::string content)
+        : mContent(std::move(content))
+    {
+        size = m_off_t(mContent.size());
+        mtime = 1500000000;
+    }
+
+    bool sysstat(mega::m_time_t* curr_mtime, m_off_t* curr_size) override
+    {
+        *curr_mtime = mtime;
+        *curr_size = size;
+        return true;
+    }
+
+    bool sysopen(bool) override
+    {
+        return true;
+    }
+
+    bool sysread(mega::byte* buffer, unsigned len, m_off_t offset) override
+    {
+        memcpy(buffer, mContent.data() + offset, len);
+        return true;
+    }
+
+    void sysclose() override
+    {
+    }
+
+private:
+    const std::string mContent;
+};
+
+} // anonymous
+
+MEGA_BENCHMARK(Node_serialize)
+{
+    Client client;
+    mega::Node& n = makeFileNode(*client.cli, 42, 43);
+    std::string data;
+    while (state.keepRunning())
+    {
+        data.clear();
+        n.serialize(&data);
+    }
+    state.setBytesPerIteration(data.size());
+    mt::bench::doNotOptimize(data.data());
+}
+
+MEGA_BENCHMARK(Node_unserialize)
+{
+    Client client;
+    std::string data;
+    makeFileNode(*client.cli, 42, 43).serialize(&data);
+    mega::node_vector dp;
+    state.setBytesPerIteration(data.size());
+    while (state.keepRunning())
+    {
+        mega::Node* n = mega::Node::unserialize(client.cli.get(), &data, &dp);
+
+        state.pauseTiming();
+        client.cli->nodes.erase(n->nodehandle);
+        delete n;
+        dp.clear();
+        state.resumeTiming();
+    }
+}
+
+// files up to 8 KiB are hashed whole, larger ones are sampled
+MEGA_BENCHMARK(FileFingerprint_genfingerprint_4KiB)
+{
+    MemoryFileAccess fa(mt::bench::referenceBytes(4 << 10));
+    mega::FileFingerprint ffp;
+    while (state.keepRunning())
+    {
+        ffp.genfingerprint(&fa);
+    }
+    mt::bench::doNotOptimize(ffp.crc.data());
+}
+
+MEGA_BENCHMARK(FileFingerprint_genfingerprint_16MiB)
+{
+    MemoryFileAccess fa(mt::bench::referenceBytes(16 << 20));
+    mega::FileFingerprint ffp;
+    while (state.keepRunning())
+    {
+        ffp.genfingerprint(&fa);
+    }
+    mt::bench::doNotOptimize(ffp.crc.data());
+}
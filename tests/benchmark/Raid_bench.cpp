@@ -0,0 +1,105 @@
+/**
+ * (c) 2019 by Mega Limited, Wellsford, New Zealand
+ *
+ * This file is part of the MEGA SDK - Client Access Engine.
+ *
+ * Applications using the MEGA API must present a valid application key
+ * and comply with the the rules set forth in the Terms of Service.
+ *
+ * The MEGA SDK is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.
+ *
+ * @copyright Simplified (2-clause) BSD License.
+ *
+ * You should have received a copy of the license along with this
+ * program.
+ */
+
+#include <mega.h>
+
+#include "bench.h"
+#include "inputs.h"
+
+namespace {
+
+const m_off_t RAID_FILE = 5 << 20;  // 1 MiB per part
+
+// only combines, the decryption cost is covered by the SymmCipher benchmarks
+class PassThroughBufferManager : public mega::RaidBufferManager
+{
+    void finalize(FilePiece&) override {}
+    m_off_t calcOutputChunkPos(m_off_t acquiredpos) override { return acquiredpos; }
+};
+
+// the six parts of a cloudraid file: parity first, then the data sectors round robin
+std::vector<std::string> referenceRaidParts(const std::string& file)
+{
+    assert(file.size() % mega::RAIDLINE == 0);
+    std::vector<std::string> parts(mega::RAIDPARTS);
+    for (size_t line = 0; line < file.size(); line += mega::RAIDLINE)
+    {
+        std::string parity(mega::RAIDSECTOR, '\0');
+        for (unsigned p = 1; p < mega::RAIDPARTS; p++)
+        {
+            const char* sector = file.data() + line + (p - 1) * mega::RAIDSECTOR;
+            parts[p].append(sector, mega::RAIDSECTOR);
+            for (unsigned i = mega::RAIDSECTOR; i--; )
+            {
+                parity[i] ^= sector[i];
+            }
+        }
+        parts[0] += parity;
+    }
+    return parts;
+}
+
+void combine(mt::bench::State& state, unsigned missingPart)
+{
+    const std::vector<std::string> parts = referenceRaidParts(mt::bench::referenceBytes(size_t(RAID_FILE)));
+    const std::vector<std::string> urls(mega::RAIDPARTS, "http://localhost/");
+    state.setBytesPerIteration(RAID_FILE);
+
+    while (state.keepRunning())
+    {
+        state.pauseTiming();
+        PassThroughBufferManager rbm;
+        rbm.setIsRaid(urls, 0, RAID_FILE, RAID_FILE, RAID_FILE);
+        for (unsigned i = 0; i < mega::RAIDPARTS; i++)
+        {
+            if (i == missingPart)
+            {
+                rbm.submitBuffer(i, new mega::RaidBufferManager::FilePiece(0, new mega::HttpReq::http_buf_t(NULL, 0, parts[i].size())));
+            }
+            else
+            {
+                auto piece = new mega::RaidBufferManager::FilePiece(0, parts[i].size());
+                memcpy(piece->buf.datastart(), parts[i].data(), parts[i].size());
+                rbm.submitBuffer(i, piece);
+            }
+        }
+        state.resumeTiming();
+
+        mega::RaidBufferManager::FilePiece* output = rbm.getAsyncOutputBufferPointer(0);
+        mt::bench::doNotOptimize(output);
+        assert(output && m_off_t(output->buf.datalen()) == RAID_FILE);
+
+        state.pauseTiming();
+        rbm.bufferWriteCompleted(0, true);
+        state.resumeTiming();
+    }
+}
+
+} // anonymous
+
+// all six connections delivered: plain interleave
+MEGA_BENCHMARK(RaidBufferManager_combineRaidParts_6of6)
+{
+    combine(state, mega::RAIDPARTS);
+}
+
+// one data part missing: every fifth sector is recovered from parity
+MEGA_BENCHMARK(RaidBufferManager_combineRaidParts_5of6)
+{
+    combine(state, 1);
+}
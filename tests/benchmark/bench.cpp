@@ -0,0 +1,104 @@
+/**
+ * @file bench.cpp
+ * @brief Minimal micro-benchmark harness
+ *
+ * (c) 2013-2019 by Mega Limited, Auckland, New Zealand
+ *
+ * This file is part of the MEGA SDK - Client Access Engine.
+ *
+ * Applications using the MEGA API must present a valid application key
+ * and comply with the the rules set forth in the Terms of Service.
+ *
+ * The MEGA SDK is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.
+ *
+ * @copyright Simplified (2-clause) BSD License.
+ *
+ * You should have received a copy of the license along with this
+ * program.
+ */
+
+#include "bench.h"
+
+#include <algorithm>
+#include <atomic>
+
+namespace mt {
+namespace bench {
+
+State::State(uint64_t iterations)
+    : mIterations(iterations)
+    , mRemaining(iterations)
+{
+}
+
+void State::pauseTiming()
+{
+    mElapsed += std::chrono::steady_clock::now() - mStart;
+}
+
+void State::resumeTiming()
+{
+    mStart = std::chrono::steady_clock::now();
+}
+
+std::vector<Benchmark>& registry()
+{
+    static std::vector<Benchmark> benchmarks;
+    return benchmarks;
+}
+
+Registrar::Registrar(const char* name, Function function)
+{
+    registry().push_back(Benchmark{name, std::move(function)});
+}
+
+Result run(const Benchmark& b, double minSeconds, unsigned repetitions)
+{
+    // find an iteration count that runs for long enough to be timed reliably
+    uint64_t iterations = 1;
+    for (;;)
+    {
+        State state(iterations);
+        b.function(state);
+        double seconds = state.seconds();
+        if (seconds >= minSeconds || iterations >= (uint64_t(1) << 40))
+        {
+            break;
+        }
+
+        // aim a little past minSeconds, but never grow more than 10x per step
+        double factor = seconds > 0 ? minSeconds * 1.4 / seconds : 10;
+        iterations = std::max<uint64_t>(iterations + 1, uint64_t(iterations * std::min(factor, 10.0)));
+    }
+
+    Result best;
+    best.name = b.name;
+    for (unsigned i = std::max(repetitions, 1u); i--; )
+    {
+        State state(iterations);
+        b.function(state);
+        double seconds = state.seconds();
+        double ns = seconds * 1e9 / double(state.iterations());
+
+        if (!best.iterations || ns < best.nsPerIteration)
+        {
+            best.iterations = state.iterations();
+            best.nsPerIteration = ns;
+            best.bytesPerSecond = seconds > 0 ? double(state.bytesPerIteration() * state.iterations()) / seconds : 0;
+            best.itemsPerSecond = seconds > 0 ? double(state.itemsPerIteration() * state.iterations()) / seconds : 0;
+        }
+    }
+    return best;
+}
+
+void doNotOptimize(const void* p)
+{
+    // an opaque store the optimizer cannot prove dead
+    static std::atomic<const void*> sink{nullptr};
+    sink.store(p, std::memory_order_relaxed);
+}
+
+} // bench
+} // mt
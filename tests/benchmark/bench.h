@@ -0,0 +1,115 @@
+/**
+ * @file bench.h
+ * @brief Minimal micro-benchmark harness
+ *
+ * (c) 2013-2019 by Mega Limited, Auckland, New Zealand
+ *
+ * This file is part of the MEGA SDK - Client Access Engine.
+ *
+ * Applications using the MEGA API must present a valid application key
+ * and comply with the the rules set forth in the Terms of Service.
+ *
+ * The MEGA SDK is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.
+ *
+ * @copyright Simplified (2-clause) BSD License.
+ *
+ * You should have received a copy of the license along with this
+ * program.
+ */
+
+#pragma once
+
+#include <chrono>
+#include <cstdint>
+#include <functional>
+#include <string>
+#include <vector>
+
+namespace mt {
+namespace bench {
+
+// Passed to every benchmark body.  The body does its setup, then loops with
+// `while (state.keepRunning())` around the code being measured.  Only the
+// time spent inside that loop is counted.
+class State
+{
+public:
+    explicit State(uint64_t iterations);
+
+    bool keepRunning()
+    {
+        if (mRemaining == mIterations)
+        {
+            mStart = std::chrono::steady_clock::now();
+        }
+        if (mRemaining)
+        {
+            mRemaining--;
+            return true;
+        }
+        mElapsed += std::chrono::steady_clock::now() - mStart;
+        return false;
+    }
+
+    // exclude per-iteration bookkeeping (e.g. freeing results) from the measurement
+    void pauseTiming();
+    void resumeTiming();
+
+    // payload handled by a single iteration, for MB/s and items/s reporting
+    void setBytesPerIteration(uint64_t bytes) { mBytes = bytes; }
+    void setItemsPerIteration(uint64_t items) { mItems = items; }
+
+    uint64_t iterations() const { return mIterations; }
+    uint64_t bytesPerIteration() const { return mBytes; }
+    uint64_t itemsPerIteration() const { return mItems; }
+    double seconds() const { return std::chrono::duration<double>(mElapsed).count(); }
+
+private:
+    uint64_t mIterations;
+    uint64_t mRemaining;
+    uint64_t mBytes = 0;
+    uint64_t mItems = 0;
+    std::chrono::steady_clock::time_point mStart;
+    std::chrono::steady_clock::duration mElapsed{};
+};
+
+typedef std::function<void(State&)> Function;
+
+struct Benchmark
+{
+    std::string name;
+    Function function;
+};
+
+std::vector<Benchmark>& registry();
+
+struct Registrar
+{
+    Registrar(const char* name, Function function);
+};
+
+struct Result
+{
+    std::string name;
+    uint64_t iterations = 0;
+    double nsPerIteration = 0;
+    double bytesPerSecond = 0;
+    double itemsPerSecond = 0;
+};
+
+// Runs `b` with a growing iteration count until one run lasts at least
+// `minSeconds`, then repeats that run `repetitions` times and keeps the fastest.
+Result run(const Benchmark& b, double minSeconds, unsigned repetitions);
+
+// Stops the compiler from discarding a computation whose result is unused.
+void doNotOptimize(const void* p);
+
+} // bench
+} // mt
+
+#define MEGA_BENCHMARK(name) \
+    static void name(::mt::bench::State&); \
+    static ::mt::bench::Registrar name##_registrar{#name, name}; \
+    static void name(::mt::bench::State& state)
@@ -0,0 +1,108 @@
+/**
+ * @file inputs.cpp
+ * @brief Reference inputs shared by the micro-benchmarks
+ *
+ * (c) 2013-2019 by Mega Limited, Auckland, New Zealand
+ *
+ * This file is part of the MEGA SDK - Client Access Engine.
+ *
+ * Applications using the MEGA API must present a valid application key
+ * and comply with the the rules set forth in the Terms of Service.
+ *
+ * The MEGA SDK is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.
+ *
+ * @copyright Simplified (2-clause) BSD License.
+ *
+ * You should have received a copy of the license along with this
+ * program.
+ */
+
+#include "inputs.h"
+
+#include <random>
+
+namespace mt {
+namespace bench {
+
+std::string referenceBytes(size_t len, unsigned seed)
+{
+    std::mt19937 rng(seed);
+    std::string s(len, '\0');
+    for (char& c : s)
+    {
+        c = char(rng());
+    }
+    return s;
+}
+
+const mega::byte* referenceKey()
+{
+    static const mega::byte key[mega::SymmCipher::KEYLENGTH] = {
+        0x6d, 0x65, 0x67, 0x61, 0x2d, 0x62, 0x65, 0x6e, 0x63, 0x68, 0x2d, 0x6b, 0x65, 0x79, 0x2d, 0x31
+    };
+    return key;
+}
+
+const mega::byte* referenceFileKey()
+{
+    static const std::string key = referenceBytes(mega::FILENODEKEYLENGTH, 2);
+    return reinterpret_cast<const mega::byte*>(key.data());
+}
+
+std::string referenceText(size_t len, unsigned seed)
+{
+    static const char chars[] = "abcdefghijklmnopqrstuvwxyzABCDEFGHIJKLMNOPQRSTUVWXYZ0123456789 _-.";
+    std::mt19937 rng(seed);
+    std::string s(len, ' ');
+    for (char& c : s)
+    {
+        c = chars[rng() % (sizeof chars - 1)];
+    }
+    return s;
+}
+
+std::string referenceFetchNodesResponse(unsigned nodes)
+{
+    std::mt19937 rng(3);
+    std::string f = "[";
+    std::vector<mega::handle> folders;
+
+    for (unsigned i = 0; i < nodes; i++)
+    {
+        bool folder = !(i % 10);
+        mega::handle h = i + 1;
+        mega::handle p = folders.empty() ? mega::handle(0x4242) : folders[rng() % folders.size()];
+
+        // attributes and keys are opaque to the JSON parser, so random base64 of the usual length is enough
+        std::string attr = mega::Base64::btoa(referenceBytes(folder ? 48 : 64, i));
+        std::string key = mega::Base64::btoa(referenceBytes(folder ? mega::FOLDERNODEKEYLENGTH : mega::FILENODEKEYLENGTH, i + 7));
+
+        if (i)
+        {
+            f += ',';
+        }
+        f += "{\"h\":\"" + std::string(mega::Base64Str<mega::MegaClient::NODEHANDLE>(h)) + "\""
+           + ",\"p\":\"" + std::string(mega::Base64Str<mega::MegaClient::NODEHANDLE>(p)) + "\""
+           + ",\"u\":\"" + std::string(mega::Base64Str<mega::MegaClient::USERHANDLE>(mega::handle(0x1234))) + "\""
+           + ",\"t\":" + (folder ? "1" : "0")
+           + ",\"a\":\"" + attr + "\""
+           + ",\"k\":\"" + std::string(mega::Base64Str<mega::MegaClient::USERHANDLE>(mega::handle(0x1234))) + ":" + key + "\"";
+        if (!folder)
+        {
+            f += ",\"s\":" + std::to_string(rng() % (64 << 20));
+            f += ",\"fa\":\"" + std::to_string(rng() % 1000) + ":0*" + mega::Base64::btoa(referenceBytes(8, i + 13)) + "\"";
+        }
+        f += ",\"ts\":" + std::to_string(1500000000 + i) + "}";
+
+        if (folder)
+        {
+            folders.push_back(h);
+        }
+    }
+    return f + "]";
+}
+
+} // bench
+} // mt
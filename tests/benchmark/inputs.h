@@ -0,0 +1,50 @@
+/**
+ * @file inputs.h
+ * @brief Reference inputs shared by the micro-benchmarks
+ *
+ * (c) 2013-2019 by Mega Limited, Auckland, New Zealand
+ *
+ * This file is part of the MEGA SDK - Client Access Engine.
+ *
+ * Applications using the MEGA API must present a valid application key
+ * and comply with the the rules set forth in the Terms of Service.
+ *
+ * The MEGA SDK is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.
+ *
+ * @copyright Simplified (2-clause) BSD License.
+ *
+ * You should have received a copy of the license along with this
+ * program.
+ */
+
+#pragma once
+
+#include <mega.h>
+
+#include <string>
+
+// All inputs are generated from fixed seeds, so every run (and every machine)
+// measures exactly the same data.  Change a seed or a size and old baselines
+// are no longer comparable.
+namespace mt {
+namespace bench {
+
+// `len` pseudo-random bytes
+std::string referenceBytes(size_t len, unsigned seed = 1);
+
+// a fixed 128-bit key for SymmCipher
+const mega::byte* referenceKey();
+
+// a fixed file key layout: 128-bit key, 64-bit ctr IV, 64-bit meta-MAC
+const mega::byte* referenceFileKey();
+
+// printable text of `len` bytes, as found in file names and attributes
+std::string referenceText(size_t len, unsigned seed = 1);
+
+// the `f` array of a fetchnodes response with `nodes` nodes, a tenth of them folders
+std::string referenceFetchNodesResponse(unsigned nodes);
+
+} // bench
+} // mt
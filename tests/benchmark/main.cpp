@@ -0,0 +1,189 @@
+/**
+ * @file main.cpp
+ * @brief Runs the micro-benchmarks and compares them against a baseline
+ *
+ * (c) 2013-2019 by Mega Limited, Auckland, New Zealand
+ *
+ * This file is part of the MEGA SDK - Client Access Engine.
+ *
+ * Applications using the MEGA API must present a valid application key
+ * and comply with the the rules set forth in the Terms of Service.
+ *
+ * The MEGA SDK is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.
+ *
+ * @copyright Simplified (2-clause) BSD License.
+ *
+ * You should have received a copy of the license along with this
+ * program.
+ */
+
+#include "bench.h"
+
+#include <mega.h>
+
+#include <cstdio>
+#include <fstream>
+#include <iostream>
+#include <map>
+#include <sstream>
+
+using std::string;
+using std::cout;
+using std::cerr;
+using std::endl;
+
+namespace {
+
+struct Options
+{
+    string filter;
+    double minSeconds = 0.5;
+    unsigned repetitions = 3;
+    string json;
+    string baseline;
+    double tolerance = 10;
+    bool list = false;
+};
+
+void usage(const char* argv0)
+{
+    cerr << "Usage: " << argv0 << " [options]\n"
+         << "  --filter TEXT       only run benchmarks whose name contains TEXT\n"
+         << "  --min-time SECONDS  minimum duration of one timed run (default 0.5)\n"
+         << "  --repetitions N     timed runs per benchmark, the fastest is kept (default 3)\n"
+         << "  --json FILE         write ns per iteration of every benchmark as JSON\n"
+         << "  --baseline FILE     compare against a previous --json run, fail on regressions\n"
+         << "  --tolerance PCT     allowed slowdown against the baseline (default 10)\n"
+         << "  --list              print the benchmark names and exit\n";
+}
+
+bool parseArgs(int argc, char** argv, Options& o)
+{
+    for (int i = 1; i < argc; i++)
+    {
+        string a = argv[i];
+        auto next = [&]() -> const char* { return i + 1 < argc ? argv[++i] : ""; };
+
+        if (a == "--filter") o.filter = next();
+        else if (a == "--min-time") o.minSeconds = atof(next());
+        else if (a == "--repetitions") o.repetitions = unsigned(atoi(next()));
+        else if (a == "--json") o.json = next();
+        else if (a == "--baseline") o.baseline = next();
+        else if (a == "--tolerance") o.tolerance = atof(next());
+        else if (a == "--list") o.list = true;
+        else return false;
+    }
+    return o.minSeconds > 0;
+}
+
+string humanRate(double perSecond, const char* unit)
+{
+    char buf[64];
+    if (perSecond >= 1e9) snprintf(buf, sizeof buf, "%.2f G%s/s", perSecond / 1e9, unit);
+    else if (perSecond >= 1e6) snprintf(buf, sizeof buf, "%.2f M%s/s", perSecond / 1e6, unit);
+    else if (perSecond >= 1e3) snprintf(buf, sizeof buf, "%.2f k%s/s", perSecond / 1e3, unit);
+    else snprintf(buf, sizeof buf, "%.2f %s/s", perSecond, unit);
+    return buf;
+}
+
+// returns the number of benchmarks that got slower than the tolerance allows
+int compareBaseline(const string& file, const std::vector<mt::bench::Result>& results, double tolerance)
+{
+    std::ifstream in(file);
+    string text((std::istreambuf_iterator<char>(in)), std::istreambuf_iterator<char>());
+    if (text.empty())
+    {
+        cerr << "Cannot read baseline " << file << endl;
+        return 1;
+    }
+
+    std::map<string, double> base;
+    mega::JSON json;
+    json.begin(text.c_str());
+    json.enterobject();
+    for (string name; !(name = json.getname()).empty(); )
+    {
+        base[name] = json.getfloat();
+    }
+
+    int regressions = 0;
+    for (const auto& r : results)
+    {
+        auto it = base.find(r.name);
+        if (it == base.end() || it->second <= 0)
+        {
+            continue;
+        }
+
+        double change = (r.nsPerIteration - it->second) / it->second * 100;
+        bool regressed = change > tolerance;
+        printf("  %-40s %12.1f -> %12.1f ns (%+.1f%%)%s\n", r.name.c_str(), it->second, r.nsPerIteration,
+               change, regressed ? "  REGRESSION" : "");
+        regressions += regressed;
+    }
+    return regressions;
+}
+
+} // anonymous
+
+int main(int argc, char** argv)
+{
+    Options o;
+    if (!parseArgs(argc, argv, o))
+    {
+        usage(argv[0]);
+        return 1;
+    }
+
+    mega::SimpleLogger::setLogLevel(mega::logError);
+
+    std::vector<mt::bench::Result> results;
+    for (const auto& b : mt::bench::registry())
+    {
+        if (!o.filter.empty() && b.name.find(o.filter) == string::npos)
+        {
+            continue;
+        }
+        if (o.list)
+        {
+            cout << b.name << endl;
+            continue;
+        }
+
+        mt::bench::Result r = mt::bench::run(b, o.minSeconds, o.repetitions);
+        printf("%-40s %12.1f ns %12llu iter", r.name.c_str(), r.nsPerIteration, (unsigned long long)r.iterations);
+        if (r.bytesPerSecond > 0)
+        {
+            printf("  %14s", humanRate(r.bytesPerSecond, "B").c_str());
+        }
+        if (r.itemsPerSecond > 0)
+        {
+            printf("  %14s", humanRate(r.itemsPerSecond, "item").c_str());
+        }
+        printf("\n");
+        fflush(stdout);
+        results.push_back(r);
+    }
+
+    if (!o.json.empty())
+    {
+        std::ostringstream s;
+        s << "{";
+        for (size_t i = 0; i < results.size(); i++)
+        {
+            s << (i ? "," : "") << "\n\"" << results[i].name << "\":" << results[i].nsPerIteration;
+        }
+        s << "\n}\n";
+        std::ofstream(o.json) << s.str();
+    }
+
+    int regressions = 0;
+    if (!o.baseline.empty())
+    {
+        cout << "Comparing with " << o.baseline << " (tolerance " << o.tolerance << "%):" << endl;
+        regressions = compareBaseline(o.baseline, results, o.tolerance);
+    }
+    return regressions ? 2 : 0;
+}
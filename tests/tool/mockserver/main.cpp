@@ -0,0 +1,407 @@
+/**
+ * @file main.cpp
+ * @brief End-to-end transfer and fetchnodes benchmark against the offline mock server
+ *
+ * (c) 2013-2019 by Mega Limited, Auckland, New Zealand
+ *
+ * This file is part of the MEGA SDK - Client Access Engine.
+ *
+ * Applications using the MEGA API must present a valid application key
+ * and comply with the the rules set forth in the Terms of Service.
+ *
+ * The MEGA SDK is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.
+ *
+ * @copyright Simplified (2-clause) BSD License.
+ *
+ * You should have received a copy of the license along with this
+ * program.
+ */
+
+#include "mockserver.h"
+#include "megaapi.h"
+
+#include <sys/resource.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include <condition_variable>
+#include <fstream>
+#include <iostream>
+#include <random>
+#include <sstream>
+
+using namespace mega;
+using std::string;
+using std::cout;
+using std::cerr;
+using std::endl;
+
+static const char* APP_KEY = "MockBnch";
+
+namespace {
+
+struct Results
+{
+    double fetchnodesSeconds = 0;
+    size_t nodes = 0;
+    double downloadMBps = 0;
+    double downloadCpuSecondsPerGB = 0;
+    double uploadMBps = 0;
+    double uploadCpuSecondsPerGB = 0;
+};
+
+double processCpuSeconds()
+{
+    rusage ru;
+    getrusage(RUSAGE_SELF, &ru);
+    return double(ru.ru_utime.tv_sec + ru.ru_stime.tv_sec) + double(ru.ru_utime.tv_usec + ru.ru_stime.tv_usec) / 1e6;
+}
+
+double wallSeconds()
+{
+    return std::chrono::duration<double>(std::chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+// counts finished transfers started with it as listener
+class BatchTransferListener : public MegaTransferListener
+{
+public:
+    void onTransferFinish(MegaApi*, MegaTransfer* transfer, MegaError* e) override
+    {
+        std::lock_guard<std::mutex> g(mMutex);
+        if (e->getErrorCode() != API_OK)
+        {
+            mErrors++;
+        }
+        else
+        {
+            mBytes += uint64_t(transfer->getTransferredBytes());
+        }
+        mFinished++;
+        mCv.notify_all();
+    }
+
+    void waitFor(unsigned count)
+    {
+        std::unique_lock<std::mutex> g(mMutex);
+        mCv.wait(g, [this, count]() { return mFinished >= count; });
+    }
+
+    unsigned errors() const { return mErrors; }
+    uint64_t bytes() const { return mBytes; }
+
+private:
+    std::mutex mMutex;
+    std::condition_variable mCv;
+    unsigned mFinished = 0;
+    unsigned mErrors = 0;
+    uint64_t mBytes = 0;
+};
+
+struct Options
+{
+    mt::MockServer::Config server;
+    unsigned downloads = 8;
+    unsigned uploads = 2;
+    m_off_t uploadSize = 16 << 20;
+    string json;
+    string baseline;
+    double tolerance = 15;
+    bool serveOnly = false;
+    unsigned short port = 0;
+};
+
+void usage(const char* argv0)
+{
+    cerr << "Usage: " << argv0 << " [options]\n"
+         << "  --nodes N           nodes in the synthetic folder (default 10000)\n"
+         << "  --depth N           folder depth (default 4)\n"
+         << "  --fanout N          subfolders per folder (default 8)\n"
+         << "  --filesize BYTES    size of every synthetic file (default 4 MiB)\n"
+         << "  --latency MS        delay added to every response (default 0)\n"
+         << "  --bandwidth BYTES/S server bandwidth cap, 0 = unlimited (default 0)\n"
+         << "  --downloads N       files to download (default 8)\n"
+         << "  --uploads N         files to upload (default 2)\n"
+         << "  --uploadsize BYTES  size of every uploaded file (default 16 MiB)\n"
+         << "  --json FILE         write results as JSON\n"
+         << "  --baseline FILE     compare against a previous --json run, fail on regressions\n"
+         << "  --tolerance PCT     allowed regression against the baseline (default 15)\n"
+         << "  --serve [PORT]      only run the server and print the API URL and folder link\n";
+}
+
+bool parseArgs(int argc, char** argv, Options& o)
+{
+    for (int i = 1; i < argc; i++)
+    {
+        string a = argv[i];
+        auto next = [&]() -> const char* { return i + 1 < argc ? argv[++i] : "0"; };
+
+        if (a == "--nodes") o.server.nodes = unsigned(atoi(next()));
+        else if (a == "--depth") o.server.depth = unsigned(atoi(next()));
+        else if (a == "--fanout") o.server.fanout = unsigned(atoi(next()));
+        else if (a == "--filesize") o.server.fileSize = atoll(next());
+        else if (a == "--latency") o.server.latencyMs = unsigned(atoi(next()));
+        else if (a == "--bandwidth") o.server.bandwidth = atoll(next());
+        else if (a == "--downloads") o.downloads = unsigned(atoi(next()));
+        else if (a == "--uploads") o.uploads = unsigned(atoi(next()));
+        else if (a == "--uploadsize") o.uploadSize = atoll(next());
+        else if (a == "--json") o.json = next();
+        else if (a == "--baseline") o.baseline = next();
+        else if (a == "--tolerance") o.tolerance = atof(next());
+        else if (a == "--serve")
+        {
+            o.serveOnly = true;
+            if (i + 1 < argc && argv[i + 1][0] != '-')
+            {
+                o.port = (unsigned short)atoi(argv[++i]);
+            }
+        }
+        else
+        {
+            return false;
+        }
+    }
+    return o.server.nodes > 0 && o.server.fileSize > 0;
+}
+
+string toJson(const Options& o, const Results& r)
+{
+    std::ostringstream s;
+    s << "{\"nodes\":" << r.nodes
+      << ",\"filesize\":" << o.server.fileSize
+      << ",\"latencyms\":" << o.server.latencyMs
+      << ",\"fetchnodes_s\":" << r.fetchnodesSeconds
+      << ",\"download_mbps\":" << r.downloadMBps
+      << ",\"download_cpu_s_per_gb\":" << r.downloadCpuSecondsPerGB
+      << ",\"upload_mbps\":" << r.uploadMBps
+      << ",\"upload_cpu_s_per_gb\":" << r.uploadCpuSecondsPerGB
+      << "}";
+    return s.str();
+}
+
+// returns the number of metrics that regressed beyond the tolerance
+int compareBaseline(const string& file, const Results& r, double tolerance)
+{
+    std::ifstream in(file);
+    string text((std::istreambuf_iterator<char>(in)), std::istreambuf_iterator<char>());
+    if (text.empty())
+    {
+        cerr << "Cannot read baseline " << file << endl;
+        return 1;
+    }
+
+    std::map<string, double> base;
+    JSON json;
+    json.begin(text.c_str());
+    json.enterobject();
+    for (string name; !(name = json.getname()).empty(); )
+    {
+        base[name] = json.getfloat();
+    }
+
+    struct Metric { const char* name; double value; bool higherIsBetter; };
+    const Metric metrics[] = {
+        { "fetchnodes_s", r.fetchnodesSeconds, false },
+        { "download_mbps", r.downloadMBps, true },
+        { "download_cpu_s_per_gb", r.downloadCpuSecondsPerGB, false },
+        { "upload_mbps", r.uploadMBps, true },
+        { "upload_cpu_s_per_gb", r.uploadCpuSecondsPerGB, false },
+    };
+
+    int regressions = 0;
+    for (const Metric& m : metrics)
+    {
+        auto it = base.find(m.name);
+        if (it == base.end() || it->second <= 0 || m.value <= 0)
+        {
+            continue;
+        }
+
+        double change = (m.value - it->second) / it->second * 100;
+        bool regressed = m.higherIsBetter ? change < -tolerance : change > tolerance;
+        cout << "  " << m.name << ": " << it->second << " -> " << m.value
+             << " (" << (change >= 0 ? "+" : "") << change << "%)" << (regressed ? "  REGRESSION" : "") << endl;
+        regressions += regressed;
+    }
+    return regressions;
+}
+
+bool makeUploadFile(const string& path, m_off_t size, unsigned seed)
+{
+    std::ofstream out(path, std::ios::binary);
+    std::mt19937 rng(seed);
+    std::vector<uint32_t> block(16384);
+    for (m_off_t written = 0; written < size; )
+    {
+        for (auto& w : block)
+        {
+            w = rng();
+        }
+        size_t n = size_t(std::min<m_off_t>(size - written, m_off_t(block.size() * sizeof(uint32_t))));
+        out.write((const char*)block.data(), std::streamsize(n));
+        written += m_off_t(n);
+    }
+    return bool(out);
+}
+
+} // namespace
+
+int main(int argc, char** argv)
+{
+    Options o;
+    if (!parseArgs(argc, argv, o))
+    {
+        usage(argv[0]);
+        return 1;
+    }
+
+    cout << "Generating synthetic folder with " << o.server.nodes << " nodes..." << endl;
+    mt::MockServer server(o.server);
+    if (!server.start(o.port))
+    {
+        cerr << "Unable to start the mock server" << endl;
+        return 1;
+    }
+
+    if (o.serveOnly)
+    {
+        cout << "API URL:     " << server.apiUrl() << endl
+             << "Folder link: " << server.folderLink() << endl
+             << "Press Enter to stop" << endl;
+        std::cin.get();
+        return 0;
+    }
+
+    char tmpl[] = "/tmp/mockbench.XXXXXX";
+    if (!mkdtemp(tmpl))
+    {
+        cerr << "Unable to create a working directory" << endl;
+        return 1;
+    }
+    string workdir = tmpl;
+
+    MegaApi::setLogLevel(MegaApi::LOG_LEVEL_ERROR);
+    MegaApi api(APP_KEY, (const char*)nullptr, "mockbench");
+    api.changeApiUrl(server.apiUrl().c_str(), true);
+
+    Results r;
+    int failures = 0;
+
+    {
+        SynchronousRequestListener login;
+        api.loginToFolder(server.folderLink().c_str(), &login);
+        login.wait();
+
+        double start = wallSeconds();
+        SynchronousRequestListener fetch;
+        api.fetchNodes(&fetch);
+        fetch.wait();
+        r.fetchnodesSeconds = wallSeconds() - start;
+
+        if (login.getError()->getErrorCode() != API_OK || fetch.getError()->getErrorCode() != API_OK)
+        {
+            cerr << "Login/fetchnodes failed against the mock server" << endl;
+            return 1;
+        }
+
+        r.nodes = o.server.nodes;
+        cout << "fetchnodes: " << r.fetchnodesSeconds << " s for " << r.nodes << " nodes" << endl;
+    }
+
+    unsigned downloads = std::min<unsigned>(o.downloads, unsigned(server.files().size()));
+    if (downloads)
+    {
+        BatchTransferListener listener;
+        double cpu = processCpuSeconds() - server.serverCpuSeconds();
+        double start = wallSeconds();
+
+        for (unsigned i = 0; i < downloads; i++)
+        {
+            std::unique_ptr<MegaNode> node(api.getNodeByHandle(server.files()[i]));
+            if (!node)
+            {
+                cerr << "Synthetic file missing from the node tree" << endl;
+                return 1;
+            }
+            string target = workdir + "/dl" + std::to_string(i);
+            api.startDownload(node.get(), target.c_str(), &listener);
+        }
+        listener.waitFor(downloads);
+
+        double elapsed = wallSeconds() - start;
+        cpu = processCpuSeconds() - server.serverCpuSeconds() - cpu;
+        double gb = double(listener.bytes()) / (1 << 30);
+
+        r.downloadMBps = double(listener.bytes()) / (1 << 20) / elapsed;
+        r.downloadCpuSecondsPerGB = gb > 0 ? cpu / gb : 0;
+        failures += int(listener.errors());
+        cout << "download: " << downloads << " files, " << r.downloadMBps << " MB/s, "
+             << r.downloadCpuSecondsPerGB << " CPU s/GB, " << listener.errors() << " errors" << endl;
+    }
+
+    if (o.uploads)
+    {
+        std::unique_ptr<MegaNode> root(api.getRootNode());
+        std::vector<string> paths;
+        for (unsigned i = 0; i < o.uploads; i++)
+        {
+            paths.push_back(workdir + "/ul" + std::to_string(i));
+            if (!makeUploadFile(paths.back(), o.uploadSize, i))
+            {
+                cerr << "Unable to create " << paths.back() << endl;
+                return 1;
+            }
+        }
+
+        BatchTransferListener listener;
+        double cpu = processCpuSeconds() - server.serverCpuSeconds();
+        double start = wallSeconds();
+
+        for (const string& path : paths)
+        {
+            api.startUpload(path.c_str(), root.get(), &listener);
+        }
+        listener.waitFor(o.uploads);
+
+        double elapsed = wallSeconds() - start;
+        cpu = processCpuSeconds() - server.serverCpuSeconds() - cpu;
+        double gb = double(listener.bytes()) / (1 << 30);
+
+        r.uploadMBps = double(listener.bytes()) / (1 << 20) / elapsed;
+        r.uploadCpuSecondsPerGB = gb > 0 ? cpu / gb : 0;
+        failures += int(listener.errors());
+        cout << "upload: " << o.uploads << " files, " << r.uploadMBps << " MB/s, "
+             << r.uploadCpuSecondsPerGB << " CPU s/GB, " << listener.errors() << " errors" << endl;
+    }
+
+    {
+        SynchronousRequestListener logout;
+        api.logout(&logout);
+        logout.wait();
+    }
+    server.stop();
+
+    string results = toJson(o, r);
+    cout << results << endl;
+    if (!o.json.empty())
+    {
+        std::ofstream(o.json) << results << endl;
+    }
+
+    int regressions = 0;
+    if (!o.baseline.empty())
+    {
+        cout << "Comparing with " << o.baseline << " (tolerance " << o.tolerance << "%):" << endl;
+        regressions = compareBaseline(o.baseline, r, o.tolerance);
+    }
+
+    string cleanup = "rm -rf " + workdir;
+    if (system(cleanup.c_str()))
+    {
+        cerr << "Unable to remove " << workdir << endl;
+    }
+
+    return failures ? 1 : (regressions ? 2 : 0);
+}
@@ -0,0 +1,666 @@
+/**
+ * @file mockserver.cpp
+ * @brief Offline stand-in for the MEGA API and storage servers
+ *
+ * (c) 2013-2019 by Mega Limited, Auckland, New Zealand
+ *
+ * This file is part of the MEGA SDK - Client Access Engine.
+ *
+ * Applications using the MEGA API must present a valid application key
+ * and comply with the the rules set forth in the Terms of Service.
+ *
+ * The MEGA SDK is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.
+ *
+ * @copyright Simplified (2-clause) BSD License.
+ *
+ * You should have received a copy of the license along with this
+ * program.
+ */
+
+#include "mockserver.h"
+
+#include <arpa/inet.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <sys/socket.h>
+#include <time.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <random>
+#include <sstream>
+
+using namespace mega;
+using std::string;
+
+namespace mt {
+
+namespace {
+
+const handle OWNER = 0x4d6f636b55736572ULL;   // arbitrary user handle for every node
+
+int64_t threadCpuNs()
+{
+    timespec ts;
+    clock_gettime(CLOCK_THREAD_CPUTIME_ID, &ts);
+    return int64_t(ts.tv_sec) * 1000000000 + ts.tv_nsec;
+}
+
+string b64(const byte* data, int len)
+{
+    string in((const char*)data, size_t(len));
+    return Base64::btoa(in);
+}
+
+string nodeHandleB64(handle h)
+{
+    return string(Base64Str<MegaClient::NODEHANDLE>(h));
+}
+
+bool caseInsensitiveStartsWith(const string& s, const char* prefix)
+{
+    size_t n = strlen(prefix);
+    return s.size() >= n && std::equal(prefix, prefix + n, s.begin(), [](char a, char b) { return tolower(a) == tolower(b); });
+}
+
+} // namespace
+
+MockServer::MockServer(const Config& config)
+    : mConfig(config)
+{
+    generate();
+}
+
+MockServer::~MockServer()
+{
+    stop();
+}
+
+handle MockServer::newHandle()
+{
+    return mNextHandle++;
+}
+
+string MockServer::encryptAttr(const byte* nodekey, nodetype_t t, const string& json)
+{
+    SymmCipher c;
+    c.setkey(nodekey, t);
+
+    // same layout as MegaClient::makeattr()
+    size_t l = json.size();
+    size_t ll = (l + 6 + SymmCipher::KEYLENGTH - 1) & -SymmCipher::KEYLENGTH;
+    string buf(ll, '\0');
+    memcpy(&buf[0], "MEGA{", 5);
+    memcpy(&buf[5], json.data(), l);
+    buf[l + 5] = '}';
+    c.cbc_encrypt((byte*)&buf[0], ll);
+
+    return b64((const byte*)buf.data(), int(ll));
+}
+
+string MockServer::encryptKey(const byte* nodekey, nodetype_t t)
+{
+    int len = t == FILENODE ? FILENODEKEYLENGTH : FOLDERNODEKEYLENGTH;
+    byte buf[FILENODEKEYLENGTH];
+    mFolderKey.ecb_encrypt((byte*)nodekey, buf, size_t(len));
+    return nodeHandleB64(mRoot) + ":" + b64(buf, len);
+}
+
+string MockServer::nodeJson(handle h, handle p, nodetype_t t, const string& name)
+{
+    std::ostringstream s;
+    s << "{\"h\":\"" << nodeHandleB64(h) << "\",\"p\":\"" << nodeHandleB64(p)
+      << "\",\"u\":\"" << Base64Str<MegaClient::USERHANDLE>(OWNER)
+      << "\",\"t\":" << t
+      << ",\"a\":\"" << encryptAttr(t == FILENODE ? mFileKey : mFolderKeyBytes, t, "\"n\":\"" + name + "\"")
+      << "\",\"k\":\"" << (t == FILENODE ? mFileKeyJson : mFolderKeyJson) << "\"";
+    if (t == FILENODE)
+    {
+        s << ",\"s\":" << mConfig.fileSize;
+    }
+    s << ",\"ts\":" << m_time() << "}";
+    return s.str();
+}
+
+void MockServer::generate()
+{
+    // deterministic contents, so consecutive runs are comparable
+    std::mt19937_64 rng(0x6d6f636b);
+    auto fill = [&rng](byte* b, size_t n) { for (size_t i = 0; i < n; i++) b[i] = byte(rng()); };
+
+    fill(mFolderKeyBytes, sizeof mFolderKeyBytes);
+    mFolderKey.setkey(mFolderKeyBytes, FOLDERNODE);
+
+    // one shared plaintext for every file: encrypt once, compute the real meta-MAC
+    byte transferkey[SymmCipher::KEYLENGTH];
+    fill(transferkey, sizeof transferkey);
+    uint64_t ctriv = rng();
+
+    size_t padded = size_t((mConfig.fileSize + SymmCipher::BLOCKSIZE - 1) & -SymmCipher::BLOCKSIZE);
+    mEncryptedContent.assign(padded, '\0');
+    fill((byte*)&mEncryptedContent[0], size_t(mConfig.fileSize));
+
+    SymmCipher cipher;
+    cipher.setkey(transferkey);
+    chunkmac_map macs;
+    EncryptBufferByChunks eb((byte*)&mEncryptedContent[0], &cipher, &macs, ctriv);
+    string suffix;
+    eb.encrypt(0, mConfig.fileSize, suffix);
+    mEncryptedContent.resize(size_t(mConfig.fileSize));
+
+    memcpy(mFileKey, transferkey, sizeof transferkey);
+    MemAccess::set<uint64_t>(mFileKey + SymmCipher::KEYLENGTH, ctriv);
+    MemAccess::set<int64_t>(mFileKey + SymmCipher::KEYLENGTH + sizeof ctriv, macs.macsmac(&cipher));
+    SymmCipher::xorblock(mFileKey + SymmCipher::KEYLENGTH, mFileKey);
+
+    // tree: breadth-first folders up to the configured depth, then files round-robin
+    mRoot = newHandle();
+    handle outside = newHandle();
+
+    mFileKeyJson = encryptKey(mFileKey, FILENODE);
+    mFolderKeyJson = encryptKey(mFolderKeyBytes, FOLDERNODE);
+
+    unsigned folderBudget = std::max(1u, mConfig.nodes * mConfig.folderPercent / 100);
+    std::vector<handle> folders(1, mRoot);
+    std::vector<std::pair<handle, unsigned>> frontier(1, std::make_pair(mRoot, 0u));
+
+    std::ostringstream f;
+    f << "{\"f\":[" << nodeJson(mRoot, outside, FOLDERNODE, "mockroot");
+
+    for (size_t i = 0; i < frontier.size() && folders.size() < folderBudget; i++)
+    {
+        if (frontier[i].second >= mConfig.depth)
+        {
+            continue;
+        }
+
+        for (unsigned j = 0; j < mConfig.fanout && folders.size() < folderBudget; j++)
+        {
+            handle h = newHandle();
+            f << "," << nodeJson(h, frontier[i].first, FOLDERNODE, "d" + std::to_string(folders.size()));
+            folders.push_back(h);
+            frontier.push_back(std::make_pair(h, frontier[i].second + 1));
+        }
+    }
+
+    for (unsigned i = unsigned(folders.size()); i < mConfig.nodes; i++)
+    {
+        handle h = newHandle();
+        f << "," << nodeJson(h, folders[i % folders.size()], FILENODE, "f" + std::to_string(i) + ".bin");
+        mFiles.push_back(h);
+    }
+
+    handle sn = rng();
+    mScsn = b64((const byte*)&sn, sizeof sn);
+    f << "],\"sn\":\"" << mScsn << "\"}";
+    mFetchNodesResponse = f.str();
+
+    mFileAttrs = "\"n\":\"upload\"";
+}
+
+string MockServer::apiUrl() const
+{
+    return "http://127.0.0.1:" + std::to_string(mPort) + "/";
+}
+
+string MockServer::folderLink() const
+{
+    return "https://mega.nz/#F!" + nodeHandleB64(mRoot) + "!" + b64(mFolderKeyBytes, sizeof mFolderKeyBytes);
+}
+
+double MockServer::serverCpuSeconds() const
+{
+    return double(mServerCpuNs) / 1e9;
+}
+
+bool MockServer::start(unsigned short port)
+{
+    mListenFd = socket(AF_INET, SOCK_STREAM, 0);
+    if (mListenFd < 0)
+    {
+        return false;
+    }
+
+    int one = 1;
+    setsockopt(mListenFd, SOL_SOCKET, SO_REUSEADDR, &one, sizeof one);
+
+    sockaddr_in addr;
+    memset(&addr, 0, sizeof addr);
+    addr.sin_family = AF_INET;
+    addr.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+    addr.sin_port = htons(port);
+
+    socklen_t len = sizeof addr;
+    if (bind(mListenFd, (sockaddr*)&addr, sizeof addr) || listen(mListenFd, 64)
+            || getsockname(mListenFd, (sockaddr*)&addr, &len))
+    {
+        close(mListenFd);
+        mListenFd = -1;
+        return false;
+    }
+
+    mPort = ntohs(addr.sin_port);
+    mBandwidthEpoch = std::chrono::steady_clock::now();
+    mAcceptThread = std::thread([this]() { acceptLoop(); });
+    return true;
+}
+
+void MockServer::stop()
+{
+    if (mStopping.exchange(true))
+    {
+        return;
+    }
+
+    if (mListenFd >= 0)
+    {
+        shutdown(mListenFd, SHUT_RDWR);
+        close(mListenFd);
+    }
+
+    if (mAcceptThread.joinable())
+    {
+        mAcceptThread.join();
+    }
+
+    std::vector<std::thread> threads;
+    {
+        std::lock_guard<std::mutex> g(mConnectionsMutex);
+        for (int fd : mConnectionFds)
+        {
+            shutdown(fd, SHUT_RDWR);
+        }
+        threads.swap(mConnectionThreads);
+    }
+
+    for (auto& t : threads)
+    {
+        t.join();
+    }
+}
+
+void MockServer::acceptLoop()
+{
+    while (!mStopping)
+    {
+        int fd = accept(mListenFd, nullptr, nullptr);
+        if (fd < 0)
+        {
+            continue;
+        }
+
+        int one = 1;
+        setsockopt(fd, IPPROTO_TCP, TCP_NODELAY, &one, sizeof one);
+
+        std::lock_guard<std::mutex> g(mConnectionsMutex);
+        mConnectionFds.push_back(fd);
+        mConnectionThreads.emplace_back([this, fd]() { serveConnection(fd); });
+    }
+}
+
+void MockServer::serveConnection(int fd)
+{
+    string pending;
+    Request req;
+    int64_t cpu = threadCpuNs();
+
+    while (!mStopping && readRequest(fd, pending, req))
+    {
+        bool keepalive = dispatch(fd, req);
+
+        int64_t now = threadCpuNs();
+        mServerCpuNs += now - cpu;
+        cpu = now;
+
+        if (!keepalive)
+        {
+            break;
+        }
+    }
+
+    std::lock_guard<std::mutex> g(mConnectionsMutex);
+    mConnectionFds.erase(std::remove(mConnectionFds.begin(), mConnectionFds.end(), fd), mConnectionFds.end());
+    close(fd);
+}
+
+bool MockServer::readRequest(int fd, string& pending, Request& req)
+{
+    char buf[65536];
+    size_t headerEnd;
+
+    while ((headerEnd = pending.find("\r\n\r\n")) == string::npos)
+    {
+        ssize_t n = recv(fd, buf, sizeof buf, 0);
+        if (n <= 0)
+        {
+            return false;
+        }
+        pending.append(buf, size_t(n));
+    }
+
+    std::istringstream headers(pending.substr(0, headerEnd));
+    string target, version, line;
+    headers >> req.method >> target >> version;
+    std::getline(headers, line);
+
+    size_t q = target.find('?');
+    req.path = target.substr(0, q);
+    req.query = q == string::npos ? string() : target.substr(q + 1);
+
+    size_t contentLength = 0;
+    bool expectContinue = false;
+    while (std::getline(headers, line))
+    {
+        if (caseInsensitiveStartsWith(line, "content-length:"))
+        {
+            contentLength = size_t(strtoull(line.c_str() + 15, nullptr, 10));
+        }
+        else if (caseInsensitiveStartsWith(line, "expect:") && line.find("100") != string::npos)
+        {
+            expectContinue = true;
+        }
+    }
+
+    pending.erase(0, headerEnd + 4);
+
+    if (expectContinue && pending.size() < contentLength)
+    {
+        static const char cont[] = "HTTP/1.1 100 Continue\r\n\r\n";
+        send(fd, cont, sizeof cont - 1, MSG_NOSIGNAL);
+    }
+
+    while (pending.size() < contentLength)
+    {
+        ssize_t n = recv(fd, buf, sizeof buf, 0);
+        if (n <= 0)
+        {
+            return false;
+        }
+        pending.append(buf, size_t(n));
+    }
+
+    req.body = pending.substr(0, contentLength);
+    pending.erase(0, contentLength);
+    mBytesReceived += contentLength;
+    return true;
+}
+
+void MockServer::throttle(size_t len)
+{
+    if (!mConfig.bandwidth)
+    {
+        return;
+    }
+
+    double wait;
+    {
+        std::lock_guard<std::mutex> g(mBandwidthMutex);
+        mBandwidthSent += double(len);
+        double elapsed = std::chrono::duration<double>(std::chrono::steady_clock::now() - mBandwidthEpoch).count();
+        wait = mBandwidthSent / double(mConfig.bandwidth) - elapsed;
+    }
+
+    if (wait > 0)
+    {
+        std::this_thread::sleep_for(std::chrono::duration<double>(wait));
+    }
+}
+
+bool MockServer::sendResponse(int fd, const string& contentType, const char* data, size_t len)
+{
+    if (mConfig.latencyMs)
+    {
+        std::this_thread::sleep_for(std::chrono::milliseconds(mConfig.latencyMs));
+    }
+
+    std::ostringstream h;
+    h << "HTTP/1.1 200 OK\r\nContent-Type: " << contentType
+      << "\r\nContent-Length: " << len
+      << "\r\nConnection: keep-alive\r\n\r\n";
+    string header = h.str();
+    if (send(fd, header.data(), header.size(), MSG_NOSIGNAL) != ssize_t(header.size()))
+    {
+        return false;
+    }
+
+    const size_t SLICE = 65536;
+    while (len)
+    {
+        size_t n = std::min(len, SLICE);
+        throttle(n);
+
+        ssize_t sent = send(fd, data, n, MSG_NOSIGNAL);
+        if (sent <= 0)
+        {
+            return false;
+        }
+        data += sent;
+        len -= size_t(sent);
+        mBytesServed += uint64_t(sent);
+    }
+    return true;
+}
+
+bool MockServer::dispatch(int fd, const Request& req)
+{
+    if (req.path == "/cs")
+    {
+        string response = processCommands(req.body);
+        return sendResponse(fd, "application/json", response.data(), response.size());
+    }
+    else if (req.path == "/wsc" || req.path == "/sc")
+    {
+        return handleServerClient(fd);
+    }
+    else if (!req.path.compare(0, 4, "/dl/"))
+    {
+        return handleDownload(fd, req);
+    }
+    else if (!req.path.compare(0, 4, "/ul/"))
+    {
+        return handleUpload(fd, req);
+    }
+
+    static const char notfound[] = "HTTP/1.1 404 Not Found\r\nContent-Length: 0\r\n\r\n";
+    send(fd, notfound, sizeof notfound - 1, MSG_NOSIGNAL);
+    return true;
+}
+
+string MockServer::processCommands(const string& body)
+{
+    JSON json;
+    json.begin(body.c_str());
+
+    if (!json.enterarray())
+    {
+        return "-2";
+    }
+
+    string response = "[";
+    bool first = true;
+    while (json.enterobject())
+    {
+        std::map<string, string> cmd;
+        for (;;)
+        {
+            string name = json.getname();
+            if (name.empty())
+            {
+                break;
+            }
+
+            string value;
+            if (!json.storeobject(&value))
+            {
+                return "-2";
+            }
+            cmd[name] = value;
+        }
+        json.leaveobject();
+
+        response += first ? "" : ",";
+        response += processCommand(cmd);
+        first = false;
+    }
+
+    return response + "]";
+}
+
+string MockServer::processCommand(const std::map<string, string>& cmd)
+{
+    auto get = [&cmd](const char* name) -> string
+    {
+        auto it = cmd.find(name);
+        return it == cmd.end() ? string() : it->second;
+    };
+
+    string a = get("a");
+    std::ostringstream s;
+
+    if (a == "f")
+    {
+        return mFetchNodesResponse;
+    }
+    else if (a == "g")
+    {
+        string h = get("n").empty() ? get("p") : get("n");
+        s << "{\"s\":" << mConfig.fileSize
+          << ",\"at\":\"" << encryptAttr(mFileKey, FILENODE, mFileAttrs)
+          << "\",\"msd\":1,\"tl\":0,\"g\":\"" << apiUrl() << "dl/" << h << "\"}";
+    }
+    else if (a == "u")
+    {
+        std::lock_guard<std::mutex> g(mStateMutex);
+        handle id = mNextUpload++;
+        mUploads[id].size = atoll(get("s").c_str());
+        s << "{\"p\":\"" << apiUrl() << "ul/" << id << "\"}";
+    }
+    else if (a == "p")
+    {
+        // accept every new node, echoing its attributes under a fresh handle
+        JSON n;
+        string nodes = get("n");
+        n.begin(nodes.c_str());
+        n.enterarray();
+
+        s << "{\"f\":[";
+        for (int i = 0; n.enterobject(); i++)
+        {
+            string token, attrs, key, type = "0";
+            for (;;)
+            {
+                string name = n.getname();
+                if (name.empty())
+                {
+                    break;
+                }
+                string value;
+                n.storeobject(&value);
+                if (name == "h") token = value;
+                else if (name == "a") attrs = value;
+                else if (name == "k") key = value;
+                else if (name == "t") type = value;
+            }
+            n.leaveobject();
+
+            m_off_t size = 0;
+            byte ultoken[NewNode::UPLOADTOKENLEN] = { 0 };
+            if (Base64::atob(token.c_str(), ultoken, sizeof ultoken) == sizeof ultoken)
+            {
+                std::lock_guard<std::mutex> g(mStateMutex);
+                size = mUploadedSizes[MemAccess::get<handle>((const char*)ultoken)];
+            }
+
+            std::lock_guard<std::mutex> g(mStateMutex);
+            handle h = newHandle();
+            s << (i ? "," : "") << "{\"h\":\"" << nodeHandleB64(h) << "\",\"p\":\"" << get("t")
+              << "\",\"u\":\"" << Base64Str<MegaClient::USERHANDLE>(OWNER) << "\",\"t\":" << type
+              << ",\"a\":\"" << attrs << "\",\"k\":\"" << nodeHandleB64(mRoot) << ":" << key << "\"";
+            if (type == "0")
+            {
+                s << ",\"s\":" << size;
+            }
+            s << ",\"ts\":" << m_time() << ",\"i\":" << i << "}";
+        }
+        s << "]}";
+    }
+    else
+    {
+        // commands the benchmark does not care about (events, logs, misc flags) just succeed
+        s << "0";
+    }
+
+    return s.str();
+}
+
+bool MockServer::handleDownload(int fd, const Request& req)
+{
+    // /dl/<handle>/<start>-<end>, end inclusive
+    size_t slash = req.path.find('/', 4);
+    unsigned long long start = 0, end = 0;
+    if (slash == string::npos || sscanf(req.path.c_str() + slash, "/%llu-%llu", &start, &end) != 2
+            || start > end || end >= (unsigned long long)mEncryptedContent.size())
+    {
+        static const char range[] = "HTTP/1.1 416 Range Not Satisfiable\r\nContent-Length: 0\r\n\r\n";
+        send(fd, range, sizeof range - 1, MSG_NOSIGNAL);
+        return true;
+    }
+
+    return sendResponse(fd, "application/octet-stream", mEncryptedContent.data() + start, size_t(end - start + 1));
+}
+
+bool MockServer::handleUpload(int fd, const Request& req)
+{
+    // /ul/<id>/<pos>
+    handle id = strtoull(req.path.c_str() + 4, nullptr, 10);
+    throttle(req.body.size());
+
+    bool complete = false;
+    {
+        std::lock_guard<std::mutex> g(mStateMutex);
+        auto it = mUploads.find(id);
+        if (it == mUploads.end())
+        {
+            string e = std::to_string(API_ENOENT);
+            return sendResponse(fd, "text/plain", e.data(), e.size());
+        }
+
+        it->second.received += m_off_t(req.body.size());
+        if (it->second.received >= it->second.size)
+        {
+            mUploadedSizes[id] = it->second.size;
+            mUploads.erase(it);
+            complete = true;
+        }
+    }
+
+    if (!complete)
+    {
+        return sendResponse(fd, "text/plain", "", 0);
+    }
+
+    // new-style upload token: the upload id, terminated by a 1
+    byte token[NewNode::UPLOADTOKENLEN] = { 0 };
+    MemAccess::set<handle>(token, id);
+    token[NewNode::UPLOADTOKENLEN - 1] = 1;
+    return sendResponse(fd, "application/octet-stream", (const char*)token, sizeof token);
+}
+
+bool MockServer::handleServerClient(int fd)
+{
+    // the first request completes fetchnodes; later ones idle like a quiet account
+    if (mScDelivered.exchange(true))
+    {
+        for (unsigned i = 0; i < mConfig.scHoldSeconds * 10 && !mStopping; i++)
+        {
+            std::this_thread::sleep_for(std::chrono::milliseconds(100));
+        }
+    }
+
+    string response = "{\"a\":[],\"sn\":\"" + mScsn + "\"}";
+    return sendResponse(fd, "application/json", response.data(), response.size());
+}
+
+} // namespace mt
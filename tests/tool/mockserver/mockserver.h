@@ -0,0 +1,150 @@
+/**
+ * @file mockserver.h
+ * @brief Offline stand-in for the MEGA API and storage servers
+ *
+ * (c) 2013-2019 by Mega Limited, Auckland, New Zealand
+ *
+ * This file is part of the MEGA SDK - Client Access Engine.
+ *
+ * Applications using the MEGA API must present a valid application key
+ * and comply with the the rules set forth in the Terms of Service.
+ *
+ * The MEGA SDK is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.
+ *
+ * @copyright Simplified (2-clause) BSD License.
+ *
+ * You should have received a copy of the license along with this
+ * program.
+ */
+
+#pragma once
+
+#include <mega.h>
+
+#include <atomic>
+#include <chrono>
+#include <map>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+namespace mt {
+
+// Speaks just enough of the cs/sc/upload/download protocol to serve a
+// synthetic public folder to an unmodified MegaClient over plain HTTP.
+// Every file in the synthetic tree shares one key and one content buffer,
+// so the download path costs the server a memcpy per request.
+class MockServer
+{
+public:
+    struct Config
+    {
+        unsigned nodes = 10000;         // total nodes in the synthetic folder (folders + files)
+        unsigned depth = 4;             // maximum folder depth below the root
+        unsigned fanout = 8;            // subfolders per folder
+        unsigned folderPercent = 10;    // share of `nodes` that are folders
+        m_off_t fileSize = 4 << 20;     // size of every synthetic file
+        unsigned latencyMs = 0;         // added before each response
+        m_off_t bandwidth = 0;          // bytes/s shared by all connections, 0 = unlimited
+        unsigned scHoldSeconds = 10;    // how long an idle sc request is held open
+    };
+
+    explicit MockServer(const Config& config);
+    ~MockServer();
+
+    // binds to 127.0.0.1 (port 0 = any free port) and starts accepting
+    bool start(unsigned short port = 0);
+    void stop();
+
+    unsigned short port() const { return mPort; }
+    std::string apiUrl() const;
+    std::string folderLink() const;
+
+    // handles of all files in the synthetic tree
+    const std::vector<mega::handle>& files() const { return mFiles; }
+    mega::handle rootHandle() const { return mRoot; }
+
+    // CPU time consumed by server threads, so clients sharing the process can subtract it
+    double serverCpuSeconds() const;
+
+    uint64_t bytesServed() const { return mBytesServed; }
+    uint64_t bytesReceived() const { return mBytesReceived; }
+
+private:
+    struct Request
+    {
+        std::string method;
+        std::string path;
+        std::string query;
+        std::string body;
+    };
+
+    struct Upload
+    {
+        m_off_t size = 0;
+        m_off_t received = 0;
+    };
+
+    Config mConfig;
+
+    int mListenFd = -1;
+    unsigned short mPort = 0;
+    std::atomic<bool> mStopping{false};
+    std::thread mAcceptThread;
+
+    std::mutex mConnectionsMutex;
+    std::vector<std::thread> mConnectionThreads;
+    std::vector<int> mConnectionFds;
+
+    // synthetic account
+    mega::SymmCipher mFolderKey;
+    mega::byte mFolderKeyBytes[mega::FOLDERNODEKEYLENGTH];
+    mega::byte mFileKey[mega::FILENODEKEYLENGTH];
+    mega::handle mRoot = mega::UNDEF;
+    mega::handle mNextHandle = 1;
+    std::vector<mega::handle> mFiles;
+    std::string mFetchNodesResponse;
+    std::string mEncryptedContent;
+    std::string mFileAttrs;
+    std::string mFileKeyJson;
+    std::string mFolderKeyJson;
+
+    std::mutex mStateMutex;
+    std::map<mega::handle, Upload> mUploads;
+    std::map<mega::handle, m_off_t> mUploadedSizes;
+    uint64_t mNextUpload = 1;
+    std::string mScsn;
+    std::atomic<bool> mScDelivered{false};
+
+    // throttling and accounting
+    std::mutex mBandwidthMutex;
+    std::chrono::steady_clock::time_point mBandwidthEpoch;
+    double mBandwidthSent = 0;
+    std::atomic<uint64_t> mBytesServed{0};
+    std::atomic<uint64_t> mBytesReceived{0};
+    std::atomic<int64_t> mServerCpuNs{0};
+
+    void generate();
+    mega::handle newHandle();
+    std::string nodeJson(mega::handle h, mega::handle p, mega::nodetype_t t, const std::string& name);
+    std::string encryptAttr(const mega::byte* nodekey, mega::nodetype_t t, const std::string& json);
+    std::string encryptKey(const mega::byte* nodekey, mega::nodetype_t t);
+
+    void acceptLoop();
+    void serveConnection(int fd);
+    bool readRequest(int fd, std::string& pending, Request& req);
+    bool sendResponse(int fd, const std::string& contentType, const char* data, size_t len);
+    void throttle(size_t len);
+
+    bool dispatch(int fd, const Request& req);
+    std::string processCommands(const std::string& body);
+    std::string processCommand(const std::map<std::string, std::string>& cmd);
+    bool handleDownload(int fd, const Request& req);
+    bool handleUpload(int fd, const Request& req);
+    bool handleServerClient(int fd);
+};
+
+} // namespace mt
@@ -16,6 +16,9 @@
  * program.
  */
 
+#include <algorithm>
+#include <vector>
+
 #include <gtest/gtest.h>
 
 #include <mega/attrmap.h>
@@ -57,3 +60,33 @@ TEST(AttrMap, unserialize_32bit)
 
     ASSERT_EQ(expMap.map, newMap.map);
 }
+
+TEST(AttrMap, flatMap_behavesLikeSortedMap)
+{
+    mega::attr_map m;
+    m['n'] = "name";
+    m['c'] = "fingerprint";
+    m[mega::AttrMap::string2nameid("lbl")] = "3";
+    m['c'] += "2";
+
+    ASSERT_EQ(3u, m.size());
+    std::vector<mega::nameid> names;
+    for (const auto& entry : m)
+    {
+        names.push_back(entry.first);
+    }
+    ASSERT_TRUE(std::is_sorted(names.begin(), names.end()));
+    ASSERT_EQ("fingerprint2", m.find('c')->second);
+    ASSERT_TRUE(m.find('x') == m.end());
+
+    ASSERT_EQ(1u, m.erase('n'));
+    ASSERT_EQ(0u, m.erase('n'));
+    ASSERT_EQ(0u, m.count('n'));
+    m.erase(m.find('c'));
+    ASSERT_EQ(1u, m.size());
+
+    mega::attr_map dup = { {42, "first"}, {13, "x"}, {42, "second"} };
+    ASSERT_EQ(2u, dup.size());
+    ASSERT_EQ(13, dup.begin()->first);
+    ASSERT_EQ("first", dup.find(42)->second);
+}
@@ -0,0 +1,104 @@
+/**
+ * (c) 2019 by Mega Limited, Wellsford, New Zealand
+ *
+ * This file is part of the MEGA SDK - Client Access Engine.
+ *
+ * Applications using the MEGA API must present a valid application key
+ * and comply with the the rules set forth in the Terms of Service.
+ *
+ * The MEGA SDK is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.
+ *
+ * @copyright Simplified (2-clause) BSD License.
+ *
+ * You should have received a copy of the license along with this
+ * program.
+ */
+
+#include <map>
+#include <vector>
+
+#include <gtest/gtest.h>
+
+#include <mega/http.h>
+
+namespace
+{
+
+// every class in `busy` takes all it is given, once per decisecond, from `from` to `to`
+void drain(mega::BandwidthScheduler& bw, const std::vector<mega::bwclass_t>& busy,
+           mega::dstime from, mega::dstime to, std::map<mega::bwclass_t, m_off_t>& moved)
+{
+    for (mega::dstime now = from; now < to; ++now)
+    {
+        for (auto cls : busy)
+        {
+            m_off_t n = bw.available(cls, now);
+            if (n > 0)
+            {
+                bw.consume(cls, n);
+                moved[cls] += n;
+            }
+        }
+    }
+}
+
+} // anonymous
+
+TEST(BandwidthScheduler, unlimitedNeverWaits)
+{
+    mega::BandwidthScheduler bw;
+    ASSERT_GT(bw.available(mega::BW_BACKUP, 1), 1 << 30);
+}
+
+TEST(BandwidthScheduler, loneClassGetsTheWholeLimit)
+{
+    mega::BandwidthScheduler bw;
+    bw.setlimit(1000000);
+
+    std::map<mega::bwclass_t, m_off_t> moved;
+    drain(bw, {mega::BW_BACKUP}, 1, 101, moved);
+    ASSERT_NEAR(10000000, moved[mega::BW_BACKUP], 200000);
+}
+
+TEST(BandwidthScheduler, busyClassesShareByWeight)
+{
+    mega::BandwidthScheduler bw;
+    bw.setlimit(1500000);
+
+    std::map<mega::bwclass_t, m_off_t> moved;
+    drain(bw, {mega::BW_BULK, mega::BW_BACKUP}, 1, 201, moved);
+    ASSERT_NEAR(20000000, moved[mega::BW_BULK], 400000);
+    ASSERT_NEAR(10000000, moved[mega::BW_BACKUP], 400000);
+}
+
+TEST(BandwidthScheduler, minimumRateHoldsAgainstHeavierClasses)
+{
+    mega::BandwidthScheduler bw;
+    bw.setlimit(1000000);
+    bw.setclass(mega::BW_INTERACTIVE, 1, 400000);
+    bw.setclass(mega::BW_BACKUP, 100, 0);
+
+    std::map<mega::bwclass_t, m_off_t> moved;
+    drain(bw, {mega::BW_INTERACTIVE, mega::BW_BACKUP}, 1, 101, moved);
+    ASSERT_GE(moved[mega::BW_INTERACTIVE], 4000000);
+    ASSERT_NEAR(10000000, moved[mega::BW_INTERACTIVE] + moved[mega::BW_BACKUP], 200000);
+}
+
+TEST(BandwidthScheduler, idleClassReleasesItsShare)
+{
+    mega::BandwidthScheduler bw;
+    bw.setlimit(1000000);
+
+    std::map<mega::bwclass_t, m_off_t> moved;
+    drain(bw, {mega::BW_INTERACTIVE, mega::BW_BACKUP}, 1, 101, moved);
+    ASSERT_GT(moved[mega::BW_INTERACTIVE], 8 * moved[mega::BW_BACKUP]);
+
+    // playback stopped: once it has been quiet for a while the backup runs at full speed
+    moved.clear();
+    drain(bw, {mega::BW_BACKUP}, 101, 101 + mega::BandwidthScheduler::IDLEDS, moved);
+    moved.clear();
+    drain(bw, {mega::BW_BACKUP}, 101 + mega::BandwidthScheduler::IDLEDS, 201 + mega::BandwidthScheduler::IDLEDS, moved);
+    ASSERT_NEAR(10000000, moved[mega::BW_BACKUP], 200000);
+}
@@ -89,3 +89,124 @@ TEST(ChunkMacMap, unserialize_32bit)
     ASSERT_TRUE(newMap.unserialize(data, d.c_str() + d.size()));
     EXPECT_EQ(map, newMap);
 }
+
+namespace {
+
+// chunk start positions of a file of the given size
+std::vector<m_off_t> chunkPositions(m_off_t size)
+{
+    std::vector<m_off_t> positions;
+    for (m_off_t pos = 0; pos < size; pos = mega::ChunkedHash::chunkceil(pos, size))
+    {
+        positions.push_back(pos);
+    }
+    return positions;
+}
+
+mega::ChunkMAC finishedChunkMac(m_off_t pos)
+{
+    mega::ChunkMAC chunkMac;
+    for (int i = 0; i < mega::SymmCipher::BLOCKSIZE; ++i)
+    {
+        chunkMac.mac[i] = static_cast<mega::byte>(pos * 31 + i);
+    }
+    chunkMac.finished = true;
+    return chunkMac;
+}
+
+} // anonymous
+
+TEST(ChunkMacMap, foldFinishedPrefix_keepsMacsmac)
+{
+    const m_off_t size = 50 * 1024 * 1024 + 12345;
+    const auto positions = chunkPositions(size);
+    mega::byte key[mega::SymmCipher::KEYLENGTH] = { 1, 2, 3 };
+    mega::SymmCipher cipher(key);
+
+    mega::chunkmac_map reference;
+    for (auto pos : positions)
+    {
+        reference[pos] = finishedChunkMac(pos);
+    }
+
+    // complete the chunks out of order, folding as we go like a transfer does
+    mega::chunkmac_map folded;
+    for (size_t i = 0; i < positions.size(); i += 2)
+    {
+        if (i + 1 < positions.size())
+        {
+            folded[positions[i + 1]] = finishedChunkMac(positions[i + 1]);
+            folded.foldFinishedPrefix(&cipher);
+        }
+        folded[positions[i]] = finishedChunkMac(positions[i]);
+        folded.foldFinishedPrefix(&cipher);
+        ASSERT_LE(folded.size(), 1u);
+    }
+
+    ASSERT_TRUE(folded.empty());
+    ASSERT_GE(folded.foldedEnd(), size);
+    ASSERT_EQ(reference.macsmac(&cipher), folded.macsmac(&cipher));
+}
+
+TEST(ChunkMacMap, foldFinishedPrefix_stopsAtUnfinishedChunk)
+{
+    const auto positions = chunkPositions(10 * 1024 * 1024);
+    mega::byte key[mega::SymmCipher::KEYLENGTH] = { 1, 2, 3 };
+    mega::SymmCipher cipher(key);
+
+    mega::chunkmac_map map;
+    map[positions[0]] = finishedChunkMac(positions[0]);
+    map[positions[1]].offset = 100;
+    map[positions[2]] = finishedChunkMac(positions[2]);
+    map.foldFinishedPrefix(&cipher);
+
+    ASSERT_EQ(positions[1], map.foldedEnd());
+    ASSERT_EQ(2u, map.size());
+    ASSERT_TRUE(map.finishedAt(positions[0]));
+    ASSERT_FALSE(map.finishedAt(positions[1]));
+    ASSERT_TRUE(map.startedAt(positions[1]));
+    ASSERT_TRUE(map.finishedAt(positions[2]));
+    ASSERT_FALSE(map.startedAt(positions[3]));
+
+    // writes to folded chunks do not resurrect them
+    map[positions[0]].finished = false;
+    ASSERT_TRUE(map.finishedAt(positions[0]));
+    ASSERT_EQ(2u, map.size());
+
+    m_off_t chunkpos, progress;
+    map.calcprogress(10 * 1024 * 1024, chunkpos, progress);
+    ASSERT_EQ(positions[1], chunkpos);
+    ASSERT_EQ(positions[1] + 100 + (positions[3] - positions[2]), progress);
+}
+
+TEST(ChunkMacMap, serialize_unserialize_folded)
+{
+    const auto positions = chunkPositions(10 * 1024 * 1024);
+    mega::byte key[mega::SymmCipher::KEYLENGTH] = { 1, 2, 3 };
+    mega::SymmCipher cipher(key);
+
+    mega::chunkmac_map map;
+    for (size_t i = 0; i < 5; ++i)
+    {
+        map[positions[i]] = finishedChunkMac(positions[i]);
+    }
+    map[positions[7]] = finishedChunkMac(positions[7]);
+    map.foldFinishedPrefix(&cipher);
+
+    std::string d;
+    map.serialize(d);
+    ASSERT_EQ(2 + 1 + sizeof(m_off_t) + mega::SymmCipher::BLOCKSIZE + 4 + sizeof(m_off_t) + sizeof(mega::ChunkMAC), d.size());
+
+    mega::chunkmac_map newMap;
+    auto data = d.c_str();
+    ASSERT_TRUE(newMap.unserialize(data, d.c_str() + d.size()));
+    ASSERT_EQ(d.c_str() + d.size(), data);
+    EXPECT_EQ(map, newMap);
+    ASSERT_EQ(map.foldedEnd(), newMap.foldedEnd());
+    ASSERT_EQ(map.macsmac(&cipher), newMap.macsmac(&cipher));
+
+    // truncated data is rejected
+    mega::chunkmac_map truncatedMap;
+    data = d.c_str();
+    ASSERT_FALSE(truncatedMap.unserialize(data, d.c_str() + d.size() - 1));
+}
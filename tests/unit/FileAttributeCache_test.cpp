@@ -0,0 +1,297 @@
+/**
+ * (c) 2019 by Mega Limited, Wellsford, New Zealand
+ *
+ * This file is part of the MEGA SDK - Client Access Engine.
+ *
+ * Applications using the MEGA API must present a valid application key
+ * and comply with the the rules set forth in the Terms of Service.
+ *
+ * The MEGA SDK is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.
+ *
+ * @copyright Simplified (2-clause) BSD License.
+ *
+ * You should have received a copy of the license along with this
+ * program.
+ */
+
+#include <cstring>
+#include <map>
+
+#include <gtest/gtest.h>
+
+#include <mega/fileattributefetch.h>
+
+#include "DefaultedDirAccess.h"
+#include "DefaultedFileAccess.h"
+#include "DefaultedFileSystemAccess.h"
+
+namespace {
+
+// files by path, with their mtime
+struct MemFiles
+{
+    std::map<std::string, std::pair<std::string, mega::m_time_t>> files;
+    mega::m_time_t now = 1000;
+};
+
+class MemFileAccess : public mt::DefaultedFileAccess
+{
+public:
+    explicit MemFileAccess(MemFiles& fs)
+    : mFs{fs}
+    {}
+
+    bool fopen(std::string* path, bool read, bool write) override
+    {
+        mPath = *path;
+        auto it = mFs.files.find(mPath);
+        if (it == mFs.files.end())
+        {
+            if (!write)
+            {
+                return false;
+            }
+            it = mFs.files.emplace(mPath, std::make_pair(std::string(), mFs.now++)).first;
+        }
+        size = m_off_t(it->second.first.size());
+        mtime = it->second.second;
+        type = mega::FILENODE;
+        return true;
+    }
+
+    bool fwrite(const mega::byte* data, unsigned len, m_off_t pos) override
+    {
+        auto& file = mFs.files[mPath];
+        if (file.first.size() < size_t(pos) + len)
+        {
+            file.first.resize(size_t(pos) + len);
+        }
+        memcpy(&file.first[size_t(pos)], data, len);
+        file.second = mFs.now++;
+        return true;
+    }
+
+    bool sysread(mega::byte* dst, unsigned len, m_off_t pos) override
+    {
+        const std::string& data = mFs.files.at(mPath).first;
+        if (size_t(pos) + len > data.size())
+        {
+            return false;
+        }
+        memcpy(dst, data.data() + pos, len);
+        return true;
+    }
+
+private:
+    MemFiles& mFs;
+    std::string mPath;
+};
+
+class MemDirAccess : public mt::DefaultedDirAccess
+{
+public:
+    explicit MemDirAccess(MemFiles& fs)
+    : mFs{fs}
+    {}
+
+    bool dopen(std::string* path, mega::FileAccess*, bool) override
+    {
+        for (auto& f : mFs.files)
+        {
+            if (!f.first.compare(0, path->size() + 1, *path + "/"))
+            {
+                mNames.push_back(f.first.substr(path->size() + 1));
+            }
+        }
+        return true;
+    }
+
+    bool dnext(std::string*, std::string* localname, bool, mega::nodetype_t* type) override
+    {
+        if (mNames.empty())
+        {
+            return false;
+        }
+        *localname = mNames.front();
+        *type = mega::FILENODE;
+        mNames.erase(mNames.begin());
+        return true;
+    }
+
+private:
+    MemFiles& mFs;
+    std::vector<std::string> mNames;
+};
+
+class MemFileSystemAccess : public mt::DefaultedFileSystemAccess
+{
+public:
+    MemFiles fs;
+
+    std::unique_ptr<mega::FileAccess> newfileaccess(bool = true) override
+    {
+        return std::unique_ptr<mega::FileAccess>{new MemFileAccess{fs}};
+    }
+    mega::DirAccess* newdiraccess() override
+    {
+        return new MemDirAccess{fs};
+    }
+    void path2local(std::string* path, std::string* local) const override
+    {
+        *local = *path;
+    }
+    void local2path(std::string* local, std::string* path) const override
+    {
+        *path = *local;
+    }
+    bool mkdirlocal(std::string*, bool = false) override
+    {
+        return true;
+    }
+    bool unlinklocal(std::string* path) override
+    {
+        return fs.files.erase(*path) > 0;
+    }
+    bool renamelocal(std::string* from, std::string* to, bool = true) override
+    {
+        auto it = fs.files.find(*from);
+        if (it == fs.files.end())
+        {
+            return false;
+        }
+        fs.files[*to] = it->second;
+        fs.files.erase(it);
+        return true;
+    }
+    bool setmtimelocal(std::string* path, mega::m_time_t) override
+    {
+        fs.files.at(*path).second = fs.now++;
+        return true;
+    }
+};
+
+std::string blob(char c, size_t len)
+{
+    return std::string(len, c);
+}
+
+} // anonymous
+
+TEST(FileAttributeCache, putAndGet)
+{
+    MemFileSystemAccess fsaccess;
+    mega::FileAttributeCache cache{fsaccess, "cache", 1000};
+
+    const std::string data = blob('a', 32);
+    cache.put(1, data.data(), data.size());
+
+    std::string result;
+    ASSERT_TRUE(cache.contains(1));
+    ASSERT_TRUE(cache.get(1, &result));
+    ASSERT_EQ(data, result);
+    ASSERT_FALSE(cache.get(2, &result));
+    ASSERT_EQ(1u, cache.count());
+    ASSERT_EQ(32, cache.size());
+
+    // one file per entry, and no temporary left behind
+    ASSERT_EQ(1u, fsaccess.fs.files.size());
+}
+
+TEST(FileAttributeCache, evictsLeastRecentlyUsed)
+{
+    MemFileSystemAccess fsaccess;
+    mega::FileAttributeCache cache{fsaccess, "cache", 100};
+
+    const std::string data = blob('a', 40);
+    std::string result;
+    cache.put(1, data.data(), data.size());
+    cache.put(2, data.data(), data.size());
+    ASSERT_TRUE(cache.get(1, &result));
+    cache.put(3, data.data(), data.size());
+
+    ASSERT_TRUE(cache.contains(1));
+    ASSERT_FALSE(cache.contains(2));
+    ASSERT_TRUE(cache.contains(3));
+    ASSERT_EQ(80, cache.size());
+    ASSERT_EQ(2u, fsaccess.fs.files.size());
+
+    // larger than the whole cache
+    const std::string big = blob('b', 101);
+    cache.put(4, big.data(), big.size());
+    ASSERT_FALSE(cache.contains(4));
+    ASSERT_EQ(2u, cache.count());
+}
+
+TEST(FileAttributeCache, reusesEntriesOfPreviousSessions)
+{
+    MemFileSystemAccess fsaccess;
+    const std::string data = blob('a', 40);
+    std::string result;
+    {
+        mega::FileAttributeCache cache{fsaccess, "cache", 1000};
+        cache.put(1, data.data(), data.size());
+        cache.put(2, data.data(), data.size());
+        cache.put(3, data.data(), data.size());
+        ASSERT_TRUE(cache.get(1, &result));
+    }
+
+    // files that aren't entries are left alone
+    fsaccess.fs.files["cache/notes.txt"] = std::make_pair(std::string("x"), fsaccess.fs.now++);
+
+    // the least recently used don't fit anymore
+    mega::FileAttributeCache cache{fsaccess, "cache", 80};
+    ASSERT_EQ(2u, cache.count());
+    ASSERT_TRUE(cache.contains(1));
+    ASSERT_FALSE(cache.contains(2));
+    ASSERT_TRUE(cache.contains(3));
+    ASSERT_TRUE(cache.get(3, &result));
+    ASSERT_EQ(data, result);
+    ASSERT_EQ(1u, fsaccess.fs.files.count("cache/notes.txt"));
+}
+
+TEST(FileAttributeCache, dropsEntriesThatChangedOnDisk)
+{
+    MemFileSystemAccess fsaccess;
+    mega::FileAttributeCache cache{fsaccess, "cache", 1000};
+
+    const std::string data = blob('a', 32);
+    cache.put(1, data.data(), data.size());
+    for (auto& f : fsaccess.fs.files)
+    {
+        f.second.first.resize(16);
+    }
+
+    std::string result;
+    ASSERT_FALSE(cache.get(1, &result));
+    ASSERT_FALSE(cache.contains(1));
+    ASSERT_EQ(0, cache.size());
+    ASSERT_TRUE(fsaccess.fs.files.empty());
+}
+
+TEST(FileAttributeCache, removesInterruptedWrites)
+{
+    MemFileSystemAccess fsaccess;
+    const std::string data = blob('a', 32);
+    {
+        mega::FileAttributeCache cache{fsaccess, "cache", 1000};
+        cache.put(1, data.data(), data.size());
+    }
+
+    // a write that didn't get to its rename, next to one that isn't ours
+    const std::string entry = fsaccess.fs.files.begin()->first;
+    fsaccess.fs.files[entry + ".tmp"] = std::make_pair(data, fsaccess.fs.now++);
+    fsaccess.fs.files["cache/notes.tmp"] = std::make_pair(std::string("x"), fsaccess.fs.now++);
+
+    const auto existing = mega::FileAttributeCache::scan(fsaccess, "cache");
+    ASSERT_EQ(1u, existing.size());
+    ASSERT_EQ(1u, existing[0].first);
+    ASSERT_EQ(32, existing[0].second);
+    ASSERT_EQ(0u, fsaccess.fs.files.count(entry + ".tmp"));
+    ASSERT_EQ(1u, fsaccess.fs.files.count("cache/notes.tmp"));
+
+    mega::FileAttributeCache cache{fsaccess, "cache", 1000, existing};
+    ASSERT_EQ(1u, cache.count());
+    ASSERT_EQ(32, cache.size());
+}
@@ -0,0 +1,135 @@
+/**
+ * (c) 2019 by Mega Limited, Wellsford, New Zealand
+ *
+ * This file is part of the MEGA SDK - Client Access Engine.
+ *
+ * Applications using the MEGA API must present a valid application key
+ * and comply with the the rules set forth in the Terms of Service.
+ *
+ * The MEGA SDK is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.
+ *
+ * @copyright Simplified (2-clause) BSD License.
+ *
+ * You should have received a copy of the license along with this
+ * program.
+ */
+
+#include <map>
+#include <vector>
+
+#include <gtest/gtest.h>
+
+#include <mega/megaclient.h>
+#include <mega/megaapp.h>
+#include <mega/fileattributefetch.h>
+
+#include "DefaultedFileSystemAccess.h"
+#include "utils.h"
+
+namespace {
+
+class MockApp : public mega::MegaApp
+{
+public:
+    std::vector<mega::handle> completed;
+    std::map<mega::handle, mega::error> failed;
+    bool changedToHttps = false;
+
+    void fa_complete(mega::handle h, mega::fatype, const char*, uint32_t) override
+    {
+        completed.push_back(h);
+    }
+
+    int fa_failed(mega::handle h, mega::fatype, int, mega::error e) override
+    {
+        failed[h] = e;
+        return 1; // no retry
+    }
+
+    void notify_change_to_https() override
+    {
+        changedToHttps = true;
+    }
+};
+
+class MockFileSystemAccess : public mt::DefaultedFileSystemAccess
+{
+};
+
+// queues a fetch of the attribute `fah` for node `h`
+void addFetch(mega::FileAttributeFetchChannel& fc, mega::handle fah, mega::handle h)
+{
+    fc.fafs[0][fah] = new mega::FileAttributeFetch{h, std::string(mega::FILENODEKEYLENGTH, 'k'), 0, 1};
+}
+
+// the response for one attribute: handle, length and the encrypted data
+std::string response(mega::handle fah)
+{
+    uint32_t len = mega::SymmCipher::BLOCKSIZE;
+    std::string r((const char*)&fah, sizeof fah);
+    r.append((const char*)&len, sizeof len);
+    r.append(len, 'x');
+    return r;
+}
+
+} // anonymous
+
+TEST(FileAttributeFetchChannel, overlappingRequestsKeepTheirFetchesAndErrors)
+{
+    MockApp app;
+    MockFileSystemAccess fsaccess;
+    auto client = mt::makeClient(app, fsaccess);
+
+    mega::FileAttributeFetchChannel fc{client.get()};
+    fc.posturl = "http://fa.example";
+    fc.urltime = 1;
+
+    // the channel's own request and two pipelined behind it
+    addFetch(fc, 101, 1);
+    fc.dispatch();
+    fc.e = mega::API_ENOENT;
+    addFetch(fc, 102, 2);
+    fc.pipeline();
+    addFetch(fc, 103, 3);
+    fc.pipeline();
+
+    ASSERT_EQ(2u, fc.pipelined.size());
+    ASSERT_EQ(3u, fc.fafs[1].size());
+    ASSERT_EQ(mega::API_ENOENT, fc.e);
+
+    // the first pipelined request succeeds; it must not complete nor fail anything else
+    mega::HttpReq& first = fc.pipelined.front()->req;
+    first.in = response(102) + response(101);
+    first.httpstatus = 200;
+    first.contenttype = "application/octet-stream";
+    first.status = mega::REQ_SUCCESS;
+    fc.pipelineio();
+
+    ASSERT_EQ(std::vector<mega::handle>{2}, app.completed);
+    ASSERT_TRUE(app.failed.empty());
+    ASSERT_EQ(1u, fc.pipelined.size());
+    ASSERT_EQ(1u, fc.fafs[1].count(101));
+    ASSERT_EQ(1u, fc.fafs[1].count(103));
+
+    // the second gets an HTML page over HTTP: switch to HTTPS, as the channel's request would
+    mega::HttpReq& second = fc.pipelined.front()->req;
+    second.httpstatus = 200;
+    second.contenttype = "text/html";
+    second.status = mega::REQ_SUCCESS;
+    fc.pipelineio();
+
+    ASSERT_TRUE(fc.pipelined.empty());
+    ASSERT_TRUE(app.changedToHttps);
+    ASSERT_TRUE(client->usehttps);
+    ASSERT_EQ(0, fc.urltime);
+    ASSERT_EQ(1u, app.failed.size());
+    ASSERT_EQ(mega::API_EFAILED, app.failed[3]);
+
+    // the channel's request still reports its own error
+    fc.failed(fc.req, fc.e);
+    ASSERT_EQ(2u, app.failed.size());
+    ASSERT_EQ(mega::API_ENOENT, app.failed[1]);
+    ASSERT_TRUE(fc.fafs[1].empty());
+}
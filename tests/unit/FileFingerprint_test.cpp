@@ -24,6 +24,7 @@
 #include <gtest/gtest.h>
 
 #include <mega/filefingerprint.h>
+#include <mega/filesystem.h>
 
 #include "DefaultedFileAccess.h"
 
@@ -536,6 +537,75 @@ TEST(FileFingerprint, genfingerprint_InputStreamAccess_forLargeFile_butReadFails
     ASSERT_EQ(false, ffp.isvalid);
 }
 
+TEST(FileFingerprint, genfingerprint_StreamFileAccess_forTinyFile)
+{
+    mega::FileFingerprint ffp;
+    const std::vector<mega::byte> content = {3, 4, 5, 6};
+    auto stream = std::make_shared<mega::UploadStream>(content.size(), 1);
+    stream->append(content.data(), content.size());
+    stream->release(stream->size);
+    mega::StreamFileAccess fa{stream, nullptr};
+    ASSERT_TRUE(ffp.genfingerprint(&fa));
+    ASSERT_EQ(4, ffp.size);
+    ASSERT_EQ(1, ffp.mtime);
+    const std::array<int32_t, 4> expected = {100992003, 0, 0, 0};
+    ASSERT_EQ(expected, ffp.crc);
+    ASSERT_EQ(true, ffp.isvalid);
+}
+
+TEST(FileFingerprint, genfingerprint_StreamFileAccess_forSmallFile)
+{
+    mega::FileFingerprint ffp;
+    std::vector<mega::byte> content(100);
+    std::iota(content.begin(), content.end(), mega::byte{0});
+    auto stream = std::make_shared<mega::UploadStream>(content.size(), 1);
+    stream->append(content.data(), content.size());
+    stream->release(stream->size);
+    mega::StreamFileAccess fa{stream, nullptr};
+    ASSERT_TRUE(ffp.genfingerprint(&fa));
+    ASSERT_EQ(100, ffp.size);
+    ASSERT_EQ(1, ffp.mtime);
+    const std::array<int32_t, 4> expected = {215253208, 661795201, 937191950, 562141813};
+    ASSERT_EQ(expected, ffp.crc);
+    ASSERT_EQ(true, ffp.isvalid);
+}
+
+TEST(FileFingerprint, genfingerprint_StreamFileAccess_forLargeFile_releasedWhileReceived)
+{
+    mega::FileFingerprint ffp;
+    std::vector<mega::byte> content(20000);
+    std::iota(content.begin(), content.end(), mega::byte{0});
+    auto stream = std::make_shared<mega::UploadStream>(content.size(), 1);
+    for (size_t pos = 0; pos < content.size(); pos += 777)
+    {
+        const size_t len = std::min<size_t>(777, content.size() - pos);
+        stream->append(content.data() + pos, len);
+        stream->release(m_off_t(pos + len));
+    }
+    ASSERT_EQ(0, stream->buffered());
+    mega::StreamFileAccess fa{stream, nullptr};
+    ASSERT_TRUE(ffp.genfingerprint(&fa));
+    ASSERT_EQ(20000, ffp.size);
+    ASSERT_EQ(1, ffp.mtime);
+    const std::array<int32_t, 4> expected = {-1424885571, 1204627086, 1194313128, -177560448};
+    ASSERT_EQ(expected, ffp.crc);
+    ASSERT_EQ(true, ffp.isvalid);
+}
+
+TEST(FileFingerprint, genfingerprint_StreamFileAccess_forLargeFile_butAborted)
+{
+    mega::FileFingerprint ffp;
+    std::vector<mega::byte> content(20000);
+    std::iota(content.begin(), content.end(), mega::byte{0});
+    auto stream = std::make_shared<mega::UploadStream>(content.size(), 1);
+    stream->append(content.data(), 10000);
+    stream->abort();
+    mega::StreamFileAccess fa{stream, nullptr};
+    ASSERT_TRUE(ffp.genfingerprint(&fa));
+    ASSERT_EQ(-1, ffp.size);
+    ASSERT_EQ(false, ffp.isvalid);
+}
+
 TEST(FileFingerprint, light_genfingerprint)
 {
     mega::LightFileFingerprint ffp;
@@ -0,0 +1,175 @@
+/**
+ * (c) 2019 by Mega Limited, Wellsford, New Zealand
+ *
+ * This file is part of the MEGA SDK - Client Access Engine.
+ *
+ * Applications using the MEGA API must present a valid application key
+ * and comply with the the rules set forth in the Terms of Service.
+ *
+ * The MEGA SDK is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.
+ *
+ * @copyright Simplified (2-clause) BSD License.
+ *
+ * You should have received a copy of the license along with this
+ * program.
+ */
+
+#include <cstdlib>
+#include <memory>
+
+#include <gtest/gtest.h>
+
+#include <mega/filesystem.h>
+#include <mega/mega_utf8proc.h>
+
+#include "DefaultedFileSystemAccess.h"
+
+namespace {
+
+std::string normalized(std::string name)
+{
+    mt::DefaultedFileSystemAccess fsaccess;
+    fsaccess.normalize(&name);
+    return name;
+}
+
+std::string nfc(const std::string& name)
+{
+    char* result = (char*)utf8proc_NFC((const utf8proc_uint8_t*)name.c_str());
+    std::string s = result ? result : "";
+    free(result);
+    return s;
+}
+
+std::string utf8(int32_t codepoint)
+{
+    utf8proc_uint8_t buf[4];
+    return std::string((char*)buf, size_t(utf8proc_encode_char(codepoint, buf)));
+}
+
+} // anonymous
+
+TEST(FileSystemAccess, normalize_keepsAsciiAndComposedNames)
+{
+    ASSERT_EQ("Holidays 2019 (1).jpg", normalized("Holidays 2019 (1).jpg"));
+    ASSERT_EQ("caf\xc3\xa9", normalized("caf\xc3\xa9"));
+    ASSERT_EQ("\xe6\x97\xa5\xe6\x9c\xac", normalized("\xe6\x97\xa5\xe6\x9c\xac"));
+    ASSERT_EQ("", normalized(""));
+}
+
+TEST(FileSystemAccess, normalize_composesDecomposedNames)
+{
+    ASSERT_EQ("caf\xc3\xa9", normalized("cafe\xcc\x81"));
+
+    // Hangul L + V
+    ASSERT_EQ("\xea\xb0\x80", normalized("\xe1\x84\x80\xe1\x85\xa1"));
+
+    // longer than the stack buffer
+    std::string name, expected;
+    for (int i = 0; i < 300; i++)
+    {
+        name += "e\xcc\x81";
+        expected += "\xc3\xa9";
+    }
+    ASSERT_EQ(expected, normalized(name));
+}
+
+TEST(FileSystemAccess, normalize_keepsNulSeparatedSegments)
+{
+    std::string name("a\xcc\x8a", 3);
+    name.append("", 1);
+    name += "b";
+
+    std::string expected("\xc3\xa5", 2);
+    expected.append("", 1);
+    expected += "b";
+
+    ASSERT_EQ(expected, normalized(name));
+}
+
+TEST(FileSystemAccess, normalize_clearsInvalidUtf8)
+{
+    ASSERT_EQ("", normalized("abc\xff"));
+    ASSERT_EQ("", normalized("\xc3"));
+}
+
+TEST(FileSystemAccess, normalize_matchesUtf8procForEveryBmpCodepoint)
+{
+    for (int32_t c = 1; c < 0x10000; c++)
+    {
+        if (c >= 0xD800 && c < 0xE000)
+        {
+            continue;
+        }
+
+        // alone, and followed by a combining acute accent and a Hangul trailing consonant
+        const std::string s = utf8(c);
+        ASSERT_EQ(nfc(s), normalized(s)) << c;
+        ASSERT_EQ(nfc(s + "\xcc\x81"), normalized(s + "\xcc\x81")) << c;
+        ASSERT_EQ(nfc(s + "\xe1\x86\xa8"), normalized(s + "\xe1\x86\xa8")) << c;
+    }
+}
+
+TEST(UploadStream, read_waitsForData_thenReadsTheWindow)
+{
+    mega::UploadStream stream(100, 1);
+    const std::string data(60, 'x');
+    mega::byte buf[40];
+
+    ASSERT_EQ(mega::UploadStream::READ_PENDING, stream.read(buf, 40, 20, nullptr));
+
+    stream.append((const mega::byte*)data.data(), data.size());
+    ASSERT_EQ(mega::UploadStream::READ_OK, stream.read(buf, 40, 20, nullptr));
+    ASSERT_EQ(std::string(40, 'x'), std::string((char*)buf, 40));
+    ASSERT_EQ(mega::UploadStream::READ_PENDING, stream.read(buf, 40, 40, nullptr));
+    ASSERT_EQ(60, stream.buffered());
+}
+
+TEST(UploadStream, release_dropsDataAndCallsBack)
+{
+    mega::UploadStream stream(100, 1);
+    const std::string data(100, 'x');
+    mega::byte buf[10];
+    int released = 0;
+    stream.setreleasecallback([&released]() { ++released; });
+
+    stream.append((const mega::byte*)data.data(), data.size());
+    ASSERT_TRUE(stream.canrestart());
+
+    stream.release(70);
+    ASSERT_EQ(1, released);
+    ASSERT_EQ(30, stream.buffered());
+    ASSERT_FALSE(stream.canrestart());
+
+    // un-released data can still be read again, e.g. to repost a failed chunk
+    ASSERT_EQ(mega::UploadStream::READ_OK, stream.read(buf, 10, 80, nullptr));
+    ASSERT_EQ(mega::UploadStream::READ_FAILED, stream.read(buf, 10, 50, nullptr));
+
+    stream.release(50);
+    ASSERT_EQ(1, released);
+}
+
+TEST(UploadStream, abort_failsPendingReadsOfIncompleteBody)
+{
+    mega::UploadStream stream(100, 1);
+    const std::string data(50, 'x');
+    mega::byte buf[10];
+
+    stream.append((const mega::byte*)data.data(), data.size());
+    stream.abort();
+
+    ASSERT_EQ(mega::UploadStream::READ_OK, stream.read(buf, 10, 0, nullptr));
+    ASSERT_EQ(mega::UploadStream::READ_FAILED, stream.read(buf, 10, 60, nullptr));
+    ASSERT_FALSE(stream.canrestart());
+}
+
+TEST(UploadStream, abort_keepsCompleteBody)
+{
+    mega::UploadStream stream(10, 1);
+    const std::string data(10, 'x');
+    stream.append((const mega::byte*)data.data(), data.size());
+    stream.abort();
+    ASSERT_TRUE(stream.canrestart());
+}
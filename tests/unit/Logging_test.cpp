@@ -15,6 +15,9 @@
  * You should have received a copy of the license along with this
  * program.
  */
+#include <future>
+#include <thread>
+
 #include <gtest/gtest.h>
 
 #include <mega/logging.h>
@@ -339,6 +342,18 @@ private:
 
 #endif
 
+namespace {
+
+// asynchronous mode delivers on another thread
+void flushLogs()
+{
+#ifdef ENABLE_LOG_ASYNC
+    mega::SimpleLogger::flush();
+#endif
+}
+
+}
+
 TEST(Logging, toStr)
 {
     ASSERT_EQ(0, std::strcmp("verbose", mega::SimpleLogger::toStr(mega::LogLevel::logMax)));
@@ -364,6 +379,7 @@ TEST(Logging, macroVerbose)
         mega::SimpleLogger::setLogLevel(static_cast<mega::LogLevel>(level));
         const std::string msg = "foobar";
         LOG_verbose << msg;
+        flushLogs();
         const auto currentLevel = mega::LogLevel::logMax;
         if (level >= currentLevel)
         {
@@ -386,6 +402,7 @@ TEST(Logging, macroDebug)
         mega::SimpleLogger::setLogLevel(static_cast<mega::LogLevel>(level));
         const std::string msg = "foobar";
         LOG_debug << msg;
+        flushLogs();
         const auto currentLevel = mega::LogLevel::logDebug;
         if (level >= currentLevel)
         {
@@ -408,6 +425,7 @@ TEST(Logging, macroInfo)
         mega::SimpleLogger::setLogLevel(static_cast<mega::LogLevel>(level));
         const std::string msg = "foobar";
         LOG_info << msg;
+        flushLogs();
         const auto currentLevel = mega::LogLevel::logInfo;
         if (level >= currentLevel)
         {
@@ -430,6 +448,7 @@ TEST(Logging, macroWarn)
         mega::SimpleLogger::setLogLevel(static_cast<mega::LogLevel>(level));
         const std::string msg = "foobar";
         LOG_warn << msg;
+        flushLogs();
         const auto currentLevel = mega::LogLevel::logWarning;
         if (level >= currentLevel)
         {
@@ -452,6 +471,7 @@ TEST(Logging, macroErr)
         mega::SimpleLogger::setLogLevel(static_cast<mega::LogLevel>(level));
         const std::string msg = "foobar";
         LOG_err << msg;
+        flushLogs();
         const auto currentLevel = mega::LogLevel::logError;
         if (level >= currentLevel)
         {
@@ -474,8 +494,216 @@ TEST(Logging, macroFatal)
         mega::SimpleLogger::setLogLevel(static_cast<mega::LogLevel>(level));
         const std::string msg = "foobar";
         LOG_fatal << msg;
+        flushLogs();
         logger.checkLogLevel(mega::LogLevel::logFatal);
         ASSERT_EQ(1u, logger.mMessage.size());
         EXPECT_NE(logger.mMessage[0].find(msg), std::string::npos);
     }
 }
+
+namespace {
+
+struct DeliveredLog
+{
+    int level;
+    std::string source;
+    std::string message;
+};
+
+}
+
+TEST(Logging, logRecord_formatsValuesLikeStreams)
+{
+    const int x = 0;
+    mega::LogRecord record{mega::logInfo, "file.cpp", 13};
+    record.putString("a", 1);
+    record.putSigned(-42);
+    record.putUnsigned(std::numeric_limits<unsigned long long>::max());
+    record.putFloating(42.123);
+    record.putChar('c');
+    record.putPointer(&x);
+
+    std::ostringstream expected;
+    expected << "a" << -42 << std::numeric_limits<unsigned long long>::max() << 42.123 << 'c' << &x;
+
+    std::string source, message;
+    record.format(source, message);
+    ASSERT_EQ("file.cpp:13", source);
+    ASSERT_EQ(expected.str(), message);
+}
+
+TEST(Logging, logRecord_keepsLongLinesWhole)
+{
+    mega::LogRecord record{mega::logInfo, "file.cpp", -1};
+    std::ostringstream expected;
+    for (int i = 0; i < 100; ++i)
+    {
+        record.putString("value ", 6);
+        record.putSigned(i);
+        expected << "value " << i;
+    }
+    const std::string huge(5000, 'X');
+    record.putString(huge.data(), huge.size());
+    expected << huge;
+
+    mega::LogRecord moved;
+    moved = std::move(record);
+
+    std::string source, message;
+    moved.format(source, message);
+    ASSERT_EQ("file.cpp", source);
+    ASSERT_EQ(expected.str(), message);
+}
+
+TEST(Logging, asyncQueue_deliversEachThreadsRecordsInOrder)
+{
+    std::vector<DeliveredLog> delivered; // only touched by the queue's thread until flush()
+    mega::AsyncLogQueue queue{16, mega::logDebug, [&delivered](const char* time, int level, const char* source, const char* message) {
+        EXPECT_NE(nullptr, time);
+        delivered.push_back({level, source, message});
+    }};
+
+    const int threads = 4;
+    const int records = 1000;
+    std::vector<std::thread> producers;
+    for (int t = 0; t < threads; ++t)
+    {
+        producers.emplace_back([&queue, t]() {
+            for (int i = 0; i < records; ++i)
+            {
+                mega::LogRecord record{mega::logInfo, "producer", t};
+                record.putSigned(i);
+                EXPECT_TRUE(queue.push(record));
+            }
+        });
+    }
+    for (auto& p : producers)
+    {
+        p.join();
+    }
+    queue.flush();
+
+    ASSERT_EQ(size_t(threads * records), delivered.size());
+    std::vector<int> next(threads, 0);
+    for (auto& d : delivered)
+    {
+        const int t = d.source.back() - '0';
+        ASSERT_EQ(std::to_string(next[t]++), d.message);
+    }
+    ASSERT_EQ(0u, queue.dropped());
+}
+
+TEST(Logging, asyncQueue_dropsVerboseRecordsWhenFullAndReportsThem)
+{
+    std::promise<void> blocked;
+    std::promise<void> unblock;
+    std::shared_future<void> unblocked = unblock.get_future().share();
+    std::vector<DeliveredLog> delivered;
+    mega::AsyncLogQueue queue{4, mega::logDebug, [&](const char*, int level, const char* source, const char* message) {
+        if (delivered.empty())
+        {
+            blocked.set_value();
+            unblocked.wait();
+        }
+        delivered.push_back({level, source, message});
+    }};
+
+    auto push = [&queue](int i) {
+        mega::LogRecord record{mega::logDebug, "file.cpp", 13};
+        record.putSigned(i);
+        return queue.push(record);
+    };
+
+    // the first record keeps the queue's thread busy while the next ones fill the queue
+    ASSERT_TRUE(push(0));
+    blocked.get_future().wait();
+    for (int i = 1; i <= 4; ++i)
+    {
+        ASSERT_TRUE(push(i));
+    }
+    for (int i = 5; i < 8; ++i)
+    {
+        ASSERT_FALSE(push(i));
+    }
+    ASSERT_EQ(3u, queue.dropped());
+
+    unblock.set_value();
+    queue.flush();
+
+    ASSERT_EQ(6u, delivered.size());
+    for (int i = 0; i <= 4; ++i)
+    {
+        ASSERT_EQ(std::to_string(i), delivered[i].message);
+    }
+    ASSERT_EQ(mega::logWarning, delivered[5].level);
+    ASSERT_EQ(0u, delivered[5].message.find("3 log records dropped"));
+}
+
+TEST(Logging, asyncQueue_flushesOutputsAfterDelivering)
+{
+    std::atomic<int> delivered{0};
+    std::atomic<int> flushedAt{-1};
+    mega::AsyncLogQueue queue{16, mega::logDebug,
+        [&delivered](const char*, int, const char*, const char*) { ++delivered; },
+        [&delivered, &flushedAt]() { flushedAt = delivered.load(); }};
+
+    for (int i = 0; i < 10; ++i)
+    {
+        mega::LogRecord record{mega::logInfo, "file.cpp", i};
+        ASSERT_TRUE(queue.push(record));
+    }
+    queue.flush();
+    queue.stop();
+    ASSERT_EQ(10, flushedAt);
+
+    mega::LogRecord late{mega::logInfo, "file.cpp", 10};
+    ASSERT_TRUE(queue.push(late));
+    ASSERT_EQ(11, flushedAt);
+}
+
+TEST(Logging, asyncQueue_stopLosesNoRecordPushedConcurrently)
+{
+    std::atomic<int> delivered{0};
+    mega::AsyncLogQueue queue{64, mega::logDebug, [&delivered](const char*, int, const char*, const char*) {
+        ++delivered;
+    }};
+
+    const int threads = 4;
+    const int records = 2000;
+    std::vector<std::thread> producers;
+    for (int t = 0; t < threads; ++t)
+    {
+        producers.emplace_back([&queue]() {
+            for (int i = 0; i < records; ++i)
+            {
+                mega::LogRecord record{mega::logInfo, "producer", i};
+                EXPECT_TRUE(queue.push(record));
+            }
+        });
+    }
+    queue.stop();
+    for (auto& p : producers)
+    {
+        p.join();
+    }
+
+    ASSERT_EQ(threads * records, delivered);
+}
+
+TEST(Logging, asyncQueue_deliversSynchronouslyOnceStopped)
+{
+    std::vector<DeliveredLog> delivered;
+    mega::AsyncLogQueue queue{4, mega::logDebug, [&delivered](const char*, int level, const char* source, const char* message) {
+        delivered.push_back({level, source, message});
+    }};
+
+    mega::LogRecord first{mega::logError, "file.cpp", 1};
+    ASSERT_TRUE(queue.push(first));
+    queue.stop();
+    ASSERT_EQ(1u, delivered.size());
+
+    mega::LogRecord second{mega::logError, "file.cpp", 2};
+    ASSERT_TRUE(queue.push(second));
+    ASSERT_EQ(2u, delivered.size());
+    ASSERT_EQ("file.cpp:2", delivered[1].source);
+}
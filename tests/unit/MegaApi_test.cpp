@@ -42,6 +42,12 @@ unique_ptr<MegaStringList> createMegaStringList(const vector<const char*>& data)
         new MegaStringListPrivate{list.data(), static_cast<int>(list.size())}};
 }
 
+MegaNode* createMegaNode(MegaHandle h, const char* name)
+{
+    string nodekey, attrstring, fileattrstring;
+    return new MegaNodePrivate(name, MegaNode::TYPE_FILE, 1, 0, 0, h, &nodekey, &attrstring, &fileattrstring, nullptr, nullptr, UNDEF);
+}
+
 } // anonymous
 
 TEST(MegaApi, MegaStringList_get_and_size_happyPath)
@@ -217,3 +223,96 @@ TEST(MegaApi, getMimeType)
 
     ASSERT_EQ(600, successCount);
 }
+
+TEST(MegaApi, MegaNodeSnapshots_publishAndInvalidate)
+{
+    MegaNodeSnapshots snapshots;
+    ASSERT_EQ(nullptr, snapshots.get(1));
+
+    snapshots.publish(createMegaNode(1, "one"));
+    snapshots.publish(createMegaNode(17, "seventeen"));   // same shard
+
+    unique_ptr<MegaNode> one{snapshots.get(1)};
+    ASSERT_NE(nullptr, one);
+    ASSERT_STREQ("one", one->getName());
+
+    snapshots.publish(createMegaNode(1, "renamed"));
+    ASSERT_STREQ("one", one->getName());   // copies are independent of later publications
+    ASSERT_STREQ("renamed", unique_ptr<MegaNode>{snapshots.get(1)}->getName());
+
+    snapshots.invalidate(1);
+    ASSERT_EQ(nullptr, snapshots.get(1));
+    ASSERT_NE(nullptr, unique_ptr<MegaNode>{snapshots.get(17)});
+
+    snapshots.clear();
+    ASSERT_EQ(nullptr, snapshots.get(17));
+}
+
+TEST(MegaApi, MegaNodeSnapshots_keepsMostRecentlyUsed)
+{
+    MegaNodeSnapshots snapshots;
+
+    // all in the same shard, which holds MAXNODES / 16
+    const MegaHandle perShard = MegaNodeSnapshots::MAXNODES / 16;
+    for (MegaHandle i = 0; i < perShard; ++i)
+    {
+        snapshots.publish(createMegaNode(i * 16, "n"));
+    }
+    ASSERT_EQ(size_t(perShard), snapshots.size());
+
+    // reading the oldest makes the second oldest the next to go
+    ASSERT_NE(nullptr, unique_ptr<MegaNode>{snapshots.get(0)});
+    snapshots.publish(createMegaNode(perShard * 16, "n"));
+
+    ASSERT_EQ(size_t(perShard), snapshots.size());
+    ASSERT_NE(nullptr, unique_ptr<MegaNode>{snapshots.get(0)});
+    ASSERT_EQ(nullptr, snapshots.get(16));
+    ASSERT_NE(nullptr, unique_ptr<MegaNode>{snapshots.get(perShard * 16)});
+
+    snapshots.invalidate(0);
+    ASSERT_EQ(size_t(perShard - 1), snapshots.size());
+    snapshots.clear();
+    ASSERT_EQ(0u, snapshots.size());
+}
+
+TEST(MegaApi, MegaNodeSnapshots_concurrentReadersAndWriter)
+{
+    MegaNodeSnapshots snapshots;
+    for (MegaHandle h = 0; h < 64; ++h)
+    {
+        snapshots.publish(createMegaNode(h, "n"));
+    }
+
+    std::atomic<bool> done{false};
+    std::atomic<int> hits{0};
+    vector<std::thread> readers;
+    for (int t = 0; t < 4; ++t)
+    {
+        readers.emplace_back([&]()
+        {
+            for (MegaHandle h = 0; !done; h = (h + 1) % 64)
+            {
+                if (unique_ptr<MegaNode> n{snapshots.get(h)})
+                {
+                    EXPECT_EQ(h, n->getHandle());
+                    ++hits;
+                }
+            }
+        });
+    }
+
+    // keeps going until the readers have been scheduled
+    for (int round = 0; round < 1000 || !hits; ++round)
+    {
+        const MegaHandle h = MegaHandle(round % 64);
+        snapshots.invalidate(h);
+        snapshots.publish(createMegaNode(h, "n"));
+    }
+    done = true;
+
+    for (auto& t : readers)
+    {
+        t.join();
+    }
+    ASSERT_GT(hits, 0);
+}
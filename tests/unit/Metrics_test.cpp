@@ -0,0 +1,140 @@
+/**
+ * (c) 2019 by Mega Limited, Wellsford, New Zealand
+ *
+ * This file is part of the MEGA SDK - Client Access Engine.
+ *
+ * Applications using the MEGA API must present a valid application key
+ * and comply with the the rules set forth in the Terms of Service.
+ *
+ * The MEGA SDK is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.
+ *
+ * @copyright Simplified (2-clause) BSD License.
+ *
+ * You should have received a copy of the license along with this
+ * program.
+ */
+
+#include <thread>
+
+#include <gtest/gtest.h>
+
+#include <mega/metrics.h>
+
+TEST(Metrics, counter_add)
+{
+    std::vector<mega::Metric*> registry;
+    mega::MetricCounter c{registry, "c_total", "help"};
+    ASSERT_EQ(1u, registry.size());
+    ASSERT_EQ(0u, c.value());
+    c.add();
+    c.add(41);
+    ASSERT_EQ(42u, c.value());
+}
+
+TEST(Metrics, counter_addFromManyThreads)
+{
+    std::vector<mega::Metric*> registry;
+    mega::MetricCounter c{registry, "c_total", "help"};
+    std::vector<std::thread> threads;
+    for (int t = 4; t--; )
+    {
+        threads.emplace_back([&c]() { for (int i = 10000; i--; ) c.add(); });
+    }
+    for (auto& t : threads)
+    {
+        t.join();
+    }
+    ASSERT_EQ(40000u, c.value());
+}
+
+TEST(Metrics, histogram_buckets)
+{
+    std::vector<mega::Metric*> registry;
+    mega::MetricHistogram h{registry, "h_seconds", "help"};
+    h.observeMicroseconds(0);
+    h.observeMicroseconds(1);
+    h.observeMicroseconds(2);
+    h.observeMicroseconds(3);
+    h.observeMicroseconds(1000);
+    h.observeMicroseconds(uint64_t(1) << 40);
+
+    ASSERT_EQ(6u, h.count());
+    ASSERT_EQ(2u, h.bucket(0));     // <= 1us
+    ASSERT_EQ(1u, h.bucket(1));     // <= 2us
+    ASSERT_EQ(1u, h.bucket(2));     // <= 4us
+    ASSERT_EQ(1u, h.bucket(10));    // <= 1024us
+    ASSERT_EQ(1u, h.bucket(mega::MetricHistogram::BUCKETS));
+    ASSERT_EQ(1006u + (uint64_t(1) << 40), h.sumMicroseconds());
+}
+
+TEST(Metrics, histogram_prometheusIsCumulative)
+{
+    std::vector<mega::Metric*> registry;
+    mega::MetricHistogram h{registry, "h_seconds", "help", "op", "x"};
+    h.observeMicroseconds(1);
+    h.observeMicroseconds(3);
+    h.observeMicroseconds(uint64_t(1) << 40);
+
+    std::string out;
+    h.appendPrometheus(out);
+    ASSERT_NE(std::string::npos, out.find("h_seconds_bucket{op=\"x\",le=\"1e-06\"} 1\n"));
+    ASSERT_NE(std::string::npos, out.find("h_seconds_bucket{op=\"x\",le=\"4e-06\"} 2\n"));
+    ASSERT_NE(std::string::npos, out.find("h_seconds_bucket{op=\"x\",le=\"+Inf\"} 3\n"));
+    ASSERT_NE(std::string::npos, out.find("h_seconds_count{op=\"x\"} 3\n"));
+}
+
+TEST(Metrics, histogram_jsonListsNonEmptyBuckets)
+{
+    std::vector<mega::Metric*> registry;
+    mega::MetricHistogram h{registry, "h_seconds", "help"};
+    h.observeMicroseconds(1000);
+    h.observeMicroseconds(1000);
+
+    std::string out;
+    h.appendJson(out);
+    ASSERT_EQ("{\"name\":\"h_seconds\",\"type\":\"histogram\",\"count\":2,\"sum\":0.002,\"buckets\":{\"0.001024\":2}}", out);
+}
+
+TEST(Metrics, gauge_json)
+{
+    std::vector<mega::Metric*> registry;
+    mega::MetricGauge g{registry, "queued", "help", "direction", "upload"};
+    g.set(7);
+    g.set(-3);
+
+    std::string out;
+    g.appendJson(out);
+    ASSERT_EQ("{\"name\":\"queued\",\"type\":\"gauge\",\"labels\":{\"direction\":\"upload\"},\"value\":-3}", out);
+}
+
+TEST(Metrics, gaugeShares_addUp)
+{
+    std::vector<mega::Metric*> registry;
+    mega::MetricGauge g{registry, "queued", "help"};
+    {
+        mega::MetricGaugeShare a{g};
+        mega::MetricGaugeShare b{g};
+        a.set(5);
+        b.set(3);
+        ASSERT_EQ(8, g.value());
+
+        a.set(2);
+        ASSERT_EQ(5, g.value());
+    }
+    ASSERT_EQ(0, g.value());
+}
+
+TEST(Metrics, prometheus_oneHeaderPerName)
+{
+    const std::string out = mega::Metrics::get().prometheus();
+    size_t headers = 0;
+    for (size_t pos = 0; (pos = out.find("# TYPE mega_prepwait_total counter\n", pos)) != std::string::npos; pos++)
+    {
+        headers++;
+    }
+    ASSERT_EQ(1u, headers);
+    ASSERT_NE(std::string::npos, out.find("mega_prepwait_total{reason=\"sleep\"} "));
+    ASSERT_NE(std::string::npos, out.find("mega_transfer_bytes_total{direction=\"download\"} "));
+}
@@ -0,0 +1,509 @@
+/**
+ * (c) 2019 by Mega Limited, Wellsford, New Zealand
+ *
+ * This file is part of the MEGA SDK - Client Access Engine.
+ *
+ * Applications using the MEGA API must present a valid application key
+ * and comply with the the rules set forth in the Terms of Service.
+ *
+ * The MEGA SDK is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.
+ *
+ * @copyright Simplified (2-clause) BSD License.
+ *
+ * You should have received a copy of the license along with this
+ * program.
+ */
+
+#include <algorithm>
+#include <map>
+#include <set>
+
+#include <gtest/gtest.h>
+
+#include <mega/megaclient.h>
+#include <mega/megaapp.h>
+#include <mega/base64.h>
+#include <mega/node.h>
+#include <mega/treeproc.h>
+
+#include "DefaultedFileSystemAccess.h"
+#include "utils.h"
+
+namespace {
+
+class MockFileSystemAccess : public mt::DefaultedFileSystemAccess
+{
+};
+
+mega::Node& makeNode(mega::MegaClient& client, mega::nodetype_t type, mega::handle handle, mega::Node* parent, m_off_t size = -1, mega::m_time_t ctime = 0)
+{
+    mega::node_vector dp;
+    return *new mega::Node{&client, &dp, handle, parent ? parent->nodehandle : mega::UNDEF, type, size, mega::UNDEF, nullptr, ctime}; // owned by the client
+}
+
+// the totals a full walk of the subtree yields
+mega::NodeCounter walk(const mega::Node& n)
+{
+    mega::NodeCounter nc;
+    for (const mega::Node* child : n.children)
+    {
+        nc += walk(*child);
+    }
+    if (n.type == mega::FILENODE)
+    {
+        nc.files++;
+        nc.storage += n.size;
+        if (n.parent && n.parent->type == mega::FILENODE)
+        {
+            nc.versions++;
+            nc.versionStorage += n.size;
+        }
+    }
+    else if (n.type == mega::FOLDERNODE)
+    {
+        nc.folders++;
+    }
+    return nc;
+}
+
+void checkCounts(const mega::Node& n)
+{
+    const mega::NodeCounter expected = walk(n);
+    const mega::NodeCounter& actual = n.subnodeCounts();
+    ASSERT_EQ(expected.files, actual.files);
+    ASSERT_EQ(expected.folders, actual.folders);
+    ASSERT_EQ(expected.versions, actual.versions);
+    ASSERT_EQ(expected.storage, actual.storage);
+    ASSERT_EQ(expected.versionStorage, actual.versionStorage);
+}
+
+// records every node it is handed
+class CollectingTreeProc : public mega::TreeProc
+{
+public:
+    std::vector<mega::Node*> visited;
+
+    void proc(mega::MegaClient*, mega::Node* n) override
+    {
+        visited.push_back(n);
+    }
+};
+
+std::multiset<mega::Node*> runParallel(mega::MegaClient& client, mega::Node& n, unsigned threads, bool skipversions)
+{
+    std::vector<CollectingTreeProc> procs(threads);
+    std::vector<mega::TreeProc*> tps;
+    for (auto& p : procs)
+    {
+        tps.push_back(&p);
+    }
+    client.proctreeparallel(&n, tps, false, skipversions);
+
+    std::multiset<mega::Node*> all;
+    for (auto& p : procs)
+    {
+        all.insert(p.visited.begin(), p.visited.end());
+    }
+    return all;
+}
+
+} // anonymous
+
+TEST(Node, subnodeCounts_maintainedOnAttachAndMove)
+{
+    mega::MegaApp app;
+    MockFileSystemAccess fsaccess;
+    auto client = mt::makeClient(app, fsaccess);
+
+    auto& root = makeNode(*client, mega::ROOTNODE, 1, nullptr);
+    auto& a = makeNode(*client, mega::FOLDERNODE, 2, &root);
+    auto& b = makeNode(*client, mega::FOLDERNODE, 3, &a);
+    auto& f1 = makeNode(*client, mega::FILENODE, 4, &b, 100);
+    makeNode(*client, mega::FILENODE, 5, &f1, 50);
+    makeNode(*client, mega::FILENODE, 6, &a, 10);
+
+    checkCounts(root);
+    ASSERT_EQ(3u, root.subnodeCounts().files);
+    ASSERT_EQ(1u, root.subnodeCounts().versions);
+    ASSERT_EQ(160, root.subnodeCounts().storage);
+    ASSERT_EQ(50, root.subnodeCounts().versionStorage);
+    ASSERT_EQ(2u, a.subnodeCounts().folders);
+
+    ASSERT_TRUE(b.setparent(&root));
+    checkCounts(root);
+    checkCounts(a);
+    ASSERT_EQ(10, a.subnodeCounts().storage);
+    ASSERT_EQ(150, b.subnodeCounts().storage);
+    ASSERT_EQ(1u, a.subnodeCounts().folders);
+}
+
+TEST(Node, subnodeCounts_fileBecomesVersionWhenMovedUnderFile)
+{
+    mega::MegaApp app;
+    MockFileSystemAccess fsaccess;
+    auto client = mt::makeClient(app, fsaccess);
+
+    auto& root = makeNode(*client, mega::ROOTNODE, 1, nullptr);
+    auto& older = makeNode(*client, mega::FILENODE, 2, &root, 30);
+    auto& newer = makeNode(*client, mega::FILENODE, 3, &root, 40);
+
+    ASSERT_TRUE(older.setparent(&newer));
+    checkCounts(root);
+    ASSERT_EQ(1u, root.subnodeCounts().versions);
+    ASSERT_EQ(30, newer.subnodeCounts().versionStorage);
+
+    ASSERT_TRUE(older.setparent(&root));
+    checkCounts(root);
+    ASSERT_EQ(0u, root.subnodeCounts().versions);
+    ASSERT_EQ(0, newer.subnodeCounts().versionStorage);
+}
+
+TEST(Node, subnodeCounts_maintainedOnDelete)
+{
+    mega::MegaApp app;
+    MockFileSystemAccess fsaccess;
+    auto client = mt::makeClient(app, fsaccess);
+
+    auto& root = makeNode(*client, mega::ROOTNODE, 1, nullptr);
+    auto& a = makeNode(*client, mega::FOLDERNODE, 2, &root);
+    auto& f = makeNode(*client, mega::FILENODE, 3, &a, 100);
+    makeNode(*client, mega::FILENODE, 4, &root, 7);
+
+    client->nodes.erase(f.nodehandle);
+    delete &f;
+    checkCounts(root);
+    ASSERT_EQ(7, root.subnodeCounts().storage);
+    ASSERT_EQ(0, a.subnodeCounts().storage);
+
+    client->nodes.erase(a.nodehandle);
+    delete &a;
+    checkCounts(root);
+    ASSERT_EQ(0u, root.subnodeCounts().folders);
+}
+
+TEST(Node, purgenodes_deletesWholeTreeInAnyOrder)
+{
+    mega::MegaApp app;
+    MockFileSystemAccess fsaccess;
+    auto client = mt::makeClient(app, fsaccess);
+
+    // more nodes than one pool slab, parents typically deleted before their children
+    auto& root = makeNode(*client, mega::ROOTNODE, 1, nullptr);
+    mega::handle h = 2;
+    for (int i = 0; i < 50; ++i)
+    {
+        auto& folder = makeNode(*client, mega::FOLDERNODE, h++, &root);
+        for (int j = 0; j < 40; ++j)
+        {
+            makeNode(*client, mega::FILENODE, h++, &folder, 10, 1000 + j);
+        }
+    }
+    ASSERT_EQ(2051u, client->nodes.size());
+
+    client->purgenodesusersabortsc();
+    ASSERT_TRUE(client->nodes.empty());
+    ASSERT_EQ(0, client->mFingerprints.getSumSizes());
+
+    auto& newroot = makeNode(*client, mega::ROOTNODE, 1, nullptr);
+    makeNode(*client, mega::FILENODE, 2, &newroot, 5);
+    checkCounts(newroot);
+    ASSERT_EQ(5, newroot.subnodeCounts().storage);
+}
+
+TEST(Node, allocator_freesEmptySlabsWhileOtherNodesLive)
+{
+    mega::MegaApp app;
+    MockFileSystemAccess fsaccess;
+    auto client = mt::makeClient(app, fsaccess);
+    auto other = mt::makeClient(app, fsaccess);
+
+    const size_t slabs = mega::Node::allocatorslabs();
+
+    // a node that outlives the large tree below, as in a second MegaApi
+    auto& kept = makeNode(*other, mega::ROOTNODE, 1, nullptr);
+
+    auto& root = makeNode(*client, mega::ROOTNODE, 1, nullptr);
+    for (mega::handle h = 2; h < 20000; ++h)
+    {
+        makeNode(*client, mega::FILENODE, h, &root, 1);
+    }
+    ASSERT_GE(mega::Node::allocatorslabs(), slabs + 19);
+
+    // only the slab with the surviving node and a spare remain
+    client->purgenodesusersabortsc();
+    ASSERT_LE(mega::Node::allocatorslabs(), slabs + 2);
+    ASSERT_EQ(mega::ROOTNODE, kept.type);
+}
+
+TEST(Node, childnodebyname_indexFollowsRenamesAndMoves)
+{
+    mega::MegaApp app;
+    MockFileSystemAccess fsaccess;
+    auto client = mt::makeClient(app, fsaccess);
+
+    auto& root = makeNode(*client, mega::ROOTNODE, 1, nullptr);
+    auto& other = makeNode(*client, mega::FOLDERNODE, 2, &root);
+    for (mega::handle h = 100; h < 200; ++h)
+    {
+        auto& n = makeNode(*client, mega::FILENODE, h, &root, 1);
+        n.attrs.map['n'] = "file" + std::to_string(h);
+    }
+
+    auto& f = *client->nodebyhandle(150);
+    ASSERT_EQ(&f, client->childnodebyname(&root, "file150"));
+    ASSERT_EQ(nullptr, client->childnodebyname(&root, "renamed"));
+
+    f.attrs.map['n'] = "renamed";
+    f.namechanged();
+    ASSERT_EQ(&f, client->childnodebyname(&root, "renamed"));
+    ASSERT_EQ(nullptr, client->childnodebyname(&root, "file150"));
+
+    ASSERT_TRUE(f.setparent(&other));
+    ASSERT_EQ(nullptr, client->childnodebyname(&root, "renamed"));
+    ASSERT_EQ(&f, client->childnodebyname(&other, "renamed"));
+
+    ASSERT_TRUE(f.setparent(&root));
+    ASSERT_EQ(&f, client->childnodebyname(&root, "renamed"));
+
+    auto& g = *client->nodebyhandle(160);
+    client->nodes.erase(g.nodehandle);
+    delete &g;
+    ASSERT_EQ(nullptr, client->childnodebyname(&root, "file160"));
+}
+
+TEST(Node, childnodesbyname_duplicatesInChildrenOrder)
+{
+    mega::MegaApp app;
+    MockFileSystemAccess fsaccess;
+    auto client = mt::makeClient(app, fsaccess);
+
+    auto& root = makeNode(*client, mega::ROOTNODE, 1, nullptr);
+    std::vector<mega::Node*> dups;
+    for (mega::handle h = 100; h < 200; ++h)
+    {
+        auto& n = makeNode(*client, h % 10 ? mega::FILENODE : mega::FOLDERNODE, h, &root, 1);
+        n.attrs.map['n'] = h % 3 ? "x" + std::to_string(h) : "dup";
+        if (h % 3 == 0)
+        {
+            dups.push_back(&n);
+        }
+    }
+
+    ASSERT_EQ(dups, client->childnodesbyname(&root, "dup"));
+
+    // the first matching folder wins, otherwise the last matching file
+    ASSERT_EQ(client->nodebyhandle(120), client->childnodebyname(&root, "dup"));
+    ASSERT_EQ(dups.front(), client->childnodebyname(&root, "dup", true));
+    ASSERT_EQ(client->nodebyhandle(101), client->childnodebyname(&root, "x101"));
+}
+
+TEST(Node, getRecentNodes_newestFirstWithoutVersionsOrRubbish)
+{
+    mega::MegaApp app;
+    MockFileSystemAccess fsaccess;
+    auto client = mt::makeClient(app, fsaccess);
+
+    auto& root = makeNode(*client, mega::ROOTNODE, 1, nullptr);
+    auto& rubbish = makeNode(*client, mega::RUBBISHNODE, 2, nullptr);
+    auto& a = makeNode(*client, mega::FILENODE, 10, &root, 1, 100);
+    auto& b = makeNode(*client, mega::FILENODE, 11, &root, 1, 300);
+    makeNode(*client, mega::FILENODE, 12, &b, 1, 250);          // version of b
+    makeNode(*client, mega::FILENODE, 13, &rubbish, 1, 400);
+    auto& c = makeNode(*client, mega::FILENODE, 14, &root, 1, 200);
+    makeNode(*client, mega::FOLDERNODE, 15, &root, -1, 500);
+
+    ASSERT_EQ((mega::node_vector{&b, &c, &a}), client->getRecentNodes(10, 0, false));
+    ASSERT_EQ((mega::node_vector{&b, &c}), client->getRecentNodes(2, 0, false));
+    ASSERT_EQ((mega::node_vector{&b, &c}), client->getRecentNodes(10, 200, false));
+    ASSERT_EQ(client->nodebyhandle(13), client->getRecentNodes(10, 0, true).front());
+
+    // the index follows deletions
+    client->nodes.erase(c.nodehandle);
+    delete &c;
+    ASSERT_EQ((mega::node_vector{&b, &a}), client->getRecentNodes(10, 0, false));
+}
+
+TEST(Node, proctreeparallel_visitsEveryNodeOnce)
+{
+    mega::MegaApp app;
+    MockFileSystemAccess fsaccess;
+    auto client = mt::makeClient(app, fsaccess);
+
+    // a few thousand nodes in uneven folders, so that workers have to share out subtrees
+    auto& root = makeNode(*client, mega::ROOTNODE, 1, nullptr);
+    std::vector<mega::Node*> folders{&root};
+    std::multiset<mega::Node*> everything{&root}, withoutVersions{&root};
+    mega::handle h = 2;
+    for (int i = 0; i < 5000; ++i)
+    {
+        mega::Node* parent = folders[mt::nextRandomInt() % folders.size()];
+        auto& n = makeNode(*client, i % 4 ? mega::FILENODE : mega::FOLDERNODE, h++, parent, 1);
+        everything.insert(&n);
+        withoutVersions.insert(&n);
+        if (n.type == mega::FOLDERNODE)
+        {
+            folders.push_back(&n);
+        }
+        else if (i % 7 == 0)
+        {
+            everything.insert(&makeNode(*client, mega::FILENODE, h++, &n, 1));
+        }
+    }
+
+    for (unsigned threads : {1u, 2u, 8u})
+    {
+        ASSERT_EQ(everything, runParallel(*client, root, threads, false)) << threads << " threads";
+        ASSERT_EQ(withoutVersions, runParallel(*client, root, threads, true)) << threads << " threads";
+    }
+}
+
+TEST(Node, sortinproctreeorder_matchesSequentialWalk)
+{
+    mega::MegaApp app;
+    MockFileSystemAccess fsaccess;
+    auto client = mt::makeClient(app, fsaccess);
+
+    auto& root = makeNode(*client, mega::ROOTNODE, 1, nullptr);
+    std::vector<mega::Node*> folders{&root};
+    mega::handle h = 2;
+    for (int i = 0; i < 2000; ++i)
+    {
+        mega::Node* parent = folders[mt::nextRandomInt() % folders.size()];
+        auto& n = makeNode(*client, i % 4 ? mega::FILENODE : mega::FOLDERNODE, h++, parent, 1);
+        if (n.type == mega::FOLDERNODE)
+        {
+            folders.push_back(&n);
+        }
+    }
+
+    CollectingTreeProc sequential;
+    client->proctree(&root, &sequential);
+
+    // whatever order the parallel walk happened to merge them in
+    for (unsigned threads : {1u, 4u})
+    {
+        std::vector<CollectingTreeProc> procs(threads);
+        std::vector<mega::TreeProc*> tps;
+        for (auto& p : procs)
+        {
+            tps.push_back(&p);
+        }
+        client->proctreeparallel(&root, tps);
+
+        mega::node_vector merged;
+        for (auto& p : procs)
+        {
+            merged.insert(merged.end(), p.visited.begin(), p.visited.end());
+        }
+        std::reverse(merged.begin(), merged.end());
+
+        mega::MegaClient::sortinproctreeorder(merged, &root);
+        ASSERT_EQ(sequential.visited, merged) << threads << " threads";
+    }
+
+    // a subset keeps the relative order
+    mega::node_vector some{sequential.visited[1500], sequential.visited[3], sequential.visited[700]};
+    mega::MegaClient::sortinproctreeorder(some, &root);
+    ASSERT_EQ((mega::node_vector{sequential.visited[3], sequential.visited[700], sequential.visited[1500]}), some);
+}
+
+TEST(Node, applykeysbatch_unwrapsMasterAndShareKeys)
+{
+    mega::MegaApp app;
+    MockFileSystemAccess fsaccess;
+    auto client = mt::makeClient(app, fsaccess);
+
+    std::string masterKey(mega::SymmCipher::KEYLENGTH, '\0'), shareKey(mega::SymmCipher::KEYLENGTH, '\0');
+    for (size_t i = 0; i < masterKey.size(); ++i)
+    {
+        masterKey[i] = static_cast<char>(mt::nextRandomByte());
+        shareKey[i] = static_cast<char>(mt::nextRandomByte());
+    }
+    client->key.setkey(reinterpret_cast<const mega::byte*>(masterKey.data()));
+
+    auto& root = makeNode(*client, mega::ROOTNODE, 1, nullptr);
+    auto& share = makeNode(*client, mega::FOLDERNODE, 2, &root);
+    share.sharekey = new mega::SymmCipher(reinterpret_cast<const mega::byte*>(shareKey.data()));
+    const std::string shareHandle = mega::Base64::btoa(std::string(reinterpret_cast<const char*>(&share.nodehandle), mega::MegaClient::NODEHANDLE));
+
+    std::map<mega::Node*, std::string> expected;
+    for (mega::handle h = 10; h < 110; ++h)
+    {
+        const bool viaShare = h % 3 == 0;
+        auto& n = makeNode(*client, h % 2 ? mega::FILENODE : mega::FOLDERNODE, h, viaShare ? &share : &root, 1);
+
+        std::string key(n.type == mega::FILENODE ? mega::FILENODEKEYLENGTH : mega::FOLDERNODEKEYLENGTH, '\0');
+        for (auto& c : key)
+        {
+            c = static_cast<char>(mt::nextRandomByte());
+        }
+        std::string wrapped = key;
+        (viaShare ? *share.sharekey : client->key).ecb_encrypt(reinterpret_cast<mega::byte*>(&wrapped[0]), nullptr, wrapped.size());
+        n.setkeyfromjson(((viaShare ? shareHandle + ":" : std::string()) + mega::Base64::btoa(wrapped)).c_str());
+        expected[&n] = key;
+    }
+
+    // wrapped with the key of a share we don't have: stays pending
+    auto& pending = makeNode(*client, mega::FILENODE, 200, &root, 1);
+    pending.setkeyfromjson("AAAAAAAA:AAAAAAAAAAAAAAAAAAAAAAAAAAAAAAAAAAAAAAAAAAA");
+
+    client->applykeysbatch();
+
+    for (auto& e : expected)
+    {
+        ASSERT_TRUE(e.first->keyApplied());
+        ASSERT_EQ(e.second, e.first->nodekey());
+    }
+    ASSERT_FALSE(pending.keyApplied());
+    ASSERT_EQ(100, client->mAppliedKeyNodeCount);
+}
+
+TEST(Node, decryptattrs_largeBatchMatchesSetattr)
+{
+    mega::MegaApp app;
+    MockFileSystemAccess fsaccess;
+    auto client = mt::makeClient(app, fsaccess);
+
+    // enough nodes for the work to be spread across threads
+    auto& root = makeNode(*client, mega::ROOTNODE, 1, nullptr);
+    mega::node_vector batch;
+    for (mega::handle h = 100; h < 100 + 3 * mega::MegaClient::ATTRSPERTHREAD; ++h)
+    {
+        auto& n = makeNode(*client, mega::FOLDERNODE, h, &root);
+        mega::byte key[mega::FOLDERNODEKEYLENGTH];
+        for (auto& b : key)
+        {
+            b = mt::nextRandomByte();
+        }
+        n.installkey(key);
+
+        std::string encrypted;
+        mega::SymmCipher cipher(key);
+        client->makeattr(&cipher, &encrypted, ("\"n\":\"folder" + std::to_string(h) + "\"").c_str());
+        if (h % 10 == 0)
+        {
+            encrypted[0] = static_cast<char>(encrypted[0] ^ 1);    // corrupt: stays encrypted
+        }
+        n.attrstring = new std::string(mega::Base64::btoa(encrypted));
+        batch.push_back(&n);
+    }
+
+    client->decryptattrs(batch);
+
+    for (mega::Node* n : batch)
+    {
+        if (n->nodehandle % 10 == 0)
+        {
+            ASSERT_NE(nullptr, n->attrstring);
+            ASSERT_EQ(0u, n->attrs.map.count('n'));
+        }
+        else
+        {
+            ASSERT_EQ(nullptr, n->attrstring);
+            ASSERT_EQ("folder" + std::to_string(n->nodehandle), n->attrs.map['n']);
+            ASSERT_EQ(n, client->childnodebyname(&root, ("folder" + std::to_string(n->nodehandle)).c_str()));
+        }
+    }
+}
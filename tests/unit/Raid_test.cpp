@@ -0,0 +1,272 @@
+/**
+ * (c) 2019 by Mega Limited, Wellsford, New Zealand
+ *
+ * This file is part of the MEGA SDK - Client Access Engine.
+ *
+ * Applications using the MEGA API must present a valid application key
+ * and comply with the the rules set forth in the Terms of Service.
+ *
+ * The MEGA SDK is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.
+ *
+ * @copyright Simplified (2-clause) BSD License.
+ *
+ * You should have received a copy of the license along with this
+ * program.
+ */
+
+#include <gtest/gtest.h>
+
+#include <mega/raid.h>
+
+#include "utils.h"
+
+namespace {
+
+std::string randomData(size_t len)
+{
+    std::string s(len, '\0');
+    for (auto& c : s)
+    {
+        c = static_cast<char>(mt::nextRandomByte());
+    }
+    return s;
+}
+
+// split a file into its six raid parts, each truncated to the size the storage servers serve
+std::vector<std::string> makeRaidParts(const std::string& file)
+{
+    std::string padded = file;
+    padded.resize((file.size() + mega::RAIDLINE - 1) / mega::RAIDLINE * mega::RAIDLINE, '\0');
+
+    std::vector<std::string> parts(mega::RAIDPARTS);
+    for (size_t line = 0; line < padded.size(); line += mega::RAIDLINE)
+    {
+        std::string parity(mega::RAIDSECTOR, '\0');
+        for (unsigned p = 1; p < mega::RAIDPARTS; ++p)
+        {
+            const char* sector = padded.data() + line + (p - 1) * mega::RAIDSECTOR;
+            parts[p].append(sector, mega::RAIDSECTOR);
+            for (unsigned i = mega::RAIDSECTOR; i--; )
+            {
+                parity[i] = static_cast<char>(parity[i] ^ sector[i]);
+            }
+        }
+        parts[0] += parity;
+    }
+
+    for (unsigned p = 0; p < mega::RAIDPARTS; ++p)
+    {
+        parts[p].resize(static_cast<size_t>(mega::RaidBufferManager::raidPartSize(p, static_cast<m_off_t>(file.size()))));
+    }
+    return parts;
+}
+
+// the sector by sector reassembly that raidInterleave replaced
+std::string referenceInterleave(const std::vector<const mega::byte*>& inputbufs, size_t partslen)
+{
+    std::string out;
+    for (size_t i = 0; i < partslen; i += mega::RAIDSECTOR)
+    {
+        for (unsigned j = 1; j < mega::RAIDPARTS; ++j)
+        {
+            mega::byte sector[mega::RAIDSECTOR] = {};
+            if (inputbufs[j])
+            {
+                memcpy(sector, inputbufs[j] + i, mega::RAIDSECTOR);
+            }
+            else
+            {
+                for (unsigned k = 0; k < mega::RAIDPARTS; ++k)
+                {
+                    for (unsigned b = 0; inputbufs[k] && b < mega::RAIDSECTOR; ++b)
+                    {
+                        sector[b] ^= inputbufs[k][i + b];
+                    }
+                }
+            }
+            out.append(reinterpret_cast<char*>(sector), mega::RAIDSECTOR);
+        }
+    }
+    return out;
+}
+
+// no decryption or mac boundaries, so the output is the plain reassembled file
+class PassThroughBufferManager : public mega::RaidBufferManager
+{
+    void finalize(FilePiece&) override {}
+    m_off_t calcOutputChunkPos(m_off_t acquiredpos) override { return acquiredpos; }
+};
+
+// releases output only up to multiples of CHUNK, holding the rest over like TransferBufferManager does at mac boundaries
+class ChunkedBufferManager : public mega::RaidBufferManager
+{
+public:
+    static const m_off_t CHUNK = 1024;
+
+private:
+    void finalize(FilePiece&) override {}
+    m_off_t calcOutputChunkPos(m_off_t acquiredpos) override { return acquiredpos - acquiredpos % CHUNK; }
+};
+
+// feeds each part in pieces of at most pieceLen bytes, draining the output after every round
+std::string downloadThroughBufferManager(mega::RaidBufferManager& rbm, const std::string& file, unsigned missingPart, size_t pieceLen)
+{
+    const auto size = static_cast<m_off_t>(file.size());
+    const auto parts = makeRaidParts(file);
+
+    rbm.setIsRaid(std::vector<std::string>(mega::RAIDPARTS, "http://localhost/"), 0, size, size, 1 << 20);
+
+    std::string out;
+    for (size_t pos = 0; pos < parts[0].size(); pos += pieceLen)
+    {
+        for (unsigned i = 0; i < mega::RAIDPARTS; ++i)
+        {
+            const size_t len = std::min(pieceLen, parts[i].size() - std::min(pos, parts[i].size()));
+            if (!len)
+            {
+                continue;
+            }
+            if (i == missingPart)
+            {
+                rbm.submitBuffer(i, new mega::RaidBufferManager::FilePiece(m_off_t(pos), new mega::HttpReq::http_buf_t(nullptr, 0, len)));
+            }
+            else
+            {
+                auto piece = new mega::RaidBufferManager::FilePiece(m_off_t(pos), len);
+                memcpy(piece->buf.datastart(), parts[i].data() + pos, len);
+                rbm.submitBuffer(i, piece);
+            }
+        }
+
+        while (auto piece = rbm.getAsyncOutputBufferPointer(0))
+        {
+            EXPECT_EQ(m_off_t(out.size()), piece->pos);
+            out.append(reinterpret_cast<char*>(piece->buf.datastart()), piece->buf.datalen());
+            rbm.bufferWriteCompleted(0, true);
+        }
+    }
+    return out;
+}
+
+std::string downloadThroughBufferManager(const std::string& file, unsigned missingPart)
+{
+    PassThroughBufferManager rbm;
+    return downloadThroughBufferManager(rbm, file, missingPart, file.size());
+}
+
+} // anonymous
+
+TEST(Raid, raidInterleave_allPartsPresent)
+{
+    const auto file = randomData(mega::RAIDLINE * 1000);
+    const auto parts = makeRaidParts(file);
+    const mega::byte* inputbufs[mega::RAIDPARTS];
+    for (unsigned i = 0; i < mega::RAIDPARTS; ++i)
+    {
+        inputbufs[i] = reinterpret_cast<const mega::byte*>(parts[i].data());
+    }
+
+    std::string out(file.size(), '\0');
+    mega::raidInterleave(reinterpret_cast<mega::byte*>(&out[0]), inputbufs, parts[1].size());
+    ASSERT_EQ(file, out);
+}
+
+TEST(Raid, raidInterleave_eachPartMissing_matchesReference)
+{
+    const auto file = randomData(mega::RAIDLINE * 1000);
+    const auto parts = makeRaidParts(file);
+
+    for (unsigned missing = 0; missing < mega::RAIDPARTS; ++missing)
+    {
+        std::vector<const mega::byte*> inputbufs(mega::RAIDPARTS);
+        for (unsigned i = 0; i < mega::RAIDPARTS; ++i)
+        {
+            inputbufs[i] = i == missing ? nullptr : reinterpret_cast<const mega::byte*>(parts[i].data());
+        }
+
+        std::string out(file.size(), '\0');
+        mega::raidInterleave(reinterpret_cast<mega::byte*>(&out[0]), inputbufs.data(), parts[1].size());
+        ASSERT_EQ(referenceInterleave(inputbufs, parts[1].size()), out) << "missing part " << missing;
+        ASSERT_EQ(file, out) << "missing part " << missing;
+    }
+}
+
+TEST(Raid, RaidBufferManager_reassemblesAnySize)
+{
+    for (size_t size : {1, 15, 16, 79, 80, 81, 1000, 65536, 1000003})
+    {
+        const auto file = randomData(size);
+        for (unsigned missing = 0; missing <= mega::RAIDPARTS; ++missing)
+        {
+            ASSERT_EQ(file, downloadThroughBufferManager(file, missing)) << "size " << size << " missing part " << missing;
+        }
+    }
+}
+
+TEST(Raid, RaidBufferManager_holdsOverPartialChunks)
+{
+    for (size_t size : {1000, 1024, 5000, 65536, 100003})
+    {
+        const auto file = randomData(size);
+        for (unsigned missing = 0; missing <= mega::RAIDPARTS; ++missing)
+        {
+            ChunkedBufferManager rbm;
+            ASSERT_EQ(file, downloadThroughBufferManager(rbm, file, missing, 160)) << "size " << size << " missing part " << missing;
+        }
+    }
+}
+
+TEST(Raid, FilePiece_reusesPooledBuffers)
+{
+    mega::DownloadBufferPool::Activity activity;
+    activity.set(true);
+
+    mega::byte* first;
+    {
+        mega::RaidBufferManager::FilePiece piece(0, 100000);
+        first = piece.buf.datastart();
+    }
+    ASSERT_GE(mega::DownloadBufferPool::get().pooled(), 100000u);
+
+    mega::RaidBufferManager::FilePiece piece(0, 100000);
+    ASSERT_EQ(first, piece.buf.datastart());
+}
+
+TEST(Raid, DownloadBufferPool_sizeClasses)
+{
+    ASSERT_EQ(size_t(4096), mega::DownloadBufferPool::capacity(64));
+    ASSERT_EQ(size_t(65536), mega::DownloadBufferPool::capacity(40000));
+    ASSERT_EQ(size_t(128 << 10), mega::DownloadBufferPool::capacity(128 << 10));
+
+    // a chunk plus cipher padding stays close to its size
+    ASSERT_EQ(size_t(9 << 17), mega::DownloadBufferPool::capacity((1 << 20) + 16));
+}
+
+TEST(Raid, DownloadBufferPool_keepsBuffersOnlyWhileActive)
+{
+    {
+        mega::DownloadBufferPool::Activity activity;
+        activity.set(true);
+        mega::DownloadBufferPool::get().acquire(100000);
+        ASSERT_GE(mega::DownloadBufferPool::get().pooled(), 100000u);
+    }
+    ASSERT_EQ(0u, mega::DownloadBufferPool::get().pooled());
+
+    mega::DownloadBufferPool::get().acquire(100000);
+    ASSERT_EQ(0u, mega::DownloadBufferPool::get().pooled());
+}
+
+TEST(Raid, http_buf_t_shareKeepsMemoryAlive)
+{
+    std::unique_ptr<mega::HttpReq::http_buf_t> tail;
+    {
+        mega::HttpReq::http_buf_t buf(mega::DownloadBufferPool::get().acquire(64), 0, 64);
+        memset(buf.datastart(), 'x', 64);
+        tail.reset(buf.share(48, 64));
+        buf.end = 48;
+    }
+    ASSERT_EQ(16u, tail->datalen());
+    ASSERT_EQ(std::string(16, 'x'), std::string(reinterpret_cast<char*>(tail->datastart()), tail->datalen()));
+}
@@ -18,10 +18,13 @@
 
 #include <gtest/gtest.h>
 
+#include <mega/db.h>
 #include <mega/megaclient.h>
 #include <mega/megaapp.h>
 #include <mega/transfer.h>
+#include <mega/transferslot.h>
 
+#include "DefaultedFileAccess.h"
 #include "DefaultedFileSystemAccess.h"
 #include "utils.h"
 
@@ -30,6 +33,67 @@ namespace
 
 class MockFileSystemAccess : public mt::DefaultedFileSystemAccess
 {
+public:
+    std::unique_ptr<mega::FileAccess> newfileaccess(bool = true) override
+    {
+        return std::unique_ptr<mega::FileAccess>{new mt::DefaultedFileAccess};
+    }
+};
+
+using Records = std::map<uint32_t, std::string>;
+
+class MockDbTable : public mega::DbTable
+{
+public:
+    MockDbTable(mega::PrnGen& rng, Records& records)
+        : DbTable(rng, false)
+        , mRecords(records)
+    {}
+
+    void rewind() override { mCursor = mRecords.begin(); }
+    bool next(uint32_t* id, std::string* data) override
+    {
+        if (mCursor == mRecords.end())
+        {
+            return false;
+        }
+        *id = mCursor->first;
+        *data = mCursor->second;
+        ++mCursor;
+        return true;
+    }
+    bool get(uint32_t id, std::string* data) override
+    {
+        auto it = mRecords.find(id);
+        return it != mRecords.end() && (*data = it->second, true);
+    }
+    bool put(uint32_t id, char* data, unsigned len) override { mRecords[id].assign(data, len); return true; }
+    bool del(uint32_t id) override { mRecords.erase(id); return true; }
+    void truncate() override { mRecords.clear(); }
+    void begin() override {}
+    void commit() override {}
+    void abort() override {}
+    void remove() override {}
+
+private:
+    Records& mRecords;
+    Records::iterator mCursor;
+};
+
+class MockDbAccess : public mega::DbAccess
+{
+public:
+    explicit MockDbAccess(Records& records)
+        : mRecords(records)
+    {}
+
+    mega::DbTable* open(mega::PrnGen& rng, mega::FileSystemAccess*, std::string*, bool, bool) override
+    {
+        return new MockDbTable(rng, mRecords);
+    }
+
+private:
+    Records& mRecords;
 };
 
 void checkTransfers(const mega::Transfer& exp, const mega::Transfer& act)
@@ -145,3 +209,230 @@ TEST(Transfer, unserialize_32bit)
     auto newTf = std::unique_ptr<mega::Transfer>{mega::Transfer::unserialize(client.get(), &d, &tfMap)};
     checkTransfers(tf, *newTf);
 }
+
+TEST(Transfer, progressJournal_replayedOnResumption)
+{
+    mega::MegaApp app;
+    MockFileSystemAccess fsaccess;
+    Records records;
+
+    std::string expected;
+    {
+        auto client = mt::makeClient(app, fsaccess);
+        client->dbaccess = new MockDbAccess(records);
+        client->enabletransferresumption();
+        ASSERT_NE(nullptr, client->tctable);
+
+        mega::Transfer tf{client.get(), mega::GET};
+        tf.localfilename = "foo";
+        tf.lastaccesstime = mega::m_time();
+
+        mega::DBTableTransactionCommitter committer(client->tctable);
+
+        // without a full record there is nothing to journal against
+        tf.chunkmacs[0].offset = 100;
+        client->transferprogresscacheadd(&tf, &committer);
+        ASSERT_EQ(1u, records.size());
+        ASSERT_TRUE(tf.journaldbids.empty());
+
+        tf.chunkmacs[0].finished = true;
+        client->transferprogresscacheadd(&tf, &committer);
+        tf.chunkmacs[131072].offset = 200;
+        client->transferprogresscacheadd(&tf, &committer);
+        ASSERT_EQ(3u, records.size());
+        ASSERT_EQ(2u, tf.journaldbids.size());
+
+        tf.chunkmacs.serialize(expected);
+        tf.skipserialization = true;  // keep the records when tf goes away
+    }
+
+    auto client = mt::makeClient(app, fsaccess);
+    client->dbaccess = new MockDbAccess(records);
+    client->enabletransferresumption();
+    ASSERT_EQ(1u, client->cachedtransfers[mega::GET].size());
+
+    mega::Transfer* tf = client->cachedtransfers[mega::GET].begin()->second;
+    std::string replayed;
+    tf->chunkmacs.serialize(replayed);
+    ASSERT_EQ(expected, replayed);
+    ASSERT_EQ(2u, tf->journaldbids.size());
+
+    // compaction rewrites the transfer and drops the journal
+    mega::DBTableTransactionCommitter committer(client->tctable);
+    while (!tf->journaldbids.empty())
+    {
+        client->transferprogresscacheadd(tf, &committer);
+    }
+    ASSERT_EQ(1u, records.size());
+}
+
+TEST(Transfer, progressJournal_orphanEntriesDiscarded)
+{
+    mega::MegaApp app;
+    MockFileSystemAccess fsaccess;
+    Records records;
+
+    mega::TransferJournalEntry entry;
+    entry.transferdbid = 12345;
+    entry.chunkmacs[0].finished = true;
+    {
+        auto client = mt::makeClient(app, fsaccess);
+        client->dbaccess = new MockDbAccess(records);
+        client->enabletransferresumption();
+
+        mega::DBTableTransactionCommitter committer(client->tctable);
+        client->tctable->put(mega::MegaClient::CACHEDTRANSFERJOURNAL, &entry, &client->tckey);
+    }
+    ASSERT_EQ(1u, records.size());
+
+    auto client = mt::makeClient(app, fsaccess);
+    client->dbaccess = new MockDbAccess(records);
+    client->enabletransferresumption();
+    ASSERT_TRUE(records.empty());
+}
+
+TEST(Transfer, TransferList_nexttransferSkipsUnavailable)
+{
+    mega::MegaApp app;
+    MockFileSystemAccess fsaccess;
+    auto client = mt::makeClient(app, fsaccess);
+    mega::TransferList& list = client->transferlist;
+    mega::DBTableTransactionCommitter committer(nullptr);
+
+    std::vector<std::unique_ptr<mega::Transfer>> tfs;
+    for (int i = 0; i < 6; ++i)
+    {
+        tfs.emplace_back(new mega::Transfer(client.get(), mega::GET));
+        list.addtransfer(tfs.back().get(), committer);
+    }
+    ASSERT_EQ(tfs[0].get(), list.nexttransfer(mega::GET));
+
+    ASSERT_EQ(mega::API_OK, list.pause(tfs[0].get(), true, committer));
+    ASSERT_EQ(tfs[1].get(), list.nexttransfer(mega::GET));
+
+    tfs[1]->state = mega::TRANSFERSTATE_RETRYING;
+    tfs[1]->bt.backoff(1000);
+    ASSERT_EQ(tfs[2].get(), list.nexttransfer(mega::GET));
+
+    list.movetofirst(tfs[4].get(), committer);
+    ASSERT_EQ(tfs[4].get(), list.nexttransfer(mega::GET));
+
+    ASSERT_EQ(mega::API_OK, list.pause(tfs[4].get(), true, committer));
+    ASSERT_EQ(mega::API_OK, list.pause(tfs[0].get(), false, committer));
+    ASSERT_EQ(tfs[0].get(), list.nexttransfer(mega::GET));
+
+    // still backing off until the backoff is aborted
+    ASSERT_EQ(mega::API_OK, list.pause(tfs[0].get(), true, committer));
+    ASSERT_EQ(tfs[2].get(), list.nexttransfer(mega::GET));
+    tfs[1]->bt.arm();
+    list.abortbackoff(mega::GET);
+    ASSERT_EQ(tfs[1].get(), list.nexttransfer(mega::GET));
+
+    tfs[1].reset();
+    ASSERT_EQ(tfs[2].get(), list.nexttransfer(mega::GET));
+}
+
+TEST(Transfer, TransferRateController_keepsConnectionsThatHelp)
+{
+    // throughput grows with connections until the link saturates at 3
+    auto windowBytes = [](unsigned connections) { return m_off_t(std::min(connections, 3u)) << 20; };
+
+    mega::TransferRateController rc(1, 6, 16 << 20, 16 << 20);
+    mega::dstime now = 1;
+    auto runWindow = [&]() {
+        now += mega::TransferRateController::WINDOWDS;
+        rc.transferred(windowBytes(rc.connections()), now);
+    };
+
+    rc.transferred(0, now);
+    for (int i = 4; i--; )
+    {
+        runWindow();
+    }
+    ASSERT_EQ(3u, rc.connections());    // climbed to 4, found it no better, went back
+
+    int atBest = 0;
+    for (int i = 0; i < 60; ++i)
+    {
+        runWindow();
+        ASSERT_GE(rc.connections(), 2u);
+        ASSERT_LE(rc.connections(), 4u);
+        atBest += rc.connections() == 3;
+    }
+    ASSERT_GT(atBest, 45);  // occasional probes either side only
+}
+
+TEST(Transfer, TransferRateController_requestSizeFollowsRequestDuration)
+{
+    const m_off_t maxSize = 32 << 20;
+    mega::TransferRateController rc(4, 4, 4 << 20, maxSize);
+    ASSERT_EQ(4 << 20, rc.requestsize());
+
+    // slow requests shrink, down to the minimum
+    mega::dstime now = 1;
+    for (int i = 10; i--; )
+    {
+        rc.requeststarted(0, now);
+        now += mega::TransferRateController::SLOWREQUESTDS + 1;
+        rc.requestcompleted(0, rc.requestsize(), now);
+    }
+    ASSERT_EQ(mega::TransferRateController::MINREQUESTSIZE, rc.requestsize());
+
+    // a short request at the end of a file says nothing about the link
+    rc.requeststarted(1, now);
+    rc.requestcompleted(1, 4096, now + 1);
+    ASSERT_EQ(mega::TransferRateController::MINREQUESTSIZE, rc.requestsize());
+
+    // fast requests grow past where they started, up to the maximum
+    for (int i = 10; i--; )
+    {
+        rc.requeststarted(1, now);
+        now += 1;
+        rc.requestcompleted(1, rc.requestsize(), now);
+    }
+    ASSERT_EQ(maxSize, rc.requestsize());
+
+    // failures halve both, once for all the connections failing together
+    rc.requestfailed(now);
+    rc.requestfailed(now);
+    rc.requestfailed(now + 1);
+    ASSERT_EQ(2u, rc.connections());
+    ASSERT_EQ(maxSize / 2, rc.requestsize());
+
+    // and again if they keep failing
+    now += mega::TransferRateController::WINDOWDS;
+    rc.requestfailed(now);
+    ASSERT_EQ(1u, rc.connections());
+    ASSERT_EQ(maxSize / 4, rc.requestsize());
+}
+
+TEST(Transfer, TransferSlot_probesPastConfiguredConnections)
+{
+    mega::MegaApp app;
+    MockFileSystemAccess fsaccess;
+    auto client = mt::makeClient(app, fsaccess);
+    client->connections[mega::PUT] = 2;
+
+    mega::Transfer transfer(client.get(), mega::PUT);
+    transfer.size = 100 << 20;
+    mega::TransferSlot slot(&transfer);
+    std::vector<std::string> tempurls{"http://upload.example"};
+    slot.transferbuf.setIsRaid(&transfer, tempurls, 0, slot.maxRequestSize);
+    ASSERT_TRUE(slot.createconnectionsonce());
+
+    // room for every connection the controller may find worthwhile, starting from the configured ones
+    ASSERT_EQ(int(mega::MegaClient::MAX_NUM_CONNECTIONS), slot.connections);
+    ASSERT_TRUE(slot.ratecontroller);
+    ASSERT_EQ(2u, slot.ratecontroller->connections());
+    ASSERT_EQ(slot.maxRequestSize, slot.ratecontroller->requestsize());
+
+    // a link that keeps scaling takes it past the configured count
+    mega::dstime now = 1;
+    slot.ratecontroller->transferred(0, now);
+    for (int i = 20; i--; )
+    {
+        now += mega::TransferRateController::WINDOWDS;
+        slot.ratecontroller->transferred(m_off_t(slot.ratecontroller->connections()) << 20, now);
+    }
+    ASSERT_EQ(unsigned(mega::MegaClient::MAX_NUM_CONNECTIONS), slot.ratecontroller->connections());
+}
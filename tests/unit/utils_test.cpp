@@ -34,3 +34,38 @@ TEST(utils, hashCombine_integer)
     ASSERT_EQ(2654435811ull, hash);
 #endif
 }
+
+TEST(utils, naturalsortkey_order)
+{
+    // each name sorts strictly before the next
+    const std::vector<std::string> names = {
+        "",
+        "1",
+        "02",
+        "9",
+        "10",
+        "100",
+        "a",
+        "a1",
+        "a2",
+        "a10",
+        "a10b",
+        "A10c",
+        "a 1",
+        "ab",
+        "b",
+        "file 2.txt",
+        "file 10.txt",
+        "File 11.txt",
+    };
+
+    for (size_t i = 1; i < names.size(); ++i)
+    {
+        ASSERT_LT(mega::naturalsortkey(names[i - 1].c_str()), mega::naturalsortkey(names[i].c_str())) << names[i - 1] << " < " << names[i];
+    }
+}
+
+TEST(utils, naturalsortkey_equalIgnoringCaseAndLeadingZeros)
+{
+    ASSERT_EQ(mega::naturalsortkey("Photo 7.JPG"), mega::naturalsortkey("photo 007.jpg"));
+}